@@ -30,6 +30,23 @@ struct pwm_handle {
     unsigned int channel;
     uint64_t period_ns;
 
+    /* Attribute file descriptors, kept open for the lifetime of the handle */
+    int period_fd;
+    int duty_cycle_fd;
+    int enable_fd;
+    int polarity_fd;
+
+    /* Last known attribute values, used to skip redundant writes */
+    struct {
+        bool period_valid;
+        bool duty_cycle_valid;
+        bool enabled_valid;
+        bool polarity_valid;
+        uint64_t duty_cycle_ns;
+        bool enabled;
+        pwm_polarity_t polarity;
+    } cache;
+
     struct {
         int c_errno;
         char errmsg[96];
@@ -62,10 +79,45 @@ pwm_t *pwm_new(void) {
 
     pwm->chip = -1;
     pwm->channel = -1;
+    pwm->period_fd = -1;
+    pwm->duty_cycle_fd = -1;
+    pwm->enable_fd = -1;
+    pwm->polarity_fd = -1;
 
     return pwm;
 }
 
+static void pwm_close_attributes(pwm_t *pwm) {
+    int *fds[] = {&pwm->period_fd, &pwm->duty_cycle_fd, &pwm->enable_fd, &pwm->polarity_fd};
+
+    for (unsigned int i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+
+    memset(&pwm->cache, 0, sizeof(pwm->cache));
+}
+
+static int pwm_open_attributes(pwm_t *pwm) {
+    static const char *names[] = {"period", "duty_cycle", "enable", "polarity"};
+    int *fds[] = {&pwm->period_fd, &pwm->duty_cycle_fd, &pwm->enable_fd, &pwm->polarity_fd};
+    char path[P_PATH_MAX];
+
+    for (unsigned int i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        snprintf(path, sizeof(path), "/sys/class/pwm/pwmchip%u/pwm%u/%s", pwm->chip, pwm->channel, names[i]);
+
+        if ((*fds[i] = open(path, O_RDWR)) < 0) {
+            int errsv = errno;
+            pwm_close_attributes(pwm);
+            return _pwm_error(pwm, PWM_ERROR_OPEN, errsv, "Opening PWM: opening 'pwm%u/%s'", pwm->channel, names[i]);
+        }
+    }
+
+    return 0;
+}
+
 int pwm_open(pwm_t *pwm, unsigned int chip, unsigned int channel) {
     char channel_path[P_PATH_MAX];
     struct stat stat_buf;
@@ -130,11 +182,23 @@ int pwm_open(pwm_t *pwm, unsigned int chip, unsigned int channel) {
     memset(pwm, 0, sizeof(pwm_t));
     pwm->chip = chip;
     pwm->channel = channel;
+    pwm->period_fd = -1;
+    pwm->duty_cycle_fd = -1;
+    pwm->enable_fd = -1;
+    pwm->polarity_fd = -1;
 
-    ret = pwm_get_period_ns(pwm, &pwm->period_ns);
-    if (ret < 0)
+    if ((ret = pwm_open_attributes(pwm)) < 0)
         return ret;
 
+    /* Prime the period and duty cycle caches */
+    uint64_t duty_cycle_ns;
+
+    if ((ret = pwm_get_period_ns(pwm, &pwm->period_ns)) < 0 ||
+            (ret = pwm_get_duty_cycle_ns(pwm, &duty_cycle_ns)) < 0) {
+        pwm_close_attributes(pwm);
+        return ret;
+    }
+
     return 0;
 }
 
@@ -155,6 +219,8 @@ int pwm_close(pwm_t *pwm) {
     if (pwm->channel == ((unsigned int) -1))
         return 0;
 
+    pwm_close_attributes(pwm);
+
     /* Unexport the PWM */
     snprintf(path, sizeof(path), "/sys/class/pwm/pwmchip%u/unexport", pwm->chip);
 
@@ -182,46 +248,21 @@ void pwm_free(pwm_t *pwm) {
     free(pwm);
 }
 
-static int pwm_read_attribute(pwm_t *pwm, const char *name, char *buf, size_t len) {
-    char path[P_PATH_MAX];
-    int fd, ret;
-
-    snprintf(path, sizeof(path), "/sys/class/pwm/pwmchip%u/pwm%u/%s", pwm->chip, pwm->channel, name);
+static int pwm_read_attribute(pwm_t *pwm, int fd, const char *name, char *buf, size_t len) {
+    ssize_t ret;
 
-    if ((fd = open(path, O_RDONLY)) < 0)
-        return _pwm_error(pwm, PWM_ERROR_QUERY, errno, "Opening PWM '%s'", name);
-
-    if ((ret = read(fd, buf, len)) < 0) {
-        int errsv = errno;
-        close(fd);
-        return _pwm_error(pwm, PWM_ERROR_QUERY, errsv, "Reading PWM '%s'", name);
-    }
-
-    if (close(fd) < 0)
-        return _pwm_error(pwm, PWM_ERROR_QUERY, errno, "Closing PWM '%s'", name);
+    /* Reading a sysfs attribute from offset 0 regenerates its contents */
+    if ((ret = pread(fd, buf, len - 1, 0)) < 0)
+        return _pwm_error(pwm, PWM_ERROR_QUERY, errno, "Reading PWM '%s'", name);
 
     buf[ret] = '\0';
 
     return 0;
 }
 
-static int pwm_write_attribute(pwm_t *pwm, const char *name, const char *buf, size_t len) {
-    char path[P_PATH_MAX];
-    int fd;
-
-    snprintf(path, sizeof(path), "/sys/class/pwm/pwmchip%u/pwm%u/%s", pwm->chip, pwm->channel, name);
-
-    if ((fd = open(path, O_WRONLY)) < 0)
-        return _pwm_error(pwm, PWM_ERROR_CONFIGURE, errno, "Opening PWM '%s'", name);
-
-    if (write(fd, buf, len) < 0) {
-        int errsv = errno;
-        close(fd);
-        return _pwm_error(pwm, PWM_ERROR_CONFIGURE, errsv, "Writing PWM '%s'", name);
-    }
-
-    if (close(fd) < 0)
-        return _pwm_error(pwm, PWM_ERROR_CONFIGURE, errno, "Closing PWM '%s'", name);
+static int pwm_write_attribute(pwm_t *pwm, int fd, const char *name, const char *buf, size_t len) {
+    if (pwrite(fd, buf, len, 0) < 0)
+        return _pwm_error(pwm, PWM_ERROR_CONFIGURE, errno, "Writing PWM '%s'", name);
 
     return 0;
 }
@@ -230,7 +271,7 @@ int pwm_get_enabled(pwm_t *pwm, bool *enabled) {
     char buf[2];
     int ret;
 
-    if ((ret = pwm_read_attribute(pwm, "enable", buf, sizeof(buf))) < 0)
+    if ((ret = pwm_read_attribute(pwm, pwm->enable_fd, "enable", buf, sizeof(buf))) < 0)
         return ret;
 
     if (buf[0] == '0')
@@ -240,6 +281,9 @@ int pwm_get_enabled(pwm_t *pwm, bool *enabled) {
     else
         return _pwm_error(pwm, PWM_ERROR_QUERY, errno, "Unknown PWM 'enabled' value");
 
+    pwm->cache.enabled = *enabled;
+    pwm->cache.enabled_valid = true;
+
     return 0;
 }
 
@@ -248,7 +292,7 @@ int pwm_get_period_ns(pwm_t *pwm, uint64_t *period_ns) {
     int ret;
     uint64_t value;
 
-    if ((ret = pwm_read_attribute(pwm, "period", buf, sizeof(buf))) < 0)
+    if ((ret = pwm_read_attribute(pwm, pwm->period_fd, "period", buf, sizeof(buf))) < 0)
         return ret;
 
     errno = 0;
@@ -258,6 +302,7 @@ int pwm_get_period_ns(pwm_t *pwm, uint64_t *period_ns) {
 
     /* Cache the period for fast duty cycle updates */
     pwm->period_ns = value;
+    pwm->cache.period_valid = true;
 
     *period_ns = value;
 
@@ -269,7 +314,7 @@ int pwm_get_duty_cycle_ns(pwm_t *pwm, uint64_t *duty_cycle_ns) {
     int ret;
     uint64_t value;
 
-    if ((ret = pwm_read_attribute(pwm, "duty_cycle", buf, sizeof(buf))) < 0)
+    if ((ret = pwm_read_attribute(pwm, pwm->duty_cycle_fd, "duty_cycle", buf, sizeof(buf))) < 0)
         return ret;
 
     errno = 0;
@@ -277,6 +322,9 @@ int pwm_get_duty_cycle_ns(pwm_t *pwm, uint64_t *duty_cycle_ns) {
     if (errno != 0)
         return _pwm_error(pwm, PWM_ERROR_QUERY, errno, "Unknown PWM 'duty_cycle' value");
 
+    pwm->cache.duty_cycle_ns = value;
+    pwm->cache.duty_cycle_valid = true;
+
     *duty_cycle_ns = value;
 
     return 0;
@@ -322,7 +370,7 @@ int pwm_get_polarity(pwm_t *pwm, pwm_polarity_t *polarity) {
     int ret;
     char buf[16];
 
-    if ((ret = pwm_read_attribute(pwm, "polarity", buf, sizeof(buf))) < 0)
+    if ((ret = pwm_read_attribute(pwm, pwm->polarity_fd, "polarity", buf, sizeof(buf))) < 0)
         return ret;
 
     if (strcmp(buf, "normal\n") == 0)
@@ -332,11 +380,27 @@ int pwm_get_polarity(pwm_t *pwm, pwm_polarity_t *polarity) {
     else
         return _pwm_error(pwm, PWM_ERROR_QUERY, errno, "Unknown PWM 'polarity' value");
 
+    pwm->cache.polarity = *polarity;
+    pwm->cache.polarity_valid = true;
+
     return 0;
 }
 
 int pwm_set_enabled(pwm_t *pwm, bool enabled) {
-    return pwm_write_attribute(pwm, "enable", enabled ? "1\n" : "0\n", 2);
+    int ret;
+
+    if (pwm->cache.enabled_valid && pwm->cache.enabled == enabled)
+        return 0;
+
+    if ((ret = pwm_write_attribute(pwm, pwm->enable_fd, "enable", enabled ? "1\n" : "0\n", 2)) < 0) {
+        pwm->cache.enabled_valid = false;
+        return ret;
+    }
+
+    pwm->cache.enabled = enabled;
+    pwm->cache.enabled_valid = true;
+
+    return 0;
 }
 
 int pwm_set_period_ns(pwm_t *pwm, uint64_t period_ns) {
@@ -344,13 +408,19 @@ int pwm_set_period_ns(pwm_t *pwm, uint64_t period_ns) {
     int len;
     int ret;
 
+    if (pwm->cache.period_valid && pwm->period_ns == period_ns)
+        return 0;
+
     len = snprintf(buf, sizeof(buf), "%" PRId64 "\n", period_ns);
 
-    if ((ret = pwm_write_attribute(pwm, "period", buf, len)) < 0)
+    if ((ret = pwm_write_attribute(pwm, pwm->period_fd, "period", buf, len)) < 0) {
+        pwm->cache.period_valid = false;
         return ret;
+    }
 
     /* Cache the period for fast duty cycle updates */
     pwm->period_ns = period_ns;
+    pwm->cache.period_valid = true;
 
     return 0;
 }
@@ -358,10 +428,47 @@ int pwm_set_period_ns(pwm_t *pwm, uint64_t period_ns) {
 int pwm_set_duty_cycle_ns(pwm_t *pwm, uint64_t duty_cycle_ns) {
     char buf[32];
     int len;
+    int ret;
+
+    if (pwm->cache.duty_cycle_valid && pwm->cache.duty_cycle_ns == duty_cycle_ns)
+        return 0;
 
     len = snprintf(buf, sizeof(buf), "%" PRId64 "\n", duty_cycle_ns);
 
-    return pwm_write_attribute(pwm, "duty_cycle", buf, len);
+    if ((ret = pwm_write_attribute(pwm, pwm->duty_cycle_fd, "duty_cycle", buf, len)) < 0) {
+        pwm->cache.duty_cycle_valid = false;
+        return ret;
+    }
+
+    pwm->cache.duty_cycle_ns = duty_cycle_ns;
+    pwm->cache.duty_cycle_valid = true;
+
+    return 0;
+}
+
+int pwm_set_period_duty_cycle_ns(pwm_t *pwm, uint64_t period_ns, uint64_t duty_cycle_ns) {
+    uint64_t current_duty_cycle_ns;
+    int ret;
+
+    if (duty_cycle_ns > period_ns)
+        return _pwm_error(pwm, PWM_ERROR_ARG, 0, "PWM duty cycle exceeds period");
+
+    if (!pwm->cache.duty_cycle_valid && (ret = pwm_get_duty_cycle_ns(pwm, &current_duty_cycle_ns)) < 0)
+        return ret;
+
+    /* The kernel rejects any intermediate state with duty_cycle > period, so
+     * shrink the duty cycle first when the new period is below it */
+    if (period_ns < pwm->cache.duty_cycle_ns) {
+        if ((ret = pwm_set_duty_cycle_ns(pwm, duty_cycle_ns)) < 0)
+            return ret;
+
+        return pwm_set_period_ns(pwm, period_ns);
+    }
+
+    if ((ret = pwm_set_period_ns(pwm, period_ns)) < 0)
+        return ret;
+
+    return pwm_set_duty_cycle_ns(pwm, duty_cycle_ns);
 }
 
 int pwm_set_period(pwm_t *pwm, double period) {
@@ -389,6 +496,7 @@ int pwm_set_frequency(pwm_t *pwm, double frequency) {
 
 int pwm_set_polarity(pwm_t *pwm, pwm_polarity_t polarity) {
     const char *buf;
+    int ret;
 
     if (polarity == PWM_POLARITY_NORMAL)
         buf = "normal\n";
@@ -397,7 +505,18 @@ int pwm_set_polarity(pwm_t *pwm, pwm_polarity_t polarity) {
     else
         return _pwm_error(pwm, PWM_ERROR_ARG, 0, "Invalid PWM polarity (can be normal, inversed)");
 
-    return pwm_write_attribute(pwm, "polarity", buf, strlen(buf));
+    if (pwm->cache.polarity_valid && pwm->cache.polarity == polarity)
+        return 0;
+
+    if ((ret = pwm_write_attribute(pwm, pwm->polarity_fd, "polarity", buf, strlen(buf))) < 0) {
+        pwm->cache.polarity_valid = false;
+        return ret;
+    }
+
+    pwm->cache.polarity = polarity;
+    pwm->cache.polarity_valid = true;
+
+    return 0;
 }
 
 unsigned int pwm_chip(pwm_t *pwm) {
@@ -21,6 +21,15 @@
 
 #include "spi.h"
 
+/* SPI_IOC_MESSAGE() size field is 14 bits wide */
+#define SPI_BATCH_MAX_SEGMENTS  (((1 << _IOC_SIZEBITS) - 1) / sizeof(struct spi_ioc_transfer))
+
+struct spi_batch {
+    struct spi_ioc_transfer *xfers;
+    size_t count;
+    size_t capacity;
+};
+
 struct spi_handle {
     int fd;
 
@@ -164,6 +173,77 @@ int spi_transfer(spi_t *spi, const uint8_t *txbuf, uint8_t *rxbuf, size_t len) {
     return 0;
 }
 
+spi_batch_t *spi_batch_new(size_t capacity) {
+    spi_batch_t *batch;
+
+    if (capacity == 0 || capacity > SPI_BATCH_MAX_SEGMENTS)
+        return NULL;
+
+    batch = calloc(1, sizeof(spi_batch_t));
+    if (batch == NULL)
+        return NULL;
+
+    batch->xfers = calloc(capacity, sizeof(struct spi_ioc_transfer));
+    if (batch->xfers == NULL) {
+        free(batch);
+        return NULL;
+    }
+
+    batch->capacity = capacity;
+
+    return batch;
+}
+
+int spi_batch_add(spi_batch_t *batch, const uint8_t *txbuf, uint8_t *rxbuf, size_t len, uint32_t speed_hz, uint16_t delay_usecs, bool cs_change) {
+    struct spi_ioc_transfer *spi_xfer;
+
+    if (batch->count == batch->capacity || (uint64_t)len > UINT32_MAX)
+        return SPI_ERROR_ARG;
+
+    /* Segments are zeroed on clear, so only set what the caller specifies */
+    spi_xfer = &batch->xfers[batch->count++];
+    spi_xfer->tx_buf = (uintptr_t)txbuf;
+    spi_xfer->rx_buf = (uintptr_t)rxbuf;
+    spi_xfer->len = len;
+    spi_xfer->speed_hz = speed_hz;
+    spi_xfer->delay_usecs = delay_usecs;
+    spi_xfer->cs_change = cs_change;
+
+    return 0;
+}
+
+void spi_batch_clear(spi_batch_t *batch) {
+    memset(batch->xfers, 0, batch->count * sizeof(struct spi_ioc_transfer));
+    batch->count = 0;
+}
+
+size_t spi_batch_count(spi_batch_t *batch) {
+    return batch->count;
+}
+
+void spi_batch_free(spi_batch_t *batch) {
+    if (batch == NULL)
+        return;
+
+    free(batch->xfers);
+    free(batch);
+}
+
+int spi_transfer_batch(spi_t *spi, spi_batch_t *batch) {
+    if (batch == NULL)
+        return _spi_error(spi, SPI_ERROR_ARG, 0, "Invalid batch");
+
+    if (batch->count == 0)
+        return 0;
+
+    /* All segments in one message, chip select held between them unless
+     * cs_change is set */
+    if (ioctl(spi->fd, SPI_IOC_MESSAGE(batch->count), batch->xfers) < 0)
+        return _spi_error(spi, SPI_ERROR_TRANSFER, errno, "SPI batch transfer");
+
+    return 0;
+}
+
 int spi_close(spi_t *spi) {
     if (spi->fd < 0)
         return 0;
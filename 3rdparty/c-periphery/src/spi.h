@@ -13,6 +13,7 @@ extern "C" {
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 enum spi_error_code {
     SPI_ERROR_ARG           = -1, /* Invalid arguments */
@@ -30,6 +31,7 @@ typedef enum spi_bit_order {
 } spi_bit_order_t;
 
 typedef struct spi_handle spi_t;
+typedef struct spi_batch spi_batch_t;
 
 /* Primary Functions */
 spi_t *spi_new(void);
@@ -45,6 +47,16 @@ int spi_transfer(spi_t *spi, const uint8_t *txbuf, uint8_t *rxbuf, size_t len);
 int spi_close(spi_t *spi);
 void spi_free(spi_t *spi);
 
+/* Batch Transfers */
+spi_batch_t *spi_batch_new(size_t capacity);
+int spi_batch_add(spi_batch_t *batch, const uint8_t *txbuf, uint8_t *rxbuf,
+                  size_t len, uint32_t speed_hz, uint16_t delay_usecs,
+                  bool cs_change);
+void spi_batch_clear(spi_batch_t *batch);
+size_t spi_batch_count(spi_batch_t *batch);
+void spi_batch_free(spi_batch_t *batch);
+int spi_transfer_batch(spi_t *spi, spi_batch_t *batch);
+
 /* Getters */
 int spi_get_mode(spi_t *spi, unsigned int *mode);
 int spi_get_max_speed(spi_t *spi, uint32_t *max_speed);
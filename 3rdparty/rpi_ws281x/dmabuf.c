@@ -0,0 +1,403 @@
+/*
+ * dmabuf.c
+ *
+ * Copyright (c) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mailbox.h"
+#include "dma.h"
+
+#include "dmabuf.h"
+
+
+#define BUS_TO_PHYS(x)                           ((x)&~0xC0000000)
+#define DMABUF_ALIGNED(x)                        (((x) + (DMABUF_ALIGN - 1)) & ~(DMABUF_ALIGN - 1))
+
+// Allocated ranges are kept sorted by offset, free space is the gaps in between
+struct dmabuf_pool
+{
+    int handle;                         /* From mbox_open() */
+    unsigned mem_ref;                   /* From mem_alloc() */
+    uint32_t bus_addr;                  /* From mem_lock() */
+    uint32_t size;                      /* Size of allocation */
+    uint8_t *virt_addr;                 /* From mapmem() */
+    int count;
+    struct
+    {
+        uint32_t offset;
+        uint32_t size;                  /* Aligned size */
+    } used[DMABUF_MAX_BUFFERS];
+};
+
+
+/**
+ * Allocate, lock and map a physically contiguous chunk of VideoCore memory.
+ *
+ * @param    pool            Set to the new pool on success.
+ * @param    size            Bytes to allocate, rounded up to whole pages.
+ * @param    videocore_base  From rpi_hw_t, selects the uncached alias.
+ *
+ * @returns  0 on success, DMABUF_ERROR_xxx otherwise.  Nothing is held on failure.
+ */
+int dmabuf_pool_create(dmabuf_pool_t **pool, uint32_t size, uint32_t videocore_base)
+{
+    dmabuf_pool_t *p;
+
+    p = calloc(1, sizeof(*p));
+    if (!p)
+    {
+        return DMABUF_ERROR_ALLOC;
+    }
+
+    // Round up to page size multiple
+    p->size = (size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
+
+    p->handle = mbox_open();
+    if (p->handle == -1)
+    {
+        free(p);
+        return DMABUF_ERROR_MAILBOX;
+    }
+
+    p->mem_ref = mem_alloc(p->handle, p->size, PAGE_SIZE,
+                           videocore_base == 0x40000000 ? 0xC : 0x4);
+    if (p->mem_ref == 0)
+    {
+        mbox_close(p->handle);
+        free(p);
+        return DMABUF_ERROR_ALLOC;
+    }
+
+    p->bus_addr = mem_lock(p->handle, p->mem_ref);
+    if (p->bus_addr == (uint32_t) ~0UL)
+    {
+        mem_free(p->handle, p->mem_ref);
+        mbox_close(p->handle);
+        free(p);
+        return DMABUF_ERROR_LOCK;
+    }
+
+    p->virt_addr = mapmem(BUS_TO_PHYS(p->bus_addr), p->size, DEV_MEM);
+    if (!p->virt_addr)
+    {
+        mem_unlock(p->handle, p->mem_ref);
+        mem_free(p->handle, p->mem_ref);
+        mbox_close(p->handle);
+        free(p);
+        return DMABUF_ERROR_MMAP;
+    }
+
+    *pool = p;
+
+    return 0;
+}
+
+/**
+ * Release the VideoCore memory of a pool.  No DMA may still be using any of its buffers.
+ *
+ * @param    pool  Pool from dmabuf_pool_create(), may be NULL.
+ *
+ * @returns  None
+ */
+void dmabuf_pool_destroy(dmabuf_pool_t *pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    unmapmem(pool->virt_addr, pool->size);
+    mem_unlock(pool->handle, pool->mem_ref);
+    mem_free(pool->handle, pool->mem_ref);
+    mbox_close(pool->handle);
+    free(pool);
+}
+
+uint32_t dmabuf_pool_size(const dmabuf_pool_t *pool)
+{
+    return pool->size;
+}
+
+/**
+ * Free space between used range i - 1 and used range i (or the end of the pool).
+ */
+static uint32_t pool_gap(const dmabuf_pool_t *pool, int i, uint32_t *offset)
+{
+    uint32_t start = i ? pool->used[i - 1].offset + pool->used[i - 1].size : 0;
+    uint32_t end = (i < pool->count) ? pool->used[i].offset : pool->size;
+
+    if (offset)
+    {
+        *offset = start;
+    }
+
+    return end - start;
+}
+
+uint32_t dmabuf_pool_largest_free(const dmabuf_pool_t *pool)
+{
+    uint32_t largest = 0;
+    int i;
+
+    if (pool->count == DMABUF_MAX_BUFFERS)
+    {
+        return 0;
+    }
+
+    for (i = 0; i <= pool->count; i++)
+    {
+        uint32_t gap = pool_gap(pool, i, NULL);
+
+        if (gap > largest)
+        {
+            largest = gap;
+        }
+    }
+
+    return largest;
+}
+
+/**
+ * Index of the used range a buffer occupies.
+ */
+static int pool_find(const dmabuf_pool_t *pool, const dmabuf_t *buf)
+{
+    uint32_t offset = (uint32_t)(buf->virt - pool->virt_addr);
+    int i;
+
+    for (i = 0; i < pool->count; i++)
+    {
+        if (pool->used[i].offset == offset)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * First fit in the gaps of the pool.
+ *
+ * @returns  Index the new range was inserted at, -1 if there is no room.
+ */
+static int pool_insert(dmabuf_pool_t *pool, uint32_t size)
+{
+    uint32_t offset;
+    int i;
+
+    if (pool->count == DMABUF_MAX_BUFFERS)
+    {
+        return -1;
+    }
+
+    for (i = 0; i <= pool->count; i++)
+    {
+        if (pool_gap(pool, i, &offset) >= size)
+        {
+            memmove(&pool->used[i + 1], &pool->used[i], (pool->count - i) * sizeof(pool->used[0]));
+            pool->used[i].offset = offset;
+            pool->used[i].size = size;
+            pool->count++;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void pool_remove(dmabuf_pool_t *pool, int i)
+{
+    pool->count--;
+    memmove(&pool->used[i], &pool->used[i + 1], (pool->count - i) * sizeof(pool->used[0]));
+}
+
+/**
+ * Allocate a zeroed buffer from a pool.
+ *
+ * @param    pool  Pool from dmabuf_pool_create().
+ * @param    buf   Filled in on success.
+ * @param    size  Bytes, at least 1.
+ *
+ * @returns  0 on success, -1 if the pool has no room.
+ */
+int dmabuf_alloc(dmabuf_pool_t *pool, dmabuf_t *buf, uint32_t size)
+{
+    int i;
+
+    if (!size || (size > pool->size))
+    {
+        return -1;
+    }
+
+    i = pool_insert(pool, DMABUF_ALIGNED(size));
+    if (i < 0)
+    {
+        return -1;
+    }
+
+    buf->pool = pool;
+    buf->size = size;
+    buf->virt = pool->virt_addr + pool->used[i].offset;
+    buf->bus_addr = pool->bus_addr + pool->used[i].offset;
+    memset((uint8_t *)buf->virt, 0, size);
+
+    return 0;
+}
+
+/**
+ * Change the size of a buffer.  It grows in place if the space after it is free,
+ * otherwise it moves and keeps its contents, so virt and bus_addr must be reloaded
+ * and control blocks pointing into it rebuilt.  Grown space is zeroed.  The DMA
+ * must not be using the buffer.
+ *
+ * @param    buf   Buffer from dmabuf_alloc().
+ * @param    size  New size in bytes, at least 1.
+ *
+ * @returns  0 on success, -1 if the pool has no room, the buffer is then unchanged.
+ */
+int dmabuf_resize(dmabuf_t *buf, uint32_t size)
+{
+    dmabuf_pool_t *pool = buf->pool;
+    uint32_t aligned = DMABUF_ALIGNED(size);
+    uint32_t old_offset, old_size, new_offset;
+    int i, j;
+
+    if (!pool || !size || ((i = pool_find(pool, buf)) < 0))
+    {
+        return -1;
+    }
+
+    old_offset = pool->used[i].offset;
+    old_size = buf->size;
+
+    // In place: shrinking, or the gap behind the buffer is large enough
+    if (aligned <= pool->used[i].size + pool_gap(pool, i + 1, NULL))
+    {
+        pool->used[i].size = aligned;
+    }
+    else
+    {
+        j = pool_insert(pool, aligned);
+        if (j < 0)
+        {
+            return -1;
+        }
+        if (j <= i)
+        {
+            i++;
+        }
+
+        new_offset = pool->used[j].offset;
+        memcpy(pool->virt_addr + new_offset, pool->virt_addr + old_offset, old_size);
+        pool_remove(pool, i);
+
+        buf->virt = pool->virt_addr + new_offset;
+        buf->bus_addr = pool->bus_addr + new_offset;
+    }
+
+    if (size > old_size)
+    {
+        memset((uint8_t *)buf->virt + old_size, 0, size - old_size);
+    }
+    buf->size = size;
+
+    return 0;
+}
+
+/**
+ * Return a buffer to its pool.  The DMA must not be using it.
+ *
+ * @param    buf   Buffer from dmabuf_alloc(), ignored if not allocated.
+ *
+ * @returns  None
+ */
+void dmabuf_free(dmabuf_t *buf)
+{
+    int i;
+
+    if (!buf->pool)
+    {
+        return;
+    }
+
+    i = pool_find(buf->pool, buf);
+    if (i >= 0)
+    {
+        pool_remove(buf->pool, i);
+    }
+
+    buf->pool = NULL;
+    buf->virt = NULL;
+    buf->bus_addr = 0;
+    buf->size = 0;
+}
+
+/**
+ * Given a userspace address pointer into a buffer, return the matching bus address
+ * used by DMA.
+ *     Note: The bus address is not the same as the CPU physical address.
+ *
+ * @param    buf   Buffer the address belongs to.
+ * @param    virt  Userspace virtual address pointer.
+ *
+ * @returns  Bus address for use by DMA.
+ */
+uint32_t dmabuf_bus_addr(const dmabuf_t *buf, const volatile void *virt)
+{
+    return buf->bus_addr + (uint32_t)((const volatile uint8_t *)virt - buf->virt);
+}
+
+/**
+ * Link control blocks in a buffer one after the other.  With ring set the last block
+ * points back at the first, so the DMA loops over the chain until it is told to stop,
+ * otherwise the chain ends after the last block.  Only nextconbk is written.
+ *
+ * @param    buf    Buffer holding the control blocks.
+ * @param    cb     Blocks to link, DMABUF_ALIGN aligned.
+ * @param    count  Number of blocks.
+ * @param    ring   Non-zero to close the chain into a ring.
+ *
+ * @returns  None
+ */
+void dmabuf_cb_chain(const dmabuf_t *buf, volatile dma_cb_t *cb, int count, int ring)
+{
+    int i;
+
+    for (i = 0; i < count - 1; i++)
+    {
+        cb[i].nextconbk = dmabuf_bus_addr(buf, &cb[i + 1]);
+    }
+
+    if (count > 0)
+    {
+        cb[count - 1].nextconbk = ring ? dmabuf_bus_addr(buf, &cb[0]) : 0;
+    }
+}
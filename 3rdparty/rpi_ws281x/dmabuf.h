@@ -0,0 +1,86 @@
+/*
+ * dmabuf.h
+ *
+ * Copyright (c) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __DMABUF_H__
+#define __DMABUF_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "dma.h"
+
+
+/*
+ * DMA-coherent buffers carved out of one VideoCore allocation.  Allocating, locking
+ * and mapping mailbox memory is slow and may fail once memory is fragmented, so a
+ * pool is set up once and the LED frame, buzzer waveforms, control block rings of
+ * other DMA users (e.g. a display on SPI) are suballocated from it.  Buffers start
+ * on DMABUF_ALIGN boundaries, so control blocks can be placed anywhere in them.
+ */
+#define DMABUF_ALIGN                             32       // DMA control blocks are 256-bit aligned
+#define DMABUF_MAX_BUFFERS                       32       // Buffers per pool
+
+// dmabuf_pool_create() failures
+#define DMABUF_ERROR_MAILBOX                     -1       // Cannot open the mailbox device
+#define DMABUF_ERROR_ALLOC                       -2       // VideoCore allocation failed
+#define DMABUF_ERROR_LOCK                        -3       // Locking the allocation failed
+#define DMABUF_ERROR_MMAP                        -4       // Mapping it through /dev/mem failed
+
+typedef struct dmabuf_pool dmabuf_pool_t;
+
+typedef struct dmabuf
+{
+    dmabuf_pool_t *pool;                         //< Pool the buffer lives in, NULL if not allocated
+    uint32_t size;                               //< Usable size in bytes
+    volatile uint8_t *virt;                      //< Uncached userspace mapping
+    uint32_t bus_addr;                           //< Address of virt[0] as seen by DMA
+} dmabuf_t;
+
+int dmabuf_pool_create(dmabuf_pool_t **pool, uint32_t size,
+                       uint32_t videocore_base);                             //< Allocate, lock and map size bytes
+void dmabuf_pool_destroy(dmabuf_pool_t *pool);                               //< Release the memory, buffers become invalid
+uint32_t dmabuf_pool_size(const dmabuf_pool_t *pool);                        //< Total size, page aligned
+uint32_t dmabuf_pool_largest_free(const dmabuf_pool_t *pool);                //< Largest buffer that can still be allocated
+
+int dmabuf_alloc(dmabuf_pool_t *pool, dmabuf_t *buf, uint32_t size);        //< Zeroed buffer, 0 or -1 if no room
+int dmabuf_resize(dmabuf_t *buf, uint32_t size);                             //< Grow or shrink, may move; 0 or -1
+void dmabuf_free(dmabuf_t *buf);                                             //< Return the buffer to its pool
+
+uint32_t dmabuf_bus_addr(const dmabuf_t *buf, const volatile void *virt);   //< Bus address of a pointer into buf
+void dmabuf_cb_chain(const dmabuf_t *buf, volatile dma_cb_t *cb, int count,
+                     int ring);                                              //< Link cb[0..count) in order, last to first if ring
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DMABUF_H__ */
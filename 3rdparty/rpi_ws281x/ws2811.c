@@ -28,6 +28,7 @@
  */
 
 
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,10 +43,12 @@
 #include <linux/spi/spidev.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
 #include "mailbox.h"
 #include "clk.h"
 #include "gpio.h"
 #include "dma.h"
+#include "dmabuf.h"
 #include "pwm.h"
 #include "pcm.h"
 #include "rpihw.h"
@@ -72,24 +75,63 @@
                                                   RPI_PWM_CHANNELS)
 #define PCM_BYTE_COUNT(leds, freq)               ((((LED_BIT_COUNT(leds, freq) >> 3) & ~0x7) + 4) + 4)
 
+// Buzzer waveform capacity in words per PWM channel, and the longest loop searched for tones
+#define BUZZER_WAVE_WORDS                        8192
+#define BUZZER_TONE_WORDS                        1024
+
+// Upper bounds for hardware handshakes, so a wedged block reports an error instead of
+// hanging the process.  Clock and FIFO handshakes take microseconds, the DMA gets the
+// wire time of the frame (and of a buzzer loop it is spliced into) on top of its slack.
+#define WS2811_REG_TIMEOUT_US                    10000
+#define WS2811_DMA_SLACK_US                      50000
+
+// spidev copies each message through a bounce buffer of this size unless the
+// spidev.bufsiz module parameter says otherwise
+#define SPI_DEFAULT_BUFSIZ                       4096
+#define SPI_BUFSIZ_PATH                          "/sys/module/spidev/parameters/bufsiz"
+// spidev counts each transfer rounded up to the kmalloc alignment (at most 128)
+// against bufsiz, and the SPI DLEN register is 16 bits, so segments are multiples
+// of the alignment below 64k
+#define SPI_SEGMENT_ALIGN                        128
+#define SPI_SEGMENT_MAX                          (65536 - SPI_SEGMENT_ALIGN)
+#define SPI_ALIGNED_LEN(len)                     (((len) + SPI_SEGMENT_ALIGN - 1) & ~(SPI_SEGMENT_ALIGN - 1))
+
 // Driver mode definitions
 #define NONE	0
 #define PWM	1
 #define PCM	2
 #define SPI	3
 
-// We use the mailbox interface to request memory from the VideoCore.
-// This lets us request one physically contiguous chunk, find its
-// physical address, and map it 'uncached' so that writes from this
-// code are immediately visible to the DMA controller.  This struct
-// holds data relevant to the mailbox interface.
-typedef struct videocore_mbox {
-    int handle;             /* From mbox_open() */
-    unsigned mem_ref;       /* From mem_alloc() */
-    unsigned bus_addr;      /* From mem_lock() */
-    unsigned size;          /* Size of allocation */
-    uint8_t *virt_addr;     /* From mapmem() */
-} videocore_mbox_t;
+// The buzzer waveform lives in its own VideoCore allocation together with two
+// control blocks.  The loop block points at itself, so once started the DMA keeps
+// feeding PWM channel 1 with no CPU involvement.  LED frames are spliced in at a
+// loop boundary and hand back to the loop through the resume block, which plays
+// the rest of the waveform so the tone stays phase continuous.
+typedef struct ws2811_buzzer
+{
+    int gpionum;                        /* PWM1 pin, 0 if not initialized */
+    int active;                         /* Waveform loop is running */
+    dmabuf_pool_t *pool;                /* Own pool, NULL when allocated from ws2811_t.dma_pool */
+    dmabuf_t buf;
+    volatile dma_cb_t *loop_cb;
+    volatile dma_cb_t *resume_cb;
+    uint32_t loop_cb_addr;
+    uint32_t resume_cb_addr;
+    volatile uint32_t *wave;            /* Interleaved PWM words, channel 0 held low */
+    uint32_t wave_words;                /* Loop length in words per channel */
+} ws2811_buzzer_t;
+
+// Color correction of one channel.  The matrix is expanded into one table per
+// coefficient so correcting a color is nine lookups and six adds, gamma tables
+// are indexed by byte position in ws2811_led_t (0 blue, 1 green, 2 red, 3 white).
+typedef struct ws2811_color
+{
+    int32_t mix[3][3][256];             /* mix[out][in][v] = matrix[out][in] * v / 256, R G B order */
+    uint16_t gamma16[LED_COLOURS][256]; /* 8.8 fixed point, for dithering and rebuilding gamma */
+    uint8_t gamma[LED_COLOURS][256];    /* gamma16 with brightness folded in */
+    int brightness;                     /* Brightness the gamma tables were built for, -1 for none */
+    int white_extract;
+} ws2811_color_t;
 
 typedef struct ws2811_device
 {
@@ -99,12 +141,21 @@ typedef struct ws2811_device
     volatile ws281x_pwm_t *pwm;
     volatile pcm_t *pcm;
     int spi_fd;
+    struct spi_ioc_transfer *spi_xfer;  /* Frame split into segments, built once by spi_init */
+    int spi_xfer_count;
+    uint32_t spi_bufsiz;                /* Largest message spidev accepts */
     volatile dma_cb_t *dma_cb;
     uint32_t dma_cb_addr;
     volatile gpio_t *gpio;
     volatile cm_clk_t *cm_clk;
-    videocore_mbox_t mbox;
+    dmabuf_pool_t *pool;                /* Own pool, NULL when allocated from ws2811_t.dma_pool */
+    dmabuf_t frame;                     /* Control block followed by the DMA buffer */
     int max_count;
+    uint32_t frame_us;                  /* Wire time of the whole DMA buffer */
+    uint64_t frame_end;                 /* When the DMA of the last frame should be done */
+    uint64_t previous_timestamp;        /* Start of the last frame, for render_wait_time */
+    ws2811_stats_t *stats;              /* NULL unless enabled with ws2811_stats_enable() */
+    ws2811_buzzer_t buzzer;
 } ws2811_device_t;
 
 /**
@@ -123,6 +174,62 @@ static uint64_t get_microsecond_timestamp()
     return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
 }
 
+/**
+ * Poll a hardware register until the masked bits read as the given value.
+ *
+ * @param    reg         Register to poll.
+ * @param    mask        Bits to compare.
+ * @param    value       Expected value of the masked bits.
+ * @param    timeout_us  Give up after this many microseconds.
+ *
+ * @returns  0 once the value is seen, -1 on timeout.
+ */
+static int reg_wait(volatile uint32_t *reg, uint32_t mask, uint32_t value, uint64_t timeout_us)
+{
+    uint64_t start = get_microsecond_timestamp();
+
+    while ((*reg & mask) != value)
+    {
+        if ((get_microsecond_timestamp() - start) > timeout_us)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Start of a stats sample, no timestamp is taken with statistics disabled.
+ *
+ * @param    stats  Statistics of the instance, may be NULL.
+ *
+ * @returns  Current timestamp in microseconds, 0 without statistics.
+ */
+static inline uint64_t stats_begin(const ws2811_stats_t *stats)
+{
+    return stats ? get_microsecond_timestamp() : 0;
+}
+
+/**
+ * Account one sample of a timed step.
+ *
+ * @param    time  Statistics of the step.
+ * @param    us    Duration in microseconds.
+ *
+ * @returns  None
+ */
+static void stats_add(ws2811_stats_time_t *time, uint64_t us)
+{
+    time->count++;
+    time->last = us;
+    time->total += us;
+    if (us > time->max)
+    {
+        time->max = us;
+    }
+}
+
 /**
  * Iterate through the channels and find the largest led count.
  *
@@ -145,6 +252,24 @@ static int max_channel_led_count(ws2811_t *ws2811)
     return max;
 }
 
+/**
+ * DMA memory of a PWM or PCM instance: the control block followed by the buffer.
+ *
+ * @param    ws2811     ws2811 instance pointer.
+ * @param    max_count  Largest LED count of the channels.
+ *
+ * @returns  Size in bytes.
+ */
+static uint32_t frame_byte_count(ws2811_t *ws2811, int max_count)
+{
+    if (ws2811->device->driver_mode == PWM)
+    {
+        return PWM_BYTE_COUNT(max_count, ws2811->freq) + sizeof(dma_cb_t);
+    }
+
+    return PCM_BYTE_COUNT(max_count, ws2811->freq) + sizeof(dma_cb_t);
+}
+
 /**
  * Map all devices into userspace memory.
  * Not called for SPI
@@ -267,11 +392,85 @@ static void unmap_registers(ws2811_t *ws2811)
  */
 static uint32_t addr_to_bus(ws2811_device_t *device, const volatile void *virt)
 {
-    videocore_mbox_t *mbox = &device->mbox;
+    return dmabuf_bus_addr(&device->frame, virt);
+}
+
+/**
+ * Allocate DMA memory from the pool the application shares between its DMA users,
+ * or, without one, from a pool of its own.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    own     Set to the pool created when ws2811->dma_pool is NULL.
+ * @param    buf     Filled in on success.
+ * @param    size    Bytes to allocate.
+ *
+ * @returns  WS2811_SUCCESS on success, error code otherwise.  Nothing is held on failure.
+ */
+static ws2811_return_t dma_buffer_alloc(ws2811_t *ws2811, dmabuf_pool_t **own, dmabuf_t *buf, uint32_t size)
+{
+    dmabuf_pool_t *pool = ws2811->dma_pool;
+
+    if (!pool)
+    {
+        switch (dmabuf_pool_create(own, size, ws2811->rpi_hw->videocore_base))
+        {
+        case 0:
+            break;
+        case DMABUF_ERROR_MAILBOX:
+            return WS2811_ERROR_MAILBOX_DEVICE;
+        case DMABUF_ERROR_LOCK:
+            return WS2811_ERROR_MEM_LOCK;
+        case DMABUF_ERROR_MMAP:
+            return WS2811_ERROR_MMAP;
+        default:
+            return WS2811_ERROR_OUT_OF_MEMORY;
+        }
+        pool = *own;
+    }
+
+    if (dmabuf_alloc(pool, buf, size))
+    {
+        dmabuf_pool_destroy(*own);
+        *own = NULL;
+        return WS2811_ERROR_OUT_OF_MEMORY;
+    }
+
+    return WS2811_SUCCESS;
+}
+
+/**
+ * Release DMA memory obtained with dma_buffer_alloc().
+ *
+ * @param    own     Pool created for the buffer, if any.
+ * @param    buf     Buffer, ignored if not allocated.
+ *
+ * @returns  None
+ */
+static void dma_buffer_free(dmabuf_pool_t **own, dmabuf_t *buf)
+{
+    dmabuf_free(buf);
+    dmabuf_pool_destroy(*own);
+    *own = NULL;
+}
+
+/**
+ * Rate at which each PWM channel serializes bits.  The clock divider is an integer,
+ * so this can differ slightly from 3 * freq (e.g. on the 54MHz Pi 4 oscillator).
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  Bits per second.
+ */
+static uint32_t pwm_bit_rate(ws2811_t *ws2811)
+{
+    uint32_t osc_freq = OSC_FREQ;
 
-    uint32_t offset = (uint8_t *)virt - mbox->virt_addr;
+    if (ws2811->rpi_hw->type == RPI_HWVER_TYPE_PI4)
+    {
+        osc_freq = OSC_FREQ_PI4;
+    }
 
-    return mbox->bus_addr + offset;
+    return osc_freq / (osc_freq / (3 * ws2811->freq));
 }
 
 /**
@@ -279,9 +478,9 @@ static uint32_t addr_to_bus(ws2811_device_t *device, const volatile void *virt)
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  None
+ * @returns  0 on success, -1 if the clock did not stop.
  */
-static void stop_pwm(ws2811_t *ws2811)
+static int stop_pwm(ws2811_t *ws2811)
 {
     ws2811_device_t *device = ws2811->device;
     volatile ws281x_pwm_t *pwm = device->pwm;
@@ -294,8 +493,13 @@ static void stop_pwm(ws2811_t *ws2811)
     // Kill the clock if it was already running
     cm_clk->ctl = CM_CLK_CTL_PASSWD | CM_CLK_CTL_KILL;
     usleep(10);
-    while (cm_clk->ctl & CM_CLK_CTL_BUSY)
-        ;
+    if (reg_wait(&cm_clk->ctl, CM_CLK_CTL_BUSY, 0, WS2811_REG_TIMEOUT_US))
+    {
+        fprintf(stderr, "Timeout stopping the clock\n");
+        return -1;
+    }
+
+    return 0;
 }
 
 /**
@@ -303,9 +507,9 @@ static void stop_pwm(ws2811_t *ws2811)
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  None
+ * @returns  0 on success, -1 if the clock did not stop.
  */
-static void stop_pcm(ws2811_t *ws2811)
+static int stop_pcm(ws2811_t *ws2811)
 {
     ws2811_device_t *device = ws2811->device;
     volatile pcm_t *pcm = device->pcm;
@@ -318,8 +522,13 @@ static void stop_pcm(ws2811_t *ws2811)
     // Kill the clock if it was already running
     cm_clk->ctl = CM_CLK_CTL_PASSWD | CM_CLK_CTL_KILL;
     usleep(10);
-    while (cm_clk->ctl & CM_CLK_CTL_BUSY)
-        ;
+    if (reg_wait(&cm_clk->ctl, CM_CLK_CTL_BUSY, 0, WS2811_REG_TIMEOUT_US))
+    {
+        fprintf(stderr, "Timeout stopping the clock\n");
+        return -1;
+    }
+
+    return 0;
 }
 
 /**
@@ -348,15 +557,21 @@ static int setup_pwm(ws2811_t *ws2811)
         osc_freq = OSC_FREQ_PI4;
     }
 
-    stop_pwm(ws2811);
+    if (stop_pwm(ws2811))
+    {
+        return -1;
+    }
 
     // Setup the Clock - Use OSC @ 19.2Mhz w/ 3 clocks/tick
     cm_clk->div = CM_CLK_DIV_PASSWD | CM_CLK_DIV_DIVI(osc_freq / (3 * freq));
     cm_clk->ctl = CM_CLK_CTL_PASSWD | CM_CLK_CTL_SRC_OSC;
     cm_clk->ctl = CM_CLK_CTL_PASSWD | CM_CLK_CTL_SRC_OSC | CM_CLK_CTL_ENAB;
     usleep(10);
-    while (!(cm_clk->ctl & CM_CLK_CTL_BUSY))
-        ;
+    if (reg_wait(&cm_clk->ctl, CM_CLK_CTL_BUSY, CM_CLK_CTL_BUSY, WS2811_REG_TIMEOUT_US))
+    {
+        fprintf(stderr, "Timeout starting the PWM clock\n");
+        return -1;
+    }
 
     // Setup the PWM, use delays as the block is rumored to lock up without them.  Make
     // sure to use a high enough priority to avoid any FIFO underruns, especially if
@@ -431,15 +646,21 @@ static int setup_pcm(ws2811_t *ws2811)
         osc_freq = OSC_FREQ_PI4;
     }
 
-    stop_pcm(ws2811);
+    if (stop_pcm(ws2811))
+    {
+        return -1;
+    }
 
     // Setup the PCM Clock - Use OSC @ 19.2Mhz w/ 3 clocks/tick
     cm_clk->div = CM_CLK_DIV_PASSWD | CM_CLK_DIV_DIVI(osc_freq / (3 * freq));
     cm_clk->ctl = CM_CLK_CTL_PASSWD | CM_CLK_CTL_SRC_OSC;
     cm_clk->ctl = CM_CLK_CTL_PASSWD | CM_CLK_CTL_SRC_OSC | CM_CLK_CTL_ENAB;
     usleep(10);
-    while (!(cm_clk->ctl & CM_CLK_CTL_BUSY))
-        ;
+    if (reg_wait(&cm_clk->ctl, CM_CLK_CTL_BUSY, CM_CLK_CTL_BUSY, WS2811_REG_TIMEOUT_US))
+    {
+        fprintf(stderr, "Timeout starting the PCM clock\n");
+        return -1;
+    }
 
     // Setup the PCM, use delays as the block is rumored to lock up without them.  Make
     // sure to use a high enough priority to avoid any FIFO underruns, especially if
@@ -479,24 +700,50 @@ static int setup_pcm(ws2811_t *ws2811)
 
 /**
  * Start the DMA feeding the PWM FIFO.  This will stream the entire DMA buffer out of both
- * PWM channels.
+ * PWM channels.  The channel is idle here (ws2811_wait() ran first), so it is only reset
+ * when a previous frame left it stuck or in error.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  None
+ * @returns  WS2811_SUCCESS, or WS2811_ERROR_DMA if the channel does not respond.
  */
-static void dma_start(ws2811_t *ws2811)
+static ws2811_return_t dma_start(ws2811_t *ws2811)
 {
     ws2811_device_t *device = ws2811->device;
     volatile dma_t *dma = device->dma;
     volatile pcm_t *pcm = device->pcm;
     uint32_t dma_cb_addr = device->dma_cb_addr;
 
-    dma->cs = RPI_DMA_CS_RESET;
-    usleep(10);
+    if (device->buzzer.active && (dma->cs & RPI_DMA_CS_ACTIVE))
+    {
+        // The buzzer loop owns the DMA, splice the LED frame in at the next loop
+        // boundary.  NEXTCONBK may only be rewritten while the channel is paused.
+        dma->cs &= ~RPI_DMA_CS_ACTIVE;
+        if (reg_wait(&dma->cs, RPI_DMA_CS_PAUSED, RPI_DMA_CS_PAUSED, WS2811_REG_TIMEOUT_US))
+        {
+            dma->cs |= RPI_DMA_CS_ACTIVE;
+            fprintf(stderr, "Timeout pausing DMA %d\n", ws2811->dmanum);
+            return WS2811_ERROR_DMA;
+        }
+        dma->nextconbk = dma_cb_addr;
+        dma->cs |= RPI_DMA_CS_ACTIVE;
+
+        // The frame starts at the next loop boundary, ws2811_wait() polls for it
+        device->frame_end = get_microsecond_timestamp();
+        return WS2811_SUCCESS;
+    }
+
+    if (dma->cs & (RPI_DMA_CS_ACTIVE | RPI_DMA_CS_ERROR))
+    {
+        dma->cs = RPI_DMA_CS_RESET;
+        if (reg_wait(&dma->cs, RPI_DMA_CS_ACTIVE, 0, WS2811_REG_TIMEOUT_US))
+        {
+            fprintf(stderr, "Timeout resetting DMA %d\n", ws2811->dmanum);
+            return WS2811_ERROR_DMA;
+        }
+    }
 
     dma->cs = RPI_DMA_CS_INT | RPI_DMA_CS_END;
-    usleep(10);
 
     dma->conblk_ad = dma_cb_addr;
     dma->debug = 7; // clear debug error flags
@@ -509,6 +756,10 @@ static void dma_start(ws2811_t *ws2811)
     {
         pcm->cs |= RPI_PCM_CS_TXON;  // Start transmission
     }
+
+    device->frame_end = get_microsecond_timestamp() + device->frame_us;
+
+    return WS2811_SUCCESS;
 }
 
 /**
@@ -628,23 +879,39 @@ void ws2811_cleanup(ws2811_t *ws2811)
             free(ws2811->channel[chan].gamma);
         }
         ws2811->channel[chan].gamma = NULL;
+        if (ws2811->channel[chan].gamma16)
+        {
+            free(ws2811->channel[chan].gamma16);
+        }
+        ws2811->channel[chan].gamma16 = NULL;
+        if (ws2811->channel[chan].dither_err)
+        {
+            free(ws2811->channel[chan].dither_err);
+        }
+        ws2811->channel[chan].dither_err = NULL;
+        if (ws2811->channel[chan].color)
+        {
+            free(ws2811->channel[chan].color);
+        }
+        ws2811->channel[chan].color = NULL;
     }
 
-    if (device->mbox.handle != -1)
-    {
-        videocore_mbox_t *mbox = &device->mbox;
+    dma_buffer_free(&device->pool, &device->frame);
+    dma_buffer_free(&device->buzzer.pool, &device->buzzer.buf);
 
-        unmapmem(mbox->virt_addr, mbox->size);
-        mem_unlock(mbox->handle, mbox->mem_ref);
-        mem_free(mbox->handle, mbox->mem_ref);
-        mbox_close(mbox->handle);
+    if (device && (device->spi_fd > 0))
+    {
+        close(device->spi_fd);
+    }
 
-        mbox->handle = -1;
+    if (device && device->spi_xfer)
+    {
+        free(device->spi_xfer);
     }
 
-    if (device && (device->spi_fd > 0))
+    if (device && device->stats)
     {
-        close(device->spi_fd);
+        free(device->stats);
     }
 
     if (device) {
@@ -653,6 +920,40 @@ void ws2811_cleanup(ws2811_t *ws2811)
     ws2811->device = NULL;
 }
 
+/**
+ * Allocate the dithering tables of a channel, the 16-bit gamma table starts out as the
+ * 8-bit one until ws2811_set_custom_gamma_factor() fills in the extra precision.
+ *
+ * @param    channel  Channel with leds and gamma already allocated.
+ *
+ * @returns  0 on success, -1 if out of memory.
+ */
+static int dither_init(ws2811_channel_t *channel)
+{
+    int x;
+
+    channel->gamma16 = NULL;
+    channel->dither_err = NULL;
+    if (!channel->dither || !channel->count)
+    {
+        return 0;
+    }
+
+    channel->gamma16 = malloc(sizeof(uint16_t) * 256);
+    channel->dither_err = calloc(channel->count, LED_COLOURS);
+    if (!channel->gamma16 || !channel->dither_err)
+    {
+        return -1;
+    }
+
+    for (x = 0; x < 256; x++)
+    {
+        channel->gamma16[x] = channel->gamma[x] << 8;
+    }
+
+    return 0;
+}
+
 static int set_driver_mode(ws2811_t *ws2811, int gpionum)
 {
     int gpionum2;
@@ -668,7 +969,7 @@ static int set_driver_mode(ws2811_t *ws2811, int gpionum)
     else if (gpionum == 21 || gpionum == 31) {
         ws2811->device->driver_mode = PCM;
     }
-    else if (gpionum == 10) {
+    else if (gpionum == 10 || gpionum == 20) {
         ws2811->device->driver_mode = SPI;
     }
     else {
@@ -687,12 +988,20 @@ static int check_hwver_and_gpionum(ws2811_t *ws2811)
     int hwver, gpionum;
     int gpionums_B1[] = { 10, 18, 21 };
     int gpionums_B2[] = { 10, 18, 31 };
-    int gpionums_40p[] = { 10, 12, 18, 21};
+    int gpionums_40p[] = { 10, 12, 18, 20, 21};
     int i;
 
     rpi_hw = ws2811->rpi_hw;
     hwver = rpi_hw->hwver & 0x0000ffff;
     gpionum = ws2811->channel[0].gpionum;
+
+    if (ws2811->spi_device)
+    {
+        // Explicit spidev, any bus and chip select
+        ws2811->device->driver_mode = SPI;
+        memset(&ws2811->channel[1], 0, sizeof(ws2811_channel_t));
+        return 0;
+    }
     if (hwver < 0x0004)  // Model B Rev 1
     {
         for ( i = 0; i < (int)(sizeof(gpionums_B1) / sizeof(gpionums_B1[0])); i++)
@@ -741,22 +1050,143 @@ static int check_hwver_and_gpionum(ws2811_t *ws2811)
     return -1;
 }
 
+// MOSI pins of the SPI controllers, SPI3 to SPI6 only exist on the Pi 4
+static const struct
+{
+    int bus;
+    int gpionum;
+    int alt;
+} spi_mosi_pins[] =
+{
+    { 0, 10, 0 },
+    { 1, 20, 4 },
+    { 3,  2, 3 },
+    { 4,  6, 3 },
+    { 5, 14, 3 },
+    { 6, 20, 3 },
+};
+
+/**
+ * Read the largest message spidev accepts.  spidev copies every message through
+ * a bounce buffer of this size and rejects longer ones with EMSGSIZE.
+ *
+ * @returns  spidev.bufsiz in bytes, SPI_DEFAULT_BUFSIZ if it cannot be read.
+ */
+static uint32_t spi_read_bufsiz(void)
+{
+    FILE *fp;
+    unsigned bufsiz = 0;
+
+    fp = fopen(SPI_BUFSIZ_PATH, "r");
+    if (fp)
+    {
+        if (fscanf(fp, "%u", &bufsiz) != 1)
+        {
+            bufsiz = 0;
+        }
+        fclose(fp);
+    }
+
+    return bufsiz ? bufsiz : SPI_DEFAULT_BUFSIZ;
+}
+
+/**
+ * Split the SPI frame into segments no longer than bufsiz, so a frame of any length
+ * goes out without raising spidev.bufsiz.  The segments are kept for every frame.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  WS2811_SUCCESS, WS2811_ERROR_OUT_OF_MEMORY.
+ */
+static ws2811_return_t spi_segments_init(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    uint32_t len = PCM_BYTE_COUNT(device->max_count, ws2811->freq);
+    uint32_t segment = device->spi_bufsiz;
+    uint32_t offset;
+    int i;
+
+    if (segment > SPI_SEGMENT_MAX)
+    {
+        segment = SPI_SEGMENT_MAX;
+    }
+    segment &= ~(SPI_SEGMENT_ALIGN - 1);
+    if (!segment)
+    {
+        segment = SPI_SEGMENT_ALIGN;
+    }
+
+    device->spi_xfer_count = (len + segment - 1) / segment;
+    device->spi_xfer = calloc(device->spi_xfer_count, sizeof(struct spi_ioc_transfer));
+    if (!device->spi_xfer)
+    {
+        return WS2811_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (i = 0, offset = 0; i < device->spi_xfer_count; i++, offset += segment)
+    {
+        struct spi_ioc_transfer *xfer = &device->spi_xfer[i];
+
+        xfer->tx_buf = (unsigned long)(device->pxl_raw + offset);
+        xfer->rx_buf = 0;
+        xfer->len = (len - offset < segment) ? len - offset : segment;
+        xfer->cs_change = 0;
+    }
+
+    if (len > device->spi_bufsiz)
+    {
+        // Each message ends with a gap on MOSI the strip may take as a latch
+        fprintf(stderr, "SPI frame of %u bytes exceeds spidev.bufsiz=%u and is sent in several messages. "
+                "Set spidev.bufsiz=%u on the kernel command line for a continuous frame.\n",
+                len, device->spi_bufsiz, SPI_ALIGNED_LEN(len));
+    }
+
+    return WS2811_SUCCESS;
+}
+
 static ws2811_return_t spi_init(ws2811_t *ws2811)
 {
     int spi_fd;
     static uint8_t mode;
     static uint8_t bits = 8;
-    uint32_t speed = ws2811->freq * 3;
+    uint32_t speed = ws2811->spi_speed ? ws2811->spi_speed : ws2811->freq * 3;
     ws2811_device_t *device = ws2811->device;
     uint32_t base = ws2811->rpi_hw->periph_base;
     int pinnum = ws2811->channel[0].gpionum;
+    char path[32];
+    const char *spidev = ws2811->spi_device;
+    int bus = -1, cs = 0, pinalt = -1;
+    ws2811_return_t ret;
+    unsigned i;
 
-    spi_fd = open("/dev/spidev0.0", O_RDWR);
+    if (!spidev)
+    {
+        // Default to chip select 0 of the bus whose MOSI is channel 0
+        bus = (pinnum == 20) ? 1 : 0;
+        snprintf(path, sizeof(path), "/dev/spidev%d.0", bus);
+        spidev = path;
+    }
+    else if (sscanf(spidev, "/dev/spidev%d.%d", &bus, &cs) != 2)
+    {
+        bus = -1;
+    }
+
+    // Only route the pin if it is the MOSI of that bus, otherwise the device tree has done it
+    for (i = 0; i < sizeof(spi_mosi_pins) / sizeof(spi_mosi_pins[0]); i++)
+    {
+        if ((spi_mosi_pins[i].bus == bus) && (spi_mosi_pins[i].gpionum == pinnum))
+        {
+            pinalt = spi_mosi_pins[i].alt;
+        }
+    }
+
+    spi_fd = open(spidev, O_RDWR);
     if (spi_fd < 0) {
-        fprintf(stderr, "Cannot open /dev/spidev0.0. spi_bcm2835 module not loaded?\n");
+        fprintf(stderr, "Cannot open %s. spi_bcm2835 module not loaded?\n", spidev);
         return WS2811_ERROR_SPI_SETUP;
     }
     device->spi_fd = spi_fd;
+    device->spi_bufsiz = spi_read_bufsiz();
 
     // SPI mode
     if (ioctl(spi_fd, SPI_IOC_WR_MODE, &mode) < 0)
@@ -797,15 +1227,17 @@ static ws2811_return_t spi_init(ws2811_t *ws2811)
     device->dma_cb = NULL;
     device->dma_cb_addr = 0;
     device->cm_clk = NULL;
-    device->mbox.handle = -1;
 
     // Set SPI-MOSI pin
-    device->gpio = mapmem(GPIO_OFFSET + base, sizeof(gpio_t), DEV_GPIOMEM);
-    if (!device->gpio)
+    if (pinalt >= 0)
     {
-        return WS2811_ERROR_SPI_SETUP;
+        device->gpio = mapmem(GPIO_OFFSET + base, sizeof(gpio_t), DEV_GPIOMEM);
+        if (!device->gpio)
+        {
+            return WS2811_ERROR_SPI_SETUP;
+        }
+        gpio_function_set(device->gpio, pinnum, pinalt);	// SPI-MOSI
     }
-    gpio_function_set(device->gpio, pinnum, 0);	// SPI-MOSI ALT0
 
     // Allocate LED buffer
     ws2811_channel_t *channel = &ws2811->channel[0];
@@ -836,6 +1268,12 @@ static ws2811_return_t spi_init(ws2811_t *ws2811)
     channel->gshift = (channel->strip_type >> 8)  & 0xff;
     channel->bshift = (channel->strip_type >> 0)  & 0xff;
 
+    if (dither_init(channel))
+    {
+        ws2811_cleanup(ws2811);
+        return WS2811_ERROR_OUT_OF_MEMORY;
+    }
+
     // Allocate SPI transmit buffer (same size as PCM)
     device->pxl_raw = malloc(PCM_BYTE_COUNT(device->max_count, ws2811->freq));
     if (device->pxl_raw == NULL)
@@ -845,48 +1283,177 @@ static ws2811_return_t spi_init(ws2811_t *ws2811)
     }
     pcm_raw_init(ws2811);
 
+    ret = spi_segments_init(ws2811);
+    if (ret != WS2811_SUCCESS)
+    {
+        ws2811_cleanup(ws2811);
+        return ret;
+    }
+
     return WS2811_SUCCESS;
 }
 
+/**
+ * Send the frame.  As many segments as spidev.bufsiz allows go into one message,
+ * so the whole frame is a single message unless it is longer than bufsiz.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  WS2811_SUCCESS, WS2811_ERROR_SPI_TRANSFER.
+ */
 static ws2811_return_t spi_transfer(ws2811_t *ws2811)
 {
+    ws2811_device_t *device = ws2811->device;
+    int first, count;
+    uint32_t total;
     int ret;
-    struct spi_ioc_transfer tr;
 
-    memset(&tr, 0, sizeof(struct spi_ioc_transfer));
-    tr.tx_buf = (unsigned long)ws2811->device->pxl_raw;
-    tr.rx_buf = 0;
-    tr.len = PCM_BYTE_COUNT(ws2811->device->max_count, ws2811->freq);
-
-    ret = ioctl(ws2811->device->spi_fd, SPI_IOC_MESSAGE(1), &tr);
-    if (ret < 1)
+    for (first = 0; first < device->spi_xfer_count; first += count)
     {
-        fprintf(stderr, "Can't send spi message");
-        return WS2811_ERROR_SPI_TRANSFER;
+        total = SPI_ALIGNED_LEN(device->spi_xfer[first].len);
+        count = 1;
+        while ((first + count < device->spi_xfer_count) &&
+               (total + SPI_ALIGNED_LEN(device->spi_xfer[first + count].len) <= device->spi_bufsiz))
+        {
+            total += SPI_ALIGNED_LEN(device->spi_xfer[first + count].len);
+            count++;
+        }
+
+        ret = ioctl(device->spi_fd, SPI_IOC_MESSAGE(count), &device->spi_xfer[first]);
+        if (ret < 1)
+        {
+            fprintf(stderr, "Can't send spi message\n");
+            return WS2811_ERROR_SPI_TRANSFER;
+        }
     }
 
     return WS2811_SUCCESS;
 }
 
-
-/*
- *
- * Application API Functions
- *
- */
-
-
 /**
- * Allocate and initialize memory, buffers, pages, PWM, DMA, and GPIO.
+ * Copy the waveform into the channel 1 words of the LED buffer, so LED frames carry
+ * the tone starting at loop phase 0, and link the loop and resume control blocks.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  0 on success, -1 otherwise.
+ * @returns  None
  */
-ws2811_return_t ws2811_init(ws2811_t *ws2811)
+static void buzzer_link(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_buzzer_t *buzzer = &device->buzzer;
+    volatile uint32_t *pxl_raw = (uint32_t *)device->pxl_raw;
+    int wordcount = (PWM_BYTE_COUNT(device->max_count, ws2811->freq) / sizeof(uint32_t)) /
+                    RPI_PWM_CHANNELS;
+    uint32_t phase = wordcount % buzzer->wave_words;
+    uint32_t wave_addr = dmabuf_bus_addr(&buzzer->buf, buzzer->wave);
+    int i;
+
+    for (i = 0; i < wordcount; i++)
+    {
+        pxl_raw[(i * 2) + 1] = buzzer->wave[((i % buzzer->wave_words) * 2) + 1];
+    }
+
+    buzzer->loop_cb->ti = device->dma_cb->ti;
+    buzzer->loop_cb->source_ad = wave_addr;
+    buzzer->loop_cb->dest_ad = device->dma_cb->dest_ad;
+    buzzer->loop_cb->txfr_len = buzzer->wave_words * RPI_PWM_CHANNELS * sizeof(uint32_t);
+    buzzer->loop_cb->stride = 0;
+    dmabuf_cb_chain(&buzzer->buf, buzzer->loop_cb, 1, 1);
+
+    // Finish the loop iteration the LED frame interrupted
+    buzzer->resume_cb->ti = device->dma_cb->ti;
+    buzzer->resume_cb->source_ad = wave_addr + (phase * RPI_PWM_CHANNELS * sizeof(uint32_t));
+    buzzer->resume_cb->dest_ad = device->dma_cb->dest_ad;
+    buzzer->resume_cb->txfr_len = (buzzer->wave_words - phase) * RPI_PWM_CHANNELS * sizeof(uint32_t);
+    buzzer->resume_cb->stride = 0;
+    buzzer->resume_cb->nextconbk = buzzer->loop_cb_addr;
+
+    device->dma_cb->nextconbk = buzzer->resume_cb_addr;
+}
+
+/**
+ * Start looping the waveform currently in the buzzer buffer.  The DMA must be idle.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  WS2811_SUCCESS, or WS2811_ERROR_DMA if the DMA did not start.
+ */
+static ws2811_return_t buzzer_play(ws2811_t *ws2811)
+{
+    ws2811_return_t ret;
+
+    buzzer_link(ws2811);
+    ws2811->device->buzzer.active = 1;
+
+    // Enter through the LED block, it re-sends the last frame and drops into the loop.
+    if ((ret = dma_start(ws2811)) != WS2811_SUCCESS)
+    {
+        ws2811->device->buzzer.active = 0;
+    }
+
+    return ret;
+}
+
+/**
+ * Stop the waveform loop after any LED frame in flight and clear the channel 1 words.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  WS2811_SUCCESS, or WS2811_ERROR_DMA if the last frame failed.
+ */
+static ws2811_return_t buzzer_halt(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    volatile uint32_t *pxl_raw = (uint32_t *)device->pxl_raw;
+    int wordcount = (PWM_BYTE_COUNT(device->max_count, ws2811->freq) / sizeof(uint32_t)) /
+                    RPI_PWM_CHANNELS;
+    ws2811_return_t ret;
+    int i;
+
+    ret = ws2811_wait(ws2811);
+    if (!device->buzzer.active)
+    {
+        return ret;
+    }
+
+    device->dma->cs = RPI_DMA_CS_RESET;
+    if (reg_wait(&device->dma->cs, RPI_DMA_CS_ACTIVE, 0, WS2811_REG_TIMEOUT_US))
+    {
+        fprintf(stderr, "Timeout resetting DMA %d\n", ws2811->dmanum);
+        ret = WS2811_ERROR_DMA;
+    }
+
+    device->buzzer.active = 0;
+    device->dma_cb->nextconbk = 0;
+
+    for (i = 0; i < wordcount; i++)
+    {
+        pxl_raw[(i * 2) + 1] = 0x0;
+    }
+
+    return ret;
+}
+
+
+/*
+ *
+ * Application API Functions
+ *
+ */
+
+
+/**
+ * Allocate and initialize memory, buffers, pages, PWM, DMA, and GPIO.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  0 on success, -1 otherwise.
+ */
+ws2811_return_t ws2811_init(ws2811_t *ws2811)
 {
     ws2811_device_t *device;
-    const rpi_hw_t *rpi_hw;
+    ws2811_return_t ret;
     int chan;
 
     ws2811->rpi_hw = rpi_hw_detect();
@@ -894,7 +1461,6 @@ ws2811_return_t ws2811_init(ws2811_t *ws2811)
     {
         return WS2811_ERROR_HW_NOT_SUPPORTED;
     }
-    rpi_hw = ws2811->rpi_hw;
 
     ws2811->device = malloc(sizeof(*ws2811->device));
     if (!ws2811->device)
@@ -916,48 +1482,11 @@ ws2811_return_t ws2811_init(ws2811_t *ws2811)
     }
 
     // Determine how much physical memory we need for DMA
-    switch (device->driver_mode) {
-    case PWM:
-        device->mbox.size = PWM_BYTE_COUNT(device->max_count, ws2811->freq) +
-                            sizeof(dma_cb_t);
-        break;
-
-    case PCM:
-        device->mbox.size = PCM_BYTE_COUNT(device->max_count, ws2811->freq) +
-                            sizeof(dma_cb_t);
-        break;
-    }
-    // Round up to page size multiple
-    device->mbox.size = (device->mbox.size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
-
-    device->mbox.handle = mbox_open();
-    if (device->mbox.handle == -1)
-    {
-        return WS2811_ERROR_MAILBOX_DEVICE;
-    }
-
-    device->mbox.mem_ref = mem_alloc(device->mbox.handle, device->mbox.size, PAGE_SIZE,
-                                     rpi_hw->videocore_base == 0x40000000 ? 0xC : 0x4);
-    if (device->mbox.mem_ref == 0)
-    {
-        return WS2811_ERROR_OUT_OF_MEMORY;
-    }
-
-    device->mbox.bus_addr = mem_lock(device->mbox.handle, device->mbox.mem_ref);
-    if (device->mbox.bus_addr == (uint32_t) ~0UL)
-    {
-       mem_free(device->mbox.handle, device->mbox.size);
-       return WS2811_ERROR_MEM_LOCK;
-    }
-
-    device->mbox.virt_addr = mapmem(BUS_TO_PHYS(device->mbox.bus_addr), device->mbox.size, DEV_MEM);
-    if (!device->mbox.virt_addr)
+    ret = dma_buffer_alloc(ws2811, &device->pool, &device->frame, frame_byte_count(ws2811, device->max_count));
+    if (ret != WS2811_SUCCESS)
     {
-        mem_unlock(device->mbox.handle, device->mbox.mem_ref);
-        mem_free(device->mbox.handle, device->mbox.size);
-
         ws2811_cleanup(ws2811);
-        return WS2811_ERROR_MMAP;
+        return ret;
     }
 
     // Initialize all pointers to NULL.  Any non-NULL pointers will be freed on cleanup.
@@ -966,6 +1495,9 @@ ws2811_return_t ws2811_init(ws2811_t *ws2811)
     for (chan = 0; chan < RPI_PWM_CHANNELS; chan++)
     {
         ws2811->channel[chan].leds = NULL;
+        ws2811->channel[chan].gamma16 = NULL;
+        ws2811->channel[chan].dither_err = NULL;
+        ws2811->channel[chan].color = NULL;
     }
 
     // Allocate the LED buffers
@@ -1002,10 +1534,19 @@ ws2811_return_t ws2811_init(ws2811_t *ws2811)
         channel->gshift = (channel->strip_type >> 8)  & 0xff;
         channel->bshift = (channel->strip_type >> 0)  & 0xff;
 
+        if (dither_init(channel))
+        {
+            ws2811_cleanup(ws2811);
+            return WS2811_ERROR_OUT_OF_MEMORY;
+        }
     }
 
-    device->dma_cb = (dma_cb_t *)device->mbox.virt_addr;
-    device->pxl_raw = (uint8_t *)device->mbox.virt_addr + sizeof(dma_cb_t);
+    device->dma_cb = (dma_cb_t *)device->frame.virt;
+    device->pxl_raw = device->frame.virt + sizeof(dma_cb_t);
+
+    // The DMA always sends the whole buffer, 3 symbols per LED bit, PWM interleaves both channels
+    device->frame_us = (uint64_t)PCM_BYTE_COUNT(device->max_count, ws2811->freq) * 8 * 1000000 /
+                       (3 * ws2811->freq);
 
     switch (device->driver_mode) {
     case PWM:
@@ -1075,10 +1616,15 @@ void ws2811_fini(ws2811_t *ws2811)
     ws2811_wait(ws2811);
     switch (ws2811->device->driver_mode) {
     case PWM:
+        buzzer_halt(ws2811);
         stop_pwm(ws2811);
         break;
     case PCM:
-        while (!(pcm->cs & RPI_PCM_CS_TXE)) ;    // Wait till TX FIFO is empty
+        // Wait till TX FIFO is empty
+        if (reg_wait(&pcm->cs, RPI_PCM_CS_TXE, RPI_PCM_CS_TXE, WS2811_REG_TIMEOUT_US))
+        {
+            fprintf(stderr, "Timeout draining the PCM FIFO\n");
+        }
         stop_pcm(ws2811);
         break;
     }
@@ -1089,24 +1635,52 @@ void ws2811_fini(ws2811_t *ws2811)
 }
 
 /**
- * Wait for any executing DMA operation to complete before returning.
+ * Wait for any executing DMA operation to complete before returning.  The DMA cannot
+ * finish before the whole buffer is on the wire, so sleep until then and only poll
+ * the status for the last few microseconds.  Gives up with WS2811_ERROR_DMA once the
+ * frame is WS2811_DMA_SLACK_US overdue.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  0 on success, -1 on DMA competion error
+ * @returns  0 on success, WS2811_ERROR_DMA on DMA error or timeout
  */
-ws2811_return_t ws2811_wait(ws2811_t *ws2811)
+static ws2811_return_t dma_wait(ws2811_t *ws2811)
 {
-    volatile dma_t *dma = ws2811->device->dma;
+    ws2811_device_t *device = ws2811->device;
+    volatile dma_t *dma = device->dma;
+    uint64_t now, deadline;
 
-    if (ws2811->device->driver_mode == SPI)  // Nothing to do for SPI
+    if (device->driver_mode == SPI)  // Nothing to do for SPI
     {
         return WS2811_SUCCESS;
     }
 
+    now = get_microsecond_timestamp();
+    deadline = device->frame_end + WS2811_DMA_SLACK_US;
+    if (device->buzzer.active)
+    {
+        // A spliced frame waits for the end of the current loop
+        deadline += (uint64_t)device->buzzer.wave_words * 32 * 1000000 / pwm_bit_rate(ws2811) +
+                    device->frame_us;
+    }
+    else if (device->frame_end > now)
+    {
+        usleep(device->frame_end - now);
+    }
+
+    // With the buzzer looping the DMA never goes idle, the frame is done once the
+    // LED control block is neither queued nor executing.
     while ((dma->cs & RPI_DMA_CS_ACTIVE) &&
-           !(dma->cs & RPI_DMA_CS_ERROR))
+           !(dma->cs & RPI_DMA_CS_ERROR) &&
+           (!device->buzzer.active ||
+            (dma->nextconbk == device->dma_cb_addr) ||
+            (dma->conblk_ad == device->dma_cb_addr)))
     {
+        if (get_microsecond_timestamp() > deadline)
+        {
+            fprintf(stderr, "DMA %d timeout: cs %08x debug %08x\n", ws2811->dmanum, dma->cs, dma->debug);
+            return WS2811_ERROR_DMA;
+        }
         usleep(10);
     }
 
@@ -1120,14 +1694,157 @@ ws2811_return_t ws2811_wait(ws2811_t *ws2811)
 }
 
 /**
- * Render the DMA buffer from the user supplied LED arrays and start the DMA
- * controller.  This will update all LEDs on both PWM channels.
+ * Wait for any executing DMA operation to complete, see dma_wait().
  *
  * @param    ws2811  ws2811 instance pointer.
  *
+ * @returns  0 on success, WS2811_ERROR_DMA on DMA error or timeout
+ */
+ws2811_return_t ws2811_wait(ws2811_t *ws2811)
+{
+    ws2811_stats_t *stats = ws2811->device->stats;
+    uint64_t begin = stats_begin(stats);
+    ws2811_return_t ret;
+
+    ret = dma_wait(ws2811);
+
+    if (stats)
+    {
+        stats_add(&stats->wait, get_microsecond_timestamp() - begin);
+        if (ret != WS2811_SUCCESS)
+        {
+            stats->dma_errors++;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Add the fraction dropped in the last frame to an 8.8 fixed point level and keep the
+ * new fraction for the next frame (first order error diffusion over time).
+ *
+ * @param    level  8.8 fixed point output level, at most 0xff00.
+ * @param    err    Remainder of this LED and color, updated.
+ *
+ * @returns  Output byte for this frame.
+ */
+static inline uint8_t dither_level(uint32_t level, uint8_t *err)
+{
+    uint32_t acc = level + *err;
+
+    *err = acc & 0xff;
+    return acc >> 8;
+}
+
+/**
+ * One color of a dithered LED on a plain channel.  Same order as the 8-bit path,
+ * brightness first, then gamma: the 8.8 scaled value interpolates between two
+ * neighbouring gamma16 entries, so only the precision differs, not the level.
+ *
+ * @param    gamma16  8.8 fixed point gamma table, at most 0xff00.
+ * @param    value    Color byte, the upper bits are ignored.
+ * @param    scale    Brightness + 1.
+ * @param    err      Remainder of this LED and color, updated.
+ *
+ * @returns  Output byte for this frame.
+ */
+static inline uint8_t dither_color(const uint16_t *gamma16, uint32_t value, int scale, uint8_t *err)
+{
+    uint32_t index = (value & 0xff) * scale;          // 8.8, at most 0xff00
+    uint32_t lo = gamma16[index >> 8];
+    uint32_t frac = index & 0xff;
+    uint32_t level = lo;
+
+    if (frac)
+    {
+        level += (((uint32_t)gamma16[(index >> 8) + 1] - lo) * frac) >> 8;
+    }
+
+    return dither_level(level, err);
+}
+
+/**
+ * One color of a dithered LED on a color corrected channel.  Same order as the 8-bit
+ * tables of color_update_brightness(), gamma first, then brightness.
+ *
+ * @param    gamma16  8.8 fixed point gamma table, at most 0xff00.
+ * @param    value    Color byte, the upper bits are ignored.
+ * @param    scale    Brightness + 1.
+ * @param    err      Remainder of this LED and color, updated.
+ *
+ * @returns  Output byte for this frame.
+ */
+static inline uint8_t dither_color_corrected(const uint16_t *gamma16, uint32_t value, int scale, uint8_t *err)
+{
+    return dither_level((gamma16[value & 0xff] * scale) >> 8, err);
+}
+
+/**
+ * Fold the channel brightness into the 8-bit gamma tables of a corrected channel.
+ *
+ * @param    cc     Color correction tables.
+ * @param    scale  Brightness + 1.
+ *
  * @returns  None
  */
-ws2811_return_t  ws2811_render(ws2811_t *ws2811)
+static void color_update_brightness(ws2811_color_t *cc, int scale)
+{
+    int k, x;
+
+    for (k = 0; k < LED_COLOURS; k++)
+    {
+        for (x = 0; x < 256; x++)
+        {
+            cc->gamma[k][x] = ((uint32_t)cc->gamma16[k][x] * scale + 0x8000) >> 16;
+        }
+    }
+    cc->brightness = scale - 1;
+}
+
+/**
+ * Apply the color matrix and white extraction to one LED.
+ *
+ * @param    cc    Color correction tables.
+ * @param    led   0xWWRRGGBB input.
+ * @param    rgbw  Strip has a white LED.
+ *
+ * @returns  Corrected 0xWWRRGGBB, before gamma.
+ */
+static inline ws2811_led_t color_correct(const ws2811_color_t *cc, ws2811_led_t led, int rgbw)
+{
+    const uint32_t r = (led >> 16) & 0xff, g = (led >> 8) & 0xff, b = led & 0xff;
+    int32_t out[3], w = (led >> 24) & 0xff;
+    int k;
+
+    for (k = 0; k < 3; k++)
+    {
+        out[k] = cc->mix[k][0][r] + cc->mix[k][1][g] + cc->mix[k][2][b];
+        out[k] = out[k] < 0 ? 0 : (out[k] > 255 ? 255 : out[k]);
+    }
+
+    if (rgbw && cc->white_extract)
+    {
+        int32_t common = out[0] < out[1] ? out[0] : out[1];
+
+        common = common < out[2] ? common : out[2];
+        out[0] -= common;
+        out[1] -= common;
+        out[2] -= common;
+        w = (w + common) > 255 ? 255 : w + common;
+    }
+
+    return ((uint32_t)w << 24) | ((uint32_t)out[0] << 16) | ((uint32_t)out[1] << 8) | (uint32_t)out[2];
+}
+
+/**
+ * Encode the user supplied LED arrays into the DMA (or SPI) buffer.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  Time in µs the longest channel takes on the wire.
+ */
+static uint32_t render_encode(ws2811_t *ws2811)
 {
 	static uint8_t convert_table[3][256] =
 	{ 
@@ -1201,11 +1918,11 @@ ws2811_return_t  ws2811_render(ws2811_t *ws2811)
 
     volatile uint8_t *pxl_raw = ws2811->device->pxl_raw;
     int driver_mode = ws2811->device->driver_mode;
+    ws2811_stats_t *stats = ws2811->device->stats;
+    uint64_t begin = stats_begin(stats);
     int i, l, chan;
     unsigned j;
-    ws2811_return_t ret = WS2811_SUCCESS;
     uint32_t protocol_time = 0;
-    static uint64_t previous_timestamp = 0;
 
     for (chan = 0; chan < RPI_PWM_CHANNELS; chan++)         // Channel
     {
@@ -1214,6 +1931,10 @@ ws2811_return_t  ws2811_render(ws2811_t *ws2811)
         int wordpos = chan; // PWM & PCM
         int bytepos = 0;    // SPI
         const int scale = (channel->brightness & 0xff) + 1;
+        // Either the LED array, or a caller owned frame read through the remap table
+        const ws2811_led_t *source = channel->source ? channel->source : channel->leds;
+        const uint32_t *remap = channel->source ? channel->remap : NULL;
+        ws2811_color_t *cc = channel->color;
         uint8_t array_size = 3; // Assume 3 color LEDs, RGB
 
         // If our shift mask includes the highest nibble, then we have 4 LEDs, RBGW.
@@ -1222,6 +1943,11 @@ ws2811_return_t  ws2811_render(ws2811_t *ws2811)
             array_size = 4;
         }
 
+        if (cc && (cc->brightness != scale - 1))
+        {
+            color_update_brightness(cc, scale);
+        }
+
         // 1.25µs per bit
         const uint32_t channel_protocol_time = channel->count * array_size * 8 * 1.25;
 
@@ -1233,13 +1959,46 @@ ws2811_return_t  ws2811_render(ws2811_t *ws2811)
 
         for (i = 0; i < channel->count; i++)                // Led
         {
-            uint8_t color[] =
+            const ws2811_led_t led = remap ? source[remap[i]] : source[i];
+            uint8_t color[LED_COLOURS];
+
+            if (cc)
+            {
+                const ws2811_led_t corrected = color_correct(cc, led, array_size == 4);
+
+                if (channel->dither)
+                {
+                    uint8_t *err = &channel->dither_err[i * LED_COLOURS];
+
+                    color[0] = dither_color_corrected(cc->gamma16[channel->rshift >> 3], corrected >> channel->rshift, scale, &err[0]);
+                    color[1] = dither_color_corrected(cc->gamma16[channel->gshift >> 3], corrected >> channel->gshift, scale, &err[1]);
+                    color[2] = dither_color_corrected(cc->gamma16[channel->bshift >> 3], corrected >> channel->bshift, scale, &err[2]);
+                    color[3] = dither_color_corrected(cc->gamma16[channel->wshift >> 3], corrected >> channel->wshift, scale, &err[3]);
+                }
+                else
+                {
+                    color[0] = cc->gamma[channel->rshift >> 3][(corrected >> channel->rshift) & 0xff];
+                    color[1] = cc->gamma[channel->gshift >> 3][(corrected >> channel->gshift) & 0xff];
+                    color[2] = cc->gamma[channel->bshift >> 3][(corrected >> channel->bshift) & 0xff];
+                    color[3] = cc->gamma[channel->wshift >> 3][(corrected >> channel->wshift) & 0xff];
+                }
+            }
+            else if (channel->dither)
+            {
+                uint8_t *err = &channel->dither_err[i * LED_COLOURS];
+
+                color[0] = dither_color(channel->gamma16, led >> channel->rshift, scale, &err[0]);
+                color[1] = dither_color(channel->gamma16, led >> channel->gshift, scale, &err[1]);
+                color[2] = dither_color(channel->gamma16, led >> channel->bshift, scale, &err[2]);
+                color[3] = dither_color(channel->gamma16, led >> channel->wshift, scale, &err[3]);
+            }
+            else
             {
-                channel->gamma[(((channel->leds[i] >> channel->rshift) & 0xff) * scale) >> 8], // red
-                channel->gamma[(((channel->leds[i] >> channel->gshift) & 0xff) * scale) >> 8], // green
-                channel->gamma[(((channel->leds[i] >> channel->bshift) & 0xff) * scale) >> 8], // blue
-                channel->gamma[(((channel->leds[i] >> channel->wshift) & 0xff) * scale) >> 8], // white
-            };
+                color[0] = channel->gamma[(((led >> channel->rshift) & 0xff) * scale) >> 8]; // red
+                color[1] = channel->gamma[(((led >> channel->gshift) & 0xff) * scale) >> 8]; // green
+                color[2] = channel->gamma[(((led >> channel->bshift) & 0xff) * scale) >> 8]; // blue
+                color[3] = channel->gamma[(((led >> channel->wshift) & 0xff) * scale) >> 8]; // white
+            }
 
             for (j = 0; j < array_size; j++)               // Color
             {
@@ -1260,67 +2019,1111 @@ ws2811_return_t  ws2811_render(ws2811_t *ws2811)
         }
     }
 
-    // Wait for any previous DMA operation to complete.
-    if ((ret = ws2811_wait(ws2811)) != WS2811_SUCCESS)
+    if (stats)
     {
-        return ret;
+        stats_add(&stats->encode, get_microsecond_timestamp() - begin);
     }
 
-    if (ws2811->render_wait_time != 0) {
-        const uint64_t current_timestamp = get_microsecond_timestamp();
-        uint64_t time_diff = current_timestamp - previous_timestamp;
+    return protocol_time;
+}
 
-        if (ws2811->render_wait_time > time_diff) {
-            usleep(ws2811->render_wait_time - time_diff);
-        }
-    }
+/**
+ * Time left before the strips have latched the previous frame.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  Microseconds to wait before the next frame may start.
+ */
+static uint64_t render_delay(ws2811_t *ws2811)
+{
+    uint64_t time_diff;
 
-    if (driver_mode != SPI)
+    if (ws2811->render_wait_time == 0)
     {
-        dma_start(ws2811);
+        return 0;
     }
-    else
+
+    time_diff = get_microsecond_timestamp() - ws2811->device->previous_timestamp;
+    if (ws2811->render_wait_time > time_diff)
     {
-        ret = spi_transfer(ws2811);
+        return ws2811->render_wait_time - time_diff;
     }
 
-    // LED_RESET_WAIT_TIME is added to allow enough time for the reset to occur.
-    previous_timestamp = get_microsecond_timestamp();
-    ws2811->render_wait_time = protocol_time + LED_RESET_WAIT_TIME;
-
-    return ret;
+    return 0;
 }
 
-const char * ws2811_get_return_t_str(const ws2811_return_t state)
+/**
+ * Record the start of a frame so the next render waits for the strips to latch it.
+ *
+ * @param    ws2811         ws2811 instance pointer.
+ * @param    protocol_time  Wire time of the frame in µs, from render_encode().
+ *
+ * @returns  None
+ */
+static void render_started(ws2811_t *ws2811, uint32_t protocol_time)
 {
-    const int index = -state;
-    static const char * const ret_state_str[] = { WS2811_RETURN_STATES(WS2811_RETURN_STATES_STRING) };
+    ws2811_device_t *device = ws2811->device;
+    ws2811_stats_t *stats = device->stats;
+    uint64_t now = get_microsecond_timestamp();
 
-    if (index < (int)(sizeof(ret_state_str) / sizeof(ret_state_str[0])))
+    if (stats)
     {
-        return ret_state_str[index];
+        stats->frames_rendered++;
+        if (device->previous_timestamp)
+        {
+            uint64_t interval = now - device->previous_timestamp;
+            uint64_t bucket = interval / WS2811_STATS_BUCKET_US;
+
+            stats_add(&stats->interval, interval);
+            stats->interval_hist[bucket < WS2811_STATS_BUCKETS ? bucket : WS2811_STATS_BUCKETS - 1]++;
+        }
     }
 
-    return "";
+    // LED_RESET_WAIT_TIME is added to allow enough time for the reset to occur.
+    device->previous_timestamp = now;
+    ws2811->render_wait_time = protocol_time + LED_RESET_WAIT_TIME;
 }
 
-
-void ws2811_set_custom_gamma_factor(ws2811_t *ws2811, double gamma_factor)
+/**
+ * Sleep until the strips of all given instances have latched their last frame.
+ *
+ * @param    lanes  Array of ws2811 instance pointers.
+ * @param    count  Number of instances.
+ * @param    delay  Longest render_delay() of the instances.
+ *
+ * @returns  None
+ */
+static void render_throttle(ws2811_t **lanes, int count, uint64_t delay)
 {
-    int chan, counter;
-    for (chan = 0; chan < RPI_PWM_CHANNELS; chan++)
-    {
-        ws2811_channel_t *channel = &ws2811->channel[chan];
+    uint64_t begin = 0, slept = 0;
+    int timed = 0;
+    int i;
 
-        if (channel->gamma)
+    for (i = 0; i < count; i++)
+    {
+        if (lanes[i]->device->stats)
         {
-          for(counter = 0; counter < 256; counter++)
-          {
+            timed = 1;
+        }
+    }
 
-             channel->gamma[counter] = (gamma_factor > 0)? (int)(pow((float)counter / (float)255.00, gamma_factor) * 255.00 + 0.5) : counter;
+    if (delay)
+    {
+        begin = timed ? get_microsecond_timestamp() : 0;
+        usleep(delay);
+        slept = timed ? get_microsecond_timestamp() - begin : 0;
+    }
 
-          }
+    for (i = 0; timed && (i < count); i++)
+    {
+        if (lanes[i]->device->stats)
+        {
+            stats_add(&lanes[i]->device->stats->throttle, slept);
         }
-
     }
 }
+
+/**
+ * Start the DMA of the encoded frame, or clock it out over SPI.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  WS2811_SUCCESS, or the error of dma_start() or spi_transfer().
+ */
+static ws2811_return_t render_start(ws2811_t *ws2811)
+{
+    ws2811_stats_t *stats = ws2811->device->stats;
+    uint64_t begin = stats_begin(stats);
+    ws2811_return_t ret;
+
+    if (ws2811->device->driver_mode != SPI)
+    {
+        ret = dma_start(ws2811);
+    }
+    else
+    {
+        ret = spi_transfer(ws2811);
+    }
+
+    if (stats)
+    {
+        stats_add(&stats->start, get_microsecond_timestamp() - begin);
+        if (ret == WS2811_ERROR_DMA)
+        {
+            stats->dma_errors++;
+        }
+        else if (ret != WS2811_SUCCESS)
+        {
+            stats->spi_errors++;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Render the DMA buffer from the user supplied LED arrays and start the DMA
+ * controller.  This will update all LEDs on both PWM channels.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+ws2811_return_t  ws2811_render(ws2811_t *ws2811)
+{
+    ws2811_return_t ret = WS2811_SUCCESS;
+    uint32_t protocol_time;
+    uint64_t delay;
+
+    protocol_time = render_encode(ws2811);
+
+    // Wait for any previous DMA operation to complete.
+    if ((ret = ws2811_wait(ws2811)) != WS2811_SUCCESS)
+    {
+        return ret;
+    }
+
+    delay = render_delay(ws2811);
+    render_throttle(&ws2811, 1, delay);
+
+    ret = render_start(ws2811);
+
+    render_started(ws2811, protocol_time);
+
+    return ret;
+}
+
+/**
+ * SPI transfers block until the last byte is out, so every SPI lane but one is
+ * clocked out from its own thread.
+ *
+ * @param    arg  ws2811 instance pointer of an SPI lane.
+ *
+ * @returns  ws2811_return_t of the transfer, cast to a pointer.
+ */
+static void *spi_lane_transfer(void *arg)
+{
+    return (void *)(intptr_t)render_start((ws2811_t *)arg);
+}
+
+/**
+ * Render several instances as one frame.  Each lane is an instance set up with
+ * ws2811_init() on its own output (the PWM channels, PCM, one per SPI bus) and its
+ * own dmanum.  All lanes are encoded first and then started back to back, so the
+ * frame takes as long as the longest lane instead of the sum of all of them.
+ *
+ * @param    lanes  Array of initialized ws2811 instance pointers.
+ * @param    count  Number of lanes, at most WS2811_MAX_LANES.
+ *
+ * @returns  WS2811_SUCCESS, or the first error any lane returned.
+ */
+ws2811_return_t ws2811_render_lanes(ws2811_t **lanes, int count)
+{
+    uint32_t protocol_time[WS2811_MAX_LANES];
+    pthread_t thread[WS2811_MAX_LANES];
+    int threaded[WS2811_MAX_LANES];
+    ws2811_return_t ret = WS2811_SUCCESS;
+    ws2811_return_t lane_ret;
+    uint64_t delay = 0;
+    int last_spi = -1;
+    int i;
+
+    if ((count < 1) || (count > WS2811_MAX_LANES))
+    {
+        return WS2811_ERROR_GENERIC;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (!lanes[i] || !lanes[i]->device)
+        {
+            return WS2811_ERROR_GENERIC;
+        }
+        protocol_time[i] = render_encode(lanes[i]);
+    }
+
+    // Every lane must be idle and latched before any of them starts, otherwise
+    // the lanes would drift apart by one frame.
+    for (i = 0; i < count; i++)
+    {
+        uint64_t lane_delay;
+
+        if ((ret = ws2811_wait(lanes[i])) != WS2811_SUCCESS)
+        {
+            return ret;
+        }
+
+        lane_delay = render_delay(lanes[i]);
+        if (lane_delay > delay)
+        {
+            delay = lane_delay;
+        }
+    }
+
+    render_throttle(lanes, count, delay);
+
+    // DMA lanes run on their own once started
+    for (i = 0; i < count; i++)
+    {
+        threaded[i] = 0;
+        if (lanes[i]->device->driver_mode != SPI)
+        {
+            lane_ret = render_start(lanes[i]);
+            render_started(lanes[i], protocol_time[i]);
+            if (ret == WS2811_SUCCESS)
+            {
+                ret = lane_ret;
+            }
+        }
+        else
+        {
+            last_spi = i;
+        }
+    }
+
+    for (i = 0; i < last_spi; i++)
+    {
+        if (lanes[i]->device->driver_mode == SPI)
+        {
+            threaded[i] = !pthread_create(&thread[i], NULL, spi_lane_transfer, lanes[i]);
+            if (!threaded[i])
+            {
+                // No thread, fall back to sending this lane in series
+                lane_ret = render_start(lanes[i]);
+                render_started(lanes[i], protocol_time[i]);
+                if (ret == WS2811_SUCCESS)
+                {
+                    ret = lane_ret;
+                }
+            }
+        }
+    }
+
+    if (last_spi >= 0)
+    {
+        lane_ret = render_start(lanes[last_spi]);
+        render_started(lanes[last_spi], protocol_time[last_spi]);
+        if (ret == WS2811_SUCCESS)
+        {
+            ret = lane_ret;
+        }
+    }
+
+    for (i = 0; i < last_spi; i++)
+    {
+        void *result;
+
+        if (threaded[i])
+        {
+            pthread_join(thread[i], &result);
+            render_started(lanes[i], protocol_time[i]);
+            if (ret == WS2811_SUCCESS)
+            {
+                ret = (ws2811_return_t)(intptr_t)result;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Move the frame to a DMA buffer for a new largest LED count.  The buffer is resized
+ * in its pool; only a pool of the driver's own that is too small is replaced.
+ *
+ * @param    ws2811     ws2811 instance pointer, DMA idle.
+ * @param    max_count  New largest LED count of the channels.
+ *
+ * @returns  WS2811_SUCCESS, or an error with the old frame left in place.
+ */
+static ws2811_return_t frame_resize(ws2811_t *ws2811, int max_count)
+{
+    ws2811_device_t *device = ws2811->device;
+    dma_cb_t dma_cb;
+    ws2811_return_t ret;
+
+    if (device->driver_mode == SPI)
+    {
+        volatile uint8_t *pxl_raw = realloc((uint8_t *)device->pxl_raw, PCM_BYTE_COUNT(max_count, ws2811->freq));
+
+        if (!pxl_raw)
+        {
+            return WS2811_ERROR_OUT_OF_MEMORY;
+        }
+        device->pxl_raw = pxl_raw;
+        device->max_count = max_count;
+        pcm_raw_init(ws2811);
+
+        free(device->spi_xfer);
+        device->spi_xfer = NULL;
+        return spi_segments_init(ws2811);
+    }
+
+    memcpy(&dma_cb, (dma_cb_t *)device->dma_cb, sizeof(dma_cb));
+
+    if (dmabuf_resize(&device->frame, frame_byte_count(ws2811, max_count)))
+    {
+        dmabuf_pool_t *pool = NULL;
+        dmabuf_t frame;
+
+        if (!device->pool)
+        {
+            // The shared pool is full, the application has to make room
+            return WS2811_ERROR_OUT_OF_MEMORY;
+        }
+
+        ret = dma_buffer_alloc(ws2811, &pool, &frame, frame_byte_count(ws2811, max_count));
+        if (ret != WS2811_SUCCESS)
+        {
+            return ret;
+        }
+        dma_buffer_free(&device->pool, &device->frame);
+        device->pool = pool;
+        device->frame = frame;
+    }
+
+    device->max_count = max_count;
+    device->dma_cb = (dma_cb_t *)device->frame.virt;
+    device->pxl_raw = device->frame.virt + sizeof(dma_cb_t);
+    device->dma_cb_addr = addr_to_bus(device, device->dma_cb);
+    device->frame_us = (uint64_t)PCM_BYTE_COUNT(max_count, ws2811->freq) * 8 * 1000000 /
+                       (3 * ws2811->freq);
+
+    if (device->driver_mode == PWM)
+    {
+        pwm_raw_init(ws2811);
+        dma_cb.txfr_len = PWM_BYTE_COUNT(max_count, ws2811->freq);
+    }
+    else
+    {
+        pcm_raw_init(ws2811);
+        dma_cb.txfr_len = PCM_BYTE_COUNT(max_count, ws2811->freq);
+    }
+    dma_cb.source_ad = addr_to_bus(device, device->pxl_raw);
+    dma_cb.nextconbk = 0;
+    memcpy((dma_cb_t *)device->dma_cb, &dma_cb, sizeof(dma_cb));
+
+    return WS2811_SUCCESS;
+}
+
+/**
+ * Change the number of LEDs of a channel without tearing the instance down.  The
+ * LED array keeps its contents (new LEDs are off), the DMA buffer is resized in
+ * place where its pool allows.  Waits for the frame in flight first.
+ *
+ * Not possible while the channel renders from a caller frame (channel[].source),
+ * the frame and remap table have the old size: clear source, resize, then install
+ * a frame of the new size.  Buffers sized from the count elsewhere stay as they
+ * are; led_fx only draws the LEDs the channel had at led_fx_open().
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    chan    Channel with a GPIO assigned at init, 0 in SPI mode.
+ * @param    count   New number of LEDs.
+ *
+ * @returns  WS2811_SUCCESS, or an error with the channel unchanged.
+ */
+ws2811_return_t ws2811_set_led_count(ws2811_t *ws2811, int chan, int count)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_channel_t *channel;
+    ws2811_led_t *leds;
+    int old_count, max_count;
+    int dither_new = 0;
+    ws2811_return_t ret;
+
+    if (!device || (chan < 0) || (chan >= RPI_PWM_CHANNELS) || (count < 0))
+    {
+        return WS2811_ERROR_GENERIC;
+    }
+
+    channel = &ws2811->channel[chan];
+    if (!channel->gpionum || ((device->driver_mode == SPI) && chan))
+    {
+        return WS2811_ERROR_ILLEGAL_GPIO;
+    }
+    if (device->buzzer.active || ((chan == 1) && device->buzzer.gpionum))
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+    if (channel->source && (count > channel->count))
+    {
+        // render_encode() would read past the caller's frame and remap table
+        return WS2811_ERROR_GENERIC;
+    }
+
+    if ((ret = ws2811_wait(ws2811)) != WS2811_SUCCESS)
+    {
+        return ret;
+    }
+
+    // Growing the arrays is harmless if the DMA buffer cannot follow
+    old_count = channel->count;
+    if (count > old_count)
+    {
+        leds = realloc(channel->leds, sizeof(ws2811_led_t) * count);
+        if (!leds)
+        {
+            return WS2811_ERROR_OUT_OF_MEMORY;
+        }
+        memset(leds + old_count, 0, sizeof(ws2811_led_t) * (count - old_count));
+        channel->leds = leds;
+
+        if (channel->dither_err)
+        {
+            uint8_t *dither_err = realloc(channel->dither_err, (size_t)count * 4);
+
+            if (!dither_err)
+            {
+                ret = WS2811_ERROR_OUT_OF_MEMORY;
+                goto err;
+            }
+            memset(dither_err + old_count * 4, 0, (size_t)(count - old_count) * 4);
+            channel->dither_err = dither_err;
+        }
+    }
+
+    channel->count = count;
+
+    // A dithered channel that started empty has no dither state yet
+    if (channel->dither && count && !channel->dither_err)
+    {
+        dither_new = 1;
+        if (dither_init(channel))
+        {
+            ret = WS2811_ERROR_OUT_OF_MEMORY;
+            goto err;
+        }
+    }
+
+    max_count = max_channel_led_count(ws2811);
+    if (max_count != device->max_count)
+    {
+        ret = frame_resize(ws2811, max_count);
+        if (ret != WS2811_SUCCESS)
+        {
+            goto err;
+        }
+    }
+
+    return WS2811_SUCCESS;
+
+err:
+    channel->count = old_count;
+    if (dither_new)
+    {
+        free(channel->gamma16);
+        free(channel->dither_err);
+        channel->gamma16 = NULL;
+        channel->dither_err = NULL;
+    }
+    else if (channel->dither_err && (count > old_count))
+    {
+        uint8_t *dither_err = realloc(channel->dither_err, (size_t)old_count * 4);
+
+        if (dither_err)
+        {
+            channel->dither_err = dither_err;
+        }
+    }
+    if (old_count && (count > old_count))
+    {
+        leds = realloc(channel->leds, sizeof(ws2811_led_t) * old_count);
+        if (leds)
+        {
+            channel->leds = leds;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Start collecting statistics from zero, or stop and drop them.
+ *
+ * @param    ws2811  ws2811 instance pointer, initialized.
+ * @param    enable  Non-zero to collect.
+ *
+ * @returns  WS2811_SUCCESS, WS2811_ERROR_GENERIC if not initialized,
+ *           WS2811_ERROR_OUT_OF_MEMORY.
+ */
+ws2811_return_t ws2811_stats_enable(ws2811_t *ws2811, int enable)
+{
+    ws2811_device_t *device = ws2811->device;
+
+    if (!device)
+    {
+        return WS2811_ERROR_GENERIC;
+    }
+
+    if (!enable)
+    {
+        free(device->stats);
+        device->stats = NULL;
+        return WS2811_SUCCESS;
+    }
+
+    if (!device->stats)
+    {
+        device->stats = malloc(sizeof(*device->stats));
+        if (!device->stats)
+        {
+            return WS2811_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    memset(device->stats, 0, sizeof(*device->stats));
+
+    return WS2811_SUCCESS;
+}
+
+/**
+ * Copy the current statistics.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    stats   Filled in.
+ *
+ * @returns  WS2811_SUCCESS, WS2811_ERROR_GENERIC if statistics are not enabled.
+ */
+ws2811_return_t ws2811_stats_get(ws2811_t *ws2811, ws2811_stats_t *stats)
+{
+    if (!ws2811->device || !ws2811->device->stats)
+    {
+        return WS2811_ERROR_GENERIC;
+    }
+
+    *stats = *ws2811->device->stats;
+
+    return WS2811_SUCCESS;
+}
+
+/**
+ * Zero the statistics, if enabled.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+void ws2811_stats_reset(ws2811_t *ws2811)
+{
+    if (ws2811->device && ws2811->device->stats)
+    {
+        memset(ws2811->device->stats, 0, sizeof(*ws2811->device->stats));
+    }
+}
+
+/**
+ * Count frames the application dropped instead of rendering, e.g. to catch up
+ * with its frame clock.  The driver cannot see those itself.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    frames  Number of frames dropped.
+ *
+ * @returns  None
+ */
+void ws2811_stats_skipped(ws2811_t *ws2811, uint32_t frames)
+{
+    if (ws2811->device && ws2811->device->stats)
+    {
+        ws2811->device->stats->frames_skipped += frames;
+    }
+}
+
+/**
+ * snprintf() that appends at *len and keeps counting past the end of the buffer.
+ */
+static void stats_printf(char *buf, size_t size, size_t *len, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(*len < size ? buf + *len : NULL, *len < size ? size - *len : 0, fmt, ap);
+    va_end(ap);
+
+    if (n > 0)
+    {
+        *len += n;
+    }
+}
+
+/**
+ * Format a statistics snapshot as text, one step per line, or as one JSON object.
+ *
+ * @param    stats  Snapshot from ws2811_stats_get().
+ * @param    json   Non-zero for JSON.
+ * @param    buf    Output, may be NULL with size 0 to get the length.
+ * @param    size   Size of buf.
+ *
+ * @returns  Length of the whole snapshot without the terminating NUL, like snprintf().
+ */
+int ws2811_stats_format(const ws2811_stats_t *stats, int json, char *buf, size_t size)
+{
+    const struct
+    {
+        const char *name;
+        const ws2811_stats_time_t *time;
+    } steps[] =
+    {
+        { "encode", &stats->encode },
+        { "wait", &stats->wait },
+        { "throttle", &stats->throttle },
+        { "start", &stats->start },
+        { "interval", &stats->interval },
+    };
+    size_t len = 0;
+    unsigned int i;
+
+    if (buf && size)
+    {
+        buf[0] = '\0';
+    }
+
+    stats_printf(buf, size, &len, json ?
+                 "{\"frames_rendered\":%llu,\"frames_skipped\":%llu,\"dma_errors\":%llu,\"spi_errors\":%llu" :
+                 "frames %llu skipped %llu dma_errors %llu spi_errors %llu\n",
+                 (unsigned long long)stats->frames_rendered, (unsigned long long)stats->frames_skipped,
+                 (unsigned long long)stats->dma_errors, (unsigned long long)stats->spi_errors);
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+    {
+        const ws2811_stats_time_t *t = steps[i].time;
+        unsigned long long avg = t->count ? t->total / t->count : 0;
+
+        stats_printf(buf, size, &len, json ?
+                     ",\"%s\":{\"count\":%llu,\"last\":%llu,\"avg\":%llu,\"max\":%llu}" :
+                     "%-8s count %llu last %llu avg %llu max %llu us\n",
+                     steps[i].name, (unsigned long long)t->count, (unsigned long long)t->last,
+                     avg, (unsigned long long)t->max);
+    }
+
+    if (json)
+    {
+        stats_printf(buf, size, &len, ",\"interval_bucket_us\":%d,\"interval_hist\":[", WS2811_STATS_BUCKET_US);
+        for (i = 0; i < WS2811_STATS_BUCKETS; i++)
+        {
+            stats_printf(buf, size, &len, "%s%llu", i ? "," : "", (unsigned long long)stats->interval_hist[i]);
+        }
+        stats_printf(buf, size, &len, "]}\n");
+    }
+    else
+    {
+        // Only the buckets that were hit, "<16000us" counts intervals from 15 to 16 ms
+        stats_printf(buf, size, &len, "hist");
+        for (i = 0; i < WS2811_STATS_BUCKETS; i++)
+        {
+            if (stats->interval_hist[i])
+            {
+                stats_printf(buf, size, &len, (i < WS2811_STATS_BUCKETS - 1) ? " <%uus:%llu" : " >=%uus:%llu",
+                             (i < WS2811_STATS_BUCKETS - 1 ? i + 1 : i) * WS2811_STATS_BUCKET_US,
+                             (unsigned long long)stats->interval_hist[i]);
+            }
+        }
+        stats_printf(buf, size, &len, "\n");
+    }
+
+    return (int)len;
+}
+
+/**
+ * Wait for the DMA of every lane to complete.
+ *
+ * @param    lanes  Array of initialized ws2811 instance pointers.
+ * @param    count  Number of lanes.
+ *
+ * @returns  WS2811_SUCCESS, or the first error any lane returned.
+ */
+ws2811_return_t ws2811_wait_lanes(ws2811_t **lanes, int count)
+{
+    ws2811_return_t ret = WS2811_SUCCESS;
+    ws2811_return_t lane_ret;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        lane_ret = ws2811_wait(lanes[i]);
+        if (ret == WS2811_SUCCESS)
+        {
+            ret = lane_ret;
+        }
+    }
+
+    return ret;
+}
+
+
+const char * ws2811_get_return_t_str(const ws2811_return_t state)
+{
+    const int index = -state;
+    static const char * const ret_state_str[] = { WS2811_RETURN_STATES(WS2811_RETURN_STATES_STRING) };
+
+    if (index < (int)(sizeof(ret_state_str) / sizeof(ret_state_str[0])))
+    {
+        return ret_state_str[index];
+    }
+
+    return "";
+}
+
+
+void ws2811_set_custom_gamma_factor(ws2811_t *ws2811, double gamma_factor)
+{
+    int chan, counter;
+    for (chan = 0; chan < RPI_PWM_CHANNELS; chan++)
+    {
+        ws2811_channel_t *channel = &ws2811->channel[chan];
+
+        if (channel->gamma)
+        {
+          for(counter = 0; counter < 256; counter++)
+          {
+
+             channel->gamma[counter] = (gamma_factor > 0)? (int)(pow((float)counter / (float)255.00, gamma_factor) * 255.00 + 0.5) : counter;
+
+          }
+        }
+
+        if (channel->gamma16)
+        {
+          for(counter = 0; counter < 256; counter++)
+          {
+             channel->gamma16[counter] = (gamma_factor > 0)? (int)(pow((float)counter / (float)255.00, gamma_factor) * 0xff00 + 0.5) : counter << 8;
+          }
+        }
+
+    }
+}
+
+/**
+ * Build the color correction tables of a channel, replacing any previous ones.
+ * Call after ws2811_init().
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    chan    Channel number.
+ * @param    cc      Matrix, gamma factors and white extraction, NULL to disable.
+ *
+ * @returns  WS2811_SUCCESS, WS2811_ERROR_GENERIC for a bad channel, WS2811_ERROR_OUT_OF_MEMORY.
+ */
+ws2811_return_t ws2811_set_color_correction(ws2811_t *ws2811, int chan, const ws2811_color_correction_t *cc)
+{
+    ws2811_channel_t *channel;
+    ws2811_color_t *color;
+    const double gamma_factor[LED_COLOURS] = { cc ? cc->gamma_b : 0, cc ? cc->gamma_g : 0,
+                                               cc ? cc->gamma_r : 0, cc ? cc->gamma_w : 0 };
+    int k, in, x;
+
+    if ((chan < 0) || (chan >= RPI_PWM_CHANNELS))
+    {
+        return WS2811_ERROR_GENERIC;
+    }
+    channel = &ws2811->channel[chan];
+
+    if (!cc)
+    {
+        free(channel->color);
+        channel->color = NULL;
+        return WS2811_SUCCESS;
+    }
+
+    color = malloc(sizeof(*color));
+    if (!color)
+    {
+        return WS2811_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        for (in = 0; in < 3; in++)
+        {
+            for (x = 0; x < 256; x++)
+            {
+                color->mix[k][in][x] = (cc->matrix[k][in] * x) / 256;
+            }
+        }
+    }
+
+    for (k = 0; k < LED_COLOURS; k++)
+    {
+        for (x = 0; x < 256; x++)
+        {
+            color->gamma16[k][x] = (gamma_factor[k] > 0) ?
+                                   (int)(pow((double)x / 255.0, gamma_factor[k]) * 0xff00 + 0.5) : x << 8;
+        }
+    }
+
+    color->white_extract = cc->white_extract;
+    color->brightness = -1;
+
+    free(channel->color);
+    channel->color = color;
+
+    return WS2811_SUCCESS;
+}
+
+/**
+ * White balance matrix that tints white towards a black body color temperature,
+ * scaled so the strongest primary stays at full power.
+ *
+ * @param    kelvin  Color temperature, 1000 to 40000.
+ * @param    matrix  Receives a diagonal matrix for ws2811_color_correction_t.
+ *
+ * @returns  None
+ */
+void ws2811_color_temperature(uint32_t kelvin, int16_t matrix[3][3])
+{
+    // Curve fit of the black body colors in sRGB, computed once at setup
+    double t = (kelvin < 1000 ? 1000 : (kelvin > 40000 ? 40000 : kelvin)) / 100.0;
+    double r, g, b, max;
+    int k;
+
+    if (t <= 66)
+    {
+        r = 255;
+        g = 99.4708025861 * log(t) - 161.1195681661;
+        b = (t <= 19) ? 0 : 138.5177312231 * log(t - 10) - 305.0447927307;
+    }
+    else
+    {
+        r = 329.698727446 * pow(t - 60, -0.1332047592);
+        g = 288.1221695283 * pow(t - 60, -0.0755148492);
+        b = 255;
+    }
+
+    r = r < 0 ? 0 : (r > 255 ? 255 : r);
+    g = g < 0 ? 0 : (g > 255 ? 255 : g);
+    b = b < 0 ? 0 : (b > 255 ? 255 : b);
+    max = r > g ? r : g;
+    max = max > b ? max : b;
+
+    memset(matrix, 0, sizeof(int16_t) * 9);
+    for (k = 0; k < 3; k++)
+    {
+        double c = (k == 0) ? r : ((k == 1) ? g : b);
+        matrix[k][k] = (int16_t)(c * 256 / max + 0.5);
+    }
+}
+
+/**
+ * Route the second PWM channel to a buzzer.  The LEDs stay on channel 0 and both are
+ * fed by the DMA channel given in ws2811->dmanum, so no extra DMA channel is taken.
+ *
+ * @param    ws2811   ws2811 instance pointer, initialized in PWM mode.
+ * @param    gpionum  PWM1 capable pin (13, 19, 41 or 45).
+ *
+ * @returns  WS2811_SUCCESS on success, error code otherwise.
+ */
+ws2811_return_t ws2811_buzzer_init(ws2811_t *ws2811, int gpionum)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_buzzer_t *buzzer;
+    ws2811_return_t ret;
+    int altnum;
+
+    if (!device || (device->driver_mode != PWM) || ws2811->channel[1].count)
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+
+    altnum = pwm_pin_alt(1, gpionum);
+    if (altnum < 0)
+    {
+        return WS2811_ERROR_ILLEGAL_GPIO;
+    }
+
+    buzzer = &device->buzzer;
+    if (!buzzer->buf.pool)
+    {
+        // Control blocks at 256 byte boundaries, then the interleaved waveform
+        ret = dma_buffer_alloc(ws2811, &buzzer->pool, &buzzer->buf,
+                               512 + (BUZZER_WAVE_WORDS * RPI_PWM_CHANNELS * sizeof(uint32_t)));
+        if (ret != WS2811_SUCCESS)
+        {
+            return ret;
+        }
+
+        buzzer->loop_cb = (dma_cb_t *)buzzer->buf.virt;
+        buzzer->resume_cb = (dma_cb_t *)(buzzer->buf.virt + 256);
+        buzzer->wave = (uint32_t *)(buzzer->buf.virt + 512);
+        buzzer->loop_cb_addr = dmabuf_bus_addr(&buzzer->buf, buzzer->loop_cb);
+        buzzer->resume_cb_addr = dmabuf_bus_addr(&buzzer->buf, buzzer->resume_cb);
+
+        memset((dma_cb_t *)buzzer->loop_cb, 0, sizeof(dma_cb_t));
+        memset((dma_cb_t *)buzzer->resume_cb, 0, sizeof(dma_cb_t));
+    }
+
+    gpio_function_set(device->gpio, gpionum, altnum);
+    buzzer->gpionum = gpionum;
+
+    return WS2811_SUCCESS;
+}
+
+/**
+ * Loop a square wave on the buzzer.  The loop holds a whole number of periods, its
+ * length is picked so the played frequency is within 0.05% of freq_hz where possible.
+ * LED frames rendered while the tone plays are delayed to the next loop boundary,
+ * at most BUZZER_TONE_WORDS words (about 14ms at 800kHz).
+ *
+ * @param    ws2811   ws2811 instance pointer.
+ * @param    freq_hz  Tone frequency, 0 silences the buzzer.
+ * @param    volume   0..255, mapped to 0..50% duty cycle.
+ *
+ * @returns  WS2811_SUCCESS on success, error code otherwise.
+ */
+ws2811_return_t ws2811_buzzer_tone(ws2811_t *ws2811, uint32_t freq_hz, uint8_t volume)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_buzzer_t *buzzer;
+    uint32_t bit_rate, words, best_words = 0;
+    uint64_t bits, periods, best_periods = 0, threshold;
+    double err, best_err = INFINITY;
+    ws2811_return_t ret;
+    uint32_t i;
+    int b;
+
+    if (!device || !device->buzzer.gpionum)
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+    buzzer = &device->buzzer;
+
+    if (!freq_hz || !volume)
+    {
+        return buzzer_halt(ws2811);
+    }
+
+    bit_rate = pwm_bit_rate(ws2811);
+    if (freq_hz > (bit_rate / 2))
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+
+    for (words = 1; words <= BUZZER_TONE_WORDS; words++)
+    {
+        bits = (uint64_t)words * 32;
+        periods = ((bits * freq_hz) + (bit_rate / 2)) / bit_rate;
+        if (!periods)
+        {
+            continue;
+        }
+
+        err = fabs(((double)periods * bit_rate / bits) - freq_hz);
+        if (err < best_err)
+        {
+            best_err = err;
+            best_words = words;
+            best_periods = periods;
+        }
+
+        if ((err * 2000) <= freq_hz)
+        {
+            break;
+        }
+    }
+
+    if ((ret = buzzer_halt(ws2811)) != WS2811_SUCCESS)
+    {
+        return ret;
+    }
+
+    bits = (uint64_t)best_words * 32;
+    threshold = (bits * volume) / 510;
+    for (i = 0; i < best_words; i++)
+    {
+        uint32_t word = 0;
+
+        for (b = 0; b < 32; b++)
+        {
+            uint64_t n = ((uint64_t)i * 32) + b;
+
+            if (((n * best_periods) % bits) < threshold)
+            {
+                word |= 0x80000000 >> b;
+            }
+        }
+
+        buzzer->wave[i * 2] = 0x0;
+        buzzer->wave[(i * 2) + 1] = word;
+    }
+    buzzer->wave_words = best_words;
+
+    return buzzer_play(ws2811);
+}
+
+/**
+ * Loop a buffer of unsigned 8-bit samples on the buzzer, converted to a first order
+ * sigma-delta bit stream at the PWM bit rate.  The buffer must fit in BUZZER_WAVE_WORDS
+ * words per channel (about 109ms at 800kHz).
+ *
+ * @param    ws2811       ws2811 instance pointer.
+ * @param    samples      Unsigned samples, 128 is the midpoint.
+ * @param    count        Number of samples.
+ * @param    sample_rate  Samples per second.
+ *
+ * @returns  WS2811_SUCCESS on success, error code otherwise.
+ */
+ws2811_return_t ws2811_buzzer_pcm(ws2811_t *ws2811, const uint8_t *samples,
+                                  uint32_t count, uint32_t sample_rate)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_buzzer_t *buzzer;
+    uint32_t bit_rate, words, acc = 0;
+    ws2811_return_t ret;
+    uint32_t i;
+    int b;
+
+    if (!device || !device->buzzer.gpionum || !samples || !count || !sample_rate)
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+    buzzer = &device->buzzer;
+
+    bit_rate = pwm_bit_rate(ws2811);
+    words = ((uint64_t)count * bit_rate / sample_rate) / 32;
+    if (!words || (words > BUZZER_WAVE_WORDS))
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+
+    if ((ret = buzzer_halt(ws2811)) != WS2811_SUCCESS)
+    {
+        return ret;
+    }
+
+    for (i = 0; i < words; i++)
+    {
+        uint32_t word = 0;
+
+        for (b = 0; b < 32; b++)
+        {
+            uint64_t n = ((uint64_t)i * 32) + b;
+
+            acc += samples[(n * sample_rate) / bit_rate];
+            if (acc >= 255)
+            {
+                acc -= 255;
+                word |= 0x80000000 >> b;
+            }
+        }
+
+        buzzer->wave[i * 2] = 0x0;
+        buzzer->wave[(i * 2) + 1] = word;
+    }
+    buzzer->wave_words = words;
+
+    return buzzer_play(ws2811);
+}
+
+/**
+ * Silence the buzzer.  Any LED frame in flight is completed first.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  WS2811_SUCCESS on success, error code otherwise.
+ */
+ws2811_return_t ws2811_buzzer_stop(ws2811_t *ws2811)
+{
+    if (!ws2811->device || !ws2811->device->buzzer.gpionum)
+    {
+        return WS2811_ERROR_BUZZER;
+    }
+
+    return buzzer_halt(ws2811);
+}
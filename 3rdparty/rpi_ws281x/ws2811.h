@@ -35,6 +35,7 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "rpihw.h"
@@ -42,6 +43,7 @@ extern "C" {
 
 
 #define WS2811_TARGET_FREQ                       800000   // Can go as low as 400000
+#define WS2811_MAX_LANES                         8        // Instances ws2811_render_lanes() can start together
 
 // 4 color R, G, B and W ordering
 #define SK6812_STRIP_RGBW                        0x18100800
@@ -66,6 +68,8 @@ extern "C" {
 #define SK6812W_STRIP                            SK6812_STRIP_GRBW
 
 struct ws2811_device;
+struct ws2811_color;
+struct dmabuf_pool;
 
 typedef uint32_t ws2811_led_t;                   //< 0xWWRRGGBB
 typedef struct ws2811_channel_t
@@ -81,6 +85,12 @@ typedef struct ws2811_channel_t
     uint8_t gshift;                              //< Green shift value
     uint8_t bshift;                              //< Blue shift value
     uint8_t *gamma;                              //< Gamma correction table
+    int dither;                                  //< Temporal dithering, set before ws2811_init()
+    uint16_t *gamma16;                           //< 8.8 fixed point gamma table used when dithering, allocated by driver
+    uint8_t *dither_err;                         //< Per LED and color dithering remainder, allocated by driver
+    const ws2811_led_t *source;                  //< Render source[remap[i]] instead of leds[i], NULL to use leds
+    const uint32_t *remap;                       //< Source index of each LED when source is set, NULL for source[i]
+    struct ws2811_color *color;                  //< Color correction tables, see ws2811_set_color_correction()
 } ws2811_channel_t;
 
 typedef struct ws2811_t
@@ -91,6 +101,9 @@ typedef struct ws2811_t
     uint32_t freq;                               //< Required output frequency
     int dmanum;                                  //< DMA number _not_ already in use
     ws2811_channel_t channel[RPI_PWM_CHANNELS];
+    const char *spi_device;                      //< SPI mode on any bus/chip select, e.g. "/dev/spidev1.2", NULL to pick from channel[0].gpionum
+    uint32_t spi_speed;                          //< SPI clock in Hz, 0 for 3 * freq
+    struct dmabuf_pool *dma_pool;                //< DMA memory shared with other users (dmabuf.h), NULL for a pool of its own
 } ws2811_t;
 
 #define WS2811_RETURN_STATES(X)                                                             \
@@ -108,7 +121,8 @@ typedef struct ws2811_t
             X(-11, WS2811_ERROR_ILLEGAL_GPIO, "Selected GPIO not possible"),                \
             X(-12, WS2811_ERROR_PCM_SETUP, "Unable to initialize PCM"),                     \
             X(-13, WS2811_ERROR_SPI_SETUP, "Unable to initialize SPI"),                     \
-            X(-14, WS2811_ERROR_SPI_TRANSFER, "SPI transfer error")                         \
+            X(-14, WS2811_ERROR_SPI_TRANSFER, "SPI transfer error"),                        \
+            X(-15, WS2811_ERROR_BUZZER, "Buzzer not initialized or waveform not possible")  \
 
 #define WS2811_RETURN_STATES_ENUM(state, name, str) name = state
 #define WS2811_RETURN_STATES_STRING(state, name, str) str
@@ -123,9 +137,95 @@ ws2811_return_t ws2811_init(ws2811_t *ws2811);
 void ws2811_fini(ws2811_t *ws2811);                                             //< Tear it all down
 ws2811_return_t ws2811_render(ws2811_t *ws2811);                                //< Send LEDs off to hardware
 ws2811_return_t ws2811_wait(ws2811_t *ws2811);                                  //< Wait for DMA completion
+ws2811_return_t ws2811_set_led_count(ws2811_t *ws2811, int chan, int count);   //< Resize a channel without ws2811_fini()/ws2811_init()
 const char * ws2811_get_return_t_str(const ws2811_return_t state);              //< Get string representation of the given return state
 void ws2811_set_custom_gamma_factor(ws2811_t *ws2811, double gamma_factor);     //< Set a custom Gamma correction array based on a gamma correction factor
 
+/*
+ * Per channel color correction, applied while encoding: a 3x3 matrix on R, G, B
+ * (white balance, color temperature), optional white extraction for RGBW strips,
+ * then separate gamma curves for R, G, B and W.  Brightness is applied after gamma
+ * on corrected channels, so it dims linearly in light output.
+ */
+typedef struct ws2811_color_correction_t
+{
+    int16_t matrix[3][3];                        //< Output R, G, B rows from input R, G, B, 256 = 1.0
+    double gamma_r;                              //< Gamma factors, 0 or 1 for linear
+    double gamma_g;
+    double gamma_b;
+    double gamma_w;
+    int white_extract;                           //< RGBW strips: move the part common to R, G and B to W
+} ws2811_color_correction_t;
+
+ws2811_return_t ws2811_set_color_correction(ws2811_t *ws2811, int chan,
+                                            const ws2811_color_correction_t *cc); //< Build the correction tables, NULL to disable
+void ws2811_color_temperature(uint32_t kelvin, int16_t matrix[3][3]);           //< White balance matrix towards a color temperature
+
+/*
+ * Temporal dithering.  With channel[].dither set, brightness and gamma are applied in
+ * 8.8 fixed point, in the same order as without dithering, and the fraction the 8-bit
+ * output drops is carried over to the same LED in the next frame, so dim levels
+ * between two output steps are shown as an average over a few frames.  Works best at
+ * high refresh rates.
+ */
+
+/*
+ * Lanes: several instances, each initialized on its own output (PWM channels, PCM,
+ * SPI0 on GPIO 10, SPI1 on GPIO 20) with its own dmanum, rendered as one frame.
+ * The frame takes as long as the longest lane, not the sum of all lanes.
+ */
+ws2811_return_t ws2811_render_lanes(ws2811_t **lanes, int count);             //< Encode all lanes, then start them together
+ws2811_return_t ws2811_wait_lanes(ws2811_t **lanes, int count);               //< Wait for DMA completion on all lanes
+
+/*
+ * Opt-in statistics, to tell whether slow or dropped frames come from encoding,
+ * waiting for the DMA, the latch delay or the scheduler.  Disabled by default, then
+ * rendering takes no timestamps.  Times are in µs.
+ */
+#define WS2811_STATS_BUCKETS                     32       // Frame interval histogram buckets
+#define WS2811_STATS_BUCKET_US                   1000     // Width of a bucket, the last one is open ended
+
+typedef struct ws2811_stats_time_t
+{
+    uint64_t count;                              //< Samples
+    uint64_t last;
+    uint64_t max;
+    uint64_t total;
+} ws2811_stats_time_t;
+
+typedef struct ws2811_stats_t
+{
+    uint64_t frames_rendered;                    //< Frames started
+    uint64_t frames_skipped;                     //< Frames the application dropped, see ws2811_stats_skipped()
+    uint64_t dma_errors;                         //< DMA errors and timeouts
+    uint64_t spi_errors;                         //< Failed SPI transfers
+    ws2811_stats_time_t encode;                  //< Encoding leds[] into the DMA/SPI buffer
+    ws2811_stats_time_t wait;                    //< ws2811_wait(), DMA of the previous frame
+    ws2811_stats_time_t throttle;                //< Sleeping for render_wait_time, strips latching
+    ws2811_stats_time_t start;                   //< Starting the DMA, or the whole SPI transfer
+    ws2811_stats_time_t interval;                //< Start of one frame to the start of the next
+    uint64_t interval_hist[WS2811_STATS_BUCKETS];
+} ws2811_stats_t;
+
+ws2811_return_t ws2811_stats_enable(ws2811_t *ws2811, int enable);             //< Start collecting from zero, or stop
+ws2811_return_t ws2811_stats_get(ws2811_t *ws2811, ws2811_stats_t *stats);      //< Snapshot of the counters
+void ws2811_stats_reset(ws2811_t *ws2811);                                      //< Zero the counters
+void ws2811_stats_skipped(ws2811_t *ws2811, uint32_t frames);                   //< Count frames the application did not render
+int ws2811_stats_format(const ws2811_stats_t *stats, int json,
+                        char *buf, size_t size);                                //< Text or JSON snapshot, snprintf() semantics
+
+/*
+ * Buzzer on the second PWM channel.  The waveform is looped by the same DMA channel
+ * that feeds the LEDs on channel 0, so playback costs no CPU time.  Only available
+ * in PWM mode with channel[1] left unused.
+ */
+ws2811_return_t ws2811_buzzer_init(ws2811_t *ws2811, int gpionum);              //< Route PWM1 to a buzzer on gpionum (13, 19, 41 or 45)
+ws2811_return_t ws2811_buzzer_tone(ws2811_t *ws2811, uint32_t freq_hz,
+                                   uint8_t volume);                             //< Loop a square wave, volume 0..255 maps to 0..50% duty
+ws2811_return_t ws2811_buzzer_pcm(ws2811_t *ws2811, const uint8_t *samples,
+                                  uint32_t count, uint32_t sample_rate);        //< Loop unsigned 8-bit samples as a 1-bit PDM stream
+ws2811_return_t ws2811_buzzer_stop(ws2811_t *ws2811);                          //< Silence the buzzer
+
 #ifdef __cplusplus
 }
 #endif
@@ -196,6 +196,19 @@
 #endif 
 #endif
 
+/* 
+  The macro U8G2_WITH_FAST_FONT adds support for the fast decode font format 
+  (bdfconv -f 3). These fonts are not compressed and about twice as large, but
+  a glyph is drawn with a few byte operations into vertical_top_lsb display
+  memory instead of decoding it bit by bit. RLE fonts can be used as before.
+  Define U8G2_WITHOUT_FAST_FONT to remove the support.
+*/
+#if defined(unix) || defined(__unix__) || defined(__arm__) || defined(__arc__) || defined(ESP8266) || defined(ESP_PLATFORM) || defined(__LUATOS__)
+#ifndef U8G2_WITHOUT_FAST_FONT
+#define U8G2_WITH_FAST_FONT
+#endif
+#endif
+
 /*==========================================*/
 /* C++ compatible */
 
@@ -166,11 +166,86 @@ void u8g2_read_font_info(u8g2_font_info_t *font_info, const uint8_t *font)
 }
 
 
+#ifdef U8G2_WITH_FAST_FONT
+/*========================================================================*/
+/* fast decode font format (bdfconv -f 3), see tools/font/bdfconv/bdf_fast.c */
+
+/*
+  After the font data structure there is a table with 256 offsets 
+  (4 bytes, high byte first, relative to the font start) for the high 
+  byte of the encoding. Each offset points to another table with 256 
+  glyph offsets for the low byte. 0 is used for missing entries.
+  The RLE fields bits_per_0 is 0 for this format.
+*/
+#define U8G2_FONT_FAST_TABLE_POS U8G2_FONT_DATA_STRUCT_SIZE
+#define U8G2_FONT_FAST_GLYPH_HEADER 5
+
+static uint32_t u8g2_font_get_long(const uint8_t *font)
+{
+  uint32_t v;
+  v = u8x8_pgm_read( font );
+  v <<= 8;
+  v |= u8x8_pgm_read( font + 1 );
+  v <<= 8;
+  v |= u8x8_pgm_read( font + 2 );
+  v <<= 8;
+  v |= u8x8_pgm_read( font + 3 );
+  return v;
+}
+
+static const uint8_t *u8g2_font_fast_get_glyph_data(const uint8_t *font, uint16_t encoding)
+{
+  uint32_t offset;
+  offset = u8g2_font_get_long(font + U8G2_FONT_FAST_TABLE_POS + (encoding >> 8)*4);
+  if ( offset == 0 )
+    return NULL;
+  offset = u8g2_font_get_long(font + offset + (encoding & 255)*4);
+  if ( offset == 0 )
+    return NULL;
+  return font + offset;
+}
+
+static size_t u8g2_font_fast_get_size(const uint8_t *font)
+{
+  uint32_t table, offset, size, end;
+  uint16_t i, j;
+  const uint8_t *glyph;
+  
+  size = U8G2_FONT_FAST_TABLE_POS + 256*4;
+  for( i = 0; i < 256; i++ )
+  {
+    table = u8g2_font_get_long(font + U8G2_FONT_FAST_TABLE_POS + i*4);
+    if ( table == 0 )
+      continue;
+    if ( size < table + 256*4 )
+      size = table + 256*4;
+    for( j = 0; j < 256; j++ )
+    {
+      offset = u8g2_font_get_long(font + table + j*4);
+      if ( offset == 0 )
+	continue;
+      glyph = font + offset;
+      end = offset + U8G2_FONT_FAST_GLYPH_HEADER;
+      end += (uint32_t)u8x8_pgm_read(glyph) * ((u8x8_pgm_read(glyph + 1) + 7) / 8);
+      if ( size < end )
+	size = end;
+    }
+  }
+  return size;
+}
+#endif /* U8G2_WITH_FAST_FONT */
+
+
 /* calculate the overall length of the font, only used to create the picture for the google wiki */
 size_t u8g2_GetFontSize(const uint8_t *font_arg)
 {
   uint16_t e;
   const uint8_t *font = font_arg;
+  
+#ifdef U8G2_WITH_FAST_FONT
+  if ( u8g2_font_get_byte(font_arg, 2) == 0 )
+    return u8g2_font_fast_get_size(font_arg);
+#endif /* U8G2_WITH_FAST_FONT */
   font += U8G2_FONT_DATA_STRUCT_SIZE;
   
   for(;;)
@@ -771,6 +846,225 @@ int8_t u8g2_font_2x_decode_glyph(u8g2_t *u8g2, const uint8_t *glyph_data)
   return d*2;
 }
 
+#ifdef U8G2_WITH_FAST_FONT
+/*========================================================================*/
+/* fast decode font format: glyph drawing */
+
+static uint8_t u8g2_font_fast_apply(uint8_t b, uint8_t mask, uint8_t color)
+{
+  if ( color == 0 )
+    return b & ~mask;
+  if ( color == 1 )
+    return b | mask;
+  return b ^ mask;
+}
+
+/*
+  Description:
+    Copy the glyph bitmap into display memory with the vertical_top_lsb
+    layout. Each glyph byte is shifted to the page of the buffer and 
+    combined with the buffer bytes through masks. Only for display 
+    rotation U8G2_R0 and font direction 0.
+  Args:
+    bitmap:			page bytes of the glyph
+    w, h:				size of the glyph
+    u8g2->font_decode.target_x	upper left X position
+    u8g2->font_decode.target_y	upper left Y position
+*/
+static void u8g2_font_fast_copy(u8g2_t *u8g2, const uint8_t *bitmap, uint8_t w, uint8_t h)
+{
+  u8g2_font_decode_t *decode = &(u8g2->font_decode);
+  uint16_t stride = u8g2_GetU8x8(u8g2)->display_info->tile_width*8;
+  uint8_t *ptr;
+  uint8_t page, bit, c;
+  uint8_t valid, first, shift;
+  uint16_t mask, fg, bg;
+  u8g2_uint_t x, y;
+  int16_t base;
+
+#ifdef U8G2_WITH_CLIP_WINDOW_SUPPORT
+  if ( u8g2->is_page_clip_window_intersection == 0 )
+    return;
+#endif /* U8G2_WITH_CLIP_WINDOW_SUPPORT */
+
+  for( page = 0; page*8 < h; page++, bitmap += w )
+  {
+    /* rows of this page, which are inside the glyph and the current page window */
+    valid = 0;
+    first = 8;
+    for( bit = 0; bit < 8 && page*8+bit < h; bit++ )
+    {
+      y = decode->target_y;
+      y += page*8+bit;
+      if ( y >= u8g2->user_y0 && y < u8g2->user_y1 )
+      {
+	valid |= 1<<bit;
+	if ( first == 8 )
+	  first = bit;
+      }
+    }
+    if ( valid == 0 )
+      continue;
+    
+    /* row of bit 0 in the buffer, might be above the buffer */
+    y = decode->target_y;
+    y += page*8+first;
+    y -= u8g2->pixel_curr_row;
+    base = (int16_t)y - first;
+    shift = 0;
+    if ( base < 0 )
+    {
+      shift = -base;
+      base = 0;
+    }
+    ptr = u8g2->tile_buf_ptr + (base >> 3)*stride;
+    base &= 7;
+    mask = (uint16_t)(valid >> shift) << base;
+    
+    for( c = 0; c < w; c++ )
+    {
+      x = decode->target_x;
+      x += c;
+      if ( x < u8g2->user_x0 || x >= u8g2->user_x1 )
+	continue;
+      fg = (uint16_t)((u8x8_pgm_read(bitmap + c) & valid) >> shift) << base;
+      bg = mask & ~fg;
+      ptr[x] = u8g2_font_fast_apply(ptr[x], fg & 255, decode->fg_color);
+      if ( decode->is_transparent == 0 )
+	ptr[x] = u8g2_font_fast_apply(ptr[x], bg & 255, decode->bg_color);
+      if ( (mask >> 8) != 0 )
+      {
+	ptr[x+stride] = u8g2_font_fast_apply(ptr[x+stride], fg >> 8, decode->fg_color);
+	if ( decode->is_transparent == 0 )
+	  ptr[x+stride] = u8g2_font_fast_apply(ptr[x+stride], bg >> 8, decode->bg_color);
+      }
+    }
+  }
+}
+
+/*
+  Description:
+    Draw the glyph bitmap column by column with u8g2_DrawHVLine().
+    Used for all cases, which are not handled by u8g2_font_fast_copy().
+  Args:
+    scale:	1 or 2 (u8g2_DrawGlyphX2), font rotation is ignored for 2
+*/
+static void u8g2_font_fast_draw_lines(u8g2_t *u8g2, const uint8_t *bitmap, uint8_t w, uint8_t h, uint8_t scale)
+{
+  u8g2_font_decode_t *decode = &(u8g2->font_decode);
+  uint8_t c, r, len, is_foreground;
+  u8g2_uint_t x, y;
+  
+  for( c = 0; c < w; c++ )
+  {
+    r = 0;
+    while( r < h )
+    {
+      is_foreground = (u8x8_pgm_read(bitmap + (r>>3)*w + c) >> (r&7)) & 1;
+      len = 1;
+      while( r+len < h && ((u8x8_pgm_read(bitmap + ((r+len)>>3)*w + c) >> ((r+len)&7)) & 1) == is_foreground )
+	len++;
+      
+      if ( is_foreground || decode->is_transparent == 0 )
+      {
+	u8g2->draw_color = is_foreground ? decode->fg_color : decode->bg_color;
+	x = decode->target_x;
+	y = decode->target_y;
+	if ( scale == 2 )
+	{
+	  x += c*2;
+	  y += r*2;
+	  u8g2_DrawHVLine(u8g2, x, y, len*2, 1);
+	  u8g2_DrawHVLine(u8g2, x+1, y, len*2, 1);
+	}
+	else
+	{
+#ifdef U8G2_WITH_FONT_ROTATION
+	  x = u8g2_add_vector_x(x, c, r, decode->dir);
+	  y = u8g2_add_vector_y(y, c, r, decode->dir);
+	  u8g2_DrawHVLine(u8g2, x, y, len, (decode->dir+1) & 3);
+#else
+	  x += c;
+	  y += r;
+	  u8g2_DrawHVLine(u8g2, x, y, len, 1);
+#endif
+	}
+      }
+      r += len;
+    }
+  }
+}
+
+/*
+  Description:
+    Draw a glyph of a fast decode font.
+  Args:
+    glyph_data: 					Pointer to the glyph, see u8g2_font_fast_get_glyph_data()
+    scale:					1 or 2 (u8g2_DrawGlyphX2)
+    u8g2->font_decode.target_x		X position
+    u8g2->font_decode.target_y		Y position
+    u8g2->font_decode.is_transparent	Transparent mode
+  Return:
+    Width (delta x advance) of the glyph.
+*/
+static int8_t u8g2_font_fast_decode_glyph(u8g2_t *u8g2, const uint8_t *glyph_data, uint8_t scale)
+{
+  u8g2_font_decode_t *decode = &(u8g2->font_decode);
+  int8_t x, y, d;
+  uint8_t w, h;
+  
+  w = u8x8_pgm_read( glyph_data );
+  h = u8x8_pgm_read( glyph_data + 1 );
+  x = (int8_t)u8x8_pgm_read( glyph_data + 2 );
+  y = (int8_t)u8x8_pgm_read( glyph_data + 3 );
+  d = (int8_t)u8x8_pgm_read( glyph_data + 4 );
+  decode->glyph_width = w;
+  decode->glyph_height = h;
+  decode->fg_color = u8g2->draw_color;
+  decode->bg_color = (decode->fg_color == 0 ? 1 : 0);
+  
+  if ( w == 0 )
+    return d*scale;
+  
+  if ( scale == 2 )
+  {
+    decode->target_x += x;
+    decode->target_y -= 2*h+y;
+  }
+  else
+  {
+#ifdef U8G2_WITH_FONT_ROTATION
+    decode->target_x = u8g2_add_vector_x(decode->target_x, x, -(h+y), decode->dir);
+    decode->target_y = u8g2_add_vector_y(decode->target_y, x, -(h+y), decode->dir);
+#else
+    decode->target_x += x;
+    decode->target_y -= h+y;
+#endif
+  }
+  
+#ifdef U8G2_WITH_FONT_ROTATION
+  if ( scale == 1 && decode->dir == 0 )
+#endif
+  {
+#ifdef U8G2_WITH_INTERSECTION
+    if ( u8g2_IsIntersection(u8g2, decode->target_x, decode->target_y, decode->target_x+w*scale, decode->target_y+h*scale) == 0 ) 
+      return d*scale;
+#endif /* U8G2_WITH_INTERSECTION */
+    if ( scale == 1 && u8g2->cb->draw_l90 == u8g2_draw_l90_r0 && u8g2->ll_hvline == u8g2_ll_hvline_vertical_top_lsb )
+    {
+      u8g2_font_fast_copy(u8g2, glyph_data + U8G2_FONT_FAST_GLYPH_HEADER, w, h);
+      return d;
+    }
+  }
+  
+  u8g2_font_fast_draw_lines(u8g2, glyph_data + U8G2_FONT_FAST_GLYPH_HEADER, w, h, scale);
+  
+  /* restore the u8g2 draw color, because this is modified by the line drawing */
+  u8g2->draw_color = decode->fg_color;
+  return d*scale;
+}
+#endif /* U8G2_WITH_FAST_FONT */
+
 /*
   Description:
     Find the starting point of the glyph data.
@@ -782,6 +1076,10 @@ int8_t u8g2_font_2x_decode_glyph(u8g2_t *u8g2, const uint8_t *glyph_data)
 const uint8_t *u8g2_font_get_glyph_data(u8g2_t *u8g2, uint16_t encoding)
 {
   const uint8_t *font = u8g2->font;
+#ifdef U8G2_WITH_FAST_FONT
+  if ( u8g2->font_info.bits_per_0 == 0 )
+    return u8g2_font_fast_get_glyph_data(font, encoding);
+#endif /* U8G2_WITH_FAST_FONT */
   font += U8G2_FONT_DATA_STRUCT_SIZE;
 
   
@@ -876,6 +1174,10 @@ static u8g2_uint_t u8g2_font_draw_glyph(u8g2_t *u8g2, u8g2_uint_t x, u8g2_uint_t
   const uint8_t *glyph_data = u8g2_font_get_glyph_data(u8g2, encoding);
   if ( glyph_data != NULL )
   {
+#ifdef U8G2_WITH_FAST_FONT
+    if ( u8g2->font_info.bits_per_0 == 0 )
+      return u8g2_font_fast_decode_glyph(u8g2, glyph_data, 1);
+#endif /* U8G2_WITH_FAST_FONT */
     dx = u8g2_font_decode_glyph(u8g2, glyph_data);
   }
   return dx;
@@ -889,6 +1191,10 @@ static u8g2_uint_t u8g2_font_2x_draw_glyph(u8g2_t *u8g2, u8g2_uint_t x, u8g2_uin
   const uint8_t *glyph_data = u8g2_font_get_glyph_data(u8g2, encoding);
   if ( glyph_data != NULL )
   {
+#ifdef U8G2_WITH_FAST_FONT
+    if ( u8g2->font_info.bits_per_0 == 0 )
+      return u8g2_font_fast_decode_glyph(u8g2, glyph_data, 2);
+#endif /* U8G2_WITH_FAST_FONT */
     dx = u8g2_font_2x_decode_glyph(u8g2, glyph_data);
   }
   return dx;
@@ -911,6 +1217,15 @@ int8_t u8g2_GetGlyphWidth(u8g2_t *u8g2, uint16_t requested_encoding)
   if ( glyph_data == NULL )
     return 0; 
   
+#ifdef U8G2_WITH_FAST_FONT
+  if ( u8g2->font_info.bits_per_0 == 0 )
+  {
+    u8g2->font_decode.glyph_width = u8x8_pgm_read( glyph_data );
+    u8g2->font_decode.glyph_height = u8x8_pgm_read( glyph_data + 1 );
+    u8g2->glyph_x_offset = (int8_t)u8x8_pgm_read( glyph_data + 2 );
+    return (int8_t)u8x8_pgm_read( glyph_data + 4 );
+  }
+#endif /* U8G2_WITH_FAST_FONT */
   u8g2_font_setup_decode(u8g2, glyph_data);
   u8g2->glyph_x_offset = u8g2_font_decode_get_signed_bits(&(u8g2->font_decode), u8g2->font_info.bits_per_char_x);
   u8g2_font_decode_get_signed_bits(&(u8g2->font_decode), u8g2->font_info.bits_per_char_y);
@@ -1405,6 +1720,15 @@ static void u8g2_GetGlyphHorizontalProperties(u8g2_t *u8g2, uint16_t requested_e
   if ( glyph_data == NULL )
     return; 
   
+#ifdef U8G2_WITH_FAST_FONT
+  if ( u8g2->font_info.bits_per_0 == 0 )
+  {
+    *w = u8x8_pgm_read( glyph_data );
+    *ox = (int8_t)u8x8_pgm_read( glyph_data + 2 );
+    *dx = (int8_t)u8x8_pgm_read( glyph_data + 4 );
+    return;
+  }
+#endif /* U8G2_WITH_FAST_FONT */
   u8g2_font_setup_decode(u8g2, glyph_data);
   *w = u8g2->font_decode.glyph_width;
   *ox =  u8g2_font_decode_get_signed_bits(&(u8g2->font_decode), u8g2->font_info.bits_per_char_x);
@@ -73,6 +73,7 @@
     U8X8_MSG_BYTE_END_TRANSFER
     U8X8_MSG_BYTE_SET_I2C_ADR (obsolete)
     U8X8_MSG_BYTE_SET_DEVICE (obsolete)
+    U8X8_MSG_BYTE_SEND_PLAN (optional, see u8x8_plan.c)
 
   GPIO and Delay
     U8X8_MSG_GPIO_INIT
@@ -96,6 +97,10 @@
 /* Define this for an additional user pointer inside the u8x8 data struct */
 //#define U8X8_WITH_USER_PTR
 
+/* Define this for the transfer plans (u8x8_plan.c). The byte callback must */
+/* return 0 for messages it does not know, see U8X8_MSG_BYTE_SEND_PLAN */
+//#define U8X8_WITH_TRANSFER_PLAN
+
 
 /* Undefine this to remove u8x8_SetFlipMode function */
 /* 26 May 2016: Obsolete */
@@ -209,6 +214,7 @@ uint8_t u8x8_pgm_read_esp(const uint8_t * addr);   /* u8x8_8x8.c */
 
 
 typedef struct u8x8_struct u8x8_t;
+typedef struct u8x8_plan_struct u8x8_plan_t;
 typedef struct u8x8_display_info_struct u8x8_display_info_t;
 typedef struct u8x8_tile_struct u8x8_tile_t;
 
@@ -366,6 +372,9 @@ struct u8x8_struct
 #ifdef U8X8_WITH_USER_PTR
   void *user_ptr;
 #endif
+#ifdef U8X8_WITH_TRANSFER_PLAN
+  u8x8_plan_t *plan;		/* not NULL while a transfer plan is recorded */
+#endif
 #ifdef U8X8_USE_PINS 
   uint8_t pins[U8X8_PIN_CNT];	/* defines a pinlist: Mainly a list of pins for the Arduino Environment, use U8X8_PIN_xxx to access */
 #endif
@@ -683,6 +692,9 @@ uint8_t u8x8_cad_uc1638_i2c(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *ar
 #define U8X8_MSG_BYTE_START_TRANSFER U8X8_MSG_CAD_START_TRANSFER
 #define U8X8_MSG_BYTE_END_TRANSFER U8X8_MSG_CAD_END_TRANSFER
 
+/* arg_ptr: const u8x8_plan_t *, send the complete plan, return 0 if not supported */
+#define U8X8_MSG_BYTE_SEND_PLAN 33
+
 //#define U8X8_MSG_BYTE_SET_I2C_ADR U8X8_MSG_CAD_SET_I2C_ADR
 //#define U8X8_MSG_BYTE_SET_DEVICE U8X8_MSG_CAD_SET_DEVICE
 
@@ -706,6 +718,73 @@ uint8_t u8x8_byte_sw_i2c(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_p
 uint8_t u8x8_byte_sed1520(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
 
 
+/*==========================================*/
+/* Transfer Plan */
+
+/*
+  A transfer plan is a recorded cad sequence or display message: a flat list
+  of byte spans with their DC level, start/end transfer marks and gpio calls
+  (delays). Consecutive bytes with the same DC level are merged into one span.
+  u8x8_plan_Send() passes the plan with U8X8_MSG_BYTE_SEND_PLAN to the byte
+  layer, a byte layer which does not support this message gets the plan
+  replayed as normal byte messages.
+*/
+
+#ifdef U8X8_WITH_TRANSFER_PLAN
+
+/* size of the plans on the stack of u8x8_plan_SendSequence() and u8x8_plan_Call() */
+#ifndef U8X8_PLAN_SEG_CNT
+#define U8X8_PLAN_SEG_CNT 24
+#endif
+#ifndef U8X8_PLAN_BUF_SIZE
+#define U8X8_PLAN_BUF_SIZE 160
+#endif
+
+/* arg of a U8X8_MSG_BYTE_SEND segment if the cad layer did not set the DC line */
+#define U8X8_PLAN_DC_NONE 255
+
+typedef struct u8x8_plan_seg_struct u8x8_plan_seg_t;
+
+struct u8x8_plan_seg_struct
+{
+  const uint8_t *data;	/* U8X8_MSG_BYTE_SEND: bytes inside the buffer of the plan */
+  uint16_t len;		/* U8X8_MSG_BYTE_SEND: number of bytes */
+  uint8_t msg;		/* U8X8_MSG_BYTE_SEND, U8X8_MSG_BYTE_START_TRANSFER, U8X8_MSG_BYTE_END_TRANSFER or a gpio/delay msg */
+  uint8_t arg;		/* DC level for U8X8_MSG_BYTE_SEND, arg_int for gpio/delay msgs */
+};
+
+struct u8x8_plan_struct
+{
+  u8x8_plan_seg_t *seg;
+  uint8_t *buf;
+  uint16_t buf_len;
+  uint16_t buf_max;
+  uint8_t seg_cnt;
+  uint8_t seg_max;
+  uint8_t dc;			/* current DC level while recording */
+  uint8_t is_overflow;	/* seg or buf was too small */
+  u8x8_msg_cb byte_cb;	/* callbacks of the u8x8 object while recording */
+  u8x8_msg_cb gpio_and_delay_cb;
+};
+
+/* u8x8_plan.c */
+void u8x8_plan_Init(u8x8_plan_t *plan, u8x8_plan_seg_t *seg, uint8_t seg_max, uint8_t *buf, uint16_t buf_max);
+void u8x8_plan_Clear(u8x8_plan_t *plan);
+void u8x8_plan_Begin(u8x8_t *u8x8, u8x8_plan_t *plan);
+uint8_t u8x8_plan_End(u8x8_t *u8x8);
+uint8_t u8x8_plan_CompileSequence(u8x8_t *u8x8, u8x8_plan_t *plan, uint8_t const *data);
+void u8x8_plan_Send(u8x8_t *u8x8, const u8x8_plan_t *plan);
+void u8x8_plan_SendSequence(u8x8_t *u8x8, uint8_t const *data);
+uint8_t u8x8_plan_Call(u8x8_t *u8x8, u8x8_msg_cb cb, uint8_t msg, uint8_t arg_int, void *arg_ptr);
+#define u8x8_plan_IsActive(u8x8) ((u8x8)->plan != NULL)
+
+#else
+
+#define u8x8_plan_SendSequence(u8x8, data) u8x8_cad_SendSequence((u8x8), (data))
+
+#endif
+
+
 /*==========================================*/
 /* GPIO Interface */
 
@@ -310,23 +310,23 @@ uint8_t u8x8_d_st7567_jlx12864(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void
       break;
     case U8X8_MSG_DISPLAY_INIT:
       u8x8_d_helper_display_init(u8x8);
-      u8x8_cad_SendSequence(u8x8, u8x8_st7567_jlx12864_init_seq);
+      u8x8_plan_SendSequence(u8x8, u8x8_st7567_jlx12864_init_seq);
       break;
     case U8X8_MSG_DISPLAY_SET_POWER_SAVE:
       if ( arg_int == 0 )
-	u8x8_cad_SendSequence(u8x8, u8x8_d_st7567_132x64_powersave0_seq);
+	u8x8_plan_SendSequence(u8x8, u8x8_d_st7567_132x64_powersave0_seq);
       else
-	u8x8_cad_SendSequence(u8x8, u8x8_d_st7567_132x64_powersave1_seq);
+	u8x8_plan_SendSequence(u8x8, u8x8_d_st7567_132x64_powersave1_seq);
       break;
     case U8X8_MSG_DISPLAY_SET_FLIP_MODE:
       if ( arg_int == 0 )
       {
-	u8x8_cad_SendSequence(u8x8, u8x8_d_st7567_132x64_flip0_seq);
+	u8x8_plan_SendSequence(u8x8, u8x8_d_st7567_132x64_flip0_seq);
 	u8x8->x_offset = u8x8->display_info->default_x_offset;
       }
       else
       {
-	u8x8_cad_SendSequence(u8x8, u8x8_d_st7567_132x64_flip1_seq);
+	u8x8_plan_SendSequence(u8x8, u8x8_d_st7567_132x64_flip1_seq);
 	u8x8->x_offset = u8x8->display_info->flipmode_x_offset;
       }	
       break;
@@ -339,6 +339,11 @@ uint8_t u8x8_d_st7567_jlx12864(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void
       break;
 #endif
     case U8X8_MSG_DISPLAY_DRAW_TILE:
+#ifdef U8X8_WITH_TRANSFER_PLAN
+      /* address commands and page data as two transfers */
+      if ( u8x8_plan_IsActive(u8x8) == 0 )
+	return u8x8_plan_Call(u8x8, u8x8_d_st7567_jlx12864, msg, arg_int, arg_ptr);
+#endif
       u8x8_cad_StartTransfer(u8x8);
     
       x = ((u8x8_tile_t *)arg_ptr)->x_pos;
@@ -0,0 +1,283 @@
+/*
+
+  u8x8_plan.c
+
+  Transfer plans: precompiled cad sequences and display messages
+
+  Universal 8bit Graphics Library (https://github.com/olikraus/u8g2/)
+
+  Copyright (c) 2016, olikraus@gmail.com
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice, this list
+    of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+  A sequence or a display message is recorded by running it with the byte
+  and gpio callbacks of the u8x8 object replaced by the recorder below.
+  The cad callback is not replaced, so the DC levels in the plan are exactly
+  the levels the cad callback of the display would have set.
+
+    u8x8_plan_Init(&plan, seg, 16, buf, sizeof(buf));
+    u8x8_plan_CompileSequence(u8x8, &plan, u8x8_st7567_jlx12864_init_seq);
+    ...
+    u8x8_plan_Send(u8x8, &plan);	(as often as required)
+
+  Display drivers can record a message with u8x8_plan_Call():
+
+    case U8X8_MSG_DISPLAY_DRAW_TILE:
+      if ( u8x8_plan_IsActive(u8x8) == 0 )
+        return u8x8_plan_Call(u8x8, u8x8_d_xyz, msg, arg_int, arg_ptr);
+      ... send tile with u8x8_cad_xyz() as before ...
+
+  A byte layer which supports U8X8_MSG_BYTE_SEND_PLAN gets the complete plan
+  with one call: one transfer per byte span instead of one callback per
+  command byte.
+*/
+
+#include "u8x8.h"
+
+#ifdef U8X8_WITH_TRANSFER_PLAN
+
+static u8x8_plan_seg_t *u8x8_plan_add_seg(u8x8_plan_t *plan, uint8_t msg, uint8_t arg)
+{
+  u8x8_plan_seg_t *seg;
+  if ( plan->seg_cnt >= plan->seg_max )
+  {
+    plan->is_overflow = 1;
+    return NULL;
+  }
+  seg = plan->seg + plan->seg_cnt;
+  plan->seg_cnt++;
+  seg->data = NULL;
+  seg->len = 0;
+  seg->msg = msg;
+  seg->arg = arg;
+  return seg;
+}
+
+static void u8x8_plan_add_bytes(u8x8_plan_t *plan, uint8_t cnt, const uint8_t *data)
+{
+  u8x8_plan_seg_t *seg;
+
+  if ( plan->is_overflow != 0 )
+    return;
+  if ( (uint16_t)(plan->buf_max - plan->buf_len) < cnt )
+  {
+    plan->is_overflow = 1;
+    return;
+  }
+
+  /* bytes of the last span are at the end of the buffer, so a span with the same DC level can grow */
+  seg = NULL;
+  if ( plan->seg_cnt > 0 )
+  {
+    seg = plan->seg + plan->seg_cnt - 1;
+    if ( seg->msg != U8X8_MSG_BYTE_SEND || seg->arg != plan->dc )
+      seg = NULL;
+  }
+  if ( seg == NULL )
+  {
+    seg = u8x8_plan_add_seg(plan, U8X8_MSG_BYTE_SEND, plan->dc);
+    if ( seg == NULL )
+      return;
+    seg->data = plan->buf + plan->buf_len;
+  }
+
+  seg->len += cnt;
+  while( cnt > 0 )
+  {
+    plan->buf[plan->buf_len++] = *data++;
+    cnt--;
+  }
+}
+
+/* byte callback while recording */
+static uint8_t u8x8_byte_plan(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+  u8x8_plan_t *plan = u8x8->plan;
+  switch(msg)
+  {
+    case U8X8_MSG_BYTE_SET_DC:
+      plan->dc = arg_int;
+      break;
+    case U8X8_MSG_BYTE_SEND:
+      u8x8_plan_add_bytes(plan, arg_int, (const uint8_t *)arg_ptr);
+      break;
+    case U8X8_MSG_BYTE_START_TRANSFER:
+    case U8X8_MSG_BYTE_END_TRANSFER:
+      u8x8_plan_add_seg(plan, msg, 0);
+      break;
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+/* gpio and delay callback while recording: delays and direct gpio calls of the cad layer */
+static uint8_t u8x8_gpio_plan(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, U8X8_UNUSED void *arg_ptr)
+{
+  u8x8_plan_add_seg(u8x8->plan, msg, arg_int);
+  return 1;
+}
+
+void u8x8_plan_Init(u8x8_plan_t *plan, u8x8_plan_seg_t *seg, uint8_t seg_max, uint8_t *buf, uint16_t buf_max)
+{
+  plan->seg = seg;
+  plan->seg_max = seg_max;
+  plan->buf = buf;
+  plan->buf_max = buf_max;
+  plan->byte_cb = NULL;
+  plan->gpio_and_delay_cb = NULL;
+  u8x8_plan_Clear(plan);
+}
+
+void u8x8_plan_Clear(u8x8_plan_t *plan)
+{
+  plan->seg_cnt = 0;
+  plan->buf_len = 0;
+  plan->dc = U8X8_PLAN_DC_NONE;
+  plan->is_overflow = 0;
+}
+
+/* plans can not be nested, u8x8_plan_IsActive() must be false */
+void u8x8_plan_Begin(u8x8_t *u8x8, u8x8_plan_t *plan)
+{
+  plan->byte_cb = u8x8->byte_cb;
+  plan->gpio_and_delay_cb = u8x8->gpio_and_delay_cb;
+  u8x8->byte_cb = u8x8_byte_plan;
+  u8x8->gpio_and_delay_cb = u8x8_gpio_plan;
+  u8x8->plan = plan;
+}
+
+/* returns 0 if the plan did not fit into seg or buf */
+uint8_t u8x8_plan_End(u8x8_t *u8x8)
+{
+  u8x8_plan_t *plan = u8x8->plan;
+  u8x8->byte_cb = plan->byte_cb;
+  u8x8->gpio_and_delay_cb = plan->gpio_and_delay_cb;
+  u8x8->plan = NULL;
+  return plan->is_overflow == 0;
+}
+
+uint8_t u8x8_plan_CompileSequence(u8x8_t *u8x8, u8x8_plan_t *plan, uint8_t const *data)
+{
+  u8x8_plan_Clear(plan);
+  u8x8_plan_Begin(u8x8, plan);
+  u8x8_cad_SendSequence(u8x8, data);
+  return u8x8_plan_End(u8x8);
+}
+
+void u8x8_plan_Send(u8x8_t *u8x8, const u8x8_plan_t *plan)
+{
+  const u8x8_plan_seg_t *seg;
+  const uint8_t *data;
+  uint16_t len;
+  uint8_t cnt;
+  uint8_t i;
+
+  if ( u8x8->byte_cb(u8x8, U8X8_MSG_BYTE_SEND_PLAN, 0, (void *)plan) != 0 )
+    return;
+
+  /* byte layer without plan support: replay the plan, still one send per span */
+  for( i = 0; i < plan->seg_cnt; i++ )
+  {
+    seg = plan->seg + i;
+    switch(seg->msg)
+    {
+      case U8X8_MSG_BYTE_SEND:
+	if ( seg->arg != U8X8_PLAN_DC_NONE )
+	  u8x8_byte_SetDC(u8x8, seg->arg);
+	data = seg->data;
+	len = seg->len;
+	while( len > 0 )
+	{
+	  cnt = len > 255 ? 255 : len;
+	  u8x8_byte_SendBytes(u8x8, cnt, (uint8_t *)data);
+	  data += cnt;
+	  len -= cnt;
+	}
+	break;
+      case U8X8_MSG_BYTE_START_TRANSFER:
+      case U8X8_MSG_BYTE_END_TRANSFER:
+	u8x8->byte_cb(u8x8, seg->msg, 0, NULL);
+	break;
+      default:
+	u8x8_gpio_call(u8x8, seg->msg, seg->arg);
+	break;
+    }
+  }
+}
+
+/* replacement for u8x8_cad_SendSequence() */
+void u8x8_plan_SendSequence(u8x8_t *u8x8, uint8_t const *data)
+{
+  u8x8_plan_seg_t seg[U8X8_PLAN_SEG_CNT];
+  uint8_t buf[U8X8_PLAN_BUF_SIZE];
+  u8x8_plan_t plan;
+
+  /* inside u8x8_plan_Call(): becomes part of the outer plan */
+  if ( u8x8_plan_IsActive(u8x8) )
+  {
+    u8x8_cad_SendSequence(u8x8, data);
+    return;
+  }
+
+  u8x8_plan_Init(&plan, seg, U8X8_PLAN_SEG_CNT, buf, U8X8_PLAN_BUF_SIZE);
+  if ( u8x8_plan_CompileSequence(u8x8, &plan, data) )
+    u8x8_plan_Send(u8x8, &plan);
+  else
+    u8x8_cad_SendSequence(u8x8, data);	/* nothing has been sent so far */
+}
+
+/*
+  Record and send the display message "msg" of the display callback "cb".
+  If the message does not fit into the plan, cb is called again with the real
+  byte layer. u8x8->plan is also set for this call, so that cb does not call
+  u8x8_plan_Call() again. cb must not change the u8x8 object for "msg",
+  DRAW_TILE is fine, SET_FLIP_MODE (x_offset) is not.
+*/
+uint8_t u8x8_plan_Call(u8x8_t *u8x8, u8x8_msg_cb cb, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+  u8x8_plan_seg_t seg[U8X8_PLAN_SEG_CNT];
+  uint8_t buf[U8X8_PLAN_BUF_SIZE];
+  u8x8_plan_t plan;
+  uint8_t r;
+
+  u8x8_plan_Init(&plan, seg, U8X8_PLAN_SEG_CNT, buf, U8X8_PLAN_BUF_SIZE);
+  u8x8_plan_Begin(u8x8, &plan);
+  r = cb(u8x8, msg, arg_int, arg_ptr);
+  if ( u8x8_plan_End(u8x8) )
+  {
+    u8x8_plan_Send(u8x8, &plan);
+    return r;
+  }
+
+  u8x8->plan = &plan;
+  r = cb(u8x8, msg, arg_int, arg_ptr);
+  u8x8->plan = NULL;
+  return r;
+}
+
+#endif /* U8X8_WITH_TRANSFER_PLAN */
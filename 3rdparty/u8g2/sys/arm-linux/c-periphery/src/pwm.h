@@ -51,6 +51,7 @@ int pwm_get_polarity(pwm_t *pwm, pwm_polarity_t *polarity);
 int pwm_set_enabled(pwm_t *pwm, bool enabled);
 int pwm_set_period_ns(pwm_t *pwm, uint64_t period_ns);
 int pwm_set_duty_cycle_ns(pwm_t *pwm, uint64_t duty_cycle_ns);
+int pwm_set_period_duty_cycle_ns(pwm_t *pwm, uint64_t period_ns, uint64_t duty_cycle_ns);
 int pwm_set_period(pwm_t *pwm, double period);
 int pwm_set_duty_cycle(pwm_t *pwm, double duty_cycle);
 int pwm_set_frequency(pwm_t *pwm, double frequency);
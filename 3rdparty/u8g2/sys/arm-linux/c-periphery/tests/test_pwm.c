@@ -150,6 +150,23 @@ void test_open_config_close(void) {
     passert(pwm_get_duty_cycle(pwm, &duty_cycle) == 0);
     passert(fabs(duty_cycle - 0.75) < 1e-3);
 
+    /* Set period and duty_cycle_ns together, shrinking below the current duty cycle */
+    passert(pwm_set_period_duty_cycle_ns(pwm, 500000, 125000) == 0);
+    passert(pwm_get_period_ns(pwm, &period_ns) == 0);
+    passert(fabs(period_ns - 500000) < 1e4);
+    passert(pwm_get_duty_cycle_ns(pwm, &duty_cycle_ns) == 0);
+    passert(fabs(duty_cycle_ns - 125000) < 1e4);
+
+    /* Set period and duty_cycle_ns together, growing past the current period */
+    passert(pwm_set_period_duty_cycle_ns(pwm, 1000000, 750000) == 0);
+    passert(pwm_get_period_ns(pwm, &period_ns) == 0);
+    passert(fabs(period_ns - 1000000) < 1e5);
+    passert(pwm_get_duty_cycle_ns(pwm, &duty_cycle_ns) == 0);
+    passert(fabs(duty_cycle_ns - 750000) < 1e4);
+
+    /* Set duty_cycle_ns larger than period */
+    passert(pwm_set_period_duty_cycle_ns(pwm, 500000, 750000) == PWM_ERROR_ARG);
+
     /* Set polarity, check polarity */
     passert(pwm_set_polarity(pwm, PWM_POLARITY_NORMAL) == 0);
     passert(pwm_get_polarity(pwm, &polarity) == 0);
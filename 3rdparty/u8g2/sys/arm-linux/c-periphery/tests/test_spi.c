@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "../src/spi.h"
 
@@ -15,6 +16,7 @@ const char *device;
 
 void test_arguments(void) {
     spi_t *spi;
+    spi_batch_t *batch;
 
     ptest();
 
@@ -29,6 +31,21 @@ void test_arguments(void) {
 
     /* Free SPI */
     spi_free(spi);
+
+    /* Invalid batch capacity */
+    passert(spi_batch_new(0) == NULL);
+    passert(spi_batch_new(100000) == NULL);
+
+    /* Full batch */
+    batch = spi_batch_new(2);
+    passert(batch != NULL);
+    passert(spi_batch_add(batch, NULL, NULL, 0, 0, 0, false) == 0);
+    passert(spi_batch_add(batch, NULL, NULL, 0, 0, 0, false) == 0);
+    passert(spi_batch_add(batch, NULL, NULL, 0, 0, 0, false) == SPI_ERROR_ARG);
+    passert(spi_batch_count(batch) == 2);
+    spi_batch_clear(batch);
+    passert(spi_batch_count(batch) == 0);
+    spi_batch_free(batch);
 }
 
 void test_open_config_close(void) {
@@ -107,6 +124,41 @@ void test_loopback(void) {
     for (i = 0; i < sizeof(buf); i++)
         passert(buf[i] == i);
 
+    /* Batch: loopback segment at a lower speed, tx only segment, loopback
+     * segment at the device speed */
+    {
+        uint8_t tx[8], rx1[8], rx2[8];
+        spi_batch_t *batch;
+
+        for (i = 0; i < sizeof(tx); i++)
+            tx[i] = 0xa0 + i;
+        memset(rx1, 0, sizeof(rx1));
+        memset(rx2, 0, sizeof(rx2));
+
+        batch = spi_batch_new(4);
+        passert(batch != NULL);
+
+        /* Empty batch is a no-op */
+        passert(spi_transfer_batch(spi, batch) == 0);
+
+        passert(spi_batch_add(batch, tx, rx1, sizeof(tx), 50000, 0, false) == 0);
+        passert(spi_batch_add(batch, tx, NULL, sizeof(tx), 0, 10, false) == 0);
+        passert(spi_batch_add(batch, tx, rx2, sizeof(tx), 0, 0, false) == 0);
+        passert(spi_transfer_batch(spi, batch) == 0);
+
+        passert(memcmp(rx1, tx, sizeof(tx)) == 0);
+        passert(memcmp(rx2, tx, sizeof(tx)) == 0);
+
+        /* Reuse after clear */
+        memset(rx1, 0, sizeof(rx1));
+        spi_batch_clear(batch);
+        passert(spi_batch_add(batch, tx, rx1, sizeof(tx), 0, 0, false) == 0);
+        passert(spi_transfer_batch(spi, batch) == 0);
+        passert(memcmp(rx1, tx, sizeof(tx)) == 0);
+
+        spi_batch_free(batch);
+    }
+
     passert(spi_close(spi) == 0);
 
     /* Free SPI */
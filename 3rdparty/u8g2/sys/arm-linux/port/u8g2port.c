@@ -2,18 +2,131 @@
  * This code supports multiple displays since GPIO pin handles have been
  * moved into user_data_struct. I2C and SPI handles are global since they can be
  * shared by multiple devices (think I2C with different address sharing bus).
+ * Transfers of displays sharing a bus are serialized, see "Bus manager".
  *
  * So far I have tested this with 3 software I2C displays. See examples.
  */
 
 #include "u8g2port.h"
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
 // c-periphery I2C handles
 static i2c_t *i2c_handles[MAX_I2C_HANDLES] = { NULL };
 
 // c-periphery SPI handles
 static spi_t *spi_handles[MAX_SPI_HANDLES] = { NULL };
 
+/*
+ * Bus manager.
+ *
+ * Displays on the same hardware bus share one bus_struct: all displays on
+ * /dev/i2c-N, and all displays on the chip selects of one SPI controller
+ * (spidev0.0 and spidev0.1 share MOSI and SCK, spidev1.x is a different
+ * bus). The hardware byte callbacks hold the transaction lock of the bus from
+ * START_TRANSFER to END_TRANSFER, so a command/data sequence of one display
+ * is never interleaved with a sequence of another display, even if they are
+ * driven from different threads. Displays on different buses do not share
+ * a lock and transmit in parallel. Software I2C/SPI displays have their own
+ * pins and are not locked.
+ *
+ * With init_async_flush() the bus also gets one flush worker, see
+ * "Asynchronous flush".
+ */
+struct bus_struct {
+	// Held for one transaction or one flush pass, recursive
+	pthread_mutex_t xfer;
+	// Protects the display list and the frame queues
+	pthread_mutex_t lock;
+	// Signals a new frame or stop to the worker
+	pthread_cond_t work;
+	pthread_t thread;
+	bool running;
+	bool stop;
+	// Bus of a software interface, freed with its display
+	bool is_private;
+	// Displays with a flush worker on this bus
+	struct async_flush_struct *displays;
+};
+
+static struct bus_struct *i2c_buses[MAX_I2C_HANDLES] = { NULL };
+static struct bus_struct *spi_buses[MAX_SPI_BUSES] = { NULL };
+
+// Protects the handle and bus tables and starting/stopping workers
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct bus_struct* new_bus(bool is_private) {
+	struct bus_struct *bus = (struct bus_struct*) calloc(1, sizeof(*bus));
+	pthread_mutexattr_t attr;
+
+	if (bus == NULL) {
+		fprintf(stderr, "new_bus(): out of memory\n");
+		return NULL;
+	}
+	// The flush worker holds it for a pass, the byte callbacks lock again
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&bus->xfer, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&bus->lock, NULL);
+	pthread_cond_init(&bus->work, NULL);
+	bus->is_private = is_private;
+	return bus;
+}
+
+static void free_bus(struct bus_struct *bus) {
+	pthread_cond_destroy(&bus->work);
+	pthread_mutex_destroy(&bus->lock);
+	pthread_mutex_destroy(&bus->xfer);
+	free(bus);
+}
+
+/*
+ * Attach the display to the bus in this table slot, the bus is created by
+ * the first display. Must be called with table_lock held.
+ */
+static struct bus_struct* attach_bus(u8x8_t *u8x8, struct bus_struct **slot) {
+	user_data_t *user_data = u8x8_GetUserPtr(u8x8);
+
+	if (*slot == NULL) {
+		*slot = new_bus(false);
+	}
+	user_data->bus_ctx = *slot;
+	return *slot;
+}
+
+/*
+ * Free buses without displays, the handles are closed.
+ */
+static void free_buses(struct bus_struct **buses, int cnt) {
+	for (int i = 0; i < cnt; ++i) {
+		if (buses[i] != NULL && buses[i]->displays == NULL
+				&& !buses[i]->running) {
+			free_bus(buses[i]);
+			buses[i] = NULL;
+		}
+	}
+}
+
+/*
+ * Begin and end a transaction on the bus of this display.
+ */
+static void bus_lock(u8x8_t *u8x8) {
+	user_data_t *user_data = u8x8_GetUserPtr(u8x8);
+	if (user_data->bus_ctx != NULL) {
+		pthread_mutex_lock(&user_data->bus_ctx->xfer);
+	}
+}
+
+static void bus_unlock(u8x8_t *u8x8) {
+	user_data_t *user_data = u8x8_GetUserPtr(u8x8);
+	if (user_data->bus_ctx != NULL) {
+		pthread_mutex_unlock(&user_data->bus_ctx->xfer);
+	}
+}
+
 /*
  * Sleep milliseconds.
  */
@@ -57,6 +170,8 @@ user_data_t* init_user_data(u8g2_t *u8g2) {
 	for (int i = 0; i < U8X8_PIN_CNT; ++i) {
 		user_data->pins[i] = NULL;
 	}
+	user_data->bus_ctx = NULL;
+	user_data->async = NULL;
 	u8g2_SetUserPtr(u8g2, user_data);
 	return user_data;
 }
@@ -99,12 +214,14 @@ void init_spi_hw_advanced(u8g2_t *u8g2, uint8_t gpio_chip, uint8_t bus,
 }
 
 /*
- * Allocate user_data_struct for hardware SPI.
+ * Allocate user_data_struct for hardware SPI, clocked at the rated SPI clock
+ * of the display controller (500 kHz if the driver does not give one).
  */
 void init_spi_hw(u8g2_t *u8g2, uint8_t gpio_chip, uint8_t bus, uint8_t dc,
 		uint8_t res, uint8_t cs) {
-	init_spi_hw_advanced(u8g2, gpio_chip, bus, dc, res, cs,
-			u8g2_GetU8x8(u8g2)->display_info->spi_mode, 500000);
+	const u8x8_display_info_t *info = u8g2_GetU8x8(u8g2)->display_info;
+	init_spi_hw_advanced(u8g2, gpio_chip, bus, dc, res, cs, info->spi_mode,
+			info->sck_clock_hz != 0 ? info->sck_clock_hz : 500000);
 }
 
 /*
@@ -122,12 +239,16 @@ void init_spi_sw(u8g2_t *u8g2, uint8_t gpio_chip, uint8_t dc, uint8_t res,
 	user_data->delay = delay;
 }
 
+static void stop_async_flush(u8g2_t *u8g2, bool flush);
+
 /*
  * Close GPIO pins and free user_data_struct.
  */
 void done_user_data(u8g2_t *u8g2) {
 	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
 	if (user_data != NULL) {
+		// Stop the flush worker, frames not sent yet are dropped
+		stop_async_flush(u8g2, false);
 		// Close all GPIO pins
 		for (int i = 0; i < U8X8_PIN_CNT; ++i) {
 			if (user_data->pins[i] != NULL) {
@@ -193,6 +314,8 @@ void write_pin(u8x8_t *u8x8, uint8_t pin, uint8_t value) {
 void init_i2c(u8x8_t *u8x8) {
 	char filename[11];
 	user_data_t *user_data = u8x8_GetUserPtr(u8x8);
+	pthread_mutex_lock(&table_lock);
+	attach_bus(u8x8, &i2c_buses[user_data->bus]);
 	// Only open bus once
 	if (i2c_handles[user_data->bus] == NULL) {
 		snprintf(filename, sizeof(filename), "/dev/i2c-%d", user_data->bus);
@@ -205,12 +328,14 @@ void init_i2c(u8x8_t *u8x8) {
 			i2c_handles[user_data->bus] = NULL;
 		}
 	}
+	pthread_mutex_unlock(&table_lock);
 }
 
 /*
  * Close and free all i2c_t.
  */
 void done_i2c() {
+	pthread_mutex_lock(&table_lock);
 	for (int i = 0; i < MAX_I2C_HANDLES; ++i) {
 		if (i2c_handles[i] != NULL) {
 			i2c_close(i2c_handles[i]);
@@ -218,6 +343,8 @@ void done_i2c() {
 			i2c_handles[i] = NULL;
 		}
 	}
+	free_buses(i2c_buses, MAX_I2C_HANDLES);
+	pthread_mutex_unlock(&table_lock);
 }
 
 /*
@@ -226,6 +353,9 @@ void done_i2c() {
 void init_spi(u8x8_t *u8x8) {
 	char filename[15];
 	user_data_t *user_data = u8x8_GetUserPtr(u8x8);
+	pthread_mutex_lock(&table_lock);
+	// Chip selects of one controller share the bus
+	attach_bus(u8x8, &spi_buses[user_data->bus >> 4]);
 	// Only open bus once
 	if (spi_handles[user_data->bus] == NULL) {
 		// user_data->bus should be in the format 0x12 for /dev/spidev1.2
@@ -246,12 +376,157 @@ void init_spi(u8x8_t *u8x8) {
 			spi_handles[user_data->bus] = NULL;
 		}
 	}
+	pthread_mutex_unlock(&table_lock);
+}
+
+/*
+ * Change the clock of the SPI bus of this display, the bus must be open.
+ * Returns 0 on success and -1 on error.
+ */
+int set_spi_hw_speed(u8g2_t *u8g2, uint32_t speed) {
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	spi_t *spi = spi_handles[user_data->bus];
+
+	if (spi == NULL) {
+		fprintf(stderr, "set_spi_hw_speed(): SPI bus not open\n");
+		return -1;
+	}
+	bus_lock(u8g2_GetU8x8(u8g2));
+	if (spi_set_max_speed(spi, speed) < 0) {
+		bus_unlock(u8g2_GetU8x8(u8g2));
+		fprintf(stderr, "spi_set_max_speed(): %s\n", spi_errmsg(spi));
+		return -1;
+	}
+	bus_unlock(u8g2_GetU8x8(u8g2));
+	user_data->max_speed = speed;
+	u8g2_GetU8x8(u8g2)->bus_clock = speed;
+	return 0;
+}
+
+/*
+ * DC level the cad layer of the display uses for pixel data.
+ */
+static uint8_t data_dc_level(u8x8_t *u8x8) {
+#ifdef U8X8_WITH_TRANSFER_PLAN
+	u8x8_plan_seg_t seg[4];
+	uint8_t buf[4];
+	u8x8_plan_t plan;
+	uint8_t b = 0;
+
+	u8x8_plan_Init(&plan, seg, 4, buf, sizeof(buf));
+	u8x8_plan_Begin(u8x8, &plan);
+	u8x8_cad_SendData(u8x8, 1, &b);
+	u8x8_plan_End(u8x8);
+	for (uint8_t i = 0; i < plan.seg_cnt; ++i) {
+		if (seg[i].msg == U8X8_MSG_BYTE_SEND && seg[i].arg != U8X8_PLAN_DC_NONE) {
+			return seg[i].arg;
+		}
+	}
+#else
+	(void) u8x8;
+#endif
+	return 1;
+}
+
+/*
+ * Send SPI_PROBE_ROUNDS pseudo random blocks at this speed and compare them
+ * with what comes back on MISO.
+ */
+static int spi_probe(spi_t *spi, uint32_t speed, int rounds) {
+	uint8_t tx[SPI_PROBE_LEN];
+	uint8_t rx[SPI_PROBE_LEN];
+	uint32_t x = speed | 1;
+
+	if (spi_set_max_speed(spi, speed) < 0) {
+		return 0;
+	}
+	for (int round = 0; round < rounds; ++round) {
+		// xorshift32, every block differs, first block starts with edge cases
+		for (size_t i = 0; i < SPI_PROBE_LEN; ++i) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			tx[i] = (uint8_t) x;
+		}
+		if (round == 0) {
+			memcpy(tx, "\x00\xff\x55\xaa\x00\xff\x01\x80", 8);
+		}
+		if (spi_transfer(spi, tx, rx, SPI_PROBE_LEN) < 0
+				|| memcmp(tx, rx, SPI_PROBE_LEN) != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Find the highest SPI clock up to max_speed at which the bus transfers data
+ * without errors. The display is write-only in 4-wire SPI mode, so MOSI has
+ * to be looped back to MISO for the calibration. Starts at the rated clock
+ * of the display (halving it until a probe passes), then goes up in steps of
+ * 25 %; the result is confirmed with four times the probes, one step lower if
+ * that fails. The probe bytes are sent as pixel data, redraw the display
+ * afterwards, and calibrate before init_async_flush(). The bus keeps the
+ * found clock, which is also stored in user_data->max_speed and
+ * u8x8->bus_clock.
+ * Returns the clock in Hz or 0 if no clock passed (no loopback), in which case
+ * the previous clock is kept.
+ */
+uint32_t calibrate_spi_hw(u8g2_t *u8g2, uint32_t max_speed) {
+	u8x8_t *u8x8 = u8g2_GetU8x8(u8g2);
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	spi_t *spi = spi_handles[user_data->bus];
+	uint32_t speed = u8x8->display_info->sck_clock_hz;
+	uint32_t prev, next;
+
+	if (spi == NULL) {
+		fprintf(stderr, "calibrate_spi_hw(): SPI bus not open\n");
+		return 0;
+	}
+	if (speed == 0 || speed > max_speed) {
+		speed = max_speed;
+	}
+	// Other displays on the bus must not see the probes
+	bus_lock(u8x8);
+	u8x8_gpio_SetDC(u8x8, data_dc_level(u8x8));
+
+	while (speed >= SPI_CALIBRATE_MIN_SPEED
+			&& !spi_probe(spi, speed, SPI_PROBE_ROUNDS)) {
+		speed /= 2;
+	}
+	if (speed < SPI_CALIBRATE_MIN_SPEED) {
+		fprintf(stderr, "calibrate_spi_hw(): no clock passed, MOSI not looped back to MISO?\n");
+		set_spi_hw_speed(u8g2, user_data->max_speed);
+		bus_unlock(u8x8);
+		return 0;
+	}
+
+	prev = speed;
+	while (speed < max_speed) {
+		next = speed + speed / 4;
+		if (next > max_speed) {
+			next = max_speed;
+		}
+		if (!spi_probe(spi, next, SPI_PROBE_ROUNDS)) {
+			break;
+		}
+		prev = speed;
+		speed = next;
+	}
+	if (!spi_probe(spi, speed, 4 * SPI_PROBE_ROUNDS)) {
+		speed = prev;
+	}
+
+	set_spi_hw_speed(u8g2, speed);
+	bus_unlock(u8x8);
+	return speed;
 }
 
 /*
  * Close and free all spi_t.
  */
 void done_spi() {
+	pthread_mutex_lock(&table_lock);
 	for (int i = 0; i < MAX_SPI_HANDLES; ++i) {
 		if (spi_handles[i] != NULL) {
 			spi_close(spi_handles[i]);
@@ -259,6 +534,8 @@ void done_spi() {
 			spi_handles[i] = NULL;
 		}
 	}
+	free_buses(spi_buses, MAX_SPI_BUSES);
+	pthread_mutex_unlock(&table_lock);
 }
 
 /**
@@ -427,6 +704,7 @@ uint8_t u8x8_byte_arm_linux_hw_i2c(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 		break;
 
 	case U8X8_MSG_BYTE_START_TRANSFER:
+		bus_lock(u8x8);
 		user_data = u8x8_GetUserPtr(u8x8);
 		user_data->index = 0;
 		break;
@@ -438,6 +716,7 @@ uint8_t u8x8_byte_arm_linux_hw_i2c(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 		msgs[0].len = user_data->index;
 		msgs[0].buf = user_data->buffer;
 		i2c_transfer(i2c_handles[user_data->bus], msgs, 1);
+		bus_unlock(u8x8);
 		break;
 
 	default:
@@ -453,6 +732,10 @@ uint8_t u8x8_byte_arm_linux_hw_spi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 		void *arg_ptr) {
 	user_data_t *user_data;
 	uint8_t *data;
+#ifdef U8X8_WITH_TRANSFER_PLAN
+	const u8x8_plan_t *plan;
+	const u8x8_plan_seg_t *seg;
+#endif
 
 	switch (msg) {
 	case U8X8_MSG_BYTE_SEND:
@@ -476,10 +759,41 @@ uint8_t u8x8_byte_arm_linux_hw_spi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 		u8x8_gpio_SetDC(u8x8, arg_int);
 		break;
 
+#ifdef U8X8_WITH_TRANSFER_PLAN
+	case U8X8_MSG_BYTE_SEND_PLAN:
+		// One transmit-only transfer per byte span, straight from the plan
+		// buffer. CS is handled by spidev, start/end marks only lock the bus.
+		user_data = u8x8_GetUserPtr(u8x8);
+		plan = (const u8x8_plan_t*) arg_ptr;
+		for (seg = plan->seg; seg < plan->seg + plan->seg_cnt; ++seg) {
+			switch (seg->msg) {
+			case U8X8_MSG_BYTE_SEND:
+				if (seg->arg != U8X8_PLAN_DC_NONE) {
+					u8x8_gpio_SetDC(u8x8, seg->arg);
+				}
+				spi_transfer(spi_handles[user_data->bus], seg->data, NULL,
+						seg->len);
+				break;
+			case U8X8_MSG_BYTE_START_TRANSFER:
+				bus_lock(u8x8);
+				break;
+			case U8X8_MSG_BYTE_END_TRANSFER:
+				bus_unlock(u8x8);
+				break;
+			default:
+				u8x8_gpio_call(u8x8, seg->msg, seg->arg);
+				break;
+			}
+		}
+		break;
+#endif
+
 	case U8X8_MSG_BYTE_START_TRANSFER:
+		bus_lock(u8x8);
 		break;
 
 	case U8X8_MSG_BYTE_END_TRANSFER:
+		bus_unlock(u8x8);
 		break;
 
 	default:
@@ -487,3 +801,311 @@ uint8_t u8x8_byte_arm_linux_hw_spi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 	}
 	return 1;
 }
+
+/*
+ * Asynchronous flush.
+ *
+ * u8g2_SendBufferAsync() copies the frame into the pending buffer and returns
+ * at once, the flush worker of the bus sends it while the caller draws the
+ * next frame. The frame is copied instead of swapping buffers, so the u8g2
+ * buffer keeps its content as after u8g2_SendBuffer(); copying 1 KB takes
+ * well below a microsecond, the SPI transfer takes milliseconds. If a new
+ * frame arrives before the worker picked up the pending one, the pending
+ * frame is overwritten (dropped).
+ *
+ * There is one worker per bus, not per display. Each pass it takes the
+ * pending frames of all displays on the bus and sends them back to back
+ * while holding the bus, so the updates of several panels are coalesced
+ * into one pass instead of competing for the bus frame by frame. Workers
+ * of different buses (spidev0.x and spidev1.x, or I2C and SPI) run in
+ * parallel.
+ *
+ * While a frame is on the way the worker owns the u8x8 part of the u8g2
+ * object: call u8g2_WaitFlush() before u8g2_SetPowerSave(),
+ * u8g2_SetContrast() etc. and call done_async_flush() before done_spi().
+ */
+struct async_flush_struct {
+	u8g2_t *u8g2;
+	struct bus_struct *bus;
+	// Next display on the bus, next display in the current pass
+	struct async_flush_struct *next;
+	struct async_flush_struct *next_in_pass;
+	// Signals a frame on the display to u8g2_WaitFlush()
+	pthread_cond_t flushed;
+	// Latest complete frame and the frame on the bus
+	uint8_t *pending;
+	uint8_t *sending;
+	size_t size;
+	// Fence of the last queued, last picked up and last sent frame
+	uint32_t queued;
+	uint32_t taken;
+	uint32_t done;
+	unsigned long dropped;
+	// sending is part of the current pass
+	bool in_pass;
+};
+
+/*
+ * Send a complete frame, same as u8g2_SendBuffer() with a full buffer.
+ */
+static void send_frame(u8g2_t *u8g2, uint8_t *frame) {
+	u8x8_t *u8x8 = u8g2_GetU8x8(u8g2);
+	uint8_t w = u8x8->display_info->tile_width;
+
+	for (uint8_t row = 0; row < u8g2->tile_buf_height; ++row) {
+		u8x8_DrawTile(u8x8, 0, row, w, frame + (size_t) row * w * 8);
+	}
+	u8x8_RefreshDisplay(u8x8);
+}
+
+static void* bus_flush_worker(void *arg) {
+	struct bus_struct *bus = (struct bus_struct*) arg;
+	struct async_flush_struct *async;
+	struct async_flush_struct *pass;
+	uint8_t *frame;
+
+	pthread_mutex_lock(&bus->lock);
+	for (;;) {
+		// Take the pending frame of every display, the callers can queue
+		// the next ones meanwhile
+		pass = NULL;
+		for (async = bus->displays; async != NULL; async = async->next) {
+			if (async->queued != async->taken) {
+				frame = async->pending;
+				async->pending = async->sending;
+				async->sending = frame;
+				async->taken = async->queued;
+				async->in_pass = true;
+				async->next_in_pass = pass;
+				pass = async;
+			}
+		}
+		if (pass == NULL) {
+			if (bus->stop) {
+				break;
+			}
+			pthread_cond_wait(&bus->work, &bus->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&bus->lock);
+
+		// Displays in the pass are not removed before in_pass is cleared
+		pthread_mutex_lock(&bus->xfer);
+		for (async = pass; async != NULL; async = async->next_in_pass) {
+			send_frame(async->u8g2, async->sending);
+		}
+		pthread_mutex_unlock(&bus->xfer);
+
+		pthread_mutex_lock(&bus->lock);
+		for (async = pass; async != NULL; async = async->next_in_pass) {
+			async->done = async->taken;
+			async->in_pass = false;
+			pthread_cond_broadcast(&async->flushed);
+		}
+	}
+	pthread_mutex_unlock(&bus->lock);
+	return NULL;
+}
+
+static void free_async_flush(struct async_flush_struct *async) {
+	pthread_cond_destroy(&async->flushed);
+	free(async->pending);
+	free(async->sending);
+	free(async);
+}
+
+/*
+ * Add a display set up with a full buffer (_f) to the flush worker of its
+ * bus, the worker is started with the first display.
+ * Returns 0 on success and -1 on error.
+ */
+int init_async_flush(u8g2_t *u8g2) {
+	u8x8_t *u8x8 = u8g2_GetU8x8(u8g2);
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	struct async_flush_struct *async;
+	struct bus_struct *bus;
+	int error;
+
+	if (user_data == NULL || user_data->async != NULL) {
+		fprintf(stderr, "init_async_flush(): no user data or already started\n");
+		return -1;
+	}
+	if (u8g2->tile_buf_height < u8x8->display_info->tile_height) {
+		fprintf(stderr, "init_async_flush(): needs a full frame buffer\n");
+		return -1;
+	}
+	async = (struct async_flush_struct*) calloc(1, sizeof(*async));
+	if (async == NULL) {
+		fprintf(stderr, "init_async_flush(): out of memory\n");
+		return -1;
+	}
+	async->u8g2 = u8g2;
+	async->size = u8g2_GetBufferSize(u8g2);
+	async->pending = (uint8_t*) malloc(async->size);
+	async->sending = (uint8_t*) malloc(async->size);
+	pthread_cond_init(&async->flushed, NULL);
+	if (async->pending == NULL || async->sending == NULL) {
+		fprintf(stderr, "init_async_flush(): out of memory\n");
+		free_async_flush(async);
+		return -1;
+	}
+
+	pthread_mutex_lock(&table_lock);
+	// Hardware displays got their bus in init_i2c()/init_spi() (display
+	// initialized before), software displays get a worker of their own
+	bus = user_data->bus_ctx;
+	if (bus == NULL) {
+		if (u8x8->byte_cb == u8x8_byte_arm_linux_hw_i2c) {
+			bus = attach_bus(u8x8, &i2c_buses[user_data->bus]);
+		} else if (u8x8->byte_cb == u8x8_byte_arm_linux_hw_spi) {
+			bus = attach_bus(u8x8, &spi_buses[user_data->bus >> 4]);
+		} else {
+			bus = new_bus(true);
+		}
+	}
+	if (bus == NULL) {
+		pthread_mutex_unlock(&table_lock);
+		free_async_flush(async);
+		return -1;
+	}
+	if (!bus->running) {
+		error = pthread_create(&bus->thread, NULL, bus_flush_worker, bus);
+		if (error != 0) {
+			fprintf(stderr, "pthread_create(): %s\n", strerror(error));
+			if (bus->is_private) {
+				free_bus(bus);
+			}
+			pthread_mutex_unlock(&table_lock);
+			free_async_flush(async);
+			return -1;
+		}
+		bus->running = true;
+	}
+	async->bus = bus;
+	pthread_mutex_lock(&bus->lock);
+	async->next = bus->displays;
+	bus->displays = async;
+	user_data->async = async;
+	pthread_mutex_unlock(&bus->lock);
+	pthread_mutex_unlock(&table_lock);
+	return 0;
+}
+
+/*
+ * Queue the current frame and return its fence for u8g2_WaitFlush(). Without
+ * a worker the frame is sent synchronously.
+ */
+uint32_t u8g2_SendBufferAsync(u8g2_t *u8g2) {
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	struct async_flush_struct *async = user_data->async;
+	uint32_t fence;
+
+	if (async == NULL) {
+		u8g2_SendBuffer(u8g2);
+		return 0;
+	}
+	pthread_mutex_lock(&async->bus->lock);
+	if (async->queued != async->taken) {
+		async->dropped++;
+	}
+	memcpy(async->pending, u8g2_GetBufferPtr(u8g2), async->size);
+	fence = ++async->queued;
+	pthread_cond_signal(&async->bus->work);
+	pthread_mutex_unlock(&async->bus->lock);
+	return fence;
+}
+
+/*
+ * Wait until the frame with this fence or a later frame is on the display.
+ * A dropped frame counts as flushed as soon as a newer frame is.
+ */
+void u8g2_WaitFlush(u8g2_t *u8g2, uint32_t fence) {
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	struct async_flush_struct *async = user_data->async;
+
+	if (async == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&async->bus->lock);
+	while ((int32_t) (async->done - fence) < 0) {
+		pthread_cond_wait(&async->flushed, &async->bus->lock);
+	}
+	pthread_mutex_unlock(&async->bus->lock);
+}
+
+/*
+ * Number of frames overwritten before the worker could send them.
+ */
+unsigned long get_async_flush_dropped(u8g2_t *u8g2) {
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	struct async_flush_struct *async = user_data->async;
+	unsigned long dropped = 0;
+
+	if (async != NULL) {
+		pthread_mutex_lock(&async->bus->lock);
+		dropped = async->dropped;
+		pthread_mutex_unlock(&async->bus->lock);
+	}
+	return dropped;
+}
+
+/*
+ * Remove the display from the worker of its bus, after its last frame was
+ * sent (flush) or dropped. The worker stops with the last display.
+ */
+static void stop_async_flush(u8g2_t *u8g2, bool flush) {
+	user_data_t *user_data = u8g2_GetUserPtr(u8g2);
+	struct async_flush_struct *async = user_data->async;
+	struct async_flush_struct **link;
+	struct bus_struct *bus;
+	bool last;
+
+	if (async == NULL) {
+		return;
+	}
+	bus = async->bus;
+	pthread_mutex_lock(&table_lock);
+	pthread_mutex_lock(&bus->lock);
+	if (flush) {
+		while (async->done != async->queued) {
+			pthread_cond_wait(&async->flushed, &bus->lock);
+		}
+	} else {
+		// Drop the pending frame, wait for the frame on the bus
+		async->taken = async->queued;
+		while (async->in_pass) {
+			pthread_cond_wait(&async->flushed, &bus->lock);
+		}
+		// Nothing is sent any more, release all waiters
+		async->done = async->queued;
+		pthread_cond_broadcast(&async->flushed);
+	}
+	for (link = &bus->displays; *link != async; link = &(*link)->next)
+		;
+	*link = async->next;
+	user_data->async = NULL;
+	last = bus->displays == NULL;
+	if (last) {
+		bus->stop = true;
+		pthread_cond_signal(&bus->work);
+	}
+	pthread_mutex_unlock(&bus->lock);
+
+	if (last) {
+		pthread_join(bus->thread, NULL);
+		bus->running = false;
+		bus->stop = false;
+		if (bus->is_private) {
+			free_bus(bus);
+		}
+	}
+	pthread_mutex_unlock(&table_lock);
+	free_async_flush(async);
+}
+
+/*
+ * Send the last queued frame and remove the display from the flush worker.
+ */
+void done_async_flush(u8g2_t *u8g2) {
+	stop_async_flush(u8g2, true);
+}
@@ -15,6 +15,13 @@ extern "C" {
 
 #define MAX_I2C_HANDLES 8
 #define MAX_SPI_HANDLES 256
+// SPI controllers, upper 4 bits of the SPI bus number
+#define MAX_SPI_BUSES 16
+
+// SPI clock calibration: bytes per probe, probes per step and lowest clock
+#define SPI_PROBE_LEN 1024
+#define SPI_PROBE_ROUNDS 8
+#define SPI_CALIBRATE_MIN_SPEED 100000
 
 /*
  * User data passed in user_ptr of u8x8_struct.
@@ -38,6 +45,10 @@ struct user_data_struct {
 	uint32_t max_speed;
 	// Internal buffer
 	uint8_t *int_buf;
+	// Shared bus of a hardware I2C/SPI display, NULL until the bus is opened
+	struct bus_struct *bus_ctx;
+	// Flush worker, NULL unless init_async_flush() was called
+	struct async_flush_struct *async;
 };
 
 typedef struct user_data_struct user_data_t;
@@ -61,6 +72,8 @@ void write_pin(u8x8_t *u8x8, uint8_t pin, uint8_t value);
 void init_i2c(u8x8_t *u8x8);
 void done_i2c();
 void init_spi(u8x8_t *u8x8);
+int set_spi_hw_speed(u8g2_t *u8g2, uint32_t speed);
+uint32_t calibrate_spi_hw(u8g2_t *u8g2, uint32_t max_speed);
 void done_spi();
 uint8_t u8x8_arm_linux_gpio_and_delay(u8x8_t *u8x8, uint8_t msg,
 		uint8_t arg_int, void *arg_ptr);
@@ -68,6 +81,11 @@ uint8_t u8x8_byte_arm_linux_hw_i2c(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 		void *arg_ptr);
 uint8_t u8x8_byte_arm_linux_hw_spi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int,
 		void *arg_ptr);
+int init_async_flush(u8g2_t *u8g2);
+uint32_t u8g2_SendBufferAsync(u8g2_t *u8g2);
+void u8g2_WaitFlush(u8g2_t *u8g2, uint32_t fence);
+unsigned long get_async_flush_dropped(u8g2_t *u8g2);
+void done_async_flush(u8g2_t *u8g2);
 
 #ifdef __cplusplus
 }
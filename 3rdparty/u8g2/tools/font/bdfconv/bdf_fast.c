@@ -0,0 +1,166 @@
+/*
+
+  bdf_fast.c
+
+  fast decode font format (font format 3) for targets with enough memory:
+  no RLE, glyphs are stored as vertical page bytes (lsb on top, like the
+  display memory of the SSD13xx controllers) and found with a two level
+  lookup table.
+
+  offset 	bytes	desc
+  0		23		font information, see bf_AddFontInfo(), bits_per_0 is 0, bits_per_1 is the format version
+  23		1024		256 entries, 4 bytes each: offset of the glyph table for the encoding high byte, 0 if not used
+  1047		n*1024	glyph tables, 256 entries, 4 bytes each: offset of the glyph for the encoding low byte, 0 if missing
+
+  All offsets are relative to the start of the font, high byte first.
+
+  glyph:
+  0		1		width
+  1		1		height
+  2		1		x offset (signed)
+  3		1		y offset (signed)
+  4		1		delta x (signed)
+  5		w*((h+7)/8)	bitmap, page by page from top to bottom, w bytes per page, bit 0 is the upper row
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "bdf_font.h"
+
+#define BDF_FAST_FONT_VERSION 1
+#define BDF_FAST_FONT_TABLE_START 23
+
+static void bf_set_fast_offset(bf_t *bf, int pos, unsigned long offset)
+{
+  bf->target_data[pos+0] = (offset >> 24) & 255;
+  bf->target_data[pos+1] = (offset >> 16) & 255;
+  bf->target_data[pos+2] = (offset >> 8) & 255;
+  bf->target_data[pos+3] = offset & 255;
+}
+
+static int bg_fast_convert(bg_t *bg, bbx_t *bbx)
+{
+  int x;
+  int y;
+  int page;
+  int bit;
+  int d;
+
+  bg_ClearTargetData(bg);
+
+  if ( bg_AddTargetData(bg, bbx->w) < 0 )
+    return 0;
+  if ( bg_AddTargetData(bg, bbx->h) < 0 )
+    return 0;
+  if ( bg_AddTargetData(bg, bbx->x & 255) < 0 )
+    return 0;
+  if ( bg_AddTargetData(bg, bbx->y & 255) < 0 )
+    return 0;
+  /* same as the delta x of the RLE font */
+  if ( bg->bf->bbx_mode == BDF_BBX_MODE_MINIMAL )
+    d = bg->dwidth_x;
+  else
+    d = bbx->w;
+  if ( bg_AddTargetData(bg, d & 255) < 0 )
+    return 0;
+
+  for( page = 0; page < (bbx->h+7)/8; page++ )
+  {
+    for( x = bbx->x; x < bbx->x + bbx->w; x++)
+    {
+      d = 0;
+      for( bit = 0; bit < 8; bit++ )
+      {
+	y = bbx->y+bbx->h-1 - (page*8+bit);
+	if ( y >= bbx->y && bg_GetBBXPixel(bg, x, y) != 0 )
+	  d |= 1<<bit;
+      }
+      if ( bg_AddTargetData(bg, d) < 0 )
+	return 0;
+    }
+  }
+  return 1;
+}
+
+void bf_GenerateFastFont(bf_t *bf)
+{
+  int i, j;
+  bg_t *bg;
+  bbx_t local_bbx;
+  int page_table[256];
+  int page_cnt = 0;
+  int glyph_cnt = 0;
+  unsigned long offset;
+
+  /* Step 1: Generate the glyph bitmaps */
+
+  for( j = 0; j < 256; j++ )
+    page_table[j] = 0;
+
+  for( i = 0; i < bf->glyph_cnt; i++ )
+  {
+    bg = bf->glyph_list[i];
+    if ( bg->map_to >= 0 )
+    {
+      if ( bg->map_to > 0x0ffff )
+      {
+	bf_Log(bf, "GenerateFastFont: Error, encoding outside of the BMP, encoding=%ld", bg->map_to);
+	continue;
+      }
+      bf_copy_bbx_and_update_shift(bf, &local_bbx, bg);
+      if ( bg_fast_convert(bg, &local_bbx) == 0 )
+      {
+	bf_Error(bf, "GenerateFastFont: Error, out of memory, encoding=%ld", bg->encoding);
+	exit(1);
+      }
+      page_table[bg->map_to >> 8] = 1;
+    }
+  }
+
+  /* Step 2: Write the font information and the lookup tables */
+
+  bf_ClearTargetData(bf);
+  bf_AddFontInfo(bf, 0, BDF_FAST_FONT_VERSION);
+  assert( bf->target_cnt == BDF_FAST_FONT_TABLE_START );
+
+  for( j = 0; j < 256*4; j++ )
+    bf_AddTargetData(bf, 0);
+
+  for( j = 0; j < 256; j++ )
+  {
+    if ( page_table[j] != 0 )
+    {
+      page_table[j] = bf->target_cnt;
+      bf_set_fast_offset(bf, BDF_FAST_FONT_TABLE_START+j*4, bf->target_cnt);
+      for( i = 0; i < 256*4; i++ )
+	bf_AddTargetData(bf, 0);
+      page_cnt++;
+    }
+  }
+
+  /* Step 3: Write the glyphs */
+
+  for( i = 0; i < bf->glyph_cnt; i++ )
+  {
+    bg = bf->glyph_list[i];
+    if ( bg->map_to >= 0 && bg->map_to <= 0x0ffff && bg->target_data != NULL )
+    {
+      offset = bf->target_cnt;
+      for( j = 0; j < bg->target_cnt; j++ )
+      {
+	if ( bf_AddTargetData(bf, bg->target_data[j]) < 0 )
+	{
+	  bf_Error(bf, "GenerateFastFont: Error, out of memory");
+	  exit(1);
+	}
+      }
+      bf_set_fast_offset(bf, page_table[bg->map_to >> 8] + (bg->map_to & 255)*4, offset);
+      glyph_cnt++;
+    }
+  }
+
+  bf_Log(bf, "GenerateFastFont: Glyphs=%d, glyph tables=%d", glyph_cnt, page_cnt);
+  bf_Log(bf, "GenerateFastFont: Font size %d", bf->target_cnt);
+}
@@ -750,6 +750,10 @@ bf_t *bf_OpenFromFile(const char *bdf_filename, int is_verbose, int bbx_mode, co
       {
 	bf_RLECompressAllGlyphs(bf);
       }
+      else if ( font_format == 3 )
+      {
+	bf_GenerateFastFont(bf);	/* bdf_fast.c */
+      }
       else
       {
 	bf_Generate8x8Font(bf, xo, yo);	/* bdf_8x8.c */
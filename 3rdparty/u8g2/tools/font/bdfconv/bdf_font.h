@@ -123,13 +123,18 @@ void bf_CalculateMaxBBX(bf_t *bf);
 void bf_CalculateMinMaxDWidth(bf_t *bf);
 void bf_copy_bbx_and_update_shift(bf_t *bf, bbx_t *target_bbx, bg_t *bg);
 void bf_CalculateMaxBitFieldSize(bf_t *bf);
+void bf_AddFontInfo(bf_t *bf, int bits_per_0, int bits_per_1);
 void bf_RLECompressAllGlyphs(bf_t *bf);
+void bf_GenerateFastFont(bf_t *bf);
 void bf_Generate8x8Font(bf_t *bf, int xo, int yo);
 
 
 int bf_WriteUCGCByFilename(bf_t *bf, const char *filename, const char *fontname, const char *indent);
 int bf_WriteU8G2CByFilename(bf_t *bf, const char *filename, const char *fontname, const char *indent);
 
+/* bdf_pack.c */
+int bf_WriteU8G2PackByFilename(bf_t *bf, const char *filename, const char *fontname, int font_format);
+
 bf_t *bf_OpenFromFile(const char *bdf_filename, int is_verbose, int bbx_mode, const char *map_str, const char *map_file_name, const char *utf8_file_name, int font_format, int xo, int yo, int th, int tv);
 
 
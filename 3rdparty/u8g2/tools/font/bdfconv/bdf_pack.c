@@ -0,0 +1,206 @@
+/*
+
+  bdf_pack.c
+
+  font pack file: many u8g2/u8x8 fonts in one file, which is mmap'ed
+  read-only at runtime (see src/font_pack.c of the application) instead of
+  linking the fonts as C arrays.
+
+  All numbers are little endian, records start at 4 byte boundaries.
+
+  header:
+  offset 	bytes	desc
+  0		8		magic "U8G2PACK"
+  8		2		version, 1
+  10		2		reserved, 0
+  12		4		reserved, 0
+
+  record:
+  0		4		record size in bytes including this field, multiple of 4
+  4		1		font format (1: u8g2 font, 2: u8x8 font, 3: u8g2 fast decode font)
+  5		1		length of the font name without the terminating zero
+  6		2		number of glyphs
+  8		4		font data size
+  12		n+1		font name, zero terminated, padded with zeros to a multiple of 4
+  ...		size	font data (same bytes as the C array), padded with zeros to a multiple of 4
+
+  A font which is written into an existing pack replaces the record with the
+  same name. The new pack is written to "<pack>.tmp" and renamed over the old
+  one, so processes which have the old pack mapped keep their (old) fonts.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bdf_font.h"
+
+#define BDF_PACK_MAGIC "U8G2PACK"
+#define BDF_PACK_VERSION 1
+#define BDF_PACK_HEADER_SIZE 16
+#define BDF_PACK_RECORD_SIZE 12
+
+static unsigned long bf_pack_get_u32(const uint8_t *p)
+{
+  return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void bf_pack_put_u16(FILE *fp, unsigned v)
+{
+  fputc(v & 255, fp);
+  fputc((v >> 8) & 255, fp);
+}
+
+static void bf_pack_put_u32(FILE *fp, unsigned long v)
+{
+  fputc(v & 255, fp);
+  fputc((v >> 8) & 255, fp);
+  fputc((v >> 16) & 255, fp);
+  fputc((v >> 24) & 255, fp);
+}
+
+static void bf_pack_pad(FILE *fp, unsigned long n)
+{
+  while ( (n & 3) != 0 )
+  {
+    fputc(0, fp);
+    n++;
+  }
+}
+
+/* read the complete old pack, returns NULL with *size = 0 if the pack does not exist yet */
+static uint8_t *bf_pack_read(bf_t *bf, const char *filename, unsigned long *size)
+{
+  FILE *fp;
+  uint8_t *buf;
+  long len;
+
+  *size = 0;
+  fp = fopen(filename, "rb");
+  if ( fp == NULL )
+    return NULL;
+  if ( fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0 )
+  {
+    fclose(fp);
+    return NULL;
+  }
+  buf = (uint8_t *)malloc(len+1);
+  if ( buf == NULL )
+  {
+    bf_Error(bf, "bf_WriteU8G2PackByFilename: Error, out of memory");
+    fclose(fp);
+    exit(1);
+  }
+  if ( fread(buf, 1, len, fp) != (size_t)len )
+  {
+    free(buf);
+    fclose(fp);
+    return NULL;
+  }
+  fclose(fp);
+  *size = len;
+  return buf;
+}
+
+/* called from main() */
+int bf_WriteU8G2PackByFilename(bf_t *bf, const char *filename, const char *fontname, int font_format)
+{
+  FILE *fp;
+  uint8_t *old;
+  unsigned long old_size;
+  unsigned long pos;
+  unsigned long record_size;
+  unsigned long data_size;
+  size_t name_len;
+  int record_cnt = 0;
+  char tmp_filename[1024];
+
+  if ( font_format < 1 || font_format > 3 )
+  {
+    bf_Log(bf, "bf_WriteU8G2PackByFilename: Font format %d can not be stored in a font pack", font_format);
+    return 0;
+  }
+  name_len = strlen(fontname);
+  if ( name_len == 0 || name_len > 255 )
+  {
+    bf_Log(bf, "bf_WriteU8G2PackByFilename: Invalid font name '%s'", fontname);
+    return 0;
+  }
+
+  old = bf_pack_read(bf, filename, &old_size);
+  if ( old != NULL && (old_size < BDF_PACK_HEADER_SIZE || memcmp(old, BDF_PACK_MAGIC, 8) != 0 || old[8] != BDF_PACK_VERSION || old[9] != 0) )
+  {
+    bf_Log(bf, "bf_WriteU8G2PackByFilename: '%s' is not a font pack", filename);
+    free(old);
+    return 0;
+  }
+
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+  fp = fopen(tmp_filename, "wb");
+  if ( fp == NULL )
+  {
+    bf_Log(bf, "bf_WriteU8G2PackByFilename: Open error '%s'", tmp_filename);
+    free(old);
+    return 0;
+  }
+
+  fwrite(BDF_PACK_MAGIC, 1, 8, fp);
+  bf_pack_put_u16(fp, BDF_PACK_VERSION);
+  bf_pack_put_u16(fp, 0);
+  bf_pack_put_u32(fp, 0);
+
+  /* copy all other fonts of the old pack */
+  pos = BDF_PACK_HEADER_SIZE;
+  while ( old != NULL && pos + BDF_PACK_RECORD_SIZE <= old_size )
+  {
+    record_size = bf_pack_get_u32(old+pos);
+    if ( record_size < BDF_PACK_RECORD_SIZE || (record_size & 3) != 0 || record_size > old_size - pos )
+    {
+      bf_Log(bf, "bf_WriteU8G2PackByFilename: Corrupt record at offset %lu in '%s', dropped the rest of the pack", pos, filename);
+      break;
+    }
+    if ( old[pos+5] != name_len || memcmp(old+pos+BDF_PACK_RECORD_SIZE, fontname, name_len) != 0 )
+    {
+      fwrite(old+pos, 1, record_size, fp);
+      record_cnt++;
+    }
+    pos += record_size;
+  }
+  free(old);
+
+  /* same bytes as the C array, see bf_WriteU8G2CByFP() */
+  data_size = bf->target_cnt;
+  if ( bf->target_data[bf->target_cnt-1] != 0 )
+    data_size++;
+
+  record_size = BDF_PACK_RECORD_SIZE + ((name_len+1+3) & ~3UL) + ((data_size+3) & ~3UL);
+  bf_pack_put_u32(fp, record_size);
+  fputc(font_format, fp);
+  fputc(name_len, fp);
+  bf_pack_put_u16(fp, bf->selected_glyphs > 0xffff ? 0xffff : bf->selected_glyphs);
+  bf_pack_put_u32(fp, data_size);
+  fwrite(fontname, 1, name_len+1, fp);
+  bf_pack_pad(fp, name_len+1);
+  fwrite(bf->target_data, 1, bf->target_cnt, fp);
+  if ( data_size > (unsigned long)bf->target_cnt )
+    fputc(0, fp);
+  bf_pack_pad(fp, data_size);
+  record_cnt++;
+
+  if ( ferror(fp) != 0 )
+  {
+    bf_Log(bf, "bf_WriteU8G2PackByFilename: Write error '%s'", tmp_filename);
+    fclose(fp);
+    remove(tmp_filename);
+    return 0;
+  }
+  if ( fclose(fp) != 0 || rename(tmp_filename, filename) != 0 )
+  {
+    bf_Log(bf, "bf_WriteU8G2PackByFilename: Write error '%s'", filename);
+    remove(tmp_filename);
+    return 0;
+  }
+
+  bf_Log(bf, "bf_WriteU8G2PackByFilename: Write font '%s' to '%s', fonts in pack: %d", fontname, filename, record_cnt);
+  return 1;
+}
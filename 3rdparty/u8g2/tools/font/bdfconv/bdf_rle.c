@@ -63,6 +63,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "bdf_font.h"
 
 #ifdef OLD_CODE
@@ -359,16 +361,78 @@ static int bg_prepare_01_rle(bg_t *bg, unsigned a, unsigned b)
 }
 
 
-int bg_rle_compress(bg_t *bg, bbx_t *bbx, unsigned rle_bits_per_0, unsigned rle_bits_per_1, int is_output)
+/*
+  Desc:
+    Build the list of 01 pairs of a glyph: bd_list[2*i] is the number of
+    zero bits, bd_list[2*i+1] the number of one bits that follow.
+  Returns:
+    Number of entries in bd_list (always even)
+*/
+static int bg_collect_01_pairs(bg_t *bg, bbx_t *bbx, int *bd_list)
 {
   int x;
   int y;
-  int i;
   int bd_is_one;	/* bit delta */
   int bd_curr_len;
   int bd_max_len;
   int bd_chg_cnt;
   
+  bd_is_one = 0;
+  bd_curr_len = 0;
+  bd_max_len = 0;
+  bd_chg_cnt = 0;
+
+  for( y = bbx->y+bbx->h-1; y >= bbx->y; y--)
+  {
+    for( x = bbx->x; x < bbx->x + bbx->w; x++)
+    {
+      if ( bg_GetBBXPixel(bg, x, y) == 0 )
+      {
+	if ( bd_is_one != 0 )
+	{
+	  bd_list[bd_chg_cnt] = bd_curr_len;
+	  bd_is_one = 0;
+	  bd_chg_cnt++;
+	  bd_curr_len = 0;
+	}
+	bd_curr_len++;	
+      }
+      else
+      {
+	if ( bd_is_one == 0 )
+	{
+	  bd_list[bd_chg_cnt] = bd_curr_len;
+	  bd_is_one = 1;
+	  bd_chg_cnt++;
+	  bd_curr_len = 0;
+	}
+	bd_curr_len++;	
+      }
+      
+      if ( bd_max_len < bd_curr_len )
+	bd_max_len = bd_curr_len;      
+    }
+  }
+  
+ 
+  bd_list[bd_chg_cnt] = bd_curr_len;
+  bd_chg_cnt++;
+  
+  if ( (bd_chg_cnt & 1) == 1 )
+  {
+    assert(bd_is_one == 0);
+    bd_list[bd_chg_cnt] = 0;
+    bd_chg_cnt++;
+  }
+  
+  return bd_chg_cnt;
+}
+
+int bg_rle_compress(bg_t *bg, bbx_t *bbx, unsigned rle_bits_per_0, unsigned rle_bits_per_1, int is_output)
+{
+  int i;
+  int bd_chg_cnt;
+  
   static int bd_list[1024*2];
 
   if ( bbx == NULL )
@@ -424,55 +488,9 @@ int bg_rle_compress(bg_t *bg, bbx_t *bbx, unsigned rle_bits_per_0, unsigned rle_
       return bg_err("error in bg_rle_compress"), 0;
   }
   
-  bd_is_one = 0;
-  bd_curr_len = 0;
-  bd_max_len = 0;
-  bd_chg_cnt = 0;
-
   /* step 1: build array with pairs of a (number of zero bits) and b (number of one bits) */
-
-  for( y = bbx->y+bbx->h-1; y >= bbx->y; y--)
-  {
-    for( x = bbx->x; x < bbx->x + bbx->w; x++)
-    {
-      if ( bg_GetBBXPixel(bg, x, y) == 0 )
-      {
-	if ( bd_is_one != 0 )
-	{
-	  bd_list[bd_chg_cnt] = bd_curr_len;
-	  bd_is_one = 0;
-	  bd_chg_cnt++;
-	  bd_curr_len = 0;
-	}
-	bd_curr_len++;	
-      }
-      else
-      {
-	if ( bd_is_one == 0 )
-	{
-	  bd_list[bd_chg_cnt] = bd_curr_len;
-	  bd_is_one = 1;
-	  bd_chg_cnt++;
-	  bd_curr_len = 0;
-	}
-	bd_curr_len++;	
-      }
-      
-      if ( bd_max_len < bd_curr_len )
-	bd_max_len = bd_curr_len;      
-    }
-  }
   
- 
-  bd_list[bd_chg_cnt] = bd_curr_len;
-  bd_chg_cnt++;
-  
-  if ( (bd_chg_cnt & 1) == 1 )
-  {
-    assert(bd_is_one == 0);
-    bd_list[bd_chg_cnt] = 0;
-    bd_chg_cnt++;
-  }
+  bd_chg_cnt = bg_collect_01_pairs(bg, bbx, bd_list);
   
   //printf("01 pairs = %d\n", bd_chg_cnt/2);
   
@@ -625,16 +643,279 @@ unsigned bf_RLE_get_glyph_data(bf_t *bf, uint8_t encoding)
 }
 
 
-void bf_RLECompressAllGlyphs(bf_t *bf)
+/*===================================================*/
+/*
+  Search for the best rle_0/rle_1 field sizes.
+  
+  The 01 pairs of a glyph do not depend on the field sizes. They are 
+  collected once per glyph, identical consecutive pairs are merged into
+  one entry with a repeat count. The bit size for a field size combination
+  is then calculated from this list with the same rules as bg_01_rle() and
+  bg_prepare_01_rle(), without writing any target data. The combinations
+  are distributed over several threads.
+*/
+
+#define RLE_0_MIN 2
+#define RLE_0_MAX 8
+#define RLE_1_MIN 2
+#define RLE_1_MAX 6
+#define RLE_COMBINATIONS ((RLE_0_MAX-RLE_0_MIN+1)*(RLE_1_MAX-RLE_1_MIN+1))
+#define RLE_SEARCH_MAX_THREADS 16
+
+struct rle_run
 {
-  int i, j;
-  bg_t *bg;
+  unsigned a;		/* number of 0 bits */
+  unsigned b;		/* number of 1 bits */
+  unsigned cnt;		/* repeat count of this pair */
+};
+
+struct rle_glyph
+{
+  unsigned header_bits;	/* encoding, size and bbx, independent from the field sizes */
+  int run_cnt;
+  struct rle_run *run_list;
+};
+
+struct rle_search
+{
+  struct rle_glyph *glyph_list;
+  int glyph_cnt;
+  int thread_cnt;
+  unsigned long total_bits[RLE_COMBINATIONS];
+};
+
+struct rle_cost
+{
+  unsigned bits_per_0;
+  unsigned bits_per_1;
+  int is_first;
+  unsigned last_0;
+  unsigned last_1;
+  unsigned long bitcnt;
+};
+
+/* same as bg_01_rle(), but only count the bits */
+static void rle_cost_01(struct rle_cost *c, unsigned a, unsigned b)
+{
+  if ( c->is_first == 0 && c->last_0 == a && c->last_1 == b )
+  {
+    c->bitcnt++;
+  }
+  else
+  {
+    if ( c->is_first == 0 )
+      c->bitcnt++;
+    c->bitcnt += c->bits_per_0 + c->bits_per_1;
+    c->is_first = 0;
+    c->last_0 = a;
+    c->last_1 = b;
+  }
+}
+
+/* same as bg_prepare_01_rle(), returns the number of generated pairs */
+static int rle_cost_prepare_01(struct rle_cost *c, unsigned a, unsigned b)
+{
+  int cnt = 0;
+  unsigned max_0 = (1<<c->bits_per_0) - 1;
+  unsigned max_1 = (1<<c->bits_per_1) - 1;
+  while( a > max_0 )
+  {
+    rle_cost_01(c, max_0, 0);
+    a -= max_0;
+    cnt++;
+  }
+  while( b > max_1 )
+  {
+    rle_cost_01(c, a, max_1);
+    a = 0;
+    b -= max_1;
+    cnt++;
+  }
+  if ( a != 0 || b != 0 )
+  {
+    rle_cost_01(c, a, b);
+    cnt++;
+  }
+  return cnt;
+}
+
+static unsigned long rle_glyph_bits(const struct rle_glyph *g, unsigned rle_0, unsigned rle_1)
+{
+  struct rle_cost c;
+  int i;
+  unsigned n;
   
-  int rle_0, rle_1;
-  int best_rle_0=0, best_rle_1= 0;
-  unsigned long total_bits = 0;
+  c.bits_per_0 = rle_0;
+  c.bits_per_1 = rle_1;
+  c.is_first = 1;
+  c.last_0 = 0;
+  c.last_1 = 1;
+  c.bitcnt = g->header_bits + 1;	/* one 0 bit is added at the end */
+  
+  for( i = 0; i < g->run_cnt; i++ )
+  {
+    if ( rle_cost_prepare_01(&c, g->run_list[i].a, g->run_list[i].b) == 1 )
+    {
+      /* a single pair is repeated with one bit each */
+      c.bitcnt += g->run_list[i].cnt - 1;
+    }
+    else
+    {
+      for( n = 1; n < g->run_list[i].cnt; n++ )
+	rle_cost_prepare_01(&c, g->run_list[i].a, g->run_list[i].b);
+    }
+  }
+  return (c.bitcnt + 7) & ~7UL;	/* bg_FlushTargetBits() */
+}
+
+struct rle_search_arg
+{
+  struct rle_search *search;
+  int thread_idx;
+};
+
+static void *rle_search_thread(void *arg)
+{
+  struct rle_search *s = ((struct rle_search_arg *)arg)->search;
+  int k, i;
+  unsigned long total_bits;
+  
+  for( k = ((struct rle_search_arg *)arg)->thread_idx; k < RLE_COMBINATIONS; k += s->thread_cnt )
+  {
+    total_bits = 0;
+    for( i = 0; i < s->glyph_cnt; i++ )
+      total_bits += rle_glyph_bits(s->glyph_list+i, RLE_0_MIN + k / (RLE_1_MAX-RLE_1_MIN+1), RLE_1_MIN + k % (RLE_1_MAX-RLE_1_MIN+1));
+    s->total_bits[k] = total_bits;
+  }
+  return NULL;
+}
+
+static int rle_search_thread_cnt(void)
+{
+  long n = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if ( n < 1 )
+    n = 1;
+  if ( n > RLE_SEARCH_MAX_THREADS )
+    n = RLE_SEARCH_MAX_THREADS;
+  return (int)n;
+}
+
+/*
+  Desc:
+    Find the field sizes with the smallest total bit size of all glyphs.
+    Same result as calling bf_RLECompressAllGlyphsWithFieldSize() for all
+    combinations, lower field sizes win if the size is equal.
+  Returns:
+    Total bit size for best_rle_0 and best_rle_1, 0 if out of memory
+*/
+static unsigned long bf_RLESearchFieldSize(bf_t *bf, int *best_rle_0, int *best_rle_1)
+{
+  static int bd_list[1024*2];
+  struct rle_search s;
+  struct rle_search_arg arg[RLE_SEARCH_MAX_THREADS];
+  pthread_t thread[RLE_SEARCH_MAX_THREADS];
+  int thread_ok[RLE_SEARCH_MAX_THREADS];
+  struct rle_glyph *g;
+  bg_t *bg;
+  bbx_t local_bbx;
+  int i, j, k, cnt;
   unsigned long min_total_bits = 0xffffffff;
   
+  s.glyph_list = (struct rle_glyph *)malloc(sizeof(struct rle_glyph)*(bf->glyph_cnt+1));
+  if ( s.glyph_list == NULL )
+    return 0;
+  s.glyph_cnt = 0;
+  
+  /* step 1: collect the 01 pairs of all glyphs, this will also update shift_x */
+  for( i = 0; i < bf->glyph_cnt; i++ )
+  {
+    bg = bf->glyph_list[i];
+    if ( bg->map_to < 0 )
+      continue;
+    bf_copy_bbx_and_update_shift(bf, &local_bbx, bg);
+    
+    g = s.glyph_list + s.glyph_cnt;
+    g->header_bits = (bg->map_to <= 255 ? 8 : 16) + 8;
+    g->header_bits += bf->bbx_w_max_bit_size + bf->bbx_h_max_bit_size;
+    g->header_bits += bf->bbx_x_max_bit_size + bf->bbx_y_max_bit_size;
+    g->header_bits += bf->dx_max_bit_size;
+    
+    cnt = bg_collect_01_pairs(bg, &local_bbx, bd_list);
+    g->run_list = (struct rle_run *)malloc(sizeof(struct rle_run)*(cnt/2));
+    if ( g->run_list == NULL )
+      break;
+    g->run_cnt = 0;
+    for( j = 0; j < cnt; j += 2 )
+    {
+      if ( g->run_cnt > 0 && g->run_list[g->run_cnt-1].a == (unsigned)bd_list[j] && g->run_list[g->run_cnt-1].b == (unsigned)bd_list[j+1] )
+      {
+	g->run_list[g->run_cnt-1].cnt++;
+      }
+      else
+      {
+	g->run_list[g->run_cnt].a = bd_list[j];
+	g->run_list[g->run_cnt].b = bd_list[j+1];
+	g->run_list[g->run_cnt].cnt = 1;
+	g->run_cnt++;
+      }
+    }
+    s.glyph_cnt++;
+  }
+  
+  /* step 2: calculate the bit size of all combinations */
+  if ( i == bf->glyph_cnt )
+  {
+    s.thread_cnt = rle_search_thread_cnt();
+    for( k = 0; k < s.thread_cnt; k++ )
+    {
+      arg[k].search = &s;
+      arg[k].thread_idx = k;
+      thread_ok[k] = 0;
+    }
+    /* thread 0 is the current thread */
+    for( k = 1; k < s.thread_cnt; k++ )
+      thread_ok[k] = pthread_create(thread+k, NULL, rle_search_thread, arg+k) == 0;
+    rle_search_thread(arg+0);
+    for( k = 1; k < s.thread_cnt; k++ )
+    {
+      if ( thread_ok[k] )
+	pthread_join(thread[k], NULL);
+      else
+	rle_search_thread(arg+k);
+    }
+    
+    for( k = 0; k < RLE_COMBINATIONS; k++ )
+    {
+      if ( min_total_bits > s.total_bits[k] )
+      {
+	min_total_bits = s.total_bits[k];
+	*best_rle_0 = RLE_0_MIN + k / (RLE_1_MAX-RLE_1_MIN+1);
+	*best_rle_1 = RLE_1_MIN + k % (RLE_1_MAX-RLE_1_MIN+1);
+      }
+    }
+  }
+  else
+  {
+    min_total_bits = 0;
+  }
+  
+  for( i = 0; i < s.glyph_cnt; i++ )
+    free(s.glyph_list[i].run_list);
+  free(s.glyph_list);
+  return min_total_bits;
+}
+
+/*
+  Desc:
+    Write the 23 byte font information, which starts all u8g2 fonts.
+    bits_per_0 and bits_per_1 are the RLE field sizes, bits_per_0 is 0 
+    for the fast decode font format (bdf_fast.c).
+*/
+void bf_AddFontInfo(bf_t *bf, int bits_per_0, int bits_per_1)
+{
   int idx_cap_a;
   int idx_cap_a_ascent;
   int idx_1;
@@ -645,17 +926,6 @@ void bf_RLECompressAllGlyphs(bf_t *bf)
   int idx_para_ascent;
   int idx_para_descent;
   
-  unsigned pos;
-  unsigned ascii_glyphs;
-  unsigned unicode_start_pos;
-  unsigned unicode_lookup_table_len;  
-  uint32_t unicode_lookup_table_start;
-  uint32_t unicode_last_delta;
-  uint32_t unicode_last_target_cnt;
-  unsigned unicode_lookup_table_pos;
-  unsigned unicode_lookup_table_glyph_cnt;
-  uint32_t unicode_glyph_cnt = 0;
-  
   idx_cap_a_ascent = 0;
   idx_cap_a = bf_GetIndexByEncoding(bf, 'A');
   if ( idx_cap_a >= 0 )
@@ -694,45 +964,11 @@ void bf_RLECompressAllGlyphs(bf_t *bf)
     idx_para_descent = idx_g_descent;
   }
 
-  
-  for( rle_0 = 2; rle_0 < 9; rle_0++ )
-  {
-    for( rle_1 = 2; rle_1 < 7; rle_1++ )
-    {
-      total_bits = bf_RLECompressAllGlyphsWithFieldSize(bf, rle_0, rle_1, 0);
-      if ( min_total_bits > total_bits )
-      {
-	min_total_bits = total_bits;
-	best_rle_0 = rle_0;
-	best_rle_1 = rle_1;
-      }
-      
-    }
-  }
-  bf_Log(bf, "RLE Compress: best zero bits %d, one bits %d, total bit size %lu", best_rle_0, best_rle_1, min_total_bits);
-  bf_RLECompressAllGlyphsWithFieldSize(bf, best_rle_0, best_rle_1, 0);
-
-
-  bf_ClearTargetData(bf);
-
-  /*
-    glyph_cnt = *font++;
-    bits_per_0 = *font++;
-    bits_per_1 = *font++;
-    bits_per_char_width = *font++;
-    bits_per_char_height = *font++;
-    bits_per_char_x = *font++;
-    bits_per_char_y = *font++;
-    bits_per_delta_x = *font++;
-  */
-
-  bf_Log(bf, "RLE Compress: Font code generation, selected glyphs=%d, total glyphs=%d", bf->selected_glyphs, bf->glyph_cnt);
-  
   /* 0 */
   bf_AddTargetData(bf, bf->selected_glyphs);
   bf_AddTargetData(bf, bf->bbx_mode);
-  bf_AddTargetData(bf, best_rle_0);
-  bf_AddTargetData(bf, best_rle_1);
+  bf_AddTargetData(bf, bits_per_0);
+  bf_AddTargetData(bf, bits_per_1);
 
   /* 4 */
   bf_AddTargetData(bf, bf->bbx_w_max_bit_size);
@@ -769,6 +1005,68 @@ void bf_RLECompressAllGlyphs(bf_t *bf)
   /* 21 */
   bf_AddTargetData(bf, 0);	/* start pos unicode, high/low */
   bf_AddTargetData(bf, 0);
+}
+
+void bf_RLECompressAllGlyphs(bf_t *bf)
+{
+  int i, j;
+  bg_t *bg;
+  
+  int rle_0, rle_1;
+  int best_rle_0=0, best_rle_1= 0;
+  unsigned long total_bits = 0;
+  unsigned long min_total_bits = 0xffffffff;
+  
+  unsigned pos;
+  unsigned ascii_glyphs;
+  unsigned unicode_start_pos;
+  unsigned unicode_lookup_table_len;  
+  uint32_t unicode_lookup_table_start;
+  uint32_t unicode_last_delta;
+  uint32_t unicode_last_target_cnt;
+  unsigned unicode_lookup_table_pos;
+  unsigned unicode_lookup_table_glyph_cnt;
+  uint32_t unicode_glyph_cnt = 0;
+  
+  min_total_bits = bf_RLESearchFieldSize(bf, &best_rle_0, &best_rle_1);
+  if ( min_total_bits == 0 )
+  {
+    /* out of memory, try all combinations with the full encoder */
+    min_total_bits = 0xffffffff;
+    for( rle_0 = RLE_0_MIN; rle_0 <= RLE_0_MAX; rle_0++ )
+    {
+      for( rle_1 = RLE_1_MIN; rle_1 <= RLE_1_MAX; rle_1++ )
+      {
+	total_bits = bf_RLECompressAllGlyphsWithFieldSize(bf, rle_0, rle_1, 0);
+	if ( min_total_bits > total_bits )
+	{
+	  min_total_bits = total_bits;
+	  best_rle_0 = rle_0;
+	  best_rle_1 = rle_1;
+	}
+      }
+    }
+  }
+  bf_Log(bf, "RLE Compress: best zero bits %d, one bits %d, total bit size %lu", best_rle_0, best_rle_1, min_total_bits);
+  bf_RLECompressAllGlyphsWithFieldSize(bf, best_rle_0, best_rle_1, 0);
+
+
+  bf_ClearTargetData(bf);
+
+  /*
+    glyph_cnt = *font++;
+    bits_per_0 = *font++;
+    bits_per_1 = *font++;
+    bits_per_char_width = *font++;
+    bits_per_char_height = *font++;
+    bits_per_char_x = *font++;
+    bits_per_char_y = *font++;
+    bits_per_delta_x = *font++;
+  */
+
+  bf_Log(bf, "RLE Compress: Font code generation, selected glyphs=%d, total glyphs=%d", bf->selected_glyphs, bf->glyph_cnt);
+  
+  bf_AddFontInfo(bf, best_rle_0, best_rle_1);
 
   /* assumes, that map_to is sorted */
 
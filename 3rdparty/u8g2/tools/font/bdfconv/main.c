@@ -131,11 +131,12 @@ void help(void)
   printf("-h          Display this help\n");
   printf("-v          Print log messages\n");
   printf("-b <n>      Font build mode, 0: proportional, 1: common height, 2: monospace, 3: multiple of 8, 4: 5x7 mode\n");
-  printf("-f <n>      Font format, 0: ucglib font, 1: u8g2 font, 2: u8g2 uncompressed 8x8 font (enforces -b 3)\n");
+  printf("-f <n>      Font format, 0: ucglib font, 1: u8g2 font, 2: u8g2 uncompressed 8x8 font (enforces -b 3), 3: u8g2 fast decode font (no RLE, for Linux targets)\n");
   printf("-m 'map'    Unicode ASCII mapping\n");
   printf("-M 'mapfile'    Read Unicode ASCII mapping from file 'mapname'\n");
   printf("-u 'utf8file'    Include all characters from utf8 text file\n");
   printf("-o <file>   C output font file\n");
+  printf("-P <file>   Add the font (with name from -n) to the font pack <file>, replaces a font with the same name (requires -f 1, 2 or 3)\n");
   printf("-k <file>   C output file with kerning information\n");	
   printf("-p <%%>      Minimum distance for kerning in percent of the global char width (lower values: Smaller gaps, more data)\n");	
   printf("-x <n>      X-Offset for 8x8 font sub-glyph extraction (requires -f 2, default 0)\n");
@@ -198,6 +199,7 @@ int font_picture_test_string = 0;
 int runtime_test = 0;
 char *c_filename = NULL;
 char *k_filename = NULL;
+char *pack_filename = NULL;
 char *target_fontname = "bdf_font";
 
 /*================================================*/
@@ -423,6 +425,9 @@ int main(int argc, char **argv)
     else if ( get_str_arg(&argv, 'k', &k_filename) != 0 )
     {
     }
+    else if ( get_str_arg(&argv, 'P', &pack_filename) != 0 )
+    {
+    }
     else if ( get_str_arg(&argv, 'M', &map_filename) != 0 )
     {      
     }
@@ -475,9 +480,9 @@ int main(int argc, char **argv)
 
   if ( bf_desc_font != NULL )
   {
-    if ( font_format == 2 )
+    if ( font_format == 2 || font_format == 3 )
     {
-      bf_Log(bf, "Note: Overview Picture not possible for font format 2, option -d ignored.");
+      bf_Log(bf, "Note: Overview Picture not possible for font format %lu, option -d ignored.", font_format);
     }
     else
     {
@@ -522,9 +527,26 @@ int main(int argc, char **argv)
     }
   }
 
+  if ( pack_filename != NULL )
+  {
+    if ( bf_WriteU8G2PackByFilename(bf, pack_filename, target_fontname, font_format) == 0 )	/* bdf_pack.c */
+    {
+      bf_Error(bf, "Error: Font pack '%s' not written", pack_filename);
+      bf_Close(bf);
+      exit(1);
+    }
+  }
+
   if ( k_filename != NULL )
   {
-    bdf_calculate_all_kerning(bf, k_filename, target_fontname, min_distance_in_per_cent_of_char_width);
+    if ( font_format == 3 )
+    {
+      bf_Log(bf, "Note: Kerning calculation requires the RLE font, option -k ignored for font format 3.");
+    }
+    else
+    {
+      bdf_calculate_all_kerning(bf, k_filename, target_fontname, min_distance_in_per_cent_of_char_width);
+    }
   }
 
 
@@ -5,6 +5,9 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <assert.h>
+#include <errno.h>
+#include <spawn.h>
+#include <sys/wait.h>
 #ifdef BUILD2
 #include "u8g2.h"
 #endif
@@ -13,6 +16,7 @@ extern const uint8_t *u8x8_font_list[] ;
 extern char *u8x8_font_names[] ;
 extern const uint8_t *u8g2_font_list[] ;
 extern char *u8g2_font_names[] ;
+extern char **environ;
 
 //const char convert_extra_options[] = "-flip";   /* issue 2080: convert seems to flip the tga picture, again do the flip */
 const char convert_extra_options[] = "";   /* 1 Sep 2024: undo flip */
@@ -20,6 +24,8 @@ const char convert_extra_options[] = "";   /* 1 Sep 2024: undo flip */
 #ifdef BUILD2
 extern void u8g2_SetupBuffer_TGA(u8g2_t *u8g2, const u8g2_cb_t *u8g2_cb);
 extern void tga_save(const char *name);
+void convert_job_start(const char *cmd, const char *tga);
+void convert_jobs_finish(void);
 #endif
 
 
@@ -2376,11 +2382,13 @@ void overviewpic(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
     if ( mm != MM_N )
       u8x8_DrawString(u8g2_GetU8x8(&u8g2), 0,(16+2)*ch, "The quick brown fox jumps over the lazy dog.");
 
-    tga_save("font.tga");
+    strcpy(tga_filename, target_font_identifier);
+    strcat(tga_filename, ".tga");
+    tga_save(tga_filename);
     
     /* remove date info, see https://legacy.imagemagick.org/discourse-server/viewtopic.php?t=12230 */
-    sprintf(convert_cmd, "convert font.tga +set modify-date +set create-date -trim %s %s.png", convert_extra_options, target_font_identifier );
-    system(convert_cmd);
+    sprintf(convert_cmd, "convert %s +set modify-date +set create-date -trim %s %s.png", tga_filename, convert_extra_options, target_font_identifier );
+    convert_job_start(convert_cmd, tga_filename);
     u8x8_fnt_cnt++;
   }
   else if ( fm == FM_C ) 
@@ -2404,11 +2412,11 @@ void overviewpic(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
     strcpy(tga_filename, target_font_identifier);
     strcat(tga_filename, ".tga");
     
-    tga_save("font.tga");
+    tga_save(tga_filename);
     
      /* remove date info, see https://legacy.imagemagick.org/discourse-server/viewtopic.php?t=12230 */
-   sprintf(convert_cmd, "convert font.tga +set modify-date +set create-date -trim %s %s.png", convert_extra_options, target_font_identifier );
-    system(convert_cmd);
+   sprintf(convert_cmd, "convert %s +set modify-date +set create-date -trim %s %s.png", tga_filename, convert_extra_options, target_font_identifier );
+    convert_job_start(convert_cmd, tga_filename);
 
     u8g2_fnt_cnt++;
   }
@@ -2433,11 +2441,13 @@ void overviewshortpic(int i, int fm, char *fms, int bm, char *bms, int mm, char
     else
       u8x8_DrawString(u8g2_GetU8x8(&u8g2), 0, 0, "Abcdefg 123");
     
-    tga_save("font.tga");
+    strcpy(tga_filename, target_font_identifier);
+    strcat(tga_filename, "_short.tga");
+    tga_save(tga_filename);
     
      /* remove date info, see https://legacy.imagemagick.org/discourse-server/viewtopic.php?t=12230 */
-    sprintf(convert_cmd, "convert font.tga +set modify-date +set create-date -trim %s %s_short.png", convert_extra_options, target_font_identifier );
-    system(convert_cmd);
+    sprintf(convert_cmd, "convert %s +set modify-date +set create-date -trim %s %s_short.png", tga_filename, convert_extra_options, target_font_identifier );
+    convert_job_start(convert_cmd, tga_filename);
 
     u8x8_fnt_cnt++;
   }
@@ -2467,11 +2477,13 @@ void overviewshortpic(int i, int fm, char *fms, int bm, char *bms, int mm, char
     
     } while( u8g2_NextPage(&u8g2) );
 
-    tga_save("font.tga");
+    strcpy(tga_filename, target_font_identifier);
+    strcat(tga_filename, "_short.tga");
+    tga_save(tga_filename);
     
     /* remove date info, see https://legacy.imagemagick.org/discourse-server/viewtopic.php?t=12230 */
-    sprintf(convert_cmd, "convert font.tga +set modify-date +set create-date -trim %s %s_short.png", convert_extra_options, target_font_identifier );
-    system(convert_cmd);
+    sprintf(convert_cmd, "convert %s +set modify-date +set create-date -trim %s %s_short.png", tga_filename, convert_extra_options, target_font_identifier );
+    convert_job_start(convert_cmd, tga_filename);
 
     u8g2_fnt_cnt++;
   }
@@ -2633,8 +2645,468 @@ void do_font_list(cbfn_t cb)
 
 #endif
 
+/*===================================================================*/
+/* 
+  parallel, incremental bdfconv
+
+  bdfconv() only queues one job per font variant. build_jobs_run() then
+  starts otf2bdf/bdfconv with posix_spawn on as many fonts as there are
+  cores. Each job writes straight into single_font_files/<identifier>.c.
+  A job is skipped if the content hash of its inputs (command line, BDF 
+  or TTF file, map file, converter binaries) matches the hash stored for 
+  that output in build_hash_filename by the last successful run.
+  Finally the single font files are appended in the original order to 
+  u8g2_fonts.c and u8x8_fonts.c, so the result does not depend on the 
+  order in which the jobs finished.
+*/
+
+#define JOB_ARGS 64
+
+struct buildjob
+{
+  char *identifier;
+  int fm;
+  char *otf_cmd;		/* NULL for BDF fonts */
+  char *bdf_cmd;
+  char *tmp_bdf;
+  char *output;
+  uint64_t hash;
+  pid_t pid;
+  int stage;			/* 0: queued, 1: otf2bdf running, 2: bdfconv running, 3: done */
+  int failed;
+};
+
+struct filehash
+{
+  char *name;
+  uint64_t hash;
+};
+
+char *build_hash_filename = "single_font_files.hash";
+
+struct buildjob *build_jobs = NULL;
+int build_job_cnt = 0;
+int build_job_max = 0;
+
+struct filehash *file_hashes = NULL;	/* inputs already read, several fonts share one BDF */
+int file_hash_cnt = 0;
+
+struct filehash *old_hashes = NULL;	/* from build_hash_filename */
+int old_hash_cnt = 0;
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+uint64_t fnv_add(uint64_t h, const void *data, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  while( len-- > 0 )
+  {
+    h ^= *p++;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+/*
+  content hash of a file, 0 if it can not be read
+*/
+uint64_t file_hash(const char *name)
+{
+  static uint8_t buf[1<<16];
+  FILE *fp;
+  size_t len;
+  uint64_t h = FNV_OFFSET;
+  int i;
+  void *t;
+  
+  for( i = 0; i < file_hash_cnt; i++ )
+    if ( strcmp(file_hashes[i].name, name) == 0 )
+      return file_hashes[i].hash;
+  
+  fp = fopen(name, "rb");
+  if ( fp == NULL )
+    return 0;
+  while( (len = fread(buf, 1, sizeof(buf), fp)) > 0 )
+    h = fnv_add(h, buf, len);
+  fclose(fp);
+  
+  t = realloc(file_hashes, (file_hash_cnt+1)*sizeof(struct filehash));
+  if ( t != NULL )
+  {
+    file_hashes = (struct filehash *)t;
+    file_hashes[file_hash_cnt].name = strdup(name);
+    file_hashes[file_hash_cnt].hash = h;
+    file_hash_cnt++;
+  }
+  return h;
+}
+
+int filehash_cmp(const void *a, const void *b)
+{
+  return strcmp(((const struct filehash *)a)->name, ((const struct filehash *)b)->name);
+}
+
+void build_hash_read(void)
+{
+  static char line[1024];
+  static char name[1024];
+  unsigned long long h;
+  FILE *fp;
+  void *t;
+  
+  fp = fopen(build_hash_filename, "r");
+  if ( fp == NULL )
+    return;
+  while( fgets(line, sizeof(line), fp) != NULL )
+  {
+    if ( sscanf(line, "%llx %1023s", &h, name) != 2 )
+      continue;
+    t = realloc(old_hashes, (old_hash_cnt+1)*sizeof(struct filehash));
+    if ( t == NULL )
+      break;
+    old_hashes = (struct filehash *)t;
+    old_hashes[old_hash_cnt].name = strdup(name);
+    old_hashes[old_hash_cnt].hash = h;
+    old_hash_cnt++;
+  }
+  fclose(fp);
+  if ( old_hash_cnt > 0 )
+    qsort(old_hashes, old_hash_cnt, sizeof(struct filehash), filehash_cmp);
+}
+
+void build_hash_write(void)
+{
+  FILE *fp;
+  int i;
+  
+  fp = fopen(build_hash_filename, "w");
+  if ( fp == NULL )
+    return;
+  for( i = 0; i < build_job_cnt; i++ )
+    if ( build_jobs[i].failed == 0 )
+      fprintf(fp, "%016llx %s\n", (unsigned long long)build_jobs[i].hash, build_jobs[i].identifier);
+  fclose(fp);
+}
+
+int build_job_unchanged(struct buildjob *job)
+{
+  struct filehash key, *old;
+  FILE *fp;
+  
+  if ( old_hash_cnt == 0 )
+    return 0;
+  key.name = job->identifier;
+  old = (struct filehash *)bsearch(&key, old_hashes, old_hash_cnt, sizeof(struct filehash), filehash_cmp);
+  if ( old == NULL || old->hash != job->hash )
+    return 0;
+  fp = fopen(job->output, "r");
+  if ( fp == NULL )
+    return 0;
+  fclose(fp);
+  return 1;
+}
+
+/*
+  split a command line into argv, single quotes group words like in the shell
+*/
+int split_args(char *s, char **argv, int max)
+{
+  int argc = 0;
+  char *d;
+  
+  for(;;)
+  {
+    while( *s == ' ' )
+      s++;
+    if ( *s == '\0' || argc >= max-1 )
+      break;
+    argv[argc++] = d = s;
+    while( *s != '\0' && *s != ' ' )
+    {
+      if ( *s == '\'' )
+      {
+	s++;
+	while( *s != '\0' && *s != '\'' )
+	  *d++ = *s++;
+	if ( *s == '\'' )
+	  s++;
+      }
+      else
+      {
+	*d++ = *s++;
+      }
+    }
+    if ( *s != '\0' )
+      s++;
+    *d = '\0';
+  }
+  argv[argc] = NULL;
+  return argc;
+}
+
+pid_t spawn_cmd(const char *cmd)
+{
+  static char buf[2048];
+  char *argv[JOB_ARGS];
+  pid_t pid;
+  
+  strncpy(buf, cmd, sizeof(buf)-1);
+  buf[sizeof(buf)-1] = '\0';
+  if ( split_args(buf, argv, JOB_ARGS) == 0 )
+    return -1;
+  if ( posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ) != 0 )
+    return -1;
+  return pid;
+}
+
+#ifdef BUILD2
+/*
+  overview pictures: each picture is saved to its own TGA and converted
+  to PNG by a convert process in the background, at most one per core.
+  The TGA is removed when its convert has finished.
+*/
+
+struct convertjob
+{
+  pid_t pid;
+  char *tga;
+};
+
+struct convertjob *convert_jobs = NULL;
+int convert_job_cnt = 0;	/* running */
+int convert_job_max = 0;
+int convert_job_failed = 0;
+
+/*
+  wait for one convert, returns 0 if none was running
+*/
+int convert_job_wait(void)
+{
+  int i, status;
+  pid_t pid;
+  
+  while( convert_job_cnt > 0 )
+  {
+    pid = wait(&status);
+    if ( pid < 0 )
+    {
+      if ( errno == EINTR )
+	continue;
+      convert_job_cnt = 0;
+      return 0;
+    }
+    for( i = 0; i < convert_job_cnt; i++ )
+      if ( convert_jobs[i].pid == pid )
+	break;
+    if ( i == convert_job_cnt )
+      continue;
+    if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+    {
+      printf("convert %s failed\n", convert_jobs[i].tga);
+      convert_job_failed++;
+    }
+    unlink(convert_jobs[i].tga);
+    free(convert_jobs[i].tga);
+    convert_jobs[i] = convert_jobs[--convert_job_cnt];
+    return 1;
+  }
+  return 0;
+}
+
+void convert_job_start(const char *cmd, const char *tga)
+{
+  pid_t pid;
+  
+  if ( convert_jobs == NULL )
+  {
+    convert_job_max = sysconf(_SC_NPROCESSORS_ONLN);
+    if ( convert_job_max < 1 )
+      convert_job_max = 1;
+    convert_jobs = (struct convertjob *)malloc(convert_job_max*sizeof(struct convertjob));
+    assert( convert_jobs != NULL );
+  }
+  while( convert_job_cnt >= convert_job_max )
+    convert_job_wait();
+  
+  pid = spawn_cmd(cmd);
+  if ( pid < 0 )
+  {
+    printf("unable to start %s\n", cmd);
+    convert_job_failed++;
+    unlink(tga);
+    return;
+  }
+  convert_jobs[convert_job_cnt].pid = pid;
+  convert_jobs[convert_job_cnt].tga = strdup(tga);
+  convert_job_cnt++;
+}
+
+void convert_jobs_finish(void)
+{
+  while( convert_job_wait() )
+    ;
+  if ( convert_job_failed > 0 )
+    printf("%d pictures failed\n", convert_job_failed);
+}
+#endif
+
+void build_job_start(struct buildjob *job)
+{
+  if ( job->stage == 0 && job->otf_cmd != NULL )
+  {
+    job->stage = 1;
+    printf("%s\n", job->otf_cmd);
+    job->pid = spawn_cmd(job->otf_cmd);
+  }
+  else
+  {
+    job->stage = 2;
+    printf("%s\n", job->bdf_cmd);
+    job->pid = spawn_cmd(job->bdf_cmd);
+  }
+  if ( job->pid < 0 )
+  {
+    printf("%s: unable to start %s\n", job->identifier, job->stage == 1 ? otf2bdf_path : bdfconv_path);
+    job->failed = 1;
+    job->stage = 3;
+  }
+}
+
+/*
+  append src to dest, returns 0 on error
+*/
+int file_append(const char *source_file_name, const char *dest_file_name)
+{
+  static char buf[1<<16];
+  size_t len;
+  FILE *source_fp;
+  FILE *dest_fp;
+  
+  source_fp = fopen(source_file_name, "rb");
+  if ( source_fp == NULL )
+    return 0;
+  dest_fp = fopen(dest_file_name, "ab");
+  if ( dest_fp == NULL )
+  {
+    fclose(source_fp);
+    return 0;
+  }
+  while( (len = fread(buf, 1, sizeof(buf), source_fp)) > 0 )
+    fwrite(buf, 1, len, dest_fp);
+  fclose(source_fp);
+  fclose(dest_fp);
+  return 1;
+}
+
+void build_jobs_run(void)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int running = 0;
+  int next = 0;
+  int skipped = 0;
+  int failed = 0;
+  int i, status;
+  pid_t pid;
+  
+  if ( cores < 1 )
+    cores = 1;
+  
+  build_hash_read();
+  
+  while( next < build_job_cnt || running > 0 )
+  {
+    while( running < cores && next < build_job_cnt )
+    {
+      struct buildjob *job = build_jobs+next++;
+      if ( build_job_unchanged(job) )
+      {
+	job->stage = 3;
+	skipped++;
+	continue;
+      }
+      build_job_start(job);
+      if ( job->stage != 3 )
+	running++;
+    }
+    if ( running == 0 )
+      continue;
+    
+    pid = wait(&status);
+    if ( pid < 0 )
+    {
+      if ( errno == EINTR )
+	continue;
+      break;
+    }
+    for( i = 0; i < build_job_cnt; i++ )
+      if ( build_jobs[i].pid == pid && (build_jobs[i].stage == 1 || build_jobs[i].stage == 2) )
+	break;
+    if ( i == build_job_cnt )
+      continue;
+    
+    if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+    {
+      printf("%s: %s failed\n", build_jobs[i].identifier, build_jobs[i].stage == 1 ? otf2bdf_path : bdfconv_path);
+      build_jobs[i].failed = 1;
+      build_jobs[i].stage = 3;
+    }
+    else if ( build_jobs[i].stage == 1 )
+    {
+      build_job_start(build_jobs+i);
+      if ( build_jobs[i].stage == 2 )
+	continue;		/* still running */
+    }
+    else
+    {
+      build_jobs[i].stage = 3;
+    }
+    
+    if ( build_jobs[i].otf_cmd != NULL )
+      unlink(build_jobs[i].tmp_bdf);
+    running--;
+  }
+  
+  for( i = 0; i < build_job_cnt; i++ )
+  {
+    if ( build_jobs[i].failed )
+    {
+      failed++;
+      continue;
+    }
+    file_append(build_jobs[i].output, build_jobs[i].fm == FM_8 ? u8x8_fonts_filename : u8g2_fonts_filename);
+  }
+  
+  build_hash_write();
+  printf("%d fonts, %d unchanged, %d failed, %ld parallel jobs\n", build_job_cnt, skipped, failed, cores);
+}
+
 void bdfconv(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
 {
+  struct buildjob *job;
+  uint64_t h = FNV_OFFSET;
+  static char input[1024];
+  static char tmp_bdf[1100];
+  static char output[1100];
+  uint64_t fh;
+  
+  if ( build_job_cnt >= build_job_max )
+  {
+    void *t;
+    build_job_max = build_job_max ? build_job_max*2 : 1024;
+    t = realloc(build_jobs, build_job_max*sizeof(struct buildjob));
+    if ( t == NULL )
+    {
+      printf("out of memory\n");
+      exit(1);
+    }
+    build_jobs = (struct buildjob *)t;
+  }
+  job = build_jobs + build_job_cnt;
+  memset(job, 0, sizeof(struct buildjob));
+  
+  snprintf(tmp_bdf, sizeof(tmp_bdf), "tmp_%s.bdf", target_font_identifier);
+  snprintf(output, sizeof(output), "./single_font_files/%s.c", target_font_identifier);
   
   if ( fi[i].ttf_opt != NULL )
   {
@@ -2643,9 +3115,19 @@ void bdfconv(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
     strcat(otf_cmd, fi[i].ttf_opt);
     strcat(otf_cmd, " ../ttf/");
     strcat(otf_cmd, fi[i].filename);
-    strcat(otf_cmd, " -o tmp.bdf");
-    printf("%s\n", otf_cmd);
-    system(otf_cmd);
+    strcat(otf_cmd, " -o ");
+    strcat(otf_cmd, tmp_bdf);
+    
+    strcpy(input, "../ttf/");
+    strcat(input, fi[i].filename);
+    h = fnv_add(h, otf_cmd, strlen(otf_cmd)+1);
+    fh = file_hash(otf2bdf_path);
+    h = fnv_add(h, &fh, sizeof(fh));
+  }
+  else
+  {
+    strcpy(input, bdf_path);
+    strcat(input, fi[i].filename);
   }
   
   
@@ -2682,40 +3164,31 @@ void bdfconv(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
     strcat(bdf_cmd, " -M '");
     strcat(bdf_cmd, fi[i].map_custom);
     strcat(bdf_cmd, "'");
+    fh = file_hash(fi[i].map_custom);
+    h = fnv_add(h, &fh, sizeof(fh));
   }
 
   strcat(bdf_cmd, " ");
   if ( fi[i].ttf_opt != NULL )
   {
-    strcat(bdf_cmd, "tmp.bdf");
+    strcat(bdf_cmd, tmp_bdf);
   }
   else
   {
-    strcat(bdf_cmd, bdf_path);
-    strcat(bdf_cmd, fi[i].filename);
+    strcat(bdf_cmd, input);
   }
 
   strcat(bdf_cmd, " -n ");
   strcat(bdf_cmd, target_font_identifier);
 
   strcat(bdf_cmd, " -o ");
-  //strcat(bdf_cmd, target_font_identifier);
-  strcat(bdf_cmd, "font");
-  strcat(bdf_cmd, ".c");
+  strcat(bdf_cmd, output);
   
-  
-  /*
-  if ( fi[i].kerning_min_distance_per_cent > 0 )
-  {
-    strcat(bdf_cmd, " -k ");
-    strcat(bdf_cmd, target_font_identifier);
-    strcat(bdf_cmd, "_k.c");
-	  
-    strcat(bdf_cmd, " -p ");
-    sprintf(bdf_cmd+strlen(bdf_cmd), "%d", fi[i].kerning_min_distance_per_cent);
-	
-  }
-  */
+  h = fnv_add(h, bdf_cmd, strlen(bdf_cmd)+1);
+  fh = file_hash(input);
+  h = fnv_add(h, &fh, sizeof(fh));
+  fh = file_hash(bdfconv_path);
+  h = fnv_add(h, &fh, sizeof(fh));
   
 /*
     fprintf(out_fp, "const uint8_t %s[%d] U8X8_FONT_SECTION(\"%s\") \n", fontname, bf->target_cnt, fontname);
@@ -2728,8 +3201,6 @@ void bdfconv(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
 
   if ( fm == FM_8 ) 
   {
-    strcat(bdf_cmd, " && cat font.c >>");
-    strcat(bdf_cmd, u8x8_fonts_filename);
     strcat(font_prototype, " U8X8_FONT_SECTION(\"");    
     strcat(font_prototype, target_font_identifier);
     strcat(font_prototype, "\");\n");
@@ -2737,22 +3208,21 @@ void bdfconv(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
   }
   else
   {    
-    strcat(bdf_cmd, " && cat font.c >>");
-    strcat(bdf_cmd, u8g2_fonts_filename);
     strcat(font_prototype, " U8G2_FONT_SECTION(\"");    
     strcat(font_prototype, target_font_identifier);
     strcat(font_prototype, "\");\n");
     add_to_str(&u8g2_prototypes, font_prototype);
   }
 
-  printf("%s\n", bdf_cmd);
-  system(bdf_cmd);
-  
-  strcpy(bdf_cmd, "cp font.c ./single_font_files/");
-  strcat(bdf_cmd, target_font_identifier);
-  strcat(bdf_cmd, ".c");
-  system(bdf_cmd);
-  
+  job->identifier = strdup(target_font_identifier);
+  job->fm = fm;
+  job->otf_cmd = fi[i].ttf_opt != NULL ? strdup(otf_cmd) : NULL;
+  job->bdf_cmd = strdup(bdf_cmd);
+  job->tmp_bdf = strdup(tmp_bdf);
+  job->output = strdup(output);
+  job->hash = h;
+  job->pid = -1;
+  build_job_cnt++;
 }
 
 void fontlist_identifier(int i, int fm, char *fms, int bm, char *bms, int mm, char *mms)
@@ -3017,10 +3487,12 @@ void do_font_groups_wc(cbfn_t cb)
     } while( u8g2_NextPage(&u8g2) );
 
 
-    tga_save("font.tga");    
+    strcpy(tga_filename, gi[current_font_group_index].reference);
+    strcat(tga_filename, "_word_cloud.tga");
+    tga_save(tga_filename);    
      /* remove date info, see https://legacy.imagemagick.org/discourse-server/viewtopic.php?t=12230 */
-   sprintf(convert_cmd, "convert font.tga +set modify-date +set create-date -trim %s %s_word_cloud.png", convert_extra_options, gi[current_font_group_index].reference );
-    system(convert_cmd);
+   sprintf(convert_cmd, "convert %s +set modify-date +set create-date -trim %s %s_word_cloud.png", tga_filename, convert_extra_options, gi[current_font_group_index].reference );
+    convert_job_start(convert_cmd, tga_filename);
 
     
     printf("Group end %s\n", gi[current_font_group_index].reference);
@@ -3047,6 +3519,7 @@ int main(void)
   
   
   do_font_loop(bdfconv);
+  build_jobs_run();
   
   u8g2_font_list_fp = fopen("u8g2_font_list.c", "w");
   u8x8_font_list_fp  = fopen("u8x8_font_list.c", "w");
@@ -3076,7 +3549,6 @@ int main(void)
   printf("update u8x8.h\n");
   insert_into_file("../../../csrc/u8x8.h", u8x8_prototypes, "/* start font list */", "/* end font list */");
 
-  unlink("font.c");
   
   
   do_font_groups(generate_font_group_md);
@@ -3093,6 +3565,7 @@ int main(void)
   do_font_list(generate_font_list);
 
   do_font_groups_wc(generate_font_group_word_cloud);
+  convert_jobs_finish();
   
 #endif
 
@@ -36,6 +36,29 @@
 
   http://www.libpng.org/pub/png/libpng-manual.txt 
 
+  Batch mode (-b) converts all png files of a directory with several threads
+  and writes for each file:
+
+    name.bin	same as the single file mode
+    name.xbm	XBM image for u8g2_DrawXBM()
+    name.tiles	tile width, tile height (one byte each), then the image in the
+		vertical top lsb page layout (each byte is a column of 8 pixels,
+		bit 0 on top, one tile row after the other), ready for
+		u8x8_DrawTile() or a memcpy() into the u8g2 buffer of a
+		vertical top lsb display (SSD13xx, ST7565, ST7567, ...)
+
+  With -a all png files of the directory are also the frames of an animation,
+  in natural name order (frame2.png before frame10.png), all of the same size:
+
+    anim.anim	tile width, tile height (one byte each), frame count (two bytes, high byte first)
+		then for each frame:
+		  number of tile runs (two bytes, high byte first)
+		  for each run: tile x, tile y, tile count (one byte each), count*8 bytes tile data
+
+  The runs of a frame contain the tiles which differ from the previous frame
+  (the first frame is compared to an empty display), each run can be passed
+  to u8x8_DrawTile(u8x8, x, y, count, data) directly.
+
 */
 
 #include <unistd.h>
@@ -44,262 +67,763 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #define PNG_DEBUG 3
 #include <png.h>
 
+#define DITHER_NONE 0
+#define DITHER_ORDERED 1
+#define DITHER_FS 2
+
 /*================================================*/
 int is_invert = 0;
 int is_16bit = 0;
 int is_preview = 0;
+int is_batch = 0;
+int dither_mode = DITHER_NONE;
+int thread_cnt = 0;
+const char *anim_name = NULL;
 
 
 /*================================================*/
 
-int width, height;
+struct image
+{
+  char *name;			/* file name without path and extension, batch mode */
+  int width, height;
+  int pw, ph;			/* width and height rounded up to a multiple of 8 */
+  png_byte color_type;
+  uint8_t *gray;			/* width*height gray values, alpha is ignored */
+  uint8_t *bits;			/* pw*ph pixel, 0 or 1, zero outside of the image */
+  uint8_t *pages;		/* pw*ph/8 bytes, vertical top lsb page layout */
+  int is_ok;
+};
+
+void print_short_info(const char* file_name, struct image *img)
+{
+  printf("%s rgb=%s alpha=%s w=%d h=%d\n",
+    file_name,
+    img->color_type&2?"no":"yes",
+    img->color_type&4?"no":"yes",
+    img->width, img->height);
+}
 
-png_byte color_type;
-png_byte bit_depth;
-uint8_t min, max;
+/*================================================*/
+/*
+  row kernels
 
-png_structp png_ptr;
-png_infop info_ptr;
-png_bytep * row_pointers;
+  There is no dependency between the pixels within these loops, gcc
+  vectorizes them with -O2 -ftree-vectorize (check with -fopt-info-vec).
+  Plain C instead of intrinsics, so that png2bin still builds for all
+  targets.
+*/
 
-void print_info(const char* file_name)
+/* threshold: legacy conversion, pixel is set for gray > 64 */
+static void row_threshold(const uint8_t *gray, uint8_t *bits, int w, uint8_t t, uint8_t inv)
 {
-  printf("%s: png_get_image_width(png_ptr, info_ptr)=%d\n", file_name, png_get_image_width(png_ptr, info_ptr));
-  printf("%s: png_get_image_height(png_ptr, info_ptr)=%d\n", file_name, png_get_image_height(png_ptr, info_ptr));
-
-  /*
-#define PNG_COLOR_MASK_PALETTE    1
-#define PNG_COLOR_MASK_COLOR      2
-#define PNG_COLOR_MASK_ALPHA      4
-  
-#define PNG_COLOR_TYPE_GRAY 0
-#define PNG_COLOR_TYPE_PALETTE  (PNG_COLOR_MASK_COLOR | PNG_COLOR_MASK_PALETTE)
-#define PNG_COLOR_TYPE_RGB        (PNG_COLOR_MASK_COLOR)
-#define PNG_COLOR_TYPE_RGB_ALPHA  (PNG_COLOR_MASK_COLOR | PNG_COLOR_MASK_ALPHA)
-#define PNG_COLOR_TYPE_GRAY_ALPHA (PNG_COLOR_MASK_ALPHA)
-*/
-  
-  printf("%s: png_get_color_type(png_ptr, info_ptr)=%d\n", file_name, png_get_color_type(png_ptr, info_ptr));
-  printf("%s: png_get_bit_depth(png_ptr, info_ptr)=%d\n", file_name, png_get_bit_depth(png_ptr, info_ptr));
-  printf("%s: png_get_rowbytes(png_ptr, info_ptr)=%lu\n", file_name, png_get_rowbytes(png_ptr, info_ptr));
-  printf("%s: range: %d .. %d\n", file_name, min, max);
-  
+  int x;
+  for( x = 0; x < w; x++ )
+    bits[x] = (gray[x] > t) ^ inv;
 }
 
-void print_short_info(const char* file_name)
+/* ordered: t contains the threshold for each pixel of the row */
+static void row_ordered(const uint8_t *gray, uint8_t *bits, int w, const uint8_t *t, uint8_t inv)
 {
-  printf("%s rgb=%s alpha=%s w=%d h=%d\n", 
-    file_name, 
-    color_type&2?"no":"yes", 
-    color_type&4?"no":"yes", 
-    width, height);
+  int x;
+  for( x = 0; x < w; x++ )
+    bits[x] = (gray[x] > t[x]) ^ inv;
 }
 
-uint8_t get_gray(int x, int y)
+/*
+  Floyd-Steinberg, part 1: quantize the row, err contains the error from the
+  previous row. Only the 7/16 to the right neighbour has to be carried in
+  this serial loop. q[x+1] receives the quantization error of pixel x.
+*/
+static void row_fs_quantize(const uint8_t *gray, const int16_t *err, int16_t *q, uint8_t *bits, int w, uint8_t inv)
 {
-  
-  uint8_t *p;
-  uint8_t g;
-  if ( color_type & PNG_COLOR_MASK_ALPHA )    
+  int x;
+  int v;
+  int carry = 0;
+  for( x = 0; x < w; x++ )
   {
-    p = row_pointers[y] + x*4;
-    g = ((int)p[0] + (int)p[1] + (int)p[2])/3;  
-    //g = ((int)g+(int)p[3])/2;
-    return g;
+    v = gray[x] + err[x] + carry;
+    if ( v > 127 )
+    {
+      bits[x] = 1 ^ inv;
+      v -= 255;
+    }
+    else
+    {
+      bits[x] = inv;
+    }
+    q[x+1] = v;
+    carry = (v*7) >> 4;
   }
-  p = row_pointers[y] + x*3;
-  return ((int)p[0] + (int)p[1] + (int)p[2])/3;  
 }
 
-uint8_t get_pixel(int x, int y)
+/* Floyd-Steinberg, part 2: 3/16, 5/16 and 1/16 of the errors go to the next row */
+static void row_fs_diffuse(const int16_t *q, int16_t *err, int w)
 {
-  if ( x < 0 )
-    return 0;
-  if ( x >= width )
-    return 0;
-  if ( y < 0 )
-    return 0;
-  if ( y >= height )
-    return 0;
-  if ( get_gray(x, y) > 128/2 )
-    return is_invert == 0 ? 1 : 0;
-  return is_invert == 0 ? 0 : 1;
+  int x;
+  for( x = 0; x < w; x++ )
+    err[x] = (3*q[x+2] + 5*q[x+1] + q[x]) >> 4;
 }
 
-uint8_t get_pixel_byte(int x, int y)
+/* pack 8 pixel into one byte, lsb is the leftmost pixel (XBM and bin format) */
+static void row_pack_lsb(const uint8_t *bits, uint8_t *out, int bytes)
 {
-  uint8_t b = 0;
   int i;
-  for( i = 0; i < 8; i++ )
+  for( i = 0; i < bytes; i++ )
+    out[i] = bits[i*8+0] | (bits[i*8+1]<<1) | (bits[i*8+2]<<2) | (bits[i*8+3]<<3) |
+      (bits[i*8+4]<<4) | (bits[i*8+5]<<5) | (bits[i*8+6]<<6) | (bits[i*8+7]<<7);
+}
+
+/* add row k (0..7) of a tile row to the page */
+static void row_to_page(const uint8_t *bits, uint8_t *page, int w, int k)
+{
+  int x;
+  for( x = 0; x < w; x++ )
+    page[x] |= bits[x] << k;
+}
+
+/*================================================*/
+
+static const uint8_t bayer8[8][8] =
+{
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+/* fill img->bits and img->pages from img->gray, returns 0 for out of memory */
+int convert_image(struct image *img)
+{
+  int x, y, k;
+  uint8_t inv = is_invert ? 1 : 0;
+  uint8_t *t = NULL;
+  int16_t *err = NULL;
+  int16_t *q = NULL;
+
+  img->pw = (img->width+7) & ~7;
+  img->ph = (img->height+7) & ~7;
+  img->bits = (uint8_t *)calloc((size_t)img->pw*img->ph, 1);
+  img->pages = (uint8_t *)calloc((size_t)img->pw*img->ph/8, 1);
+  if ( img->bits == NULL || img->pages == NULL )
+    return 0;
+
+  if ( dither_mode == DITHER_ORDERED )
   {
-      b |= get_pixel(x + i,y)<<i;  // lsb contains the leftmost pixel
+    /* one threshold row for each of the 8 rows of the matrix */
+    t = (uint8_t *)malloc((size_t)img->width*8);
+    if ( t == NULL )
+      return 0;
+    for( y = 0; y < 8; y++ )
+      for( x = 0; x < img->width; x++ )
+	t[y*img->width+x] = bayer8[y][x&7]*4+2;
   }
-  return b;
+  else if ( dither_mode == DITHER_FS )
+  {
+    err = (int16_t *)calloc(img->width, sizeof(int16_t));
+    q = (int16_t *)calloc(img->width+2, sizeof(int16_t));
+    if ( err == NULL || q == NULL )
+    {
+      free(err);
+      return free(q), 0;
+    }
+  }
+
+  for( y = 0; y < img->height; y++ )
+  {
+    const uint8_t *gray = img->gray + (size_t)y*img->width;
+    uint8_t *bits = img->bits + (size_t)y*img->pw;
+    if ( dither_mode == DITHER_ORDERED )
+    {
+      row_ordered(gray, bits, img->width, t + (y&7)*img->width, inv);
+    }
+    else if ( dither_mode == DITHER_FS )
+    {
+      row_fs_quantize(gray, err, q, bits, img->width, inv);
+      row_fs_diffuse(q, err, img->width);
+    }
+    else
+    {
+      row_threshold(gray, bits, img->width, 128/2, inv);
+    }
+  }
+  free(t);
+  free(err);
+  free(q);
+
+  for( y = 0; y < img->ph; y += 8 )
+    for( k = 0; k < 8; k++ )
+      row_to_page(img->bits + (size_t)(y+k)*img->pw, img->pages + (size_t)y/8*img->pw, img->pw, k);
+  return 1;
 }
 
+void free_image(struct image *img)
+{
+  free(img->name);
+  free(img->gray);
+  free(img->bits);
+  free(img->pages);
+  img->name = NULL;
+  img->gray = NULL;
+  img->bits = NULL;
+  img->pages = NULL;
+}
 
+/*================================================*/
 
-void write_bdf_bitmap(const char *filename)
+int write_bdf_bitmap(const char *filename, struct image *img)
 {
-  int x, y;
+  int y;
   FILE *bin_fp;
+  uint8_t row[img->pw/8];
+
   bin_fp = fopen(filename, "wb");
-  
   if ( bin_fp == NULL )
   {
     perror(filename);
-    return;
+    return 0;
   }
-  
+
   if ( is_16bit )
   {
-    fputc(width>>8, bin_fp);
-    fputc(width&255, bin_fp);
-    fputc(height>>8, bin_fp);
-    fputc(height&255, bin_fp);
+    fputc(img->width>>8, bin_fp);
+    fputc(img->width&255, bin_fp);
+    fputc(img->height>>8, bin_fp);
+    fputc(img->height&255, bin_fp);
   }
   else
   {
-    fputc(width, bin_fp);
-    fputc(height, bin_fp);
+    fputc(img->width, bin_fp);
+    fputc(img->height, bin_fp);
   }
-  
-  
-  for( y = 0; y < height; y++ )
+
+  for( y = 0; y < img->height; y++ )
+  {
+    row_pack_lsb(img->bits + (size_t)y*img->pw, row, img->pw/8);
+    fwrite(row, 1, img->pw/8, bin_fp);
+  }
+
+  fclose(bin_fp);
+  return 1;
+}
+
+int write_xbm(const char *filename, struct image *img)
+{
+  int y, i, n;
+  FILE *fp;
+  uint8_t row[img->pw/8];
+
+  fp = fopen(filename, "w");
+  if ( fp == NULL )
   {
-    x = 0;
-    while( x < width )
+    perror(filename);
+    return 0;
+  }
+
+  fprintf(fp, "#define %s_width %d\n", img->name, img->width);
+  fprintf(fp, "#define %s_height %d\n", img->name, img->height);
+  fprintf(fp, "static unsigned char %s_bits[] = {", img->name);
+  n = 0;
+  for( y = 0; y < img->height; y++ )
+  {
+    row_pack_lsb(img->bits + (size_t)y*img->pw, row, img->pw/8);
+    for( i = 0; i < img->pw/8; i++ )
     {
-      fputc(get_pixel_byte(x,y), bin_fp);
-      x+=8;
+      fprintf(fp, "%s%s0x%02x", n == 0 ? "" : ",", n % 12 == 0 ? "\n   " : " ", row[i]);
+      n++;
     }
-  }  
-  
-  fclose(bin_fp);
+  }
+  fprintf(fp, " };\n");
+
+  fclose(fp);
+  return 1;
 }
 
+int write_tiles(const char *filename, struct image *img)
+{
+  FILE *fp;
 
-void show_ascii(void)
+  if ( img->pw/8 > 255 || img->ph/8 > 255 )
+  {
+    printf("%s: image too large for u8x8 tiles\n", filename);
+    return 0;
+  }
+  fp = fopen(filename, "wb");
+  if ( fp == NULL )
+  {
+    perror(filename);
+    return 0;
+  }
+  fputc(img->pw/8, fp);
+  fputc(img->ph/8, fp);
+  fwrite(img->pages, 1, (size_t)img->pw*img->ph/8, fp);
+  fclose(fp);
+  return 1;
+}
+
+/* tile (tx,ty) of the page layout, 8 bytes */
+static const uint8_t *get_tile(struct image *img, int tx, int ty)
 {
-  int x, y;
-  for( y = 0; y < height; y++ )
+  return img->pages + (size_t)ty*img->pw + tx*8;
+}
+
+int write_anim(const char *filename, struct image *frames, int cnt)
+{
+  FILE *fp;
+  int f, tx, ty, x, tw, th;
+  int run_cnt, tile_cnt;
+  long run_cnt_pos, end_pos;
+  uint8_t *empty;
+  struct image *prev;
+
+  tw = frames[0].pw/8;
+  th = frames[0].ph/8;
+  for( f = 1; f < cnt; f++ )
+  {
+    if ( frames[f].width != frames[0].width || frames[f].height != frames[0].height )
+    {
+      printf("%s: frame %s has a different size than %s\n", filename, frames[f].name, frames[0].name);
+      return 0;
+    }
+  }
+  if ( tw > 255 || th > 255 || cnt > 0x0ffff )
+  {
+    printf("%s: too many tiles or frames\n", filename);
+    return 0;
+  }
+
+  fp = fopen(filename, "wb");
+  if ( fp == NULL )
+  {
+    perror(filename);
+    return 0;
+  }
+  fputc(tw, fp);
+  fputc(th, fp);
+  fputc(cnt>>8, fp);
+  fputc(cnt&255, fp);
+
+  /* the first frame is compared to an empty display */
+  empty = (uint8_t *)calloc((size_t)frames[0].pw*frames[0].ph/8, 1);
+  if ( empty == NULL )
+    return fclose(fp), 0;
+  struct image blank = frames[0];
+  blank.pages = empty;
+
+  tile_cnt = 0;
+  for( f = 0; f < cnt; f++ )
   {
-    for( x = 0; x < width; x++ )
+    prev = f == 0 ? &blank : &frames[f-1];
+    run_cnt = 0;
+    run_cnt_pos = ftell(fp);
+    fputc(0, fp);
+    fputc(0, fp);
+    for( ty = 0; ty < th; ty++ )
     {
-      if ( is_invert )
+      tx = 0;
+      while( tx < tw )
       {
-	if ( get_gray(x, y) <= 128/2 )
-	  printf("#");
-	else
-	  printf(".");
+	if ( memcmp(get_tile(&frames[f], tx, ty), get_tile(prev, tx, ty), 8) == 0 )
+	{
+	  tx++;
+	  continue;
+	}
+	/* a run of changed tiles, an unchanged tile always costs more than a new run */
+	x = tx;
+	while( x < tw && x-tx < 255 && memcmp(get_tile(&frames[f], x, ty), get_tile(prev, x, ty), 8) != 0 )
+	  x++;
+	fputc(tx, fp);
+	fputc(ty, fp);
+	fputc(x-tx, fp);
+	fwrite(get_tile(&frames[f], tx, ty), 1, (x-tx)*8, fp);
+	tile_cnt += x-tx;
+	run_cnt++;
+	tx = x;
       }
+    }
+    end_pos = ftell(fp);
+    fseek(fp, run_cnt_pos, SEEK_SET);
+    fputc(run_cnt>>8, fp);
+    fputc(run_cnt&255, fp);
+    fseek(fp, end_pos, SEEK_SET);
+  }
+  free(empty);
+
+  printf("%s: %d frames, %d of %d tiles written\n", filename, cnt, tile_cnt, cnt*tw*th);
+  fclose(fp);
+  return 1;
+}
+
+/*================================================*/
+
+void show_ascii(struct image *img)
+{
+  int x, y;
+  for( y = 0; y < img->height; y++ )
+  {
+    for( x = 0; x < img->width; x++ )
+    {
+      if ( img->bits[(size_t)y*img->pw+x] )
+	printf("#");
       else
+	printf(".");
+    }
+    printf("\n");
+  }
+}
+
+/* read a png file into img->gray, returns 0 on error, thread safe */
+int load_png(const char* file_name, struct image *img)
+{
+  unsigned char header[8];    // 8 is the maximum size that can be checked
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_bytep * row_pointers;
+  uint8_t *p;
+  int x, y, bpp;
+
+  /* open file and test for it being a png */
+  FILE *fp = fopen(file_name, "rb");
+  if (fp == NULL)
+  {
+    perror(file_name);
+    return 0;	/* open error */
+  }
+  if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8))
+    return fclose(fp), 0;		/* not a png file error */
+
+  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png_ptr == NULL)
+    return fclose(fp), 0;		/* alloc read struct */
+
+  info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL )
+  {
+    png_destroy_read_struct(&png_ptr, NULL, NULL);
+    return fclose(fp), 0;		/* alloc info struct */
+  }
+
+  if (setjmp(png_jmpbuf(png_ptr)))
+  {
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+    return fclose(fp), 0;		/* library error */
+  }
+
+  png_init_io(png_ptr, fp);
+  png_set_sig_bytes(png_ptr, 8);
+  png_read_png(png_ptr, info_ptr,
+    PNG_TRANSFORM_SCALE_16|
+    //PNG_TRANSFORM_STRIP_ALPHA|
+    PNG_TRANSFORM_PACKING|
+    //PNG_TRANSFORM_INVERT_ALPHA |
+    //PNG_TRANSFORM_INVERT_MONO |
+    PNG_TRANSFORM_GRAY_TO_RGB
+    , NULL);
+
+  img->width = png_get_image_width(png_ptr, info_ptr);
+  img->height = png_get_image_height(png_ptr, info_ptr);
+  img->color_type = png_get_color_type(png_ptr, info_ptr);
+  row_pointers = png_get_rows(png_ptr, info_ptr);
+
+  bpp = img->color_type & PNG_COLOR_MASK_ALPHA ? 4 : 3;
+  img->gray = (uint8_t *)malloc((size_t)img->width*img->height);
+  if ( img->gray != NULL )
+  {
+    for( y = 0; y < img->height; y++ )
+    {
+      p = row_pointers[y];
+      for( x = 0; x < img->width; x++ )
       {
-	if ( get_gray(x, y) > 128/2 )
-	  printf("#");
-	else
-	  printf(".");
+	img->gray[(size_t)y*img->width+x] = ((int)p[0] + (int)p[1] + (int)p[2])/3;
+	p += bpp;
       }
     }
-    printf("\n");
   }
+
+  png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+  fclose(fp);
+  return img->gray != NULL;
 }
 
+int read_png_file(const char* file_name, const char* bin_name)
+{
+  struct image img;
+  int ok = 0;
+
+  memset(&img, 0, sizeof(img));
+  if ( load_png(file_name, &img) && convert_image(&img) )
+  {
+    print_short_info(file_name, &img);
+    if ( is_preview )
+      show_ascii(&img);
+    ok = write_bdf_bitmap(bin_name, &img);
+  }
+  free_image(&img);
+  return ok;
+}
 
-void calc_min_max(void)
+/*================================================*/
+/* batch mode */
+
+struct batch
 {
-  int x, y;
-  uint8_t val;
-  min = 255;
-  max = 0;
-  for( y = 0; y < height; y++ )
+  const char *in_dir;
+  const char *out_dir;
+  char **files;
+  struct image *images;
+  int cnt;
+  int next;
+  pthread_mutex_t lock;
+};
+
+/* natural order: digit sequences are compared as numbers */
+static int natural_cmp(const void *a, const void *b)
+{
+  const char *s = *(const char **)a;
+  const char *t = *(const char **)b;
+  while( *s != '\0' && *t != '\0' )
   {
-    for( x = 0; x < width; x++ )
+    if ( isdigit((unsigned char)*s) && isdigit((unsigned char)*t) )
     {
-      val = get_gray(x, y);
-      if ( max < val )
-	max = val;
-      if ( min > val )
-	min = val;
+      const char *s0, *t0;
+      while( *s == '0' ) s++;
+      while( *t == '0' ) t++;
+      s0 = s;
+      t0 = t;
+      while( isdigit((unsigned char)*s) ) s++;
+      while( isdigit((unsigned char)*t) ) t++;
+      if ( s-s0 != t-t0 )
+	return (int)(s-s0) - (int)(t-t0);
+      if ( strncmp(s0, t0, s-s0) != 0 )
+	return strncmp(s0, t0, s-s0);
+      continue;
     }
+    if ( *s != *t )
+      return (unsigned char)*s - (unsigned char)*t;
+    s++;
+    t++;
   }
+  return (unsigned char)*s - (unsigned char)*t;
 }
 
-int read_png_file(const char* file_name, const char* bin_name)
+static int is_png_name(const char *name)
 {
-        unsigned char header[8];    // 8 is the maximum size that can be checked
+  size_t len = strlen(name);
+  if ( len <= 4 )
+    return 0;
+  name += len-4;
+  return name[0] == '.' && tolower((unsigned char)name[1]) == 'p' && tolower((unsigned char)name[2]) == 'n' && tolower((unsigned char)name[3]) == 'g';
+}
 
-        /* open file and test for it being a png */
-        FILE *fp = fopen(file_name, "rb");
-        if (fp == NULL)
-	{
-	  perror(file_name);
-	  return 0;	/* open error */
-	}
-        fread(header, 1, 8, fp);
-        if (png_sig_cmp(header, 0, 8))
-	  return fclose(fp), 0;		/* not a png file error */
+/* file name without extension as C identifier */
+static char *get_identifier(const char *file)
+{
+  char *s = strdup(file);
+  char *p;
+  if ( s == NULL )
+    return NULL;
+  s[strlen(s)-4] = '\0';
+  for( p = s; *p != '\0'; p++ )
+    if ( !isalnum((unsigned char)*p) )
+      *p = '_';
+  if ( isdigit((unsigned char)s[0]) )
+    s[0] = '_';
+  return s;
+}
 
-        png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-        if (png_ptr == NULL)
-	  return fclose(fp), 0;		/* alloc read struct */
+static void *batch_thread(void *arg)
+{
+  struct batch *b = (struct batch *)arg;
+  struct image *img;
+  char path[1024];
+  int i;
 
-        info_ptr = png_create_info_struct(png_ptr);
-        if (info_ptr == NULL )
-	  return fclose(fp), 0;		/* alloc info struct */
+  for(;;)
+  {
+    pthread_mutex_lock(&b->lock);
+    i = b->next++;
+    pthread_mutex_unlock(&b->lock);
+    if ( i >= b->cnt )
+      break;
 
-        if (setjmp(png_jmpbuf(png_ptr)))
-	{
-	    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
-	    return fclose(fp), 0;		/* library error */	  
-	}
+    img = &b->images[i];
+    snprintf(path, sizeof(path), "%s/%s", b->in_dir, b->files[i]);
+    img->name = get_identifier(b->files[i]);
+    if ( img->name == NULL || load_png(path, img) == 0 || convert_image(img) == 0 )
+    {
+      printf("%s: conversion failed\n", path);
+      continue;
+    }
+    free(img->gray);
+    img->gray = NULL;
+
+    snprintf(path, sizeof(path), "%s/%s.bin", b->out_dir, img->name);
+    img->is_ok = write_bdf_bitmap(path, img);
+    snprintf(path, sizeof(path), "%s/%s.xbm", b->out_dir, img->name);
+    img->is_ok &= write_xbm(path, img);
+    snprintf(path, sizeof(path), "%s/%s.tiles", b->out_dir, img->name);
+    img->is_ok &= write_tiles(path, img);
+
+    free(img->bits);
+    img->bits = NULL;
+    if ( anim_name == NULL )
+    {
+      free(img->pages);
+      img->pages = NULL;
+    }
+  }
+  return NULL;
+}
 
-        png_init_io(png_ptr, fp);
-        png_set_sig_bytes(png_ptr, 8);
-        png_read_png(png_ptr, info_ptr, 
-	  PNG_TRANSFORM_SCALE_16|
-	  //PNG_TRANSFORM_STRIP_ALPHA|
-	  PNG_TRANSFORM_PACKING|
-	  //PNG_TRANSFORM_INVERT_ALPHA |
-	  //PNG_TRANSFORM_INVERT_MONO | 
-	  PNG_TRANSFORM_GRAY_TO_RGB
-	  , NULL);
-
-        width = png_get_image_width(png_ptr, info_ptr);
-        height = png_get_image_height(png_ptr, info_ptr);
-        color_type = png_get_color_type(png_ptr, info_ptr);
-        bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-	row_pointers = png_get_rows(png_ptr, info_ptr);
-	      
-	//calc_min_max();
-	//print_info(file_name);
-	print_short_info(file_name);
-	if ( is_preview )
-	  show_ascii();
-	write_bdf_bitmap(bin_name);
-	
-	 
-	png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
-	fclose(fp);
-	
-	return 1;
-	
+static int get_thread_cnt(void)
+{
+  long n = 1;
+  if ( thread_cnt > 0 )
+    return thread_cnt;
+#ifdef _SC_NPROCESSORS_ONLN
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if ( n < 1 )
+    n = 1;
+  return n > 64 ? 64 : (int)n;
+}
+
+int convert_dir(const char *in_dir, const char *out_dir)
+{
+  struct batch b;
+  DIR *dir;
+  struct dirent *de;
+  pthread_t threads[64];
+  int i, n, started, ok_cnt;
+  int max = 0;
+  int ret = 0;
+  char path[1024];
+  clock_t c = clock();
+  time_t t0 = time(NULL);
+
+  memset(&b, 0, sizeof(b));
+  b.in_dir = in_dir;
+  b.out_dir = out_dir;
+  pthread_mutex_init(&b.lock, NULL);
+
+  dir = opendir(in_dir);
+  if ( dir == NULL )
+  {
+    perror(in_dir);
+    return 0;
+  }
+  while( (de = readdir(dir)) != NULL )
+  {
+    if ( !is_png_name(de->d_name) )
+      continue;
+    if ( b.cnt >= max )
+    {
+      char **files;
+      max = max*2 + 64;
+      files = (char **)realloc(b.files, max*sizeof(char *));
+      if ( files == NULL )
+	break;
+      b.files = files;
+    }
+    b.files[b.cnt] = strdup(de->d_name);
+    if ( b.files[b.cnt] == NULL )
+      break;
+    b.cnt++;
+  }
+  closedir(dir);
+
+  if ( b.cnt == 0 )
+  {
+    printf("%s: no png files\n", in_dir);
+    goto out;
+  }
+  qsort(b.files, b.cnt, sizeof(char *), natural_cmp);
+
+#ifdef _WIN32
+  mkdir(out_dir);
+#else
+  mkdir(out_dir, 0777);
+#endif
+
+  b.images = (struct image *)calloc(b.cnt, sizeof(struct image));
+  if ( b.images == NULL )
+    goto out;
+
+  n = get_thread_cnt();
+  if ( n > b.cnt )
+    n = b.cnt;
+  for( started = 0; started < n; started++ )
+    if ( pthread_create(&threads[started], NULL, batch_thread, &b) != 0 )
+      break;
+  if ( started == 0 )
+    batch_thread(&b);
+  for( i = 0; i < started; i++ )
+    pthread_join(threads[i], NULL);
+
+  ok_cnt = 0;
+  for( i = 0; i < b.cnt; i++ )
+    ok_cnt += b.images[i].is_ok;
+  printf("%s: %d of %d png files converted to %s, %d threads, %.2lf sec cpu, %ld sec\n",
+    in_dir, ok_cnt, b.cnt, out_dir, started, (double)(clock()-c)/(double)CLOCKS_PER_SEC, (long)(time(NULL)-t0));
+  ret = ok_cnt == b.cnt;
+
+  if ( anim_name != NULL )
+  {
+    if ( ok_cnt != b.cnt )
+    {
+      printf("%s.anim: not written, some frames failed\n", anim_name);
+      ret = 0;
+    }
+    else
+    {
+      snprintf(path, sizeof(path), "%s/%s.anim", out_dir, anim_name);
+      ret &= write_anim(path, b.images, b.cnt);
+    }
+  }
+
+out:
+  for( i = 0; i < b.cnt; i++ )
+  {
+    if ( b.images != NULL )
+      free_image(&b.images[i]);
+    free(b.files[i]);
+  }
+  free(b.images);
+  free(b.files);
+  pthread_mutex_destroy(&b.lock);
+  return ret;
 }
 
+/*================================================*/
+
 void help(void)
 {
   printf("png2bin [options] png-file bin-file\n");
+  printf("png2bin -b [options] png-dir out-dir\n");
   printf("Convert a png image to a binary \"XBM\" image, prefixed by hieght and length value.\n");
   printf("png-file format: RGB, gray, 1-bit index are supported, alpha channel is ignored, \n");
   printf("options:\n");
   printf("  -i         Invert image\n");
   printf("  -p         Preview image as ASCII art\n");
   printf("  -2         Two byte heigh/length value (16 bit values instead of 8 bit values, high byte first)\n");
-  
+  printf("  -d <mode>  Conversion to black and white: 'none' (gray > 64, default), 'ordered' (8x8 Bayer matrix), 'fs' (Floyd-Steinberg)\n");
+  printf("  -b         Batch mode: convert all png files of png-dir to .bin, .xbm and .tiles (vertical top lsb pages) in out-dir\n");
+  printf("  -j <n>     Batch mode: number of threads (default: number of cpus)\n");
+  printf("  -a <name>  Batch mode: all png files are frames of an animation, write delta encoded tile updates to <name>.anim\n");
+
 }
 
 
@@ -313,37 +837,77 @@ int main(int argc, char **argv)
   argc--; argv++;
   for(;;)
   {
-    if ( argv[0][0] == '-' )
+    if ( argv[0] != NULL && argv[0][0] == '-' )
     {
       if ( strcmp(argv[0], "-i") == 0 )
       {
 	argc--; argv++;
-	is_invert = 1;	
+	is_invert = 1;
       }
-      if ( strcmp(argv[0], "-2") == 0 )
+      else if ( strcmp(argv[0], "-2") == 0 )
       {
 	argc--; argv++;
 	is_16bit = 1;
       }
-      if ( strcmp(argv[0], "-p") == 0 )
+      else if ( strcmp(argv[0], "-p") == 0 )
       {
 	argc--; argv++;
 	is_preview = 1;
       }
-    }      
+      else if ( strcmp(argv[0], "-b") == 0 )
+      {
+	argc--; argv++;
+	is_batch = 1;
+      }
+      else if ( strcmp(argv[0], "-j") == 0 && argv[1] != NULL )
+      {
+	thread_cnt = atoi(argv[1]);
+	argc-=2; argv+=2;
+      }
+      else if ( strcmp(argv[0], "-a") == 0 && argv[1] != NULL )
+      {
+	anim_name = argv[1];
+	argc-=2; argv+=2;
+      }
+      else if ( strcmp(argv[0], "-d") == 0 && argv[1] != NULL )
+      {
+	if ( strcmp(argv[1], "none") == 0 )
+	  dither_mode = DITHER_NONE;
+	else if ( strcmp(argv[1], "ordered") == 0 )
+	  dither_mode = DITHER_ORDERED;
+	else if ( strcmp(argv[1], "fs") == 0 )
+	  dither_mode = DITHER_FS;
+	else
+	{
+	  help();
+	  return 1;
+	}
+	argc-=2; argv+=2;
+      }
+      else
+      {
+	help();
+	return 1;
+      }
+    }
     else
     {
       break;
     }
   }
 
-  
+
   if ( argv[0] != NULL && argv[1] != NULL )
   {
     if ( strcmp(argv[0], argv[1]) == 0 )
     {
       printf("source and destination file must be different\n");
     }
+    else if ( is_batch )
+    {
+      if ( convert_dir(argv[0], argv[1]) == 0 )
+	return 1;
+    }
     else
     {
       read_png_file(argv[0], argv[1]);
@@ -355,5 +919,3 @@ int main(int argc, char **argv)
   }
   return 0;
 }
-
-
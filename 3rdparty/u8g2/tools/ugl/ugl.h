@@ -30,6 +30,7 @@ extern uint16_t ugl_bytecode_len;
 
 void ugl_InitBytecode(void);
 void ugl_AddBytecode(uint8_t x);
+void ugl_RemoveBytecode(uint16_t pos, uint16_t cnt);
 void ugl_ExecBytecode(void);
 void ugl_ResolveSymbols(void);
 void ugl_WriteBytecodeCArray(FILE *fp, const char *name);
@@ -41,6 +42,8 @@ uint16_t ugl_GetLabelBytecodePos(int idx);
 
 
 /* ugl_parse.c */
+extern int ugl_is_optimize;
+
 
 uint16_t uglStartNamelessProc(int args);
 int ugl_read_line(const char **s);
@@ -25,9 +25,17 @@ void ugl_AddBytecode(uint8_t x)
   ugl_bytecode_len++;
 }
 
+/* remove cnt bytes at pos, only allowed for code without labels after pos */
+void ugl_RemoveBytecode(uint16_t pos, uint16_t cnt)
+{
+  memmove(ugl_bytecode_array+pos, ugl_bytecode_array+pos+cnt, ugl_bytecode_len-pos-cnt);
+  ugl_bytecode_len -= cnt;
+}
+
 void ugl_InitBytecode(void)
 {
   ugl_bytecode_len = 0;
+  ugl_label_cnt = 0;
   ugl_AddBytecode(BC_CMD_RETURN_FROM_PROCEDURE);
 }
 
@@ -127,6 +135,10 @@ void ugl_ResolveSymbols(void)
 	    break;
 	  case BC_CMD_RETURN_FROM_PROCEDURE:
 	    break;
+	  case BC_CMD_LOAD_ARG:
+	  case BC_CMD_STORE_ARG:
+	    code++;
+	    break;
 	  case BC_CMD_JUMP_NOT_ZERO:
 	  case BC_CMD_JUMP_ZERO:
 	    val = code[0];
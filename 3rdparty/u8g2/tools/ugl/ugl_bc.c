@@ -34,6 +34,10 @@
 #include "map.h"
 #endif
 
+#ifdef UGL_U8G2
+#include "u8g2.h"
+#endif
+
 
 
 void bc_push_on_arg_stack(bc_t *bc, uint16_t val)
@@ -86,14 +90,32 @@ void bc_init(bc_t *bc)
   bc->return_stack_pointer = 0;
 }
 
+#ifdef BC_DEBUG
 #define BC_DBG_OUT_POS(pos) printf("%05d ", (int)(pos))
 #define BC_DBG_OUT_HEX(c) printf("0x%02x ", (int)(c))
 #define BC_DBG_OUT_STR(str) printf("%s ", (str))
 #define BC_DBG_OUT_NUM(n) printf("%d ", (int)(n))
 #define BC_DBG_OUT_NUM3(n) printf("%03d ", (int)(n))
 #define BC_DBG_OUT_CR() printf("\n")
+#else
+#define BC_DBG_OUT_POS(pos)
+#define BC_DBG_OUT_HEX(c)
+#define BC_DBG_OUT_STR(str)
+#define BC_DBG_OUT_NUM(n)
+#define BC_DBG_OUT_NUM3(n)
+#define BC_DBG_OUT_CR()
+#endif
 
 void bc_exec(bc_t *bc, uint8_t *code, uint16_t pos)
+{
+#ifdef BC_THREADED_DISPATCH
+  bc_exec_threaded(bc, code, pos);
+#else
+  bc_exec_switch(bc, code, pos);
+#endif
+}
+
+void bc_exec_switch(bc_t *bc, uint8_t *code, uint16_t pos)
 {
   uint16_t val;
   uint8_t cmd;
@@ -154,6 +176,7 @@ void bc_exec(bc_t *bc, uint8_t *code, uint16_t pos)
 	}
 	BC_DBG_OUT_POS(bc->code_pos);
 	BC_DBG_OUT_CR();
+	break;
       case BC_CMD_POP_ARG_STACK:
 	cmd >>= 4;	/* in this case we need the lower 4 bit */
 	BC_DBG_OUT_STR("POP ARG STACK");	    
@@ -251,9 +274,9 @@ void bc_exec(bc_t *bc, uint8_t *code, uint16_t pos)
 	  
 	    if ( bc_pop_from_arg_stack(bc) != 0 )
 	      bc->code_pos = val;
-	    break;
 	    BC_DBG_OUT_NUM(bc->code_pos);
 	    BC_DBG_OUT_CR();
+	    break;
 	  case BC_CMD_JUMP_ZERO:
 	    BC_DBG_OUT_STR("JUMP Z");
 	    val = bc->code[bc->code_pos];
@@ -281,6 +304,22 @@ void bc_exec(bc_t *bc, uint8_t *code, uint16_t pos)
 	    BC_DBG_OUT_NUM(bc->code_pos);
 	    BC_DBG_OUT_CR();
 	    
+	    break;
+	  case BC_CMD_LOAD_ARG:
+	    BC_DBG_OUT_STR("LOAD ARG");
+	    cmd = bc->code[bc->code_pos];
+	    bc->code_pos++;
+	    BC_DBG_OUT_NUM(cmd);
+	    bc_push_on_arg_stack(bc, *bc_get_stack_frame_address(bc, cmd));
+	    BC_DBG_OUT_CR();
+	    break;
+	  case BC_CMD_STORE_ARG:
+	    BC_DBG_OUT_STR("STORE ARG");
+	    cmd = bc->code[bc->code_pos];
+	    bc->code_pos++;
+	    BC_DBG_OUT_NUM(cmd);
+	    *bc_get_stack_frame_address(bc, cmd) = bc->arg_stack[bc->arg_stack_pointer-1];
+	    BC_DBG_OUT_CR();
 	    break;
 /*	  
 	  case BC_CMD_POP_ARG_STACK:
@@ -299,6 +338,135 @@ void bc_exec(bc_t *bc, uint8_t *code, uint16_t pos)
 }
 
 
+#ifdef BC_THREADED_DISPATCH
+
+/*
+  Direct threaded dispatch: the table is indexed with the complete command
+  byte, so the 4 bit commands and the extended 0x?f commands are found with
+  one lookup and every command ends with its own indirect jump to the next
+  command. The code position is kept in a local variable, builtin
+  procedures only access the arg stack of bc.
+*/
+
+#define BC_ROW(ext) \
+  &&op_load_12bit, &&op_call_buildin, &&op_call_buildin_pop, &&op_branch, \
+  &&op_pop_arg_stack, &&op_push_arg_stack, &&op_call_procedure, &&op_nop, \
+  &&op_nop, &&op_nop, &&op_nop, &&op_nop, &&op_nop, &&op_nop, &&op_nop, &&ext
+
+#define BC_NEXT() do { cmd = code[pos]; pos++; goto *dispatch[cmd]; } while(0)
+#define BC_VAL12() ((((uint16_t)cmd & 0x0f0) << 4) | code[pos++])
+#define BC_VAL16() (pos += 2, (uint16_t)(((uint16_t)code[pos-2] << 8) | code[pos-1]))
+
+void bc_exec_threaded(bc_t *bc, uint8_t *code, uint16_t pos)
+{
+  static const void * const dispatch[256] =
+  {
+    /* 0x0f */ BC_ROW(op_load_0),
+    /* 0x1f */ BC_ROW(op_load_1),
+    /* 0x2f */ BC_ROW(op_load_16bit),
+    /* 0x3f */ BC_ROW(op_return_from_procedure),
+    /* 0x4f */ BC_ROW(op_jump_not_zero),
+    /* 0x5f */ BC_ROW(op_jump_zero),
+    /* 0x6f */ BC_ROW(op_nop),
+    /* 0x7f */ BC_ROW(op_nop),
+    /* 0x8f */ BC_ROW(op_load_arg),
+    /* 0x9f */ BC_ROW(op_store_arg),
+    /* 0xaf */ BC_ROW(op_nop),
+    /* 0xbf */ BC_ROW(op_nop),
+    /* 0xcf */ BC_ROW(op_nop),
+    /* 0xdf */ BC_ROW(op_nop),
+    /* 0xef */ BC_ROW(op_nop),
+    /* 0xff */ BC_ROW(op_nop),
+  };
+  uint16_t val;
+  uint8_t cmd;
+
+  bc_init(bc);
+  bc->code = code;
+
+  BC_NEXT();
+
+op_load_12bit:
+  bc_push_on_arg_stack(bc, BC_VAL12());
+  BC_NEXT();
+op_call_buildin:
+  val = BC_VAL12();
+  bc->code_pos = pos;
+  bc_buildin_list[val](bc);
+  BC_NEXT();
+op_call_buildin_pop:
+  val = BC_VAL12();
+  bc->code_pos = pos;
+  bc_buildin_list[val](bc);
+  bc_pop_from_arg_stack(bc);
+  BC_NEXT();
+op_branch:
+  val = BC_VAL12();
+  if ( val < 0x0800 )
+    pos += val;
+  else
+    pos -= 0x1000 - val;
+  BC_NEXT();
+op_pop_arg_stack:
+  assert( bc->arg_stack_pointer > (cmd >> 4) );
+  bc->arg_stack_pointer -= (cmd >> 4) + 1;
+  BC_NEXT();
+op_push_arg_stack:
+  cmd = (cmd >> 4) + 1;
+  do
+  {
+    bc_push_on_arg_stack(bc, 0);
+    cmd--;
+  } while( cmd > 0 );
+  BC_NEXT();
+op_call_procedure:
+  val = BC_VAL16();
+  bc_push_on_return_stack(bc, pos);	/* return position */
+  bc_push_on_return_stack(bc, bc->arg_stack_pointer - (cmd >> 4) - 1);	/* start pos of the return value and the args */
+  pos = val;
+  BC_NEXT();
+op_load_0:
+  bc_push_on_arg_stack(bc, 0);
+  BC_NEXT();
+op_load_1:
+  bc_push_on_arg_stack(bc, 1);
+  BC_NEXT();
+op_load_16bit:
+  bc_push_on_arg_stack(bc, BC_VAL16());
+  BC_NEXT();
+op_return_from_procedure:
+  if ( bc->return_stack_pointer == 0 )
+  {
+    bc->code_pos = pos;
+    return;	/* stop execution */
+  }
+  bc->arg_stack_pointer = bc_pop_from_return_stack(bc) + 1; /* restore the arg stack pointer, leave return value on stack */
+  pos = bc_pop_from_return_stack(bc);
+  BC_NEXT();
+op_jump_not_zero:
+  val = BC_VAL16();
+  if ( bc_pop_from_arg_stack(bc) != 0 )
+    pos = val;
+  BC_NEXT();
+op_jump_zero:
+  val = BC_VAL16();
+  if ( bc_pop_from_arg_stack(bc) == 0 )
+    pos = val;
+  BC_NEXT();
+op_load_arg:
+  cmd = code[pos++];
+  bc_push_on_arg_stack(bc, *bc_get_stack_frame_address(bc, cmd));
+  BC_NEXT();
+op_store_arg:
+  cmd = code[pos++];
+  *bc_get_stack_frame_address(bc, cmd) = bc->arg_stack[bc->arg_stack_pointer-1];
+  BC_NEXT();
+op_nop:
+  BC_NEXT();
+}
+
+#endif /* BC_THREADED_DISPATCH */
+
 /*======================================================*/
 
 /* put top of stack into register a, reduce stack */
@@ -397,6 +565,64 @@ void bc_fn_setItemPos(bc_t *bc)
   bc_push_on_arg_stack(bc, i);  
 }
 
+#ifdef UGL_U8G2
+u8g2_t *bc_u8g2;	/* target of the draw procedures, nothing is drawn if NULL */
+#endif
+
+void bc_fn_drawPixel(bc_t *bc)
+{
+  uint16_t x, y;
+  y = bc_pop_from_arg_stack(bc);
+  x = bc_pop_from_arg_stack(bc);
+#ifdef UGL_U8G2
+  if ( bc_u8g2 != NULL )
+    u8g2_DrawPixel(bc_u8g2, x, y);
+#else
+  (void)x; (void)y;
+#endif
+  bc_push_on_arg_stack(bc, 0);
+}
+
+static void bc_get_box_args(bc_t *bc, uint16_t *x, uint16_t *y, uint16_t *w, uint16_t *h)
+{
+  *h = bc_pop_from_arg_stack(bc);
+  *w = bc_pop_from_arg_stack(bc);
+  *y = bc_pop_from_arg_stack(bc);
+  *x = bc_pop_from_arg_stack(bc);
+}
+
+void bc_fn_drawBox(bc_t *bc)
+{
+  uint16_t x, y, w, h;
+  bc_get_box_args(bc, &x, &y, &w, &h);
+#ifdef UGL_U8G2
+  if ( bc_u8g2 != NULL )
+    u8g2_DrawBox(bc_u8g2, x, y, w, h);
+#endif
+  bc_push_on_arg_stack(bc, 0);
+}
+
+void bc_fn_drawFrame(bc_t *bc)
+{
+  uint16_t x, y, w, h;
+  bc_get_box_args(bc, &x, &y, &w, &h);
+#ifdef UGL_U8G2
+  if ( bc_u8g2 != NULL )
+    u8g2_DrawFrame(bc_u8g2, x, y, w, h);
+#endif
+  bc_push_on_arg_stack(bc, 0);
+}
+
+void bc_fn_setColor(bc_t *bc)
+{
+  uint16_t c;
+  c = bc_pop_from_arg_stack(bc);
+#ifdef UGL_U8G2
+  if ( bc_u8g2 != NULL )
+    u8g2_SetDrawColor(bc_u8g2, c);
+#endif
+  bc_push_on_arg_stack(bc, c);
+}
 
 /*======================================================*/
 bc_buildin_fn bc_buildin_list[] = 
@@ -409,6 +635,10 @@ bc_buildin_fn bc_buildin_list[] =
   /* 5 */ bc_fn_print,
   /* 6 */ bc_fn_setPos,	/* two args: x & y*/
   /* 7 */ bc_fn_setItemPos,	/* one args: item */
+  /* 8 */ bc_fn_drawPixel,	/* two args: x & y */
+  /* 9 */ bc_fn_drawBox,	/* four args: x, y, w, h */
+  /* 10 */ bc_fn_drawFrame,	/* four args: x, y, w, h */
+  /* 11 */ bc_fn_setColor,	/* one arg: draw color */
 };
 
 
@@ -73,10 +73,28 @@ extern bc_buildin_fn bc_buildin_list[];
 //#define BC_CMD_CALL_PROCEDURE (0x06f)
 /* lower 4 bit: 15, upper 4 bit: 7  --> adr are next 16 bit, third byte are the number of arguments */
 //#define BC_CMD_POP_ARG_STACK (0x07f)
+/* lower 4 bit: 15, upper 4 bit: 8  --> next byte is n, push arg n of the stack frame, same as a(n) with constant n */
+#define BC_CMD_LOAD_ARG (0x8f)
+/* lower 4 bit: 15, upper 4 bit: 9  --> next byte is n, assign top of stack to arg n and keep it on the stack, same as a(n, value) with constant n */
+#define BC_CMD_STORE_ARG (0x9f)
+
+/*
+  bc_exec() uses direct threaded dispatch (computed goto) with GCC and clang.
+  The switch based interpreter is used otherwise, or if BC_DEBUG is defined,
+  which also enables the trace output of the executed bytecode.
+*/
+#if defined(__GNUC__) && !defined(BC_DEBUG) && !defined(BC_NO_THREADED_DISPATCH)
+#define BC_THREADED_DISPATCH
+#endif
 
 
 
 void bc_exec(bc_t *bc, uint8_t *code, uint16_t pos);
+void bc_exec_switch(bc_t *bc, uint8_t *code, uint16_t pos);
+#ifdef BC_THREADED_DISPATCH
+void bc_exec_threaded(bc_t *bc, uint8_t *code, uint16_t pos);
+#endif
+uint16_t *bc_get_stack_frame_address(bc_t *bc, uint8_t pos);
 
 
 /*======================================================*/
@@ -0,0 +1,189 @@
+/*
+
+  ugl_bench.c
+
+  Runs a ugl script once per frame on a u8g2 memory display (128x64 full
+  buffer, nothing is sent to a display) and reports the time per frame for
+  the switch and the threaded interpreter, with and without constant
+  folding and peephole optimization. The time without drawing is the
+  interpreter overhead only.
+
+  ugl_bench [script.ugl] [frames]
+
+  The script must define "proc frame", which draws one frame. Without a
+  script file, a menu screen is used.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "u8g2.h"
+#include "ugl.h"
+#include "ugl_bc.h"
+
+extern uint8_t ugl_bytecode_array[];
+extern u8g2_t *bc_u8g2;
+
+static const char *ugl_bench_menu[] =
+{
+  "# menu screen: title bar, four entries, one selected, scroll bar",
+  "proc entry 3		# a(1): y, a(2): selected, a(3): width",
+  "  if a(2)",
+  "    drawBox(2, a(1), a(3), 11)",
+  "    setColor(0)",
+  "  else",
+  "    drawFrame(2, a(1), a(3), 11)",
+  "  endif",
+  "  drawBox(add(a(3), $fffc), add(a(1), 2), 3, 7)	# arrow",
+  "  setColor(1)",
+  "endproc",
+  "",
+  "proc frame",
+  "  locals 2",
+  "  a(1, add(10, 4))		# y of the first entry",
+  "  a(2, add(100, 16))		# width of the entries",
+  "  drawBox(0, 0, 128, add(10, 1))",
+  "  if add(0, 1)		# constant condition",
+  "    drawPixel(add(126, 1), 0)",
+  "  endif",
+  "  entry(a(1), 0, a(2))",
+  "  a(1, add(a(1), 12))",
+  "  entry(a(1), 1, a(2))",
+  "  a(1, add(a(1), 12))",
+  "  entry(a(1), 0, a(2))",
+  "  a(1, add(a(1), 12))",
+  "  entry(a(1), 0, a(2))",
+  "  drawFrame(122, 12, 6, 52)",
+  "  drawBox(124, add(14, 10), 2, 16)",
+  "endproc",
+  NULL
+};
+
+static char **ugl_bench_lines;
+
+static int ugl_bench_read(const char *name)
+{
+  FILE *fp;
+  char buf[1024];
+  int cnt = 0;
+
+  fp = fopen(name, "r");
+  if ( fp == NULL )
+  {
+    perror(name);
+    return 0;
+  }
+  while( fgets(buf, sizeof(buf), fp) != NULL )
+  {
+    ugl_bench_lines = (char **)realloc(ugl_bench_lines, (cnt+2)*sizeof(char *));
+    if ( ugl_bench_lines == NULL )
+      ugl_err("out of memory");
+    ugl_bench_lines[cnt++] = strdup(buf);
+  }
+  ugl_bench_lines[cnt] = NULL;
+  fclose(fp);
+  return 1;
+}
+
+/* compile the script, returns the start position of the frame call */
+static uint16_t ugl_bench_compile(int is_optimize)
+{
+  const char *s;
+  uint16_t entry;
+  int i;
+
+  ugl_is_optimize = is_optimize;
+  ugl_InitBytecode();
+  for( i = 0; ugl_bench_lines[i] != NULL; i++ )
+  {
+    ugl_current_input_line = i+1;
+    s = ugl_bench_lines[i];
+    ugl_read_line(&s);
+  }
+
+  /* toplevel call of "frame", then stop */
+  entry = ugl_bytecode_len;
+  s = "frame";
+  ugl_read_line(&s);
+  ugl_AddBytecode(BC_CMD_RETURN_FROM_PROCEDURE);
+  ugl_ResolveSymbols();
+  return entry;
+}
+
+static double ugl_bench_run(void (*exec)(bc_t *, uint8_t *, uint16_t), uint16_t entry, long frames, u8g2_t *u8g2, u8g2_t *target)
+{
+  struct timespec t0, t1;
+  bc_t bc;
+  long i;
+
+  bc_u8g2 = target;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for( i = 0; i < frames; i++ )
+  {
+    u8g2_ClearBuffer(u8g2);
+    exec(&bc, ugl_bytecode_array, entry);
+    if ( bc.arg_stack_pointer != 0 )
+      ugl_err("arg stack not empty after frame: %d", bc.arg_stack_pointer);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return ((t1.tv_sec-t0.tv_sec)*1e9 + (t1.tv_nsec-t0.tv_nsec)) / frames;
+}
+
+int main(int argc, char **argv)
+{
+  static const struct
+  {
+    const char *name;
+    void (*exec)(bc_t *, uint8_t *, uint16_t);
+  } interpreters[] =
+  {
+    { "switch", bc_exec_switch },
+#ifdef BC_THREADED_DISPATCH
+    { "threaded", bc_exec_threaded },
+#endif
+  };
+  u8g2_t u8g2;
+  uint8_t reference[1024];
+  long frames = 100000;
+  uint16_t entry;
+  double t_draw, t_nodraw;
+  int is_optimize;
+  unsigned i;
+
+  if ( argc > 1 )
+  {
+    if ( ugl_bench_read(argv[1]) == 0 )
+      return 1;
+  }
+  else
+  {
+    ugl_bench_lines = (char **)ugl_bench_menu;
+  }
+  if ( argc > 2 )
+    frames = atol(argv[2]);
+  if ( frames <= 0 )
+    frames = 1;
+
+  ugl_is_suppress_log = getenv("UGL_LOG") == NULL;
+  u8g2_Setup_ssd1306_128x64_noname_f(&u8g2, U8G2_R0, u8x8_byte_empty, u8x8_dummy_cb);
+
+  printf("%-10s %-9s %6s %14s %14s\n", "interp", "optimize", "bytes", "ns/frame", "ns w/o draw");
+  for( is_optimize = 0; is_optimize <= 1; is_optimize++ )
+  {
+    entry = ugl_bench_compile(is_optimize);
+    for( i = 0; i < sizeof(interpreters)/sizeof(*interpreters); i++ )
+    {
+      t_draw = ugl_bench_run(interpreters[i].exec, entry, frames, &u8g2, &u8g2);
+      if ( is_optimize == 0 && i == 0 )
+	memcpy(reference, u8g2_GetBufferPtr(&u8g2), sizeof(reference));
+      else if ( memcmp(reference, u8g2_GetBufferPtr(&u8g2), sizeof(reference)) != 0 )
+	ugl_err("%s interpreter, optimize %d: different display content", interpreters[i].name, is_optimize);
+      t_nodraw = ugl_bench_run(interpreters[i].exec, entry, frames, &u8g2, NULL);
+      printf("%-10s %-9s %6u %14.1f %14.1f\n", interpreters[i].name, is_optimize ? "on" : "off",
+	ugl_bytecode_len, t_draw, t_nodraw);
+    }
+  }
+  return 0;
+}
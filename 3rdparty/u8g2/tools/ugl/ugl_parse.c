@@ -30,6 +30,7 @@
 
 long ugl_current_local_variables = 0;
 long ugl_current_args = 0;
+int ugl_is_optimize = 1;		/* constant folding and peephole optimization */
 
 
 #define UGL_MAX_INDENT 64
@@ -42,22 +43,50 @@ int ugl_indent_level;
 int ugl_indent_type[UGL_MAX_INDENT];
 char ugl_indent_identifier[UGL_MAX_INDENT][UGL_MAX_IDENTIFIER_LEN+1];
 
+#define UGL_MAX_ARGS 15
+
+/* argument of a procedure call, value is valid if is_const is not 0 */
+struct ugl_arg_struct
+{
+  uint16_t bytecode_pos;
+  int is_const;
+  long value;
+};
+
+/* constant folding: result of a buildin procedure without side effects */
+typedef long (*ugl_fold_fn)(const struct ugl_arg_struct *args);
+
+static long ugl_fold_nop(const struct ugl_arg_struct *args)
+{
+  return 0;
+}
+
+static long ugl_fold_add(const struct ugl_arg_struct *args)
+{
+  return (args[0].value + args[1].value) & 0x0ffff;
+}
+
 struct ugl_buildin_cmd_struct
 {
   int code;
   const char *name;
   int args;
+  ugl_fold_fn fold;		/* NULL if the procedure has side effects */
 };
 
 struct ugl_buildin_cmd_struct ugl_buildin_cmd_list[] = {
-  { /* code=*/ 0, 	/* name=*/ "nop", 		/* args=*/ 0},
-  { /* code=*/ 1, 	/* name=*/ "return", 	/* args=*/ 1 },	/* assign the return value of a user defined function */
-  { /* code=*/ 2, 	/* name=*/ "a", 		/* args=*/ 1 },	/* return the value of the n-th argument of a user defined function */
-  { /* code=*/ 3, 	/* name=*/ "a", 		/* args=*/ 2 }, /* reassign the value of the n-th argument of a user defined function */
-  { /* code=*/ 4, 	/* name=*/ "add", 		/* args=*/ 2 },
-  { /* code=*/ 5, 	/* name=*/ "print", 		/* args=*/ 1 },
-  { /* code=*/ 6, 	/* name=*/ "setPos", 	/* args=*/ 2 },
-  { /* code=*/ 7, 	/* name=*/ "setItemPos", /* args=*/ 1 },
+  { /* code=*/ 0, 	/* name=*/ "nop", 		/* args=*/ 0, 	/* fold=*/ ugl_fold_nop },
+  { /* code=*/ 1, 	/* name=*/ "return", 	/* args=*/ 1, 	/* fold=*/ NULL },	/* assign the return value of a user defined function */
+  { /* code=*/ 2, 	/* name=*/ "a", 		/* args=*/ 1, 	/* fold=*/ NULL },	/* return the value of the n-th argument of a user defined function */
+  { /* code=*/ 3, 	/* name=*/ "a", 		/* args=*/ 2, 	/* fold=*/ NULL }, /* reassign the value of the n-th argument of a user defined function */
+  { /* code=*/ 4, 	/* name=*/ "add", 		/* args=*/ 2, 	/* fold=*/ ugl_fold_add },
+  { /* code=*/ 5, 	/* name=*/ "print", 		/* args=*/ 1, 	/* fold=*/ NULL },
+  { /* code=*/ 6, 	/* name=*/ "setPos", 	/* args=*/ 2, 	/* fold=*/ NULL },
+  { /* code=*/ 7, 	/* name=*/ "setItemPos", /* args=*/ 1, 	/* fold=*/ NULL },
+  { /* code=*/ 8, 	/* name=*/ "drawPixel", 	/* args=*/ 2, 	/* fold=*/ NULL },
+  { /* code=*/ 9, 	/* name=*/ "drawBox", 	/* args=*/ 4, 	/* fold=*/ NULL },
+  { /* code=*/ 10, 	/* name=*/ "drawFrame", 	/* args=*/ 4, 	/* fold=*/ NULL },
+  { /* code=*/ 11, 	/* name=*/ "setColor", 	/* args=*/ 1, 	/* fold=*/ NULL },
 };
 
 
@@ -345,6 +374,72 @@ void ugl_bytecode_jmp_zero(const char *s)
 }
 
 
+void ugl_bytecode_arg(int is_store, long n)
+{
+  ugl_plog("BC %s arg %ld", is_store ? "store" : "load", n);
+  ugl_AddBytecode(is_store ? BC_CMD_STORE_ARG : BC_CMD_LOAD_ARG);
+  ugl_AddBytecode(n);
+}
+
+/*======================================================*/
+/*
+  optimization of a buildin procedure call, the code for the args is already
+  generated. Returns 1 if the call has been replaced, *is_const is set if
+  the call has been replaced by a constant value *value.
+
+  - constant folding: buildin procedures without side effects and constant
+    args are calculated by the compiler, nothing is left at toplevel
+  - peephole: a(n) and a(n, value) with constant n become one command
+*/
+static int ugl_optimize_buildin(int idx, int is_toplevel, int arg_cnt, struct ugl_arg_struct *args, int *is_const, long *value)
+{
+  struct ugl_buildin_cmd_struct *cmd = ugl_buildin_cmd_list+idx;
+  uint16_t start = arg_cnt > 0 ? args[0].bytecode_pos : ugl_bytecode_len;
+  int i;
+
+  if ( ugl_is_optimize == 0 )
+    return 0;
+
+  if ( cmd->fold != NULL )
+  {
+    for( i = 0; i < arg_cnt; i++ )
+      if ( args[i].is_const == 0 )
+	break;
+    if ( i == arg_cnt )
+    {
+      ugl_RemoveBytecode(start, ugl_bytecode_len-start);
+      *value = cmd->fold(args);
+      ugl_plog("BC fold '%s' to %ld%s", cmd->name, *value, is_toplevel ? " (removed)" : "");
+      if ( is_toplevel == 0 )
+      {
+	ugl_bytecode_constant_value(*value);
+	*is_const = 1;
+      }
+      return 1;
+    }
+  }
+
+  if ( cmd->code == 2 && args[0].is_const && args[0].value <= 255 )
+  {
+    ugl_RemoveBytecode(start, ugl_bytecode_len-start);
+    ugl_bytecode_arg(0, args[0].value);
+    if ( is_toplevel )
+      ugl_AddBytecode(BC_CMD_POP_ARG_STACK);
+    return 1;
+  }
+
+  if ( cmd->code == 3 && args[0].is_const && args[0].value <= 255 )
+  {
+    ugl_RemoveBytecode(start, args[1].bytecode_pos-start);	/* keep the code for the value */
+    ugl_bytecode_arg(1, args[0].value);
+    if ( is_toplevel )
+      ugl_AddBytecode(BC_CMD_POP_ARG_STACK);
+    return 1;
+  }
+
+  return 0;
+}
+
 /*======================================================*/
 
 int ugl_is_buildin_cmd(const char *name)
@@ -359,10 +454,12 @@ int ugl_is_buildin_cmd(const char *name)
   return 0;
 }
 
-void ugl_call_proc(const char *name, int is_toplevel, int arg_cnt)
+/* returns 1 if the call has been replaced by the constant value *value */
+int ugl_call_proc(const char *name, int is_toplevel, int arg_cnt, struct ugl_arg_struct *args, long *value)
 {
   int i, cnt;
   int ii;
+  int is_const = 0;
   cnt = sizeof(ugl_buildin_cmd_list)/sizeof(*ugl_buildin_cmd_list);
   ii = cnt;
   for( i = 0; i < cnt; i++ )
@@ -374,7 +471,8 @@ void ugl_call_proc(const char *name, int is_toplevel, int arg_cnt)
   }
   if ( i < cnt )
   {
-    ugl_bytecode_buildin_procedure(name, i, is_toplevel);
+    if ( ugl_optimize_buildin(i, is_toplevel, arg_cnt, args, &is_const, value) == 0 )
+      ugl_bytecode_buildin_procedure(name, i, is_toplevel);
   }
   else
   {
@@ -387,11 +485,14 @@ void ugl_call_proc(const char *name, int is_toplevel, int arg_cnt)
       ugl_bytecode_call_procedure(name, is_toplevel, arg_cnt);
     }
   }
+  return is_const;
 }
 
-void ugl_parse_proc(const char **s, const char *id, int is_toplevel)
+/* returns 1 if the expression is the constant value *value */
+int ugl_parse_proc(const char **s, const char *id, int is_toplevel, long *value)
 {
   char procname[UGL_MAX_IDENTIFIER_LEN];
+  struct ugl_arg_struct args[UGL_MAX_ARGS];
   int arg_cnt = 0;
   ugl_plog("parse procedure '%s'", id);
   strcpy(procname, id);
@@ -413,14 +514,19 @@ void ugl_parse_proc(const char **s, const char *id, int is_toplevel)
       if ( **s == ')' )
 	break;
       
+      if ( arg_cnt >= UGL_MAX_ARGS )
+	ugl_err("too many args for '%s'", procname);
+      args[arg_cnt].bytecode_pos = ugl_bytecode_len;
       if ( (**s >= '0' && **s <= '9') || **s == '$' || **s == '\'' )
       {
-	ugl_bytecode_constant_value(get_num(s));
+	args[arg_cnt].value = get_num(s);
+	args[arg_cnt].is_const = 1;
+	ugl_bytecode_constant_value(args[arg_cnt].value);
       }
       else
       {
 	name = get_identifier(s);
-	ugl_parse_proc(s, name, 0);
+	args[arg_cnt].is_const = ugl_parse_proc(s, name, 0, &(args[arg_cnt].value));
       }
       arg_cnt++;
       if ( **s != ',' )
@@ -430,12 +536,9 @@ void ugl_parse_proc(const char **s, const char *id, int is_toplevel)
       ugl_err("missing ')'");    
     (*s)++;
     skip_space(s);
-    ugl_call_proc(procname, is_toplevel, arg_cnt);
-  }
-  else
-  {
-    ugl_call_proc(procname, is_toplevel, 0);
+    return ugl_call_proc(procname, is_toplevel, arg_cnt, args, value);
   }
+  return ugl_call_proc(procname, is_toplevel, 0, args, value);
 }
 
 uint16_t  uglStartNamelessProc(int args)
@@ -491,9 +594,22 @@ int ugl_read_line(const char **s)
   }
   else if ( strcmp(id, "if" ) == 0 )
   {
-    ugl_parse_proc(s, get_identifier(s), 0);
-    sprintf(ugl_indent_identifier[ugl_indent_level], ".if%d", ugl_bytecode_len);    /* use the current bytecode position as unique identifier */
-    ugl_bytecode_jmp_zero(ugl_indent_identifier[ugl_indent_level]);
+    static int if_cnt = 0;
+    uint16_t pos = ugl_bytecode_len;
+    long value;
+    int is_const = ugl_parse_proc(s, get_identifier(s), 0, &value);
+    sprintf(ugl_indent_identifier[ugl_indent_level], ".if%d", if_cnt++);    /* the bytecode position is not unique, if constant conditions are removed */
+    if ( is_const )
+    {
+      /* constant condition: no test, jump to else/endif for 0 */
+      ugl_RemoveBytecode(pos, ugl_bytecode_len-pos);
+      if ( value == 0 )
+	ugl_bytecode_branch(ugl_indent_identifier[ugl_indent_level]);
+    }
+    else
+    {
+      ugl_bytecode_jmp_zero(ugl_indent_identifier[ugl_indent_level]);
+    }
     ugl_IncIndent(UGL_INDENT_TYPE_IF);    
     
   }
@@ -513,7 +629,8 @@ int ugl_read_line(const char **s)
   }
   else 
   {
-    ugl_parse_proc(s, id, 1);
+    long value;
+    ugl_parse_proc(s, id, 1, &value);
   }
   return 1;
 }
@@ -0,0 +1,502 @@
+/*
+ * buzzer_seq.c
+ *
+ * Plays note lists on a c-periphery PWM channel from a dedicated thread.
+ * Note boundaries are absolute CLOCK_MONOTONIC deadlines computed from the
+ * start of the melody, so syscall overhead and wakeup jitter of one note do
+ * not accumulate into the following ones.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "buzzer_seq.h"
+
+/* Precomputed PWM settings for one note */
+typedef struct buzzer_step {
+    uint64_t period_ns;     /* 0 for a rest */
+    uint64_t duty_cycle_ns;
+    uint64_t duration_ns;
+} buzzer_step_t;
+
+struct buzzer_seq {
+    pwm_t *pwm;
+    pthread_t thread;
+    bool started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    buzzer_step_t *pending;
+    size_t pending_count;
+    unsigned int generation;
+    bool playing;
+    bool quit;
+
+    /* Written by the caller's API calls only */
+    struct {
+        int c_errno;
+        char errmsg[96];
+    } error;
+
+    /* Failure of the playback thread, under lock until buzzer_seq_wait()
+     * moves it into error */
+    struct {
+        bool pending;
+        int c_errno;
+        char errmsg[96];
+    } play_error;
+};
+
+static int _buzzer_seq_error(buzzer_seq_t *seq, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    seq->error.c_errno = c_errno;
+
+    va_start(ap, fmt);
+    vsnprintf(seq->error.errmsg, sizeof(seq->error.errmsg), fmt, ap);
+    va_end(ap);
+
+    /* Tack on strerror() and errno */
+    if (c_errno) {
+        char buf[64] = {0};
+        strerror_r(c_errno, buf, sizeof(buf));
+        snprintf(seq->error.errmsg+strlen(seq->error.errmsg), sizeof(seq->error.errmsg)-strlen(seq->error.errmsg), ": %s [errno %d]", buf, c_errno);
+    }
+
+    return code;
+}
+
+static void timespec_add_ns(struct timespec *ts, uint64_t ns) {
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+static void buzzer_seq_silence(buzzer_seq_t *seq) {
+    pwm_set_duty_cycle_ns(seq->pwm, 0);
+    pwm_disable(seq->pwm);
+}
+
+static int buzzer_seq_output(buzzer_seq_t *seq, const buzzer_step_t *step) {
+    int ret;
+
+    /* Rests keep the channel enabled at 0% duty so the next note is a
+     * single ordered period/duty update */
+    if (step->period_ns == 0)
+        return pwm_set_duty_cycle_ns(seq->pwm, 0);
+
+    if ((ret = pwm_set_period_duty_cycle_ns(seq->pwm, step->period_ns, step->duty_cycle_ns)) < 0)
+        return ret;
+
+    return pwm_enable(seq->pwm);
+}
+
+static void *buzzer_seq_thread(void *arg) {
+    buzzer_seq_t *seq = arg;
+
+    pthread_mutex_lock(&seq->lock);
+
+    while (!seq->quit) {
+        buzzer_step_t *steps;
+        size_t count;
+        unsigned int generation;
+        struct timespec deadline;
+        bool interrupted = false;
+
+        if (seq->pending == NULL) {
+            seq->playing = false;
+            pthread_cond_broadcast(&seq->cond);
+            pthread_cond_wait(&seq->cond, &seq->lock);
+            continue;
+        }
+
+        steps = seq->pending;
+        count = seq->pending_count;
+        generation = seq->generation;
+        seq->pending = NULL;
+        seq->playing = true;
+        pthread_mutex_unlock(&seq->lock);
+
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        for (size_t i = 0; i < count && !interrupted; i++) {
+            if (buzzer_seq_output(seq, &steps[i]) < 0) {
+                pthread_mutex_lock(&seq->lock);
+                seq->play_error.pending = true;
+                seq->play_error.c_errno = pwm_errno(seq->pwm);
+                snprintf(seq->play_error.errmsg, sizeof(seq->play_error.errmsg), "Playing note: %s", pwm_errmsg(seq->pwm));
+                pthread_mutex_unlock(&seq->lock);
+                break;
+            }
+
+            timespec_add_ns(&deadline, steps[i].duration_ns);
+
+            /* Sleep until the absolute end of this note, waking early only
+             * for stop, a new melody or shutdown */
+            pthread_mutex_lock(&seq->lock);
+            while (!seq->quit && seq->generation == generation) {
+                if (pthread_cond_timedwait(&seq->cond, &seq->lock, &deadline) == ETIMEDOUT)
+                    break;
+            }
+            interrupted = seq->quit || seq->generation != generation;
+            pthread_mutex_unlock(&seq->lock);
+        }
+
+        /* A replacement melody starts from its own first note without a
+         * silence gap */
+        pthread_mutex_lock(&seq->lock);
+        if (seq->pending == NULL)
+            buzzer_seq_silence(seq);
+        free(steps);
+    }
+
+    pthread_mutex_unlock(&seq->lock);
+
+    buzzer_seq_silence(seq);
+
+    return NULL;
+}
+
+buzzer_seq_t *buzzer_seq_new(void) {
+    buzzer_seq_t *seq = calloc(1, sizeof(buzzer_seq_t));
+    if (seq == NULL)
+        return NULL;
+
+    return seq;
+}
+
+int buzzer_seq_open(buzzer_seq_t *seq, pwm_t *pwm, int rt_priority) {
+    pthread_condattr_t condattr;
+    pthread_attr_t attr;
+    int ret;
+
+    if (pwm == NULL)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_ARG, 0, "Invalid PWM handle");
+
+    memset(seq, 0, sizeof(buzzer_seq_t));
+    seq->pwm = pwm;
+
+    pthread_mutex_init(&seq->lock, NULL);
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&seq->cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+
+    pthread_attr_init(&attr);
+    if (rt_priority > 0) {
+        struct sched_param param = { .sched_priority = rt_priority };
+
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+
+    ret = pthread_create(&seq->thread, &attr, buzzer_seq_thread, seq);
+    pthread_attr_destroy(&attr);
+
+    /* Fall back to normal scheduling without CAP_SYS_NICE */
+    if (ret == EPERM)
+        ret = pthread_create(&seq->thread, NULL, buzzer_seq_thread, seq);
+
+    if (ret != 0) {
+        pthread_cond_destroy(&seq->cond);
+        pthread_mutex_destroy(&seq->lock);
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_THREAD, ret, "Starting playback thread");
+    }
+
+    seq->started = true;
+
+    return 0;
+}
+
+int buzzer_seq_play(buzzer_seq_t *seq, const buzzer_note_t *notes, size_t count) {
+    buzzer_step_t *steps;
+
+    if (!seq->started)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_ARG, 0, "Sequencer not open");
+
+    if (notes == NULL || count == 0)
+        return buzzer_seq_stop(seq);
+
+    if ((steps = malloc(count * sizeof(buzzer_step_t))) == NULL)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_NO_MEMORY, errno, "Allocating notes");
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t volume = notes[i].volume > BUZZER_SEQ_VOLUME_MAX ? BUZZER_SEQ_VOLUME_MAX : notes[i].volume;
+
+        steps[i].period_ns = notes[i].freq_hz ? 1000000000ULL / notes[i].freq_hz : 0;
+        steps[i].duty_cycle_ns = steps[i].period_ns * volume / (2 * BUZZER_SEQ_VOLUME_MAX);
+        steps[i].duration_ns = (uint64_t)notes[i].duration_ms * 1000000ULL;
+    }
+
+    pthread_mutex_lock(&seq->lock);
+    free(seq->pending);
+    seq->pending = steps;
+    seq->pending_count = count;
+    seq->generation++;
+    pthread_cond_broadcast(&seq->cond);
+    pthread_mutex_unlock(&seq->lock);
+
+    return 0;
+}
+
+int buzzer_seq_play_rtttl(buzzer_seq_t *seq, const char *rtttl) {
+    buzzer_note_t *notes;
+    size_t count;
+    int ret;
+
+    if ((ret = buzzer_parse_rtttl(rtttl, NULL, 0, &count)) < 0)
+        return _buzzer_seq_error(seq, ret, 0, "Parsing RTTTL");
+
+    if ((notes = malloc(count * sizeof(buzzer_note_t) + 1)) == NULL)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_NO_MEMORY, errno, "Allocating notes");
+
+    buzzer_parse_rtttl(rtttl, notes, count, &count);
+    ret = buzzer_seq_play(seq, notes, count);
+    free(notes);
+
+    return ret;
+}
+
+int buzzer_seq_stop(buzzer_seq_t *seq) {
+    if (!seq->started)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_ARG, 0, "Sequencer not open");
+
+    pthread_mutex_lock(&seq->lock);
+    free(seq->pending);
+    seq->pending = NULL;
+    seq->generation++;
+    pthread_cond_broadcast(&seq->cond);
+    pthread_mutex_unlock(&seq->lock);
+
+    return 0;
+}
+
+int buzzer_seq_wait(buzzer_seq_t *seq, int timeout_ms) {
+    struct timespec deadline;
+    int ret = 1;
+
+    if (!seq->started)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_ARG, 0, "Sequencer not open");
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeout_ms > 0)
+        timespec_add_ns(&deadline, (uint64_t)timeout_ms * 1000000ULL);
+
+    pthread_mutex_lock(&seq->lock);
+    while (seq->playing || seq->pending != NULL) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&seq->cond, &seq->lock);
+        } else if (timeout_ms == 0 || pthread_cond_timedwait(&seq->cond, &seq->lock, &deadline) == ETIMEDOUT) {
+            ret = 0;
+            break;
+        }
+    }
+    if (ret == 1 && seq->play_error.pending) {
+        seq->play_error.pending = false;
+        seq->error.c_errno = seq->play_error.c_errno;
+        memcpy(seq->error.errmsg, seq->play_error.errmsg, sizeof(seq->error.errmsg));
+        ret = BUZZER_SEQ_ERROR_PWM;
+    }
+    pthread_mutex_unlock(&seq->lock);
+
+    return ret;
+}
+
+int buzzer_seq_close(buzzer_seq_t *seq) {
+    int ret;
+
+    if (!seq->started)
+        return 0;
+
+    pthread_mutex_lock(&seq->lock);
+    seq->quit = true;
+    pthread_cond_broadcast(&seq->cond);
+    pthread_mutex_unlock(&seq->lock);
+
+    if ((ret = pthread_join(seq->thread, NULL)) != 0)
+        return _buzzer_seq_error(seq, BUZZER_SEQ_ERROR_THREAD, ret, "Joining playback thread");
+
+    free(seq->pending);
+    seq->pending = NULL;
+    pthread_cond_destroy(&seq->cond);
+    pthread_mutex_destroy(&seq->lock);
+    seq->started = false;
+
+    return 0;
+}
+
+void buzzer_seq_free(buzzer_seq_t *seq) {
+    free(seq);
+}
+
+bool buzzer_seq_busy(buzzer_seq_t *seq) {
+    bool busy;
+
+    if (!seq->started)
+        return false;
+
+    pthread_mutex_lock(&seq->lock);
+    busy = seq->playing || seq->pending != NULL;
+    pthread_mutex_unlock(&seq->lock);
+
+    return busy;
+}
+
+/* Octave 4 note frequencies in centihertz, C4 through B4 */
+static const uint32_t rtttl_octave4_chz[12] = {
+    26163, 27718, 29366, 31113, 32963, 34923, 36999, 39200, 41530, 44000, 46616, 49388,
+};
+
+static unsigned int rtttl_number(const char **p) {
+    unsigned int value = 0;
+
+    while (isdigit((unsigned char)**p))
+        value = value * 10 + (unsigned int)(*(*p)++ - '0');
+
+    return value;
+}
+
+static void rtttl_skip_space(const char **p) {
+    while (isspace((unsigned char)**p))
+        (*p)++;
+}
+
+int buzzer_parse_rtttl(const char *rtttl, buzzer_note_t *notes, size_t max_notes, size_t *count) {
+    static const int semitones[7] = { 9, 11, 0, 2, 4, 5, 7 }; /* a..g */
+    unsigned int def_duration = 4, def_octave = 6, bpm = 63;
+    const char *p;
+    size_t n = 0;
+
+    if (rtttl == NULL || count == NULL)
+        return BUZZER_SEQ_ERROR_ARG;
+
+    /* Skip the name section */
+    if ((p = strchr(rtttl, ':')) == NULL)
+        return BUZZER_SEQ_ERROR_PARSE;
+    p++;
+
+    /* Defaults section: d=N,o=N,b=N */
+    for (;;) {
+        char key;
+        unsigned int value;
+
+        rtttl_skip_space(&p);
+        if (*p == ':')
+            break;
+
+        key = (char)tolower((unsigned char)*p++);
+        if (*p++ != '=' || !isdigit((unsigned char)*p))
+            return BUZZER_SEQ_ERROR_PARSE;
+        value = rtttl_number(&p);
+
+        if (key == 'd' && value > 0)
+            def_duration = value;
+        else if (key == 'o' && value >= 1 && value <= 8)
+            def_octave = value;
+        else if (key == 'b' && value > 0)
+            bpm = value;
+        else
+            return BUZZER_SEQ_ERROR_PARSE;
+
+        rtttl_skip_space(&p);
+        if (*p == ',')
+            p++;
+        else if (*p != ':')
+            return BUZZER_SEQ_ERROR_PARSE;
+    }
+    p++;
+
+    /* Notes section: [duration]note[#][.][octave][.] */
+    const uint32_t whole_ms = 240000 / bpm;
+
+    for (;;) {
+        unsigned int duration, octave;
+        int semitone = -1;
+        bool dotted = false;
+        char letter;
+
+        rtttl_skip_space(&p);
+        if (*p == '\0')
+            break;
+
+        duration = isdigit((unsigned char)*p) ? rtttl_number(&p) : def_duration;
+        if (duration == 0)
+            return BUZZER_SEQ_ERROR_PARSE;
+
+        letter = (char)tolower((unsigned char)*p++);
+        if (letter >= 'a' && letter <= 'g')
+            semitone = semitones[letter - 'a'];
+        else if (letter != 'p')
+            return BUZZER_SEQ_ERROR_PARSE;
+
+        if (*p == '#') {
+            if (semitone >= 0)
+                semitone++;
+            p++;
+        }
+        if (*p == '.') {
+            dotted = true;
+            p++;
+        }
+
+        octave = isdigit((unsigned char)*p) ? rtttl_number(&p) : def_octave;
+        if (octave < 1 || octave > 8)
+            return BUZZER_SEQ_ERROR_PARSE;
+
+        if (*p == '.') {
+            dotted = true;
+            p++;
+        }
+
+        if (notes != NULL && n < max_notes) {
+            uint32_t duration_ms = whole_ms / duration;
+            uint32_t freq_hz = 0;
+
+            if (dotted)
+                duration_ms += duration_ms / 2;
+
+            if (semitone >= 0) {
+                /* B# rolls over into the next octave */
+                uint32_t chz = rtttl_octave4_chz[semitone % 12];
+                unsigned int oct = octave + (unsigned int)(semitone / 12);
+
+                chz = (oct >= 4) ? chz << (oct - 4) : chz >> (4 - oct);
+                freq_hz = (chz + 50) / 100;
+            }
+
+            notes[n].freq_hz = freq_hz;
+            notes[n].duration_ms = duration_ms;
+            notes[n].volume = BUZZER_SEQ_VOLUME_MAX;
+        }
+        n++;
+
+        rtttl_skip_space(&p);
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return BUZZER_SEQ_ERROR_PARSE;
+    }
+
+    *count = n;
+
+    return 0;
+}
+
+int buzzer_seq_errno(buzzer_seq_t *seq) {
+    return seq->error.c_errno;
+}
+
+const char *buzzer_seq_errmsg(buzzer_seq_t *seq) {
+    return seq->error.errmsg;
+}
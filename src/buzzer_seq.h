@@ -0,0 +1,63 @@
+/*
+ * buzzer_seq.h
+ *
+ * Non-blocking tone/melody sequencer for a buzzer on a sysfs PWM channel.
+ */
+
+#ifndef _BUZZER_SEQ_H
+#define _BUZZER_SEQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pwm.h"
+
+enum buzzer_seq_error_code {
+    BUZZER_SEQ_ERROR_ARG        = -1, /* Invalid arguments */
+    BUZZER_SEQ_ERROR_THREAD     = -2, /* Starting or stopping the playback thread */
+    BUZZER_SEQ_ERROR_PARSE      = -3, /* Malformed RTTTL string */
+    BUZZER_SEQ_ERROR_NO_MEMORY  = -4, /* Allocating the note buffer */
+    BUZZER_SEQ_ERROR_PWM        = -5, /* Programming the PWM */
+};
+
+/* Volume used when a note does not specify one (50% duty cycle) */
+#define BUZZER_SEQ_VOLUME_MAX       100
+
+typedef struct buzzer_note {
+    uint32_t freq_hz;       /* Tone frequency, 0 for a rest */
+    uint32_t duration_ms;   /* Note length */
+    uint8_t volume;         /* 0..100, mapped to 0..50% duty cycle */
+} buzzer_note_t;
+
+typedef struct buzzer_seq buzzer_seq_t;
+
+/* Primary Functions */
+buzzer_seq_t *buzzer_seq_new(void);
+int buzzer_seq_open(buzzer_seq_t *seq, pwm_t *pwm, int rt_priority);
+int buzzer_seq_play(buzzer_seq_t *seq, const buzzer_note_t *notes, size_t count);
+int buzzer_seq_play_rtttl(buzzer_seq_t *seq, const char *rtttl);
+int buzzer_seq_stop(buzzer_seq_t *seq);
+int buzzer_seq_wait(buzzer_seq_t *seq, int timeout_ms);
+int buzzer_seq_close(buzzer_seq_t *seq);
+void buzzer_seq_free(buzzer_seq_t *seq);
+
+/* Miscellaneous */
+bool buzzer_seq_busy(buzzer_seq_t *seq);
+int buzzer_parse_rtttl(const char *rtttl, buzzer_note_t *notes, size_t max_notes, size_t *count);
+
+/* Error Handling, last failed call of the calling thread. A note the playback
+ * thread failed to play is reported by the next buzzer_seq_wait() once the
+ * melody is over, so these never race with the thread. */
+int buzzer_seq_errno(buzzer_seq_t *seq);
+const char *buzzer_seq_errmsg(buzzer_seq_t *seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
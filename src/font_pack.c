@@ -0,0 +1,351 @@
+/*
+ * font_pack.c
+ *
+ * The pack layout is described in 3rdparty/u8g2/tools/font/bdfconv/bdf_pack.c:
+ * a 16 byte header followed by 4 byte aligned records (size, format, name
+ * length, glyph count, data size, name, font data), little endian.
+ *
+ * Opening only maps the file and checks the header, so a process that uses
+ * a few fonts out of a large pack touches a few pages. The first lookup walks
+ * the records once, validates them and builds an open addressing hash table
+ * over the names. The file descriptor is closed right after mmap(), bdfconv
+ * replaces packs with rename() and the mapping keeps the old inode alive.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "font_pack.h"
+
+#define FONT_PACK_MAGIC         "U8G2PACK"
+#define FONT_PACK_VERSION       1
+#define FONT_PACK_HEADER_SIZE   16
+#define FONT_PACK_RECORD_SIZE   12
+
+/* u8g2 font header, see u8g2_read_font_info() */
+#define U8G2_FONT_HEADER_SIZE   23
+
+typedef struct font_pack_entry {
+    const char *name;
+    const uint8_t *font;
+    uint32_t size;
+    uint32_t hash;
+    uint16_t glyphs;
+    uint8_t format;
+} font_pack_entry_t;
+
+struct font_pack {
+    const uint8_t *map;
+    size_t size;
+
+    /* Built on the first lookup */
+    bool indexed;
+    font_pack_entry_t *entries;
+    unsigned int count;
+    uint32_t *slots;            /* Entry index + 1, 0 if empty */
+    uint32_t slot_mask;
+
+    struct {
+        int c_errno;
+        char errmsg[96];
+    } error;
+};
+
+static int _font_pack_error(font_pack_t *pack, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    pack->error.c_errno = c_errno;
+
+    va_start(ap, fmt);
+    vsnprintf(pack->error.errmsg, sizeof(pack->error.errmsg), fmt, ap);
+    va_end(ap);
+
+    /* Tack on strerror() and errno */
+    if (c_errno) {
+        char buf[64] = {0};
+        strerror_r(c_errno, buf, sizeof(buf));
+        snprintf(pack->error.errmsg+strlen(pack->error.errmsg), sizeof(pack->error.errmsg)-strlen(pack->error.errmsg), ": %s [errno %d]", buf, c_errno);
+    }
+
+    return code;
+}
+
+static uint32_t get_u16(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* FNV-1a */
+static uint32_t font_pack_hash(const char *name) {
+    uint32_t h = 2166136261u;
+
+    while (*name)
+        h = (h ^ (uint8_t)*name++) * 16777619u;
+
+    return h;
+}
+
+static const char *font_pack_path(const char *path) {
+    if (path == NULL)
+        path = getenv("FONT_PACK");
+
+    return path ? path : FONT_PACK_DEFAULT_PATH;
+}
+
+static void font_pack_drop_index(font_pack_t *pack) {
+    free(pack->entries);
+    free(pack->slots);
+    pack->entries = NULL;
+    pack->slots = NULL;
+    pack->count = 0;
+    pack->slot_mask = 0;
+    pack->indexed = false;
+}
+
+static void font_pack_insert(font_pack_t *pack, unsigned int index) {
+    font_pack_entry_t *entry = &pack->entries[index];
+    uint32_t slot = entry->hash & pack->slot_mask;
+
+    while (pack->slots[slot]) {
+        font_pack_entry_t *other = &pack->entries[pack->slots[slot] - 1];
+
+        /* A later record with the same name wins */
+        if (other->hash == entry->hash && strcmp(other->name, entry->name) == 0) {
+            pack->slots[slot] = index + 1;
+            return;
+        }
+        slot = (slot + 1) & pack->slot_mask;
+    }
+
+    pack->slots[slot] = index + 1;
+}
+
+static int font_pack_index(font_pack_t *pack) {
+    size_t pos;
+    unsigned int count = 0;
+    uint32_t slots;
+
+    if (pack->indexed)
+        return 0;
+    if (pack->map == NULL)
+        return _font_pack_error(pack, FONT_PACK_ERROR_ARG, 0, "Font pack not open");
+
+    /* Count and validate, the pack may come from anywhere */
+    for (pos = FONT_PACK_HEADER_SIZE; pos < pack->size; ) {
+        const uint8_t *rec = pack->map + pos;
+        uint32_t size, name_len, data_off, data_size;
+
+        if (pack->size - pos < FONT_PACK_RECORD_SIZE)
+            return _font_pack_error(pack, FONT_PACK_ERROR_FORMAT, 0, "Truncated record at offset %zu", pos);
+
+        size = get_u32(rec);
+        name_len = rec[5];
+        data_off = FONT_PACK_RECORD_SIZE + ((name_len + 1 + 3) & ~3u);
+        data_size = get_u32(rec + 8);
+
+        if (size < data_off || (size & 3) || size > pack->size - pos ||
+            data_size > size - data_off || rec[FONT_PACK_RECORD_SIZE + name_len] != '\0' ||
+            rec[4] < FONT_PACK_FORMAT_U8G2 || rec[4] > FONT_PACK_FORMAT_U8G2_FAST ||
+            data_size < (rec[4] == FONT_PACK_FORMAT_U8X8 ? 4 : U8G2_FONT_HEADER_SIZE))
+            return _font_pack_error(pack, FONT_PACK_ERROR_FORMAT, 0, "Corrupt record at offset %zu", pos);
+
+        count++;
+        pos += size;
+    }
+
+    pack->entries = calloc(count ? count : 1, sizeof(font_pack_entry_t));
+    for (slots = 8; slots < 2 * count; slots <<= 1)
+        ;
+    pack->slots = calloc(slots, sizeof(uint32_t));
+    if (pack->entries == NULL || pack->slots == NULL) {
+        font_pack_drop_index(pack);
+        return _font_pack_error(pack, FONT_PACK_ERROR_ALLOC, errno, "Allocating index for %u fonts", count);
+    }
+    pack->slot_mask = slots - 1;
+
+    count = 0;
+    for (pos = FONT_PACK_HEADER_SIZE; pos < pack->size; pos += get_u32(pack->map + pos)) {
+        const uint8_t *rec = pack->map + pos;
+        font_pack_entry_t *entry = &pack->entries[count];
+
+        entry->name = (const char *)rec + FONT_PACK_RECORD_SIZE;
+        entry->font = rec + FONT_PACK_RECORD_SIZE + ((rec[5] + 1 + 3) & ~3u);
+        entry->size = get_u32(rec + 8);
+        entry->hash = font_pack_hash(entry->name);
+        entry->glyphs = (uint16_t)get_u16(rec + 6);
+        entry->format = rec[4];
+
+        font_pack_insert(pack, count++);
+    }
+
+    pack->count = count;
+    pack->indexed = true;
+
+    return 0;
+}
+
+/*********************************************************************************/
+/* Primary Functions */
+/*********************************************************************************/
+
+font_pack_t *font_pack_new(void) {
+    font_pack_t *pack = calloc(1, sizeof(font_pack_t));
+    if (pack == NULL)
+        return NULL;
+
+    return pack;
+}
+
+int font_pack_open(font_pack_t *pack, const char *path) {
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (pack->map)
+        return _font_pack_error(pack, FONT_PACK_ERROR_ARG, 0, "Font pack already open");
+
+    path = font_pack_path(path);
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return _font_pack_error(pack, FONT_PACK_ERROR_OPEN, errno, "Opening font pack %s", path);
+
+    if (fstat(fd, &st) < 0) {
+        int c_errno = errno;
+        close(fd);
+        return _font_pack_error(pack, FONT_PACK_ERROR_OPEN, c_errno, "Querying size of %s", path);
+    }
+    if ((size_t)st.st_size < FONT_PACK_HEADER_SIZE) {
+        close(fd);
+        return _font_pack_error(pack, FONT_PACK_ERROR_FORMAT, 0, "%s is not a font pack", path);
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int c_errno = errno;
+        close(fd);
+        return _font_pack_error(pack, FONT_PACK_ERROR_OPEN, c_errno, "Mapping %s", path);
+    }
+    close(fd);
+
+    if (memcmp(map, FONT_PACK_MAGIC, 8) != 0 || get_u16((const uint8_t *)map + 8) != FONT_PACK_VERSION) {
+        munmap(map, (size_t)st.st_size);
+        return _font_pack_error(pack, FONT_PACK_ERROR_FORMAT, 0, "%s is not a version %d font pack", path, FONT_PACK_VERSION);
+    }
+
+    /* Glyph lookups jump around, readahead would only fault in unused fonts */
+    madvise(map, (size_t)st.st_size, MADV_RANDOM);
+
+    pack->map = map;
+    pack->size = (size_t)st.st_size;
+
+    return 0;
+}
+
+int font_pack_find(font_pack_t *pack, const char *name, const uint8_t **font) {
+    uint32_t hash, slot;
+    int ret;
+
+    if (name == NULL || font == NULL)
+        return _font_pack_error(pack, FONT_PACK_ERROR_ARG, 0, "Invalid arguments");
+
+    if ((ret = font_pack_index(pack)) < 0)
+        return ret;
+
+    hash = font_pack_hash(name);
+    for (slot = hash & pack->slot_mask; pack->slots[slot]; slot = (slot + 1) & pack->slot_mask) {
+        const font_pack_entry_t *entry = &pack->entries[pack->slots[slot] - 1];
+
+        if (entry->hash == hash && strcmp(entry->name, name) == 0) {
+            *font = entry->font;
+            return (int)(pack->slots[slot] - 1);
+        }
+    }
+
+    return _font_pack_error(pack, FONT_PACK_ERROR_NOT_FOUND, 0, "No font %s in the pack", name);
+}
+
+int font_pack_count(font_pack_t *pack) {
+    int ret;
+
+    if ((ret = font_pack_index(pack)) < 0)
+        return ret;
+
+    return (int)pack->count;
+}
+
+int font_pack_info(font_pack_t *pack, unsigned int index, font_pack_info_t *info) {
+    const font_pack_entry_t *entry;
+    int ret;
+
+    if (info == NULL)
+        return _font_pack_error(pack, FONT_PACK_ERROR_ARG, 0, "Invalid arguments");
+
+    if ((ret = font_pack_index(pack)) < 0)
+        return ret;
+
+    if (index >= pack->count)
+        return _font_pack_error(pack, FONT_PACK_ERROR_ARG, 0, "Font index %u out of range", index);
+
+    entry = &pack->entries[index];
+    info->name = entry->name;
+    info->font = entry->font;
+    info->size = entry->size;
+    info->format = entry->format;
+    info->glyphs = entry->glyphs;
+
+    if (entry->format == FONT_PACK_FORMAT_U8X8) {
+        /* first char, last char, tile width, tile height */
+        info->max_width = entry->font[2] * 8;
+        info->max_height = entry->font[3] * 8;
+        info->ascent = 0;
+        info->descent = 0;
+    } else {
+        info->max_width = entry->font[9];
+        info->max_height = entry->font[10];
+        info->ascent = (int8_t)entry->font[13];
+        info->descent = (int8_t)entry->font[14];
+    }
+
+    return 0;
+}
+
+int font_pack_close(font_pack_t *pack) {
+    if (pack->map == NULL)
+        return 0;
+
+    font_pack_drop_index(pack);
+    munmap((void *)pack->map, pack->size);
+    pack->map = NULL;
+    pack->size = 0;
+
+    return 0;
+}
+
+void font_pack_free(font_pack_t *pack) {
+    free(pack);
+}
+
+/*********************************************************************************/
+/* Error Handling */
+/*********************************************************************************/
+
+int font_pack_errno(font_pack_t *pack) {
+    return pack->error.c_errno;
+}
+
+const char *font_pack_errmsg(font_pack_t *pack) {
+    return pack->error.errmsg;
+}
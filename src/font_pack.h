@@ -0,0 +1,71 @@
+/*
+ * font_pack.h
+ *
+ * u8g2 fonts loaded from a font pack file written by bdfconv -P instead of
+ * being linked in as C arrays. The pack is mapped read-only and shared, so all
+ * processes use the same page cache pages and only the glyphs actually drawn
+ * are read from flash. The name index is built on the first lookup, the
+ * returned pointers go straight to u8g2_SetFont() / u8x8_SetFont() and stay
+ * valid until font_pack_close(), also when the pack file is replaced.
+ */
+
+#ifndef _FONT_PACK_H
+#define _FONT_PACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum font_pack_error_code {
+    FONT_PACK_ERROR_ARG         = -1, /* Invalid arguments */
+    FONT_PACK_ERROR_OPEN        = -2, /* Opening or mapping the pack */
+    FONT_PACK_ERROR_FORMAT      = -3, /* Not a font pack or corrupt pack */
+    FONT_PACK_ERROR_NOT_FOUND   = -4, /* No font with this name */
+    FONT_PACK_ERROR_ALLOC       = -5, /* Allocating the index */
+};
+
+/* Same numbers as bdfconv -f */
+enum font_pack_format {
+    FONT_PACK_FORMAT_U8G2       = 1, /* u8g2 font, u8g2_SetFont() */
+    FONT_PACK_FORMAT_U8X8       = 2, /* u8x8 font, u8x8_SetFont() */
+    FONT_PACK_FORMAT_U8G2_FAST  = 3, /* u8g2 fast decode font, u8g2_SetFont() */
+};
+
+/* Pack path, overridden by the FONT_PACK environment variable */
+#define FONT_PACK_DEFAULT_PATH  "/usr/local/share/u8g2/fonts.u8p"
+
+typedef struct font_pack font_pack_t;
+
+typedef struct font_pack_info {
+    const char *name;
+    const uint8_t *font;
+    size_t size;
+    int format;                 /* enum font_pack_format */
+    unsigned int glyphs;
+    int max_width;              /* Font bounding box, 8x tiles for u8x8 fonts */
+    int max_height;
+    int ascent;                 /* Ascent of 'A' and descent of 'g', 0 for u8x8 fonts */
+    int descent;
+} font_pack_info_t;
+
+/* Primary Functions */
+font_pack_t *font_pack_new(void);
+int font_pack_open(font_pack_t *pack, const char *path);
+int font_pack_find(font_pack_t *pack, const char *name, const uint8_t **font);
+int font_pack_count(font_pack_t *pack);
+int font_pack_info(font_pack_t *pack, unsigned int index, font_pack_info_t *info);
+int font_pack_close(font_pack_t *pack);
+void font_pack_free(font_pack_t *pack);
+
+/* Error Handling */
+int font_pack_errno(font_pack_t *pack);
+const char *font_pack_errmsg(font_pack_t *pack);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,525 @@
+/*
+ * led_fx.c
+ *
+ * Layers are rendered into a line buffer and blended into a work frame per
+ * channel. Phases are computed once per frame in Q16 from the frame counter,
+ * per LED work is a few integer operations on packed 0xWWRRGGBB words. The
+ * finished frame is compared with the last one written to channel[].leds and
+ * only copied (and rendered by led_fx_step()) when it differs.
+ *
+ * The frame buffers are sized at led_fx_open(). A channel grown later with
+ * ws2811_set_led_count() is only drawn up to its count at open, reopen to
+ * use the new LEDs.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <time.h>
+
+#include "led_fx.h"
+
+typedef struct led_fx_slot {
+    int id;
+    led_fx_layer_t layer;
+    ws2811_led_t *palette;      /* Own copy of layer.palette */
+    uint64_t t0_ms;             /* Frame clock time the layer starts at */
+} led_fx_slot_t;
+
+struct led_fx {
+    ws2811_t *ws2811;
+    unsigned int fps;
+    uint32_t frame;
+    int next_id;
+
+    led_fx_slot_t slots[LED_FX_MAX_LAYERS];
+    size_t slot_count;
+
+    ws2811_led_t *work[RPI_PWM_CHANNELS];
+    ws2811_led_t *last[RPI_PWM_CHANNELS];
+    int count[RPI_PWM_CHANNELS];  /* LEDs per channel at open, size of work[] and last[] */
+    ws2811_led_t *line;
+    bool written;
+
+    struct timespec deadline;
+    bool clock_started;
+
+    uint32_t compute_us;
+    uint32_t compute_max_us;
+
+    struct {
+        int c_errno;
+        char errmsg[96];
+    } error;
+};
+
+static int _led_fx_error(led_fx_t *fx, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    fx->error.c_errno = c_errno;
+
+    va_start(ap, fmt);
+    vsnprintf(fx->error.errmsg, sizeof(fx->error.errmsg), fmt, ap);
+    va_end(ap);
+
+    /* Tack on strerror() and errno */
+    if (c_errno) {
+        char buf[64] = {0};
+        strerror_r(c_errno, buf, sizeof(buf));
+        snprintf(fx->error.errmsg+strlen(fx->error.errmsg), sizeof(fx->error.errmsg)-strlen(fx->error.errmsg), ": %s [errno %d]", buf, c_errno);
+    }
+
+    return code;
+}
+
+/*********************************************************************************/
+/* Packed color helpers */
+/*********************************************************************************/
+
+/* a towards b by w/256, two colors per multiply */
+static inline ws2811_led_t color_lerp(ws2811_led_t a, ws2811_led_t b, uint32_t w) {
+    uint32_t iw = 256 - w;
+    uint32_t rb = (((a & 0x00ff00ff) * iw + (b & 0x00ff00ff) * w) >> 8) & 0x00ff00ff;
+    uint32_t wg = ((((a >> 8) & 0x00ff00ff) * iw + ((b >> 8) & 0x00ff00ff) * w)) & 0xff00ff00;
+
+    return rb | wg;
+}
+
+static inline ws2811_led_t color_scale(ws2811_led_t c, uint32_t w) {
+    return color_lerp(0, c, w);
+}
+
+static inline ws2811_led_t color_add(ws2811_led_t a, ws2811_led_t b) {
+    ws2811_led_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff);
+        out |= (sum > 0xff ? 0xff : sum) << shift;
+    }
+
+    return out;
+}
+
+static inline ws2811_led_t color_multiply(ws2811_led_t a, ws2811_led_t b) {
+    ws2811_led_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8)
+        out |= ((((a >> shift) & 0xff) * (((b >> shift) & 0xff) + 1)) >> 8) << shift;
+
+    return out;
+}
+
+static inline ws2811_led_t color_max(ws2811_led_t a, ws2811_led_t b) {
+    ws2811_led_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t ca = (a >> shift) & 0xff;
+        uint32_t cb = (b >> shift) & 0xff;
+        out |= (ca > cb ? ca : cb) << shift;
+    }
+
+    return out;
+}
+
+/* Q16 triangle 0 -> 1 -> 0 over one Q16 phase */
+static inline uint32_t phase_triangle(uint32_t phase) {
+    phase &= 0xffff;
+    return phase < 0x8000 ? phase * 2 : (0xffff - phase) * 2;
+}
+
+/* Q16 smoothstep, 3x^2 - 2x^3 */
+static inline uint32_t phase_smooth(uint32_t x) {
+    uint64_t x2 = ((uint64_t)x * x) >> 16;
+    return (uint32_t)((x2 * (3 * 0x10000 - 2 * (uint64_t)x)) >> 16);
+}
+
+/*********************************************************************************/
+/* Layer kernels */
+/*********************************************************************************/
+
+static void led_fx_generate(const led_fx_slot_t *slot, ws2811_led_t *line, int count, uint32_t phase) {
+    const led_fx_layer_t *layer = &slot->layer;
+    uint32_t step = count > 1 ? 0x10000 / (uint32_t)count : 0;
+    uint32_t pos;
+    int i;
+
+    switch (layer->kind) {
+        case LED_FX_SOLID:
+            for (i = 0; i < count; i++)
+                line[i] = layer->color[0];
+            break;
+
+        case LED_FX_GRADIENT:
+            if (layer->period_ms == 0) {
+                /* Still gradient, end to end */
+                step = count > 1 ? 0x10000 / (uint32_t)(count - 1) : 0;
+                for (i = 0, pos = 0; i < count; i++, pos += step)
+                    line[i] = color_lerp(layer->color[0], layer->color[1], pos >= 0x10000 ? 256 : pos >> 8);
+            } else {
+                /* Scrolling gradient there and back so it wraps seamlessly */
+                for (i = 0, pos = phase; i < count; i++, pos += step)
+                    line[i] = color_lerp(layer->color[0], layer->color[1], phase_triangle(pos) >> 8);
+            }
+            break;
+
+        case LED_FX_CHASE: {
+            int head = (int)(((uint64_t)phase * (uint32_t)count) >> 16);
+            int width = layer->width ? layer->width : 1;
+
+            for (i = 0; i < count; i++)
+                line[i] = layer->color[1];
+            for (i = 0; i < width && i < count; i++) {
+                int idx = head + i;
+                if (idx >= count)
+                    idx -= count;
+                line[idx] = layer->color[0];
+            }
+            break;
+        }
+
+        case LED_FX_BREATHE: {
+            ws2811_led_t c = color_scale(layer->color[0], phase_smooth(phase_triangle(phase)) >> 8);
+            for (i = 0; i < count; i++)
+                line[i] = c;
+            break;
+        }
+
+        case LED_FX_PALETTE: {
+            uint32_t n = (uint32_t)layer->palette_len;
+
+            for (i = 0, pos = phase; i < count; i++, pos += step) {
+                uint32_t x = (pos & 0xffff) * n;
+                uint32_t idx = x >> 16;
+                uint32_t next = idx + 1 < n ? idx + 1 : 0;
+                line[i] = color_lerp(slot->palette[idx], slot->palette[next], (x & 0xffff) >> 8);
+            }
+            break;
+        }
+    }
+}
+
+static void led_fx_blend(const led_fx_layer_t *layer, ws2811_led_t *dst, const ws2811_led_t *src, int count) {
+    uint32_t w = layer->opacity + (layer->opacity >> 7);   /* 0..256 */
+    int i;
+
+    if (w == 0)
+        return;
+
+    switch (layer->blend) {
+        case LED_FX_BLEND_NORMAL:
+            if (w == 256)
+                memcpy(dst, src, (size_t)count * sizeof(*dst));
+            else
+                for (i = 0; i < count; i++)
+                    dst[i] = color_lerp(dst[i], src[i], w);
+            break;
+
+        case LED_FX_BLEND_ADD:
+            for (i = 0; i < count; i++)
+                dst[i] = color_add(dst[i], w == 256 ? src[i] : color_scale(src[i], w));
+            break;
+
+        case LED_FX_BLEND_MULTIPLY:
+            for (i = 0; i < count; i++)
+                dst[i] = color_lerp(dst[i], color_multiply(dst[i], src[i]), w);
+            break;
+
+        case LED_FX_BLEND_MAX:
+            for (i = 0; i < count; i++)
+                dst[i] = color_lerp(dst[i], color_max(dst[i], src[i]), w);
+            break;
+    }
+}
+
+/*********************************************************************************/
+/* Primary Functions */
+/*********************************************************************************/
+
+led_fx_t *led_fx_new(void) {
+    led_fx_t *fx = calloc(1, sizeof(led_fx_t));
+    if (fx == NULL)
+        return NULL;
+
+    return fx;
+}
+
+int led_fx_open(led_fx_t *fx, ws2811_t *ws2811, unsigned int fps) {
+    int max_count = 0;
+
+    if (ws2811 == NULL || fps == 0 || fps > 1000)
+        return _led_fx_error(fx, LED_FX_ERROR_ARG, 0, "Invalid ws2811 handle or frame rate (1..1000 fps)");
+
+    memset(fx, 0, sizeof(*fx));
+    fx->ws2811 = ws2811;
+    fx->fps = fps;
+    fx->next_id = 1;
+
+    for (int chan = 0; chan < RPI_PWM_CHANNELS; chan++) {
+        int count = ws2811->channel[chan].count;
+
+        if (count > max_count)
+            max_count = count;
+        if (count == 0)
+            continue;
+
+        fx->count[chan] = count;
+        fx->work[chan] = calloc((size_t)count, sizeof(ws2811_led_t));
+        fx->last[chan] = calloc((size_t)count, sizeof(ws2811_led_t));
+        if (fx->work[chan] == NULL || fx->last[chan] == NULL) {
+            led_fx_close(fx);
+            return _led_fx_error(fx, LED_FX_ERROR_NO_MEMORY, errno, "Allocating frame buffers");
+        }
+    }
+
+    fx->line = calloc(max_count ? (size_t)max_count : 1, sizeof(ws2811_led_t));
+    if (fx->line == NULL) {
+        led_fx_close(fx);
+        return _led_fx_error(fx, LED_FX_ERROR_NO_MEMORY, errno, "Allocating line buffer");
+    }
+
+    return 0;
+}
+
+/* LEDs of a channel that fit both the buffers and the (possibly resized) channel */
+static int led_fx_channel_count(const led_fx_t *fx, int chan) {
+    int count = fx->ws2811->channel[chan].count;
+
+    return count < fx->count[chan] ? count : fx->count[chan];
+}
+
+static uint64_t led_fx_now_ms(led_fx_t *fx) {
+    return (uint64_t)fx->frame * 1000 / fx->fps;
+}
+
+int led_fx_add(led_fx_t *fx, const led_fx_layer_t *layer, int *id) {
+    led_fx_slot_t *slot;
+    int channel_count;
+
+    if (layer == NULL || layer->channel < 0 || layer->channel >= RPI_PWM_CHANNELS)
+        return _led_fx_error(fx, LED_FX_ERROR_ARG, 0, "Invalid layer or channel");
+
+    channel_count = led_fx_channel_count(fx, layer->channel);
+    if (layer->first < 0 || layer->count < 0 || layer->first + layer->count > channel_count)
+        return _led_fx_error(fx, LED_FX_ERROR_ARG, 0, "LED range %d+%d outside channel %d (%d LEDs)",
+                             layer->first, layer->count, layer->channel, channel_count);
+
+    if (layer->kind == LED_FX_PALETTE && (layer->palette == NULL || layer->palette_len == 0 || layer->palette_len > 0xffff))
+        return _led_fx_error(fx, LED_FX_ERROR_ARG, 0, "Palette layer without palette");
+
+    if (fx->slot_count == LED_FX_MAX_LAYERS)
+        return _led_fx_error(fx, LED_FX_ERROR_FULL, 0, "All %d layers in use", LED_FX_MAX_LAYERS);
+
+    slot = &fx->slots[fx->slot_count];
+    memset(slot, 0, sizeof(*slot));
+    slot->layer = *layer;
+    slot->layer.palette = NULL;
+
+    if (layer->kind == LED_FX_PALETTE) {
+        slot->palette = malloc(layer->palette_len * sizeof(ws2811_led_t));
+        if (slot->palette == NULL)
+            return _led_fx_error(fx, LED_FX_ERROR_NO_MEMORY, errno, "Allocating palette");
+        memcpy(slot->palette, layer->palette, layer->palette_len * sizeof(ws2811_led_t));
+    }
+
+    slot->id = fx->next_id++;
+    slot->t0_ms = led_fx_now_ms(fx) + layer->start_ms;
+    fx->slot_count++;
+
+    if (id)
+        *id = slot->id;
+
+    return 0;
+}
+
+static void led_fx_drop(led_fx_t *fx, size_t index) {
+    free(fx->slots[index].palette);
+    memmove(&fx->slots[index], &fx->slots[index + 1], (fx->slot_count - index - 1) * sizeof(led_fx_slot_t));
+    fx->slot_count--;
+}
+
+int led_fx_remove(led_fx_t *fx, int id) {
+    for (size_t i = 0; i < fx->slot_count; i++) {
+        if (fx->slots[i].id == id) {
+            led_fx_drop(fx, i);
+            return 0;
+        }
+    }
+
+    return _led_fx_error(fx, LED_FX_ERROR_NOT_FOUND, 0, "No layer %d", id);
+}
+
+int led_fx_tick(led_fx_t *fx, bool *changed) {
+    ws2811_t *ws2811 = fx->ws2811;
+    uint64_t now_ms = led_fx_now_ms(fx);
+    struct timespec t0, t1;
+    bool differs = false;
+    uint32_t us;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (int chan = 0; chan < RPI_PWM_CHANNELS; chan++) {
+        if (fx->work[chan])
+            memset(fx->work[chan], 0, (size_t)led_fx_channel_count(fx, chan) * sizeof(ws2811_led_t));
+    }
+
+    for (size_t i = 0; i < fx->slot_count; ) {
+        led_fx_slot_t *slot = &fx->slots[i];
+        const led_fx_layer_t *layer = &slot->layer;
+        uint64_t t;
+        uint32_t phase = 0;
+        int limit = led_fx_channel_count(fx, layer->channel);
+        int count;
+
+        if (now_ms < slot->t0_ms) {
+            i++;
+            continue;
+        }
+
+        t = now_ms - slot->t0_ms;
+        if (layer->duration_ms && t >= layer->duration_ms) {
+            led_fx_drop(fx, i);
+            continue;
+        }
+
+        if (layer->period_ms)
+            phase = (uint32_t)(((t % layer->period_ms) << 16) / layer->period_ms);
+
+        count = layer->count ? layer->count : limit - layer->first;
+        if (layer->first + count > limit)
+            count = limit - layer->first;
+        if (count <= 0) {
+            i++;
+            continue;
+        }
+        led_fx_generate(slot, fx->line, count, phase);
+        led_fx_blend(layer, fx->work[layer->channel] + layer->first, fx->line, count);
+        i++;
+    }
+
+    for (int chan = 0; chan < RPI_PWM_CHANNELS; chan++) {
+        size_t size = (size_t)led_fx_channel_count(fx, chan) * sizeof(ws2811_led_t);
+        ws2811_led_t *swap;
+
+        if (fx->work[chan] == NULL)
+            continue;
+        if (fx->written && memcmp(fx->work[chan], fx->last[chan], size) == 0)
+            continue;
+
+        memcpy(ws2811->channel[chan].leds, fx->work[chan], size);
+        swap = fx->last[chan];
+        fx->last[chan] = fx->work[chan];
+        fx->work[chan] = swap;
+        differs = true;
+    }
+    fx->written = true;
+    fx->frame++;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    us = (uint32_t)((t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000);
+    fx->compute_us = us;
+    if (us > fx->compute_max_us)
+        fx->compute_max_us = us;
+
+    if (changed)
+        *changed = differs;
+
+    return 0;
+}
+
+static void timespec_add_ns(struct timespec *ts, uint64_t ns) {
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+int led_fx_step(led_fx_t *fx) {
+    uint64_t frame_ns = 1000000000ULL / fx->fps;
+    struct timespec now;
+    bool changed;
+    ws2811_return_t ret;
+
+    /* Absolute frame deadlines, a late frame does not delay the next ones.
+     * When more than a frame behind, the frame counter catches up so
+     * animations keep their wall clock speed. */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!fx->clock_started) {
+        fx->deadline = now;
+        fx->clock_started = true;
+    } else {
+        uint32_t dropped = 0;
+
+        timespec_add_ns(&fx->deadline, frame_ns);
+        while ((now.tv_sec - fx->deadline.tv_sec) * 1000000000LL + (now.tv_nsec - fx->deadline.tv_nsec) > (int64_t)frame_ns) {
+            timespec_add_ns(&fx->deadline, frame_ns);
+            fx->frame++;
+            dropped++;
+        }
+        if (dropped)
+            ws2811_stats_skipped(fx->ws2811, dropped);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &fx->deadline, NULL) == EINTR)
+            ;
+    }
+
+    led_fx_tick(fx, &changed);
+    if (!changed)
+        return 0;
+
+    if ((ret = ws2811_render(fx->ws2811)) != WS2811_SUCCESS)
+        return _led_fx_error(fx, LED_FX_ERROR_RENDER, 0, "ws2811_render: %s", ws2811_get_return_t_str(ret));
+
+    return 1;
+}
+
+int led_fx_close(led_fx_t *fx) {
+    while (fx->slot_count)
+        led_fx_drop(fx, fx->slot_count - 1);
+
+    for (int chan = 0; chan < RPI_PWM_CHANNELS; chan++) {
+        free(fx->work[chan]);
+        free(fx->last[chan]);
+        fx->work[chan] = NULL;
+        fx->last[chan] = NULL;
+    }
+    free(fx->line);
+    fx->line = NULL;
+    fx->ws2811 = NULL;
+
+    return 0;
+}
+
+void led_fx_free(led_fx_t *fx) {
+    free(fx);
+}
+
+/*********************************************************************************/
+/* Miscellaneous */
+/*********************************************************************************/
+
+uint32_t led_fx_frame(led_fx_t *fx) {
+    return fx->frame;
+}
+
+uint32_t led_fx_compute_us(led_fx_t *fx) {
+    return fx->compute_us;
+}
+
+uint32_t led_fx_compute_max_us(led_fx_t *fx) {
+    return fx->compute_max_us;
+}
+
+/*********************************************************************************/
+/* Error Handling */
+/*********************************************************************************/
+
+int led_fx_errno(led_fx_t *fx) {
+    return fx->error.c_errno;
+}
+
+const char *led_fx_errmsg(led_fx_t *fx) {
+    return fx->error.errmsg;
+}
@@ -0,0 +1,88 @@
+/*
+ * led_fx.h
+ *
+ * Effects engine for LED strips driven by rpi_ws281x. A timeline of layers
+ * (solid, gradient, chase, breathe, palette cycle) is composited bottom to top
+ * into channel[].leds on a fixed frame clock, using integer math only.
+ */
+
+#ifndef _LED_FX_H
+#define _LED_FX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ws2811.h"
+
+enum led_fx_error_code {
+    LED_FX_ERROR_ARG            = -1, /* Invalid arguments */
+    LED_FX_ERROR_NO_MEMORY      = -2, /* Allocating frame or palette buffers */
+    LED_FX_ERROR_FULL           = -3, /* All layer slots in use */
+    LED_FX_ERROR_NOT_FOUND      = -4, /* No layer with that id */
+    LED_FX_ERROR_RENDER         = -5, /* ws2811_render() failed */
+};
+
+#define LED_FX_MAX_LAYERS       16
+
+typedef enum led_fx_kind {
+    LED_FX_SOLID,       /* color[0] */
+    LED_FX_GRADIENT,    /* color[0] to color[1] across the range, scrolls if period_ms is set */
+    LED_FX_CHASE,       /* width LEDs of color[0] on color[1], once around the range per period */
+    LED_FX_BREATHE,     /* color[0] fading in and out once per period */
+    LED_FX_PALETTE,     /* palette spread over the range, rotating once per period */
+} led_fx_kind_t;
+
+typedef enum led_fx_blend {
+    LED_FX_BLEND_NORMAL,    /* Cover what is below, weighted by opacity */
+    LED_FX_BLEND_ADD,       /* Saturating add */
+    LED_FX_BLEND_MULTIPLY,  /* Darken what is below */
+    LED_FX_BLEND_MAX,       /* Brightest of both per color */
+} led_fx_blend_t;
+
+typedef struct led_fx_layer {
+    led_fx_kind_t kind;
+    led_fx_blend_t blend;
+    uint8_t opacity;                /* 0..255 */
+    int channel;                    /* ws2811 channel */
+    int first;                      /* First LED of the range */
+    int count;                      /* LEDs in the range, 0 for the rest of the channel */
+    ws2811_led_t color[2];
+    const ws2811_led_t *palette;    /* Copied by led_fx_add() */
+    size_t palette_len;
+    uint32_t period_ms;             /* Cycle length, 0 for a still layer */
+    uint16_t width;                 /* Chase length in LEDs */
+    uint32_t start_ms;              /* Delay after led_fx_add() */
+    uint32_t duration_ms;           /* Removed after this long, 0 to keep it */
+} led_fx_layer_t;
+
+typedef struct led_fx led_fx_t;
+
+/* Primary Functions */
+led_fx_t *led_fx_new(void);
+int led_fx_open(led_fx_t *fx, ws2811_t *ws2811, unsigned int fps);
+int led_fx_add(led_fx_t *fx, const led_fx_layer_t *layer, int *id);
+int led_fx_remove(led_fx_t *fx, int id);
+int led_fx_tick(led_fx_t *fx, bool *changed);
+int led_fx_step(led_fx_t *fx);
+int led_fx_close(led_fx_t *fx);
+void led_fx_free(led_fx_t *fx);
+
+/* Miscellaneous */
+uint32_t led_fx_frame(led_fx_t *fx);
+uint32_t led_fx_compute_us(led_fx_t *fx);
+uint32_t led_fx_compute_max_us(led_fx_t *fx);
+
+/* Error Handling */
+int led_fx_errno(led_fx_t *fx);
+const char *led_fx_errmsg(led_fx_t *fx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * led_matrix.c
+ *
+ * The remap table holds, for each LED in wiring order, its offset from the
+ * top left pixel of the viewport in the canvas. ws2811 reads
+ * channel->source[remap[i]], so scrolling only moves channel->source.
+ */
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+
+#include "led_matrix.h"
+
+struct led_matrix {
+    ws2811_channel_t *channel;
+    ws2811_led_t *canvas;
+    unsigned int canvas_width;
+    unsigned int canvas_height;
+    unsigned int width;         /* Display size after rotation */
+    unsigned int height;
+    uint32_t *remap;
+
+    struct {
+        int c_errno;
+        char errmsg[96];
+    } error;
+};
+
+static int _led_matrix_error(led_matrix_t *matrix, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    matrix->error.c_errno = c_errno;
+
+    va_start(ap, fmt);
+    vsnprintf(matrix->error.errmsg, sizeof(matrix->error.errmsg), fmt, ap);
+    va_end(ap);
+
+    /* Tack on strerror() and errno */
+    if (c_errno) {
+        char buf[64] = {0};
+        strerror_r(c_errno, buf, sizeof(buf));
+        snprintf(matrix->error.errmsg+strlen(matrix->error.errmsg), sizeof(matrix->error.errmsg)-strlen(matrix->error.errmsg), ": %s [errno %d]", buf, c_errno);
+    }
+
+    return code;
+}
+
+led_matrix_t *led_matrix_new(void) {
+    led_matrix_t *matrix = calloc(1, sizeof(led_matrix_t));
+    if (matrix == NULL)
+        return NULL;
+
+    return matrix;
+}
+
+/* Position of LED index in the unrotated grid of all panels */
+static void led_matrix_physical(const led_matrix_layout_t *layout, unsigned int tiles_x, unsigned int index,
+                                unsigned int *px, unsigned int *py) {
+    unsigned int panel = layout->width * layout->height;
+    unsigned int tile = index / panel;
+    unsigned int k = index % panel;
+    unsigned int tx = tile % tiles_x;
+    unsigned int ty = tile / tiles_x;
+    unsigned int row, col;
+
+    if ((layout->flags & LED_MATRIX_TILES_SERPENTINE) && (ty & 1))
+        tx = tiles_x - 1 - tx;
+
+    if (layout->flags & LED_MATRIX_COLUMNS) {
+        col = k / layout->height;
+        row = k % layout->height;
+        if ((layout->flags & LED_MATRIX_SERPENTINE) && (col & 1))
+            row = layout->height - 1 - row;
+    } else {
+        row = k / layout->width;
+        col = k % layout->width;
+        if ((layout->flags & LED_MATRIX_SERPENTINE) && (row & 1))
+            col = layout->width - 1 - col;
+    }
+
+    *px = tx * layout->width + col;
+    *py = ty * layout->height + row;
+}
+
+int led_matrix_open(led_matrix_t *matrix, ws2811_t *ws2811, int channel, const led_matrix_layout_t *layout,
+                    unsigned int canvas_width, unsigned int canvas_height) {
+    unsigned int tiles_x, tiles_y, pw, ph, count;
+
+    if (ws2811 == NULL || layout == NULL || channel < 0 || channel >= RPI_PWM_CHANNELS)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_ARG, 0, "Invalid ws2811 handle, layout or channel");
+    if (layout->width == 0 || layout->height == 0)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_ARG, 0, "Invalid panel size");
+    if (layout->rotation % 90 || layout->rotation >= 360)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_ARG, 0, "Invalid rotation %u", layout->rotation);
+
+    memset(matrix, 0, sizeof(*matrix));
+
+    tiles_x = layout->tiles_x ? layout->tiles_x : 1;
+    tiles_y = layout->tiles_y ? layout->tiles_y : 1;
+    pw = layout->width * tiles_x;
+    ph = layout->height * tiles_y;
+    count = pw * ph;
+
+    if ((int)count != ws2811->channel[channel].count)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_LAYOUT, 0, "Layout has %u LEDs, channel %d has %d",
+                                 count, channel, ws2811->channel[channel].count);
+
+    matrix->width = (layout->rotation == 90 || layout->rotation == 270) ? ph : pw;
+    matrix->height = (layout->rotation == 90 || layout->rotation == 270) ? pw : ph;
+
+    if (canvas_width == 0)
+        canvas_width = matrix->width;
+    if (canvas_height == 0)
+        canvas_height = matrix->height;
+    if (canvas_width < matrix->width || canvas_height < matrix->height)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_ARG, 0, "Canvas %ux%u smaller than the display %ux%u",
+                                 canvas_width, canvas_height, matrix->width, matrix->height);
+
+    matrix->canvas = calloc((size_t)canvas_width * canvas_height, sizeof(ws2811_led_t));
+    matrix->remap = malloc(count * sizeof(uint32_t));
+    if (matrix->canvas == NULL || matrix->remap == NULL) {
+        int c_errno = errno;
+        led_matrix_close(matrix);
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_NO_MEMORY, c_errno, "Allocating canvas");
+    }
+    matrix->canvas_width = canvas_width;
+    matrix->canvas_height = canvas_height;
+
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int px, py, lx, ly;
+
+        led_matrix_physical(layout, tiles_x, i, &px, &py);
+
+        if (layout->flags & LED_MATRIX_MIRROR_X)
+            px = pw - 1 - px;
+        if (layout->flags & LED_MATRIX_MIRROR_Y)
+            py = ph - 1 - py;
+
+        switch (layout->rotation) {
+            case 90:
+                lx = ph - 1 - py;
+                ly = px;
+                break;
+            case 180:
+                lx = pw - 1 - px;
+                ly = ph - 1 - py;
+                break;
+            case 270:
+                lx = py;
+                ly = pw - 1 - px;
+                break;
+            default:
+                lx = px;
+                ly = py;
+                break;
+        }
+
+        matrix->remap[i] = ly * canvas_width + lx;
+    }
+
+    matrix->channel = &ws2811->channel[channel];
+    matrix->channel->remap = matrix->remap;
+    matrix->channel->source = matrix->canvas;
+
+    return 0;
+}
+
+int led_matrix_scroll(led_matrix_t *matrix, unsigned int x, unsigned int y) {
+    if (x > matrix->canvas_width - matrix->width || y > matrix->canvas_height - matrix->height)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_ARG, 0, "Viewport %u,%u outside the canvas", x, y);
+
+    matrix->channel->source = matrix->canvas + (size_t)y * matrix->canvas_width + x;
+
+    return 0;
+}
+
+int led_matrix_blit(led_matrix_t *matrix, int x, int y, unsigned int width, unsigned int height,
+                    const ws2811_led_t *src, size_t src_stride) {
+    long x0 = x, y0 = y, x1 = (long)x + width, y1 = (long)y + height;
+
+    if (src == NULL || src_stride < width)
+        return _led_matrix_error(matrix, LED_MATRIX_ERROR_ARG, 0, "Invalid source or stride");
+
+    /* Clip to the canvas */
+    if (x0 < 0) {
+        src += -x0;
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        src += (size_t)(-y0) * src_stride;
+        y0 = 0;
+    }
+    if (x1 > (long)matrix->canvas_width)
+        x1 = matrix->canvas_width;
+    if (y1 > (long)matrix->canvas_height)
+        y1 = matrix->canvas_height;
+    if (x1 <= x0 || y1 <= y0)
+        return 0;
+
+    for (long row = y0; row < y1; row++, src += src_stride)
+        memcpy(matrix->canvas + row * matrix->canvas_width + x0, src, (size_t)(x1 - x0) * sizeof(ws2811_led_t));
+
+    return 0;
+}
+
+int led_matrix_fill(led_matrix_t *matrix, ws2811_led_t color) {
+    size_t n = (size_t)matrix->canvas_width * matrix->canvas_height;
+
+    for (size_t i = 0; i < n; i++)
+        matrix->canvas[i] = color;
+
+    return 0;
+}
+
+int led_matrix_close(led_matrix_t *matrix) {
+    /* Hand the channel back to leds[] */
+    if (matrix->channel) {
+        matrix->channel->source = NULL;
+        matrix->channel->remap = NULL;
+        matrix->channel = NULL;
+    }
+
+    free(matrix->canvas);
+    free(matrix->remap);
+    matrix->canvas = NULL;
+    matrix->remap = NULL;
+
+    return 0;
+}
+
+void led_matrix_free(led_matrix_t *matrix) {
+    free(matrix);
+}
+
+/*********************************************************************************/
+/* Getters */
+/*********************************************************************************/
+
+ws2811_led_t *led_matrix_canvas(led_matrix_t *matrix) {
+    return matrix->canvas;
+}
+
+unsigned int led_matrix_canvas_width(led_matrix_t *matrix) {
+    return matrix->canvas_width;
+}
+
+unsigned int led_matrix_canvas_height(led_matrix_t *matrix) {
+    return matrix->canvas_height;
+}
+
+unsigned int led_matrix_width(led_matrix_t *matrix) {
+    return matrix->width;
+}
+
+unsigned int led_matrix_height(led_matrix_t *matrix) {
+    return matrix->height;
+}
+
+/*********************************************************************************/
+/* Error Handling */
+/*********************************************************************************/
+
+int led_matrix_errno(led_matrix_t *matrix) {
+    return matrix->error.c_errno;
+}
+
+const char *led_matrix_errmsg(led_matrix_t *matrix) {
+    return matrix->error.errmsg;
+}
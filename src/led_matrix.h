@@ -0,0 +1,73 @@
+/*
+ * led_matrix.h
+ *
+ * 2D LED matrix on one rpi_ws281x channel. The panel wiring (serpentine,
+ * column order, mirroring, rotation, tiled panels) is turned into a physical
+ * index -> canvas index table once, and the ws2811 encoder reads the canvas
+ * through that table, so frames are never copied into leds[]. The canvas may
+ * be larger than the display, scrolling moves the viewport pointer.
+ */
+
+#ifndef _LED_MATRIX_H
+#define _LED_MATRIX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ws2811.h"
+
+enum led_matrix_error_code {
+    LED_MATRIX_ERROR_ARG        = -1, /* Invalid arguments */
+    LED_MATRIX_ERROR_NO_MEMORY  = -2, /* Allocating the canvas or remap table */
+    LED_MATRIX_ERROR_LAYOUT     = -3, /* Layout does not match the channel LED count */
+};
+
+/* Layout flags */
+#define LED_MATRIX_SERPENTINE       0x01    /* Every other row (column) runs backwards */
+#define LED_MATRIX_COLUMNS          0x02    /* LEDs are wired column by column */
+#define LED_MATRIX_MIRROR_X         0x04
+#define LED_MATRIX_MIRROR_Y         0x08
+#define LED_MATRIX_TILES_SERPENTINE 0x10    /* Every other row of panels runs backwards */
+
+typedef struct led_matrix_layout {
+    unsigned int width;         /* LEDs per panel row */
+    unsigned int height;        /* LED rows per panel */
+    unsigned int tiles_x;       /* Panels side by side, 0 for 1 */
+    unsigned int tiles_y;       /* Rows of panels, 0 for 1 */
+    unsigned int flags;         /* LED_MATRIX_xxx */
+    unsigned int rotation;      /* 0, 90, 180 or 270 degrees clockwise */
+} led_matrix_layout_t;
+
+typedef struct led_matrix led_matrix_t;
+
+/* Primary Functions */
+led_matrix_t *led_matrix_new(void);
+int led_matrix_open(led_matrix_t *matrix, ws2811_t *ws2811, int channel, const led_matrix_layout_t *layout,
+                    unsigned int canvas_width, unsigned int canvas_height);
+int led_matrix_scroll(led_matrix_t *matrix, unsigned int x, unsigned int y);
+int led_matrix_blit(led_matrix_t *matrix, int x, int y, unsigned int width, unsigned int height,
+                    const ws2811_led_t *src, size_t src_stride);
+int led_matrix_fill(led_matrix_t *matrix, ws2811_led_t color);
+int led_matrix_close(led_matrix_t *matrix);
+void led_matrix_free(led_matrix_t *matrix);
+
+/* Getters */
+ws2811_led_t *led_matrix_canvas(led_matrix_t *matrix);
+unsigned int led_matrix_canvas_width(led_matrix_t *matrix);
+unsigned int led_matrix_canvas_height(led_matrix_t *matrix);
+unsigned int led_matrix_width(led_matrix_t *matrix);
+unsigned int led_matrix_height(led_matrix_t *matrix);
+
+/* Error Handling */
+int led_matrix_errno(led_matrix_t *matrix);
+const char *led_matrix_errmsg(led_matrix_t *matrix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,492 @@
+/*
+ * led_shm.c
+ *
+ * Every region is a classic triple buffer. The client draws into its back
+ * buffer, the server reads its front buffer, the middle one is handed over.
+ * Middle index, front index and a fresh flag share one atomic word, so commit
+ * (back <-> middle, set fresh) and collect (middle <-> front, clear fresh) are
+ * single compare-and-swaps and the three indices always stay distinct, also
+ * while a region changes owner.
+ *
+ * The server sleeps on a futex on the commit counter when no region is fresh.
+ * Clients only make the wake syscall when the server announced it is asleep.
+ * Claims and releases are serialized with flock() on the segment, dead
+ * clients are released when the next claim or server wait notices them.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "led_shm.h"
+
+#define LED_SHM_MAGIC           0x5344454c  /* "LEDS" */
+#define LED_SHM_VERSION         1
+
+/* Region state word: middle buffer index, fresh flag, front buffer index */
+#define STATE_MIDDLE(s)         ((s) & 0x3)
+#define STATE_FRESH             0x4
+#define STATE_FRONT(s)          (((s) >> 4) & 0x3)
+#define STATE(middle, front)    ((uint32_t)(middle) | ((uint32_t)(front) << 4))
+
+typedef struct led_shm_region {
+    _Atomic uint32_t state;
+    _Atomic int32_t pid;        /* Owner, 0 if free */
+    int32_t channel;
+    int32_t first;
+    int32_t count;
+} led_shm_region_t;
+
+typedef struct led_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t buffer_leds;       /* LEDs per buffer, the longest channel */
+    int32_t channel_count[RPI_PWM_CHANNELS];
+    _Atomic uint32_t seq;       /* Commit counter, futex word */
+    _Atomic uint32_t waiting;   /* Server is asleep on seq */
+    led_shm_region_t regions[LED_SHM_MAX_REGIONS];
+} led_shm_header_t;
+
+struct led_shm {
+    int fd;
+    size_t size;
+    led_shm_header_t *hdr;
+    ws2811_led_t *buffers;
+    bool server;
+    char name[64];
+
+    /* Server: access to the segment, gid -1 keeps the server's group */
+    mode_t mode;
+    gid_t gid;
+
+    /* Client */
+    int region;
+    uint32_t back;
+
+    struct {
+        int c_errno;
+        char errmsg[96];
+    } error;
+};
+
+static int _led_shm_error(led_shm_t *shm, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    shm->error.c_errno = c_errno;
+
+    va_start(ap, fmt);
+    vsnprintf(shm->error.errmsg, sizeof(shm->error.errmsg), fmt, ap);
+    va_end(ap);
+
+    /* Tack on strerror() and errno */
+    if (c_errno) {
+        char buf[64] = {0};
+        strerror_r(c_errno, buf, sizeof(buf));
+        snprintf(shm->error.errmsg+strlen(shm->error.errmsg), sizeof(shm->error.errmsg)-strlen(shm->error.errmsg), ": %s [errno %d]", buf, c_errno);
+    }
+
+    return code;
+}
+
+static size_t led_shm_size(uint32_t buffer_leds) {
+    return sizeof(led_shm_header_t) + (size_t)LED_SHM_MAX_REGIONS * 3 * buffer_leds * sizeof(ws2811_led_t);
+}
+
+static ws2811_led_t *led_shm_buffer(led_shm_t *shm, int region, uint32_t index) {
+    return shm->buffers + ((size_t)region * 3 + index) * shm->hdr->buffer_leds;
+}
+
+static const char *led_shm_name(const char *name) {
+    if (name == NULL)
+        name = getenv("LED_SHM_NAME");
+
+    return name ? name : LED_SHM_DEFAULT_NAME;
+}
+
+static bool led_shm_pid_alive(pid_t pid) {
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/* Called with the segment flock()ed */
+static void led_shm_release_region(led_shm_header_t *hdr, int r) {
+    led_shm_region_t *region = &hdr->regions[r];
+
+    atomic_fetch_and(&region->state, ~(uint32_t)STATE_FRESH);
+    atomic_store(&region->pid, 0);
+}
+
+/* Called with the segment flock()ed */
+static void led_shm_reap(led_shm_header_t *hdr) {
+    for (int r = 0; r < LED_SHM_MAX_REGIONS; r++) {
+        pid_t pid = atomic_load(&hdr->regions[r].pid);
+
+        if (pid && !led_shm_pid_alive(pid))
+            led_shm_release_region(hdr, r);
+    }
+}
+
+static int futex(_Atomic uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, (uint32_t *)uaddr, op, val, timeout, NULL, 0);
+}
+
+/*********************************************************************************/
+/* Primary Functions */
+/*********************************************************************************/
+
+led_shm_t *led_shm_new(void) {
+    led_shm_t *shm = calloc(1, sizeof(led_shm_t));
+    if (shm == NULL)
+        return NULL;
+
+    shm->fd = -1;
+    shm->region = -1;
+    shm->mode = LED_SHM_DEFAULT_MODE;
+    shm->gid = (gid_t)-1;
+
+    return shm;
+}
+
+static int led_shm_map(led_shm_t *shm, size_t size) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    shm->size = size;
+    shm->hdr = map;
+    shm->buffers = (ws2811_led_t *)((uint8_t *)map + sizeof(led_shm_header_t));
+
+    return 0;
+}
+
+static void led_shm_unmap(led_shm_t *shm) {
+    if (shm->hdr)
+        munmap(shm->hdr, shm->size);
+    if (shm->fd >= 0)
+        close(shm->fd);
+
+    shm->hdr = NULL;
+    shm->buffers = NULL;
+    shm->fd = -1;
+}
+
+int led_shm_open(led_shm_t *shm, const char *name, int channel, int first, int count) {
+    led_shm_header_t *hdr;
+    struct stat st;
+    int free_region = -1;
+    int ret;
+
+    name = led_shm_name(name);
+
+    if ((shm->fd = shm_open(name, O_RDWR, 0)) < 0)
+        return _led_shm_error(shm, LED_SHM_ERROR_OPEN, errno, "Opening %s, is led_frame_server running?", name);
+
+    if (fstat(shm->fd, &st) < 0 || (size_t)st.st_size < sizeof(led_shm_header_t)) {
+        int c_errno = errno;
+        led_shm_unmap(shm);
+        return _led_shm_error(shm, LED_SHM_ERROR_OPEN, c_errno, "Segment %s too small", name);
+    }
+
+    if (led_shm_map(shm, (size_t)st.st_size) < 0) {
+        int c_errno = errno;
+        led_shm_unmap(shm);
+        return _led_shm_error(shm, LED_SHM_ERROR_OPEN, c_errno, "Mapping %s", name);
+    }
+    hdr = shm->hdr;
+
+    if (hdr->magic != LED_SHM_MAGIC || hdr->version != LED_SHM_VERSION || led_shm_size(hdr->buffer_leds) > shm->size) {
+        led_shm_unmap(shm);
+        return _led_shm_error(shm, LED_SHM_ERROR_VERSION, 0, "Segment %s has an unknown layout", name);
+    }
+
+    if (channel < 0 || channel >= RPI_PWM_CHANNELS || first < 0 || count <= 0 ||
+        first + count > hdr->channel_count[channel]) {
+        ret = _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "LED range %d+%d outside channel %d (%d LEDs)",
+                             first, count, channel, (channel >= 0 && channel < RPI_PWM_CHANNELS) ? hdr->channel_count[channel] : 0);
+        led_shm_unmap(shm);
+        return ret;
+    }
+
+    if (flock(shm->fd, LOCK_EX) < 0) {
+        int c_errno = errno;
+        led_shm_unmap(shm);
+        return _led_shm_error(shm, LED_SHM_ERROR_LOCK, c_errno, "Locking %s", name);
+    }
+
+    led_shm_reap(hdr);
+
+    for (int r = 0; r < LED_SHM_MAX_REGIONS; r++) {
+        led_shm_region_t *region = &hdr->regions[r];
+        pid_t pid = atomic_load(&region->pid);
+
+        if (pid == 0) {
+            if (free_region < 0)
+                free_region = r;
+            continue;
+        }
+
+        if (region->channel == channel && first < region->first + region->count && region->first < first + count) {
+            ret = _led_shm_error(shm, LED_SHM_ERROR_BUSY, 0, "LEDs %d+%d overlap %d+%d of pid %d",
+                                 first, count, region->first, region->count, (int)pid);
+            flock(shm->fd, LOCK_UN);
+            led_shm_unmap(shm);
+            return ret;
+        }
+    }
+
+    if (free_region < 0) {
+        flock(shm->fd, LOCK_UN);
+        led_shm_unmap(shm);
+        return _led_shm_error(shm, LED_SHM_ERROR_NO_FREE, 0, "All %d regions claimed", LED_SHM_MAX_REGIONS);
+    }
+
+    {
+        led_shm_region_t *region = &hdr->regions[free_region];
+        uint32_t state = atomic_load(&region->state);
+
+        region->channel = channel;
+        region->first = first;
+        region->count = count;
+        shm->region = free_region;
+        shm->back = 3 - STATE_MIDDLE(state) - STATE_FRONT(state);
+        memset(led_shm_buffer(shm, free_region, shm->back), 0, (size_t)count * sizeof(ws2811_led_t));
+        atomic_store(&region->pid, getpid());
+    }
+
+    flock(shm->fd, LOCK_UN);
+
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    shm->server = false;
+
+    return 0;
+}
+
+ws2811_led_t *led_shm_frame(led_shm_t *shm) {
+    if (shm->region < 0)
+        return NULL;
+
+    return led_shm_buffer(shm, shm->region, shm->back);
+}
+
+int led_shm_commit(led_shm_t *shm) {
+    led_shm_header_t *hdr = shm->hdr;
+    led_shm_region_t *region;
+    uint32_t old, new;
+
+    if (shm->region < 0)
+        return _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "Not a client handle");
+
+    region = &hdr->regions[shm->region];
+
+    /* Hand the back buffer over as the fresh middle one, take the old middle */
+    old = atomic_load(&region->state);
+    do {
+        new = STATE(shm->back, STATE_FRONT(old)) | STATE_FRESH;
+    } while (!atomic_compare_exchange_weak(&region->state, &old, new));
+
+    /* Start the next frame from the one just published */
+    memcpy(led_shm_buffer(shm, shm->region, STATE_MIDDLE(old)), led_shm_buffer(shm, shm->region, shm->back),
+           (size_t)region->count * sizeof(ws2811_led_t));
+    shm->back = STATE_MIDDLE(old);
+
+    atomic_fetch_add(&hdr->seq, 1);
+    if (atomic_load(&hdr->waiting))
+        futex(&hdr->seq, FUTEX_WAKE, 1, NULL);
+
+    return 0;
+}
+
+int led_shm_close(led_shm_t *shm) {
+    if (shm->hdr == NULL)
+        return 0;
+
+    if (shm->server) {
+        shm_unlink(shm->name);
+    } else if (shm->region >= 0) {
+        /* The LEDs keep the last committed frame */
+        flock(shm->fd, LOCK_EX);
+        if (atomic_load(&shm->hdr->regions[shm->region].pid) == getpid())
+            led_shm_release_region(shm->hdr, shm->region);
+        flock(shm->fd, LOCK_UN);
+    }
+
+    led_shm_unmap(shm);
+    shm->region = -1;
+    shm->server = false;
+
+    return 0;
+}
+
+void led_shm_free(led_shm_t *shm) {
+    free(shm);
+}
+
+/*********************************************************************************/
+/* Server Functions */
+/*********************************************************************************/
+
+int led_shm_set_access(led_shm_t *shm, mode_t mode, gid_t gid) {
+    if (mode & ~(mode_t)0666)
+        return _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "Invalid segment mode %o", (unsigned int)mode);
+
+    shm->mode = mode;
+    shm->gid = gid;
+
+    return 0;
+}
+
+int led_shm_serve(led_shm_t *shm, const char *name, const ws2811_t *ws2811) {
+    led_shm_header_t *hdr;
+    uint32_t buffer_leds = 0;
+    size_t size;
+
+    name = led_shm_name(name);
+    if (strlen(name) >= sizeof(shm->name))
+        return _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "Segment name too long");
+
+    for (int chan = 0; chan < RPI_PWM_CHANNELS; chan++) {
+        if (ws2811->channel[chan].count > (int)buffer_leds)
+            buffer_leds = (uint32_t)ws2811->channel[chan].count;
+    }
+    if (buffer_leds == 0)
+        return _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "No LEDs to serve");
+
+    /* A segment left behind by a crashed server is replaced, its clients have to reopen */
+    shm_unlink(name);
+    if ((shm->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+        return _led_shm_error(shm, LED_SHM_ERROR_OPEN, errno, "Creating %s", name);
+
+    /* Widen access only as far as led_shm_set_access() asked, group first */
+    if ((shm->gid != (gid_t)-1 && fchown(shm->fd, (uid_t)-1, shm->gid) < 0) ||
+        fchmod(shm->fd, shm->mode) < 0) {
+        int c_errno = errno;
+        led_shm_unmap(shm);
+        shm_unlink(name);
+        return _led_shm_error(shm, LED_SHM_ERROR_OPEN, c_errno, "Setting access of %s", name);
+    }
+
+    size = led_shm_size(buffer_leds);
+    if (ftruncate(shm->fd, (off_t)size) < 0 || led_shm_map(shm, size) < 0) {
+        int c_errno = errno;
+        led_shm_unmap(shm);
+        shm_unlink(name);
+        return _led_shm_error(shm, LED_SHM_ERROR_OPEN, c_errno, "Sizing %s", name);
+    }
+
+    hdr = shm->hdr;
+    hdr->buffer_leds = buffer_leds;
+    for (int chan = 0; chan < RPI_PWM_CHANNELS; chan++)
+        hdr->channel_count[chan] = ws2811->channel[chan].count;
+    atomic_init(&hdr->seq, 0);
+    atomic_init(&hdr->waiting, 0);
+    for (int r = 0; r < LED_SHM_MAX_REGIONS; r++) {
+        atomic_init(&hdr->regions[r].state, STATE(1, 2));
+        atomic_init(&hdr->regions[r].pid, 0);
+    }
+
+    /* Publish the layout last, clients check the magic */
+    hdr->version = LED_SHM_VERSION;
+    atomic_thread_fence(memory_order_release);
+    hdr->magic = LED_SHM_MAGIC;
+
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    shm->server = true;
+
+    return 0;
+}
+
+int led_shm_collect(led_shm_t *shm, ws2811_t *ws2811, bool *changed) {
+    led_shm_header_t *hdr = shm->hdr;
+    bool differs = false;
+
+    if (!shm->server)
+        return _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "Not a server handle");
+
+    for (int r = 0; r < LED_SHM_MAX_REGIONS; r++) {
+        led_shm_region_t *region = &hdr->regions[r];
+        uint32_t old, new;
+        ws2811_channel_t *channel;
+
+        if (atomic_load(&region->pid) == 0)
+            continue;
+
+        /* Take the fresh middle buffer as the new front */
+        old = atomic_load(&region->state);
+        do {
+            if (!(old & STATE_FRESH))
+                break;
+            new = STATE(STATE_FRONT(old), STATE_MIDDLE(old));
+        } while (!atomic_compare_exchange_weak(&region->state, &old, new));
+
+        if (!(old & STATE_FRESH))
+            continue;
+
+        channel = &ws2811->channel[region->channel];
+        if (region->first + region->count > channel->count)
+            continue;
+
+        memcpy(channel->leds + region->first, led_shm_buffer(shm, r, STATE_MIDDLE(old)),
+               (size_t)region->count * sizeof(ws2811_led_t));
+        differs = true;
+    }
+
+    if (changed)
+        *changed = differs;
+
+    return 0;
+}
+
+int led_shm_wait(led_shm_t *shm, int timeout_ms) {
+    led_shm_header_t *hdr = shm->hdr;
+    struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    uint32_t seq;
+    bool fresh = false;
+
+    if (!shm->server)
+        return _led_shm_error(shm, LED_SHM_ERROR_ARG, 0, "Not a server handle");
+
+    seq = atomic_load(&hdr->seq);
+    atomic_store(&hdr->waiting, 1);
+
+    /* A commit between the last collect and announcing the wait is not missed */
+    for (int r = 0; r < LED_SHM_MAX_REGIONS && !fresh; r++)
+        fresh = atomic_load(&hdr->regions[r].pid) && (atomic_load(&hdr->regions[r].state) & STATE_FRESH);
+
+    if (!fresh && futex(&hdr->seq, FUTEX_WAIT, seq, timeout_ms < 0 ? NULL : &timeout) < 0 && errno == ETIMEDOUT) {
+        /* Idle, a good time to release regions of clients that died */
+        if (flock(shm->fd, LOCK_EX) == 0) {
+            led_shm_reap(hdr);
+            flock(shm->fd, LOCK_UN);
+        }
+    }
+
+    atomic_store(&hdr->waiting, 0);
+
+    return 0;
+}
+
+/*********************************************************************************/
+/* Error Handling */
+/*********************************************************************************/
+
+int led_shm_errno(led_shm_t *shm) {
+    return shm->error.c_errno;
+}
+
+const char *led_shm_errmsg(led_shm_t *shm) {
+    return shm->error.errmsg;
+}
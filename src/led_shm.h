@@ -0,0 +1,64 @@
+/*
+ * led_shm.h
+ *
+ * Shared-memory LED frames, so several processes can drive the strips of the
+ * one process that owns ws2811_t (tools/led_frame_server). Each client claims
+ * a range of LEDs on a channel and draws into a triple-buffered region of a
+ * POSIX shared-memory segment. led_shm_commit() publishes a frame with atomic
+ * operations only, it makes a syscall only to wake a sleeping server.
+ */
+
+#ifndef _LED_SHM_H
+#define _LED_SHM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ws2811.h"
+
+enum led_shm_error_code {
+    LED_SHM_ERROR_ARG           = -1, /* Invalid arguments */
+    LED_SHM_ERROR_OPEN          = -2, /* Creating, opening or mapping the segment */
+    LED_SHM_ERROR_VERSION       = -3, /* Segment from an incompatible server */
+    LED_SHM_ERROR_BUSY          = -4, /* LED range overlaps another client */
+    LED_SHM_ERROR_NO_FREE       = -5, /* All regions claimed */
+    LED_SHM_ERROR_LOCK          = -6, /* Locking the segment for a claim */
+};
+
+/* Segment name, overridden by the LED_SHM_NAME environment variable */
+#define LED_SHM_DEFAULT_NAME    "/led_frames"
+#define LED_SHM_MAX_REGIONS     8
+/* Segment permissions, only the server's user unless led_shm_set_access() widens them */
+#define LED_SHM_DEFAULT_MODE    0600
+
+typedef struct led_shm led_shm_t;
+
+/* Primary Functions */
+led_shm_t *led_shm_new(void);
+int led_shm_open(led_shm_t *shm, const char *name, int channel, int first, int count);
+ws2811_led_t *led_shm_frame(led_shm_t *shm);
+int led_shm_commit(led_shm_t *shm);
+int led_shm_close(led_shm_t *shm);
+void led_shm_free(led_shm_t *shm);
+
+/* Server Functions */
+int led_shm_set_access(led_shm_t *shm, mode_t mode, gid_t gid);
+int led_shm_serve(led_shm_t *shm, const char *name, const ws2811_t *ws2811);
+int led_shm_collect(led_shm_t *shm, ws2811_t *ws2811, bool *changed);
+int led_shm_wait(led_shm_t *shm, int timeout_ms);
+
+/* Error Handling */
+int led_shm_errno(led_shm_t *shm);
+const char *led_shm_errmsg(led_shm_t *shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * periph_arb.c
+ *
+ * Each resource is a file in the lock directory. A holder keeps it flock()ed,
+ * LOCK_EX for an exclusive claim and LOCK_SH for a shared one, and the first
+ * holder writes "owner pid key" into it for diagnostics. Claims are made under
+ * an exclusive lock on a guard file, so checking the current holder and taking
+ * or downgrading the lock is atomic with respect to other claimers.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "periph_arb.h"
+
+#define PERIPH_ARB_MAX_CLAIMS   16
+#define PERIPH_ARB_NAME_LEN     32
+
+/* DMA channels tried by periph_arb_claim_dma(), rpi_ws281x's default first.
+ * Channels below 8 are used by the kernel. */
+static const int periph_arb_dma_channels[] = { 10, 11, 12, 13, 9, 8, 14 };
+#define PERIPH_ARB_DMA_COUNT    (sizeof(periph_arb_dma_channels) / sizeof(periph_arb_dma_channels[0]))
+
+struct periph_arb {
+    char owner[PERIPH_ARB_NAME_LEN];
+    char dir[128];
+    int guard_fd;
+
+    struct {
+        char resource[PERIPH_ARB_NAME_LEN];
+        int fd;
+    } claims[PERIPH_ARB_MAX_CLAIMS];
+
+    struct {
+        int c_errno;
+        char errmsg[192];
+    } error;
+};
+
+static int _periph_arb_error(periph_arb_t *arb, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    arb->error.c_errno = c_errno;
+
+    va_start(ap, fmt);
+    vsnprintf(arb->error.errmsg, sizeof(arb->error.errmsg), fmt, ap);
+    va_end(ap);
+
+    /* Tack on strerror() and errno */
+    if (c_errno) {
+        char buf[64] = {0};
+        strerror_r(c_errno, buf, sizeof(buf));
+        snprintf(arb->error.errmsg+strlen(arb->error.errmsg), sizeof(arb->error.errmsg)-strlen(arb->error.errmsg), ": %s [errno %d]", buf, c_errno);
+    }
+
+    return code;
+}
+
+static bool periph_arb_valid_name(const char *name) {
+    size_t len;
+
+    if (name == NULL || (len = strlen(name)) == 0 || len >= PERIPH_ARB_NAME_LEN || name[0] == '.')
+        return false;
+
+    return strpbrk(name, "/ \t\n") == NULL;
+}
+
+static int periph_arb_find(periph_arb_t *arb, const char *resource) {
+    for (int i = 0; i < PERIPH_ARB_MAX_CLAIMS; i++) {
+        if (arb->claims[i].fd >= 0 && strcmp(arb->claims[i].resource, resource) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/* Called with the guard held. Returns the locked fd or a negative error code. */
+static int periph_arb_lock(periph_arb_t *arb, const char *resource, const char *key) {
+    char path[sizeof(arb->dir) + PERIPH_ARB_NAME_LEN + 1];
+    char record[128];
+    char holder[PERIPH_ARB_NAME_LEN] = "?";
+    char holder_key[PERIPH_ARB_NAME_LEN] = "-";
+    int holder_pid = 0;
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", arb->dir, resource);
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666)) < 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_OPEN, errno, "Opening \"%s\"", path);
+
+    /* Nobody holds it: become the first holder */
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+        len = snprintf(record, sizeof(record), "%s %d %s\n", arb->owner, (int)getpid(), key ? key : "-");
+
+        if (ftruncate(fd, 0) < 0 || pwrite(fd, record, len, 0) != len) {
+            int errsv = errno;
+            close(fd);
+            return _periph_arb_error(arb, PERIPH_ARB_ERROR_IO, errsv, "Writing \"%s\"", path);
+        }
+
+        if (key != NULL && flock(fd, LOCK_SH) < 0) {
+            int errsv = errno;
+            close(fd);
+            return _periph_arb_error(arb, PERIPH_ARB_ERROR_IO, errsv, "Sharing \"%s\"", path);
+        }
+
+        return fd;
+    }
+
+    if (errno != EWOULDBLOCK) {
+        int errsv = errno;
+        close(fd);
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_IO, errsv, "Locking \"%s\"", path);
+    }
+
+    if ((len = pread(fd, record, sizeof(record) - 1, 0)) > 0) {
+        record[len] = '\0';
+        sscanf(record, "%31s %d %31s", holder, &holder_pid, holder_key);
+    }
+
+    /* Held shared under the same key: join it */
+    if (key != NULL && strcmp(holder_key, key) == 0 && flock(fd, LOCK_SH | LOCK_NB) == 0)
+        return fd;
+
+    close(fd);
+
+    if (strcmp(holder_key, "-") == 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_BUSY, 0, "%s is held exclusively by '%s' (pid %d), '%s' wants it %s%s%s",
+                                 resource, holder, holder_pid, arb->owner,
+                                 key ? "shared as '" : "exclusively", key ? key : "", key ? "'" : "");
+
+    return _periph_arb_error(arb, PERIPH_ARB_ERROR_BUSY, 0, "%s is shared as '%s' by '%s' (pid %d), '%s' wants it %s%s%s",
+                             resource, holder_key, holder, holder_pid, arb->owner,
+                             key ? "shared as '" : "exclusively", key ? key : "", key ? "'" : "");
+}
+
+periph_arb_t *periph_arb_new(void) {
+    periph_arb_t *arb = calloc(1, sizeof(periph_arb_t));
+    if (arb == NULL)
+        return NULL;
+
+    arb->guard_fd = -1;
+    for (int i = 0; i < PERIPH_ARB_MAX_CLAIMS; i++)
+        arb->claims[i].fd = -1;
+
+    return arb;
+}
+
+int periph_arb_open(periph_arb_t *arb, const char *owner) {
+    char path[sizeof(arb->dir) + 8];
+    const char *dir;
+
+    if (!periph_arb_valid_name(owner))
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Invalid owner name");
+
+    if ((dir = getenv("PERIPH_ARB_DIR")) == NULL || dir[0] == '\0')
+        dir = PERIPH_ARB_DEFAULT_DIR;
+
+    if (strlen(dir) >= sizeof(arb->dir))
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Lock directory path too long");
+
+    memset(arb, 0, sizeof(periph_arb_t));
+    arb->guard_fd = -1;
+    for (int i = 0; i < PERIPH_ARB_MAX_CLAIMS; i++)
+        arb->claims[i].fd = -1;
+
+    strcpy(arb->owner, owner);
+    strcpy(arb->dir, dir);
+
+    /* Shared between users, claims may come from different accounts */
+    if (mkdir(dir, 0777) < 0 && errno != EEXIST)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_OPEN, errno, "Creating lock directory \"%s\"", dir);
+
+    snprintf(path, sizeof(path), "%s/.guard", dir);
+    if ((arb->guard_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666)) < 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_OPEN, errno, "Opening \"%s\"", path);
+
+    return 0;
+}
+
+int periph_arb_claim(periph_arb_t *arb, const char *resource, const char *key) {
+    int slot = -1;
+    int fd;
+
+    if (arb->guard_fd < 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Arbiter not open");
+
+    if (!periph_arb_valid_name(resource))
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Invalid resource name");
+
+    if (key != NULL && (!periph_arb_valid_name(key) || strcmp(key, "-") == 0))
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Invalid key for %s", resource);
+
+    if (periph_arb_find(arb, resource) >= 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "%s already claimed by '%s'", resource, arb->owner);
+
+    for (int i = 0; i < PERIPH_ARB_MAX_CLAIMS; i++) {
+        if (arb->claims[i].fd < 0) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot < 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Too many claims");
+
+    if (flock(arb->guard_fd, LOCK_EX) < 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_IO, errno, "Locking guard");
+
+    fd = periph_arb_lock(arb, resource, key);
+
+    flock(arb->guard_fd, LOCK_UN);
+
+    if (fd < 0)
+        return fd;
+
+    strcpy(arb->claims[slot].resource, resource);
+    arb->claims[slot].fd = fd;
+
+    return 0;
+}
+
+int periph_arb_release(periph_arb_t *arb, const char *resource) {
+    int slot;
+
+    if (resource == NULL || (slot = periph_arb_find(arb, resource)) < 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "%s not claimed", resource ? resource : "(null)");
+
+    close(arb->claims[slot].fd);
+    arb->claims[slot].fd = -1;
+    arb->claims[slot].resource[0] = '\0';
+
+    return 0;
+}
+
+int periph_arb_close(periph_arb_t *arb) {
+    for (int i = 0; i < PERIPH_ARB_MAX_CLAIMS; i++) {
+        if (arb->claims[i].fd >= 0) {
+            close(arb->claims[i].fd);
+            arb->claims[i].fd = -1;
+        }
+    }
+
+    if (arb->guard_fd >= 0) {
+        if (close(arb->guard_fd) < 0)
+            return _periph_arb_error(arb, PERIPH_ARB_ERROR_IO, errno, "Closing guard");
+        arb->guard_fd = -1;
+    }
+
+    return 0;
+}
+
+void periph_arb_free(periph_arb_t *arb) {
+    free(arb);
+}
+
+int periph_arb_claim_any(periph_arb_t *arb, const char *const *resources, size_t count, const char *key, size_t *index) {
+    char last[sizeof(arb->error.errmsg)];
+    int ret;
+
+    if (resources == NULL || count == 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "No candidate resources");
+
+    for (size_t i = 0; i < count; i++) {
+        if ((ret = periph_arb_claim(arb, resources[i], key)) == 0) {
+            if (index)
+                *index = i;
+            return 0;
+        }
+
+        if (ret != PERIPH_ARB_ERROR_BUSY)
+            return ret;
+    }
+
+    /* Keep the last conflict in the message, it names a holder */
+    memcpy(last, arb->error.errmsg, sizeof(last));
+    return _periph_arb_error(arb, PERIPH_ARB_ERROR_NO_FREE, 0, "None of %zu candidates free, last: %s", count, last);
+}
+
+int periph_arb_claim_dma(periph_arb_t *arb, int preferred, int *dmanum) {
+    char names[PERIPH_ARB_DMA_COUNT + 1][PERIPH_ARB_NAME_LEN];
+    const char *candidates[PERIPH_ARB_DMA_COUNT + 1];
+    int channels[PERIPH_ARB_DMA_COUNT + 1];
+    size_t n = 0, index;
+    int ret;
+
+    if (dmanum == NULL || preferred > 15)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Invalid DMA channel");
+
+    if (preferred >= 0)
+        channels[n++] = preferred;
+    for (size_t i = 0; i < PERIPH_ARB_DMA_COUNT; i++) {
+        if (periph_arb_dma_channels[i] != preferred)
+            channels[n++] = periph_arb_dma_channels[i];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        snprintf(names[i], sizeof(names[i]), "dma.%d", channels[i]);
+        candidates[i] = names[i];
+    }
+
+    if ((ret = periph_arb_claim_any(arb, candidates, n, NULL, &index)) < 0)
+        return ret;
+
+    *dmanum = channels[index];
+
+    return 0;
+}
+
+int periph_arb_claim_pwm_clock(periph_arb_t *arb, uint32_t rate_hz) {
+    char key[16];
+
+    if (rate_hz == 0)
+        return _periph_arb_error(arb, PERIPH_ARB_ERROR_ARG, 0, "Invalid PWM clock rate");
+
+    snprintf(key, sizeof(key), "%u", rate_hz);
+
+    return periph_arb_claim(arb, PERIPH_ARB_CM_PWM, key);
+}
+
+int periph_arb_errno(periph_arb_t *arb) {
+    return arb->error.c_errno;
+}
+
+const char *periph_arb_errmsg(periph_arb_t *arb) {
+    return arb->error.errmsg;
+}
@@ -0,0 +1,80 @@
+/*
+ * periph_arb.h
+ *
+ * Arbiter for the Raspberry Pi peripherals that c-periphery, rpi_ws281x and
+ * pigpio program behind each other's back (PWM block, PWM/PCM clocks, DMA
+ * channels, SPI buses). None of those libraries call it: enforcement is
+ * opt-in, the application claims what it is about to hand to each backend
+ * and gets an immediate, descriptive error instead of a hang on the first
+ * render. Anything that skips the claim is not seen.
+ *
+ * Claims are flock()s on per-resource files, so they are released when the
+ * handle is closed or the process dies, and they are seen across processes.
+ *
+ * A claim with a NULL key is exclusive. Claims with a key are shared with
+ * every other claim using the same key. That is the only sharing there is:
+ * the PWM clock is claimed with its rate, so users needing the same rate can
+ * both hold it, a different rate is refused.
+ *
+ * Who should claim what before starting a backend:
+ *
+ *   resource             claimed for                           key
+ *   PERIPH_ARB_PWM       rpi_ws281x PWM mode, pigpio (PWM clk)  exclusive
+ *                        c-periphery sysfs PWM                  "sysfs"
+ *   PERIPH_ARB_CM_PWM    rpi_ws281x PWM mode                    rate, 3 * freq
+ *                        c-periphery sysfs PWM                  "kernel"
+ *   PERIPH_ARB_PCM       rpi_ws281x PCM mode, pigpio (PCM clk)  exclusive
+ *   "dma.N"              rpi_ws281x dmanum, pigpio channels     exclusive
+ *   "spi0.N"             spidev0.N user                         exclusive
+ */
+
+#ifndef _PERIPH_ARB_H
+#define _PERIPH_ARB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum periph_arb_error_code {
+    PERIPH_ARB_ERROR_ARG        = -1, /* Invalid arguments */
+    PERIPH_ARB_ERROR_OPEN       = -2, /* Opening the lock directory or a resource file */
+    PERIPH_ARB_ERROR_BUSY       = -3, /* Resource held with a conflicting claim */
+    PERIPH_ARB_ERROR_NO_FREE    = -4, /* No candidate resource is free */
+    PERIPH_ARB_ERROR_IO         = -5, /* Locking or reading a resource file */
+};
+
+#define PERIPH_ARB_PWM          "pwm"
+#define PERIPH_ARB_CM_PWM       "cm_pwm"
+#define PERIPH_ARB_PCM          "pcm"
+#define PERIPH_ARB_CM_PCM       "cm_pcm"
+
+/* Lock directory, overridden by the PERIPH_ARB_DIR environment variable */
+#define PERIPH_ARB_DEFAULT_DIR  "/run/lock/periph_arb"
+
+typedef struct periph_arb periph_arb_t;
+
+/* Primary Functions */
+periph_arb_t *periph_arb_new(void);
+int periph_arb_open(periph_arb_t *arb, const char *owner);
+int periph_arb_claim(periph_arb_t *arb, const char *resource, const char *key);
+int periph_arb_release(periph_arb_t *arb, const char *resource);
+int periph_arb_close(periph_arb_t *arb);
+void periph_arb_free(periph_arb_t *arb);
+
+/* Assignment Helpers */
+int periph_arb_claim_any(periph_arb_t *arb, const char *const *resources, size_t count, const char *key, size_t *index);
+int periph_arb_claim_dma(periph_arb_t *arb, int preferred, int *dmanum);
+int periph_arb_claim_pwm_clock(periph_arb_t *arb, uint32_t rate_hz);
+
+/* Error Handling */
+int periph_arb_errno(periph_arb_t *arb);
+const char *periph_arb_errmsg(periph_arb_t *arb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <grp.h>
+#include "ws2811.h"
+#include "periph_arb.h"
+#include "led_shm.h"
+
+// Owns the LED strip and renders whatever the clients attached through
+// led_shm commit. Renders only when some client published a new frame,
+// sleeps on a futex otherwise.
+// Usage: sudo ./led_frame_server [led_gpio] [led_count] [client_group]
+// The segment name is taken from LED_SHM_NAME, default /led_frames. Only root
+// can attach unless client_group is given, its members get read/write access.
+
+#define DMA_CHANNEL     10
+#define IDLE_WAIT_MS    1000
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+int main(int argc, char **argv) {
+    int led_gpio = argc > 1 ? atoi(argv[1]) : 18;
+    int led_count = argc > 2 ? atoi(argv[2]) : 60;
+    const char *client_group = argc > 3 ? argv[3] : NULL;
+    int ret = 1;
+
+    ws2811_t leds;
+    memset(&leds, 0, sizeof(leds));
+    leds.freq = WS2811_TARGET_FREQ;
+    leds.dmanum = DMA_CHANNEL;
+    leds.channel[0].gpionum = led_gpio;
+    leds.channel[0].count = led_count;
+    leds.channel[0].strip_type = WS2811_STRIP_GRB;
+    leds.channel[0].brightness = 255;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    periph_arb_t *arb = periph_arb_new();
+    if (!arb) {
+        fprintf(stderr, "Failed to allocate arbiter handle\n");
+        return 1;
+    }
+    if (periph_arb_open(arb, "led_frame_server") < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(arb, 3 * leds.freq) < 0 ||
+        periph_arb_claim_dma(arb, DMA_CHANNEL, &leds.dmanum) < 0) {
+        fprintf(stderr, "%s\n", periph_arb_errmsg(arb));
+        goto out_arb;
+    }
+
+    ws2811_return_t err = ws2811_init(&leds);
+    if (err != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(err));
+        goto out_arb;
+    }
+
+    led_shm_t *shm = led_shm_new();
+    if (!shm) {
+        fprintf(stderr, "Failed to allocate shm handle\n");
+        goto out_leds;
+    }
+    if (client_group) {
+        struct group *gr = getgrnam(client_group);
+        if (!gr) {
+            fprintf(stderr, "Unknown group %s\n", client_group);
+            goto out_free;
+        }
+        led_shm_set_access(shm, 0660, gr->gr_gid);
+    }
+    if (led_shm_serve(shm, NULL, &leds) < 0) {
+        fprintf(stderr, "led_shm_serve: %s\n", led_shm_errmsg(shm));
+        goto out_free;
+    }
+
+    unsigned long frames = 0;
+    while (running) {
+        bool changed;
+
+        led_shm_collect(shm, &leds, &changed);
+        if (!changed) {
+            led_shm_wait(shm, IDLE_WAIT_MS);
+            continue;
+        }
+
+        if ((err = ws2811_render(&leds)) != WS2811_SUCCESS) {
+            fprintf(stderr, "ws2811_render failed: %s\n", ws2811_get_return_t_str(err));
+            goto out_close;
+        }
+        frames++;
+    }
+    printf("%lu frames rendered\n", frames);
+    ret = 0;
+
+out_close:
+    led_shm_close(shm);
+out_free:
+    led_shm_free(shm);
+out_leds:
+    memset(leds.channel[0].leds, 0, sizeof(ws2811_led_t) * leds.channel[0].count);
+    (void)ws2811_render(&leds);
+    ws2811_fini(&leds);
+out_arb:
+    periph_arb_close(arb);
+    periph_arb_free(arb);
+    return ret;
+}
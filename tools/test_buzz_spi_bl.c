@@ -85,13 +85,10 @@ int buzz_beep_freq[] = {
 // Helper to play one tone for the given duration (ms)
 int play_tone_ms(pwm_t *p, int freq_hz, int duration_ms) {
     if (freq_hz <= 0) return 0;
-    double duty_cycle = 0.5; // 50%
-    if (pwm_set_frequency(p, (double)freq_hz) < 0) {
-        fprintf(stderr, "pwm_set_frequency for frequency %d failed: %s\n", freq_hz,  pwm_errmsg(p));
-        return -1;
-    }
-    if (pwm_set_duty_cycle(p, duty_cycle) < 0) {
-        fprintf(stderr, "pwm_set_duty_cycle failed: %s\n", pwm_errmsg(p));
+    uint64_t period_ns = 1000000000ULL / (uint64_t)freq_hz;
+    // Period and 50% duty in one ordered update
+    if (pwm_set_period_duty_cycle_ns(p, period_ns, period_ns / 2) < 0) {
+        fprintf(stderr, "pwm_set_period_duty_cycle_ns for frequency %d failed: %s\n", freq_hz,  pwm_errmsg(p));
         return -1;
     }
     if (pwm_enable(p) < 0) {
@@ -101,8 +98,8 @@ int play_tone_ms(pwm_t *p, int freq_hz, int duration_ms) {
     usleep((useconds_t)duration_ms * 1000);
     // Stop
     (void)pwm_disable(p);
-    if (pwm_set_duty_cycle(p, 0) < 0) {
-        fprintf(stderr, "pwm_set_duty_cycle cleanup failed: %s\n", pwm_errmsg(p));
+    if (pwm_set_duty_cycle_ns(p, 0) < 0) {
+        fprintf(stderr, "pwm_set_duty_cycle_ns cleanup failed: %s\n", pwm_errmsg(p));
         return -1;
     }
 
@@ -22,6 +22,8 @@
 
 #include "/home/printer/coding/u8g2_rpi/3rdparty/u8g2/sys/arm-linux/port/u8g2port.h"
 
+#include "periph_arb.h"
+
 #define TARGET_FREQ             WS2811_TARGET_FREQ
 #define GPIO_PIN                18
 #define DMA                     10
@@ -85,13 +87,10 @@ int buzz_beep_freq[] = {
 // Helper to play one tone for the given duration (ms)
 int play_tone_ms(pwm_t *p, int freq_hz, int duration_ms) {
     if (freq_hz <= 0) return 0;
-    double duty_cycle = 0.5; // 50%
-    if (pwm_set_frequency(p, (double)freq_hz) < 0) {
-        fprintf(stderr, "pwm_set_frequency for frequency %d failed: %s\n", freq_hz,  pwm_errmsg(p));
-        return -1;
-    }
-    if (pwm_set_duty_cycle(p, duty_cycle) < 0) {
-        fprintf(stderr, "pwm_set_duty_cycle failed: %s\n", pwm_errmsg(p));
+    uint64_t period_ns = 1000000000ULL / (uint64_t)freq_hz;
+    // Period and 50% duty in one ordered update
+    if (pwm_set_period_duty_cycle_ns(p, period_ns, period_ns / 2) < 0) {
+        fprintf(stderr, "pwm_set_period_duty_cycle_ns for frequency %d failed: %s\n", freq_hz,  pwm_errmsg(p));
         return -1;
     }
     if (pwm_enable(p) < 0) {
@@ -101,25 +100,82 @@ int play_tone_ms(pwm_t *p, int freq_hz, int duration_ms) {
     usleep((useconds_t)duration_ms * 1000);
     // Stop
     (void)pwm_disable(p);
-    if (pwm_set_duty_cycle(p, 0) < 0) {
-        fprintf(stderr, "pwm_set_duty_cycle cleanup failed: %s\n", pwm_errmsg(p));
+    if (pwm_set_duty_cycle_ns(p, 0) < 0) {
+        fprintf(stderr, "pwm_set_duty_cycle_ns cleanup failed: %s\n", pwm_errmsg(p));
         return -1;
     }
 
     return 0;
 }
 
+// Claim what each backend is going to program, so a conflict is reported
+// up front instead of hanging on the first render. The kernel PWM driver and
+// rpi_ws281x both program the PWM block, so with the LEDs on PWM0 the arbiter
+// refuses the sysfs buzzer here and the test stops before touching hardware.
+static int claim_resources(periph_arb_t *leds, periph_arb_t *buzzer, periph_arb_t *display) {
+    if (periph_arb_open(leds, "leds") < 0 ||
+        periph_arb_claim(leds, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(leds, 3 * TARGET_FREQ) < 0 ||
+        periph_arb_claim_dma(leds, DMA, &ledstring.dmanum) < 0) {
+        fprintf(stderr, "LEDs: %s\n", periph_arb_errmsg(leds));
+        return -1;
+    }
+    // The kernel PWM driver owns the whole PWM block and its clock
+    if (periph_arb_open(buzzer, "buzzer") < 0 ||
+        periph_arb_claim(buzzer, PERIPH_ARB_PWM, "sysfs") < 0 ||
+        periph_arb_claim(buzzer, PERIPH_ARB_CM_PWM, "kernel") < 0) {
+        fprintf(stderr, "Buzzer: %s\n", periph_arb_errmsg(buzzer));
+        fprintf(stderr, "Use ws2811_buzzer_tone() (tools/test_ws281x_buzz_spi_bl) to share PWM with the LEDs\n");
+        return -1;
+    }
+    if (periph_arb_open(display, "display") < 0 ||
+        periph_arb_claim(display, "spi0.0", NULL) < 0) {
+        fprintf(stderr, "Display: %s\n", periph_arb_errmsg(display));
+        return -1;
+    }
+    return 0;
+}
+
+// Release all claims, closing a handle that was never opened is fine
+static void release_resources(periph_arb_t *leds, periph_arb_t *buzzer, periph_arb_t *display) {
+    periph_arb_close(leds);
+    periph_arb_close(buzzer);
+    periph_arb_close(display);
+    periph_arb_free(leds);
+    periph_arb_free(buzzer);
+    periph_arb_free(display);
+}
+
 int main(void) {
     ws2811_return_t ret;
+    int status = 0;
+    periph_arb_t *arb_leds = periph_arb_new();
+    periph_arb_t *arb_buzzer = periph_arb_new();
+    periph_arb_t *arb_display = periph_arb_new();
+    if (!arb_leds || !arb_buzzer || !arb_display) {
+        fprintf(stderr, "Failed to allocate arbiter handles\n");
+        periph_arb_free(arb_leds);
+        periph_arb_free(arb_buzzer);
+        periph_arb_free(arb_display);
+        return 1;
+    }
+    if (claim_resources(arb_leds, arb_buzzer, arb_display) < 0) {
+        release_resources(arb_leds, arb_buzzer, arb_display);
+        return 1;
+    }
+
     if ((ret = ws2811_init(&ledstring)) != WS2811_SUCCESS)
     {
         fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(ret));
+        release_resources(arb_leds, arb_buzzer, arb_display);
         return ret;
     }
     ledstring.channel[0].leds[BL_LED_IDX] = 0;
     if ((ret = ws2811_render(&ledstring)) != WS2811_SUCCESS)
     {
         fprintf(stderr, "ws2811_render failed: %s\n", ws2811_get_return_t_str(ret));
+        ws2811_fini(&ledstring);
+        release_resources(arb_leds, arb_buzzer, arb_display);
         return ret;
     }
 
@@ -154,12 +210,14 @@ int main(void) {
     pwm_t *pwm = pwm_new();
     if (!pwm) {
         fprintf(stderr, "Failed to allocate pwm handle\n");
-        return 1;
+        status = 1;
+        goto out_display;
     }
     if (pwm_open(pwm, pwm_chip, pwm_channel) < 0) {
         fprintf(stderr, "pwm_open failed: %s\n", pwm_errmsg(pwm));
         pwm_free(pwm);
-        return 1;
+        status = 1;
+        goto out_display;
     }
     printf("Initialized\n");
     for (int k=0; k<6; k++){
@@ -179,6 +237,10 @@ int main(void) {
         }
         sleep_ms(3000);
     }
+    pwm_close(pwm);
+    pwm_free(pwm);
+
+out_display:
     u8g2_SetPowerSave(&u8g2, 1);
     // Close and deallocate SPI resources
     done_spi();
@@ -190,11 +252,11 @@ int main(void) {
     if ((ret = ws2811_render(&ledstring)) != WS2811_SUCCESS)
     {
         fprintf(stderr, "ws2811 cleanup failed: %s\n", ws2811_get_return_t_str(ret));
-        return ret;
+        status = ret;
     }
     ws2811_fini(&ledstring);
 
-    pwm_close(pwm);
-    pwm_free(pwm);
+    release_resources(arb_leds, arb_buzzer, arb_display);
     printf("Done\n");
+    return status;
 }
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "u8g2.h"
+#include "font_pack.h"
+
+// Lists the fonts of a pack written by bdfconv -P, or draws a text with one
+// of them into an off-screen 128x64 u8g2 buffer and prints it as ASCII art.
+// No display needed. Build a pack with e.g.
+//   bdfconv -f 1 -m '32-127' 7x13.bdf -n 7x13 -P fonts.u8p
+// Usage: ./test_font_pack [pack] [font] [text]
+// Without a pack the FONT_PACK environment variable or the default is used.
+
+static const char *format_name(int format) {
+    switch (format) {
+    case FONT_PACK_FORMAT_U8G2:         return "u8g2";
+    case FONT_PACK_FORMAT_U8X8:         return "u8x8";
+    case FONT_PACK_FORMAT_U8G2_FAST:    return "u8g2 fast";
+    default:                            return "?";
+    }
+}
+
+static int list_fonts(font_pack_t *pack) {
+    font_pack_info_t info;
+    int count = font_pack_count(pack);
+
+    if (count < 0) {
+        fprintf(stderr, "font_pack_count: %s\n", font_pack_errmsg(pack));
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        font_pack_info(pack, i, &info);
+        printf("%-32s %-9s %5u glyphs %3dx%-3d %7zu bytes\n", info.name, format_name(info.format),
+               info.glyphs, info.max_width, info.max_height, info.size);
+    }
+    printf("%d fonts\n", count);
+    return 0;
+}
+
+static int draw_text(font_pack_t *pack, const char *name, const char *text) {
+    u8g2_t u8g2;
+    font_pack_info_t info;
+    const uint8_t *font;
+    int index;
+
+    if ((index = font_pack_find(pack, name, &font)) < 0) {
+        fprintf(stderr, "font_pack_find: %s\n", font_pack_errmsg(pack));
+        return -1;
+    }
+    font_pack_info(pack, index, &info);
+
+    if (info.format == FONT_PACK_FORMAT_U8X8) {
+        fprintf(stderr, "%s is an u8x8 font, use it with u8x8_SetFont()\n", name);
+        return -1;
+    }
+
+    // Memory only, the buffer is never sent anywhere
+    u8g2_Setup_ssd1306_128x64_noname_f(&u8g2, U8G2_R0, u8x8_byte_empty, u8x8_dummy_cb);
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetFont(&u8g2, font);
+    u8g2_SetFontPosTop(&u8g2);
+    u8g2_DrawUTF8(&u8g2, 0, 0, text);
+
+    // ssd1306 buffer: 8 rows per tile row, bit 0 on top
+    int w = u8g2_GetBufferTileWidth(&u8g2) * 8;
+    int h = u8g2_GetBufferTileHeight(&u8g2) * 8;
+    int rows = info.max_height < h ? info.max_height : h;
+    uint8_t *buf = u8g2_GetBufferPtr(&u8g2);
+
+    for (int y = 0; y < rows; y++) {
+        char line[w + 1];
+        int last = -1;
+
+        for (int x = 0; x < w; x++) {
+            int on = buf[(y / 8) * w + x] & (1 << (y % 8));
+            line[x] = on ? '#' : ' ';
+            if (on)
+                last = x;
+        }
+        line[last + 1] = '\0';
+        printf("%s\n", line);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    const char *name = argc > 2 ? argv[2] : NULL;
+    const char *text = argc > 3 ? argv[3] : "Hello, font pack!";
+    int ret = 1;
+
+    font_pack_t *pack = font_pack_new();
+    if (!pack) {
+        fprintf(stderr, "Failed to allocate font pack handle\n");
+        return 1;
+    }
+    if (font_pack_open(pack, path) < 0) {
+        fprintf(stderr, "font_pack_open: %s\n", font_pack_errmsg(pack));
+        goto out_free;
+    }
+
+    if ((name ? draw_text(pack, name, text) : list_fonts(pack)) < 0)
+        goto out_close;
+    ret = 0;
+
+out_close:
+    font_pack_close(pack);
+out_free:
+    font_pack_free(pack);
+    return ret;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include "ws2811.h"
+#include "periph_arb.h"
+#include "led_fx.h"
+
+// Effects engine demo: breathing backlight on LED 0, a palette cycle with a
+// chase on top on the remaining LEDs. Prints the compute time per frame.
+// Usage: sudo ./test_led_fx [led_gpio] [led_count] [seconds] [fps]
+
+#define DMA_CHANNEL     10
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static const ws2811_led_t palette[] = {
+    0x00200000, 0x00202000, 0x00002000, 0x00002020, 0x00000020, 0x00200020
+};
+
+int main(int argc, char **argv) {
+    int led_gpio = argc > 1 ? atoi(argv[1]) : 18;
+    int led_count = argc > 2 ? atoi(argv[2]) : 3;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+    unsigned int fps = argc > 4 ? (unsigned int)atoi(argv[4]) : 100;
+    int ret = 1;
+
+    ws2811_t leds;
+    memset(&leds, 0, sizeof(leds));
+    leds.freq = WS2811_TARGET_FREQ;
+    leds.dmanum = DMA_CHANNEL;
+    leds.channel[0].gpionum = led_gpio;
+    leds.channel[0].count = led_count;
+    leds.channel[0].strip_type = WS2811_STRIP_GRB;
+    leds.channel[0].brightness = 255;
+
+    periph_arb_t *arb = periph_arb_new();
+    if (!arb) {
+        fprintf(stderr, "Failed to allocate arbiter handle\n");
+        return 1;
+    }
+    if (periph_arb_open(arb, "led_fx") < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(arb, 3 * leds.freq) < 0 ||
+        periph_arb_claim_dma(arb, DMA_CHANNEL, &leds.dmanum) < 0) {
+        fprintf(stderr, "%s\n", periph_arb_errmsg(arb));
+        goto out_arb;
+    }
+
+    ws2811_return_t err = ws2811_init(&leds);
+    if (err != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(err));
+        goto out_arb;
+    }
+
+    led_fx_t *fx = led_fx_new();
+    if (!fx) {
+        fprintf(stderr, "Failed to allocate effects engine\n");
+        goto out_leds;
+    }
+    if (led_fx_open(fx, &leds, fps) < 0) {
+        fprintf(stderr, "led_fx_open: %s\n", led_fx_errmsg(fx));
+        goto out_fx;
+    }
+
+    led_fx_layer_t backlight = {
+        .kind = LED_FX_BREATHE, .blend = LED_FX_BLEND_NORMAL, .opacity = 255,
+        .channel = 0, .first = 0, .count = 1,
+        .color = { 0x00ffffff }, .period_ms = 4000,
+    };
+    led_fx_layer_t cycle = {
+        .kind = LED_FX_PALETTE, .blend = LED_FX_BLEND_NORMAL, .opacity = 255,
+        .channel = 0, .first = 1, .count = 0,
+        .palette = palette, .palette_len = sizeof(palette) / sizeof(palette[0]), .period_ms = 3000,
+    };
+    led_fx_layer_t chase = {
+        .kind = LED_FX_CHASE, .blend = LED_FX_BLEND_ADD, .opacity = 192,
+        .channel = 0, .first = 1, .count = 0,
+        .color = { 0x00404040, 0 }, .period_ms = 1000, .width = 1,
+        .start_ms = 2000,
+    };
+    if (led_fx_add(fx, &backlight, NULL) < 0 ||
+        (led_count > 1 && (led_fx_add(fx, &cycle, NULL) < 0 || led_fx_add(fx, &chase, NULL) < 0))) {
+        fprintf(stderr, "led_fx_add: %s\n", led_fx_errmsg(fx));
+        goto out_close;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    ws2811_stats_enable(&leds, 1);
+
+    unsigned int rendered = 0;
+    while (running && led_fx_frame(fx) < (uint32_t)seconds * fps) {
+        int r = led_fx_step(fx);
+        if (r < 0) {
+            fprintf(stderr, "led_fx_step: %s\n", led_fx_errmsg(fx));
+            goto out_close;
+        }
+        rendered += r;
+    }
+    printf("%u frames, %u rendered, compute %u us last, %u us max\n",
+           led_fx_frame(fx), rendered, led_fx_compute_us(fx), led_fx_compute_max_us(fx));
+
+    ws2811_stats_t stats;
+    char report[1024];
+    if (ws2811_stats_get(&leds, &stats) == WS2811_SUCCESS) {
+        ws2811_stats_format(&stats, 0, report, sizeof(report));
+        fputs(report, stdout);
+    }
+    ret = 0;
+
+out_close:
+    led_fx_close(fx);
+out_fx:
+    led_fx_free(fx);
+out_leds:
+    for (int i = 0; i < led_count; i++) {
+        leds.channel[0].leds[i] = 0;
+    }
+    (void)ws2811_render(&leds);
+    ws2811_fini(&leds);
+out_arb:
+    periph_arb_close(arb);
+    periph_arb_free(arb);
+    return ret;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "ws2811.h"
+#include "periph_arb.h"
+#include "led_matrix.h"
+
+// Scrolls a canvas twice as wide as the matrix across a serpentine panel.
+// Frames are read by the ws2811 encoder through the remap table, scrolling
+// only moves the viewport pointer.
+// Usage: sudo ./test_led_matrix [led_gpio] [width] [height] [rotation]
+
+#define DMA_CHANNEL     10
+
+int main(int argc, char **argv) {
+    int led_gpio = argc > 1 ? atoi(argv[1]) : 18;
+    led_matrix_layout_t layout = {
+        .width = argc > 2 ? (unsigned int)atoi(argv[2]) : 8,
+        .height = argc > 3 ? (unsigned int)atoi(argv[3]) : 8,
+        .flags = LED_MATRIX_SERPENTINE,
+        .rotation = argc > 4 ? (unsigned int)atoi(argv[4]) : 0,
+    };
+    int ret = 1;
+
+    ws2811_t leds;
+    memset(&leds, 0, sizeof(leds));
+    leds.freq = WS2811_TARGET_FREQ;
+    leds.dmanum = DMA_CHANNEL;
+    leds.channel[0].gpionum = led_gpio;
+    leds.channel[0].count = (int)(layout.width * layout.height);
+    leds.channel[0].strip_type = WS2811_STRIP_GRB;
+    leds.channel[0].brightness = 32;
+
+    periph_arb_t *arb = periph_arb_new();
+    if (!arb) {
+        fprintf(stderr, "Failed to allocate arbiter handle\n");
+        return 1;
+    }
+    if (periph_arb_open(arb, "led_matrix") < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(arb, 3 * leds.freq) < 0 ||
+        periph_arb_claim_dma(arb, DMA_CHANNEL, &leds.dmanum) < 0) {
+        fprintf(stderr, "%s\n", periph_arb_errmsg(arb));
+        goto out_arb;
+    }
+
+    ws2811_return_t err = ws2811_init(&leds);
+    if (err != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(err));
+        goto out_arb;
+    }
+
+    led_matrix_t *matrix = led_matrix_new();
+    if (!matrix) {
+        fprintf(stderr, "Failed to allocate matrix handle\n");
+        goto out_leds;
+    }
+    if (led_matrix_open(matrix, &leds, 0, &layout, 2 * (layout.rotation % 180 ? layout.height : layout.width), 0) < 0) {
+        fprintf(stderr, "led_matrix_open: %s\n", led_matrix_errmsg(matrix));
+        goto out_free;
+    }
+
+    // Horizontal hue bands with a white frame around the first screen
+    unsigned int cw = led_matrix_canvas_width(matrix);
+    unsigned int ch = led_matrix_canvas_height(matrix);
+    unsigned int w = led_matrix_width(matrix);
+    ws2811_led_t *row = calloc(cw, sizeof(ws2811_led_t));
+    if (!row) {
+        fprintf(stderr, "Out of memory\n");
+        goto out_close;
+    }
+    for (unsigned int y = 0; y < ch; y++) {
+        for (unsigned int x = 0; x < cw; x++) {
+            uint8_t v = (uint8_t)(x * 255 / (cw - 1));
+            row[x] = (x == 0 || x == w - 1 || y == 0 || y == ch - 1) ? 0x00ffffff :
+                     ((uint32_t)(255 - v) << 16) | ((uint32_t)v << 8) | (y * 255 / ch);
+        }
+        led_matrix_blit(matrix, 0, (int)y, cw, 1, row, cw);
+    }
+    free(row);
+
+    for (int pass = 0; pass < 4; pass++) {
+        for (unsigned int x = 0; x <= cw - w; x++) {
+            led_matrix_scroll(matrix, x, 0);
+            if ((err = ws2811_render(&leds)) != WS2811_SUCCESS) {
+                fprintf(stderr, "ws2811_render failed: %s\n", ws2811_get_return_t_str(err));
+                goto out_close;
+            }
+            usleep(80000);
+        }
+    }
+    ret = 0;
+
+out_close:
+    led_matrix_close(matrix);
+out_free:
+    led_matrix_free(matrix);
+out_leds:
+    memset(leds.channel[0].leds, 0, sizeof(ws2811_led_t) * leds.channel[0].count);
+    (void)ws2811_render(&leds);
+    ws2811_fini(&leds);
+out_arb:
+    periph_arb_close(arb);
+    periph_arb_free(arb);
+    return ret;
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "ws2811.h"
+#include "led_shm.h"
+
+// Runs a dot along a range of LEDs through led_frame_server. Start several
+// with disjoint ranges to drive one strip from independent processes.
+// No root needed, the server owns the hardware.
+// Usage: ./test_led_shm_client [first] [count] [rgb hex] [seconds]
+
+#define FRAME_US        20000
+
+int main(int argc, char **argv) {
+    int first = argc > 1 ? atoi(argv[1]) : 0;
+    int count = argc > 2 ? atoi(argv[2]) : 30;
+    ws2811_led_t color = argc > 3 ? (ws2811_led_t)strtoul(argv[3], NULL, 16) : 0x00ff4000;
+    int seconds = argc > 4 ? atoi(argv[4]) : 10;
+    int ret = 1;
+
+    led_shm_t *shm = led_shm_new();
+    if (!shm) {
+        fprintf(stderr, "Failed to allocate shm handle\n");
+        return 1;
+    }
+    if (led_shm_open(shm, NULL, 0, first, count) < 0) {
+        fprintf(stderr, "led_shm_open: %s\n", led_shm_errmsg(shm));
+        goto out_free;
+    }
+
+    ws2811_led_t *frame = led_shm_frame(shm);
+    for (int n = 0; n < seconds * (1000000 / FRAME_US); n++) {
+        memset(frame, 0, sizeof(ws2811_led_t) * count);
+        frame[n % count] = color;
+
+        if (led_shm_commit(shm) < 0) {
+            fprintf(stderr, "led_shm_commit: %s\n", led_shm_errmsg(shm));
+            goto out_close;
+        }
+        frame = led_shm_frame(shm);
+        usleep(FRAME_US);
+    }
+
+    memset(frame, 0, sizeof(ws2811_led_t) * count);
+    led_shm_commit(shm);
+    ret = 0;
+
+out_close:
+    led_shm_close(shm);
+out_free:
+    led_shm_free(shm);
+    return ret;
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "../3rdparty/c-periphery/src/pwm.h"
+#include "../src/buzzer_seq.h"
+
+// Melody test for the buzzer sequencer (c-periphery PWM)
+// Usage: ./test_melody ["<RTTTL string>"]
+
+static const char *default_melody =
+    "scale:d=8,o=6,b=120:c,d,e,f,g,a,b,c7,4p,c7,b,a,g,f,e,d,4c";
+
+int main(int argc, char **argv) {
+    const char *melody = (argc > 1) ? argv[1] : default_melody;
+
+    // Configure PWM: You must set correct chip+channel for your buzzer PWM pin.
+    unsigned int pwm_chip = 0;     // /sys/class/pwm/pwmchip0
+    unsigned int pwm_channel = 1;  // pwm1
+
+    pwm_t *pwm = pwm_new();
+    if (!pwm) {
+        fprintf(stderr, "Failed to allocate pwm handle\n");
+        return 1;
+    }
+    if (pwm_open(pwm, pwm_chip, pwm_channel) < 0) {
+        fprintf(stderr, "pwm_open failed: %s\n", pwm_errmsg(pwm));
+        pwm_free(pwm);
+        return 1;
+    }
+
+    buzzer_seq_t *seq = buzzer_seq_new();
+    if (!seq) {
+        fprintf(stderr, "Failed to allocate sequencer\n");
+        return 1;
+    }
+    // Real-time priority 50, falls back to normal scheduling without privileges
+    if (buzzer_seq_open(seq, pwm, 50) < 0) {
+        fprintf(stderr, "buzzer_seq_open failed: %s\n", buzzer_seq_errmsg(seq));
+        return 1;
+    }
+
+    if (buzzer_seq_play_rtttl(seq, melody) < 0) {
+        fprintf(stderr, "buzzer_seq_play_rtttl failed: %s\n", buzzer_seq_errmsg(seq));
+        return 1;
+    }
+
+    // The caller is free while the melody plays
+    int ticks = 0;
+    int ret;
+    while ((ret = buzzer_seq_wait(seq, 100)) == 0) {
+        ticks++;
+    }
+    if (ret < 0)
+        fprintf(stderr, "Playback failed: %s\n", buzzer_seq_errmsg(seq));
+    printf("Melody finished after %d UI ticks\n", ticks);
+
+    buzzer_seq_close(seq);
+    buzzer_seq_free(seq);
+    pwm_close(pwm);
+    pwm_free(pwm);
+    return 0;
+}
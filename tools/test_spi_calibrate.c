@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "u8g2port.h"
+
+// Calibrates the ST7567 SPI clock and measures the full frame flush time at
+// the old 500 kHz default, the rated clock of the controller and the
+// calibrated clock. Calibration needs MOSI looped back to MISO (jumper or a
+// spare wire), the display is write-only in 4-wire SPI mode.
+// Usage: ./test_spi_calibrate [max_hz] [frames]
+
+// GPIO chip number for character device
+#define GPIO_CHIP_NUM 0
+// SPI bus uses upper 4 bits and lower 4 bits, so 0x10 will be /dev/spidev1.0
+#define SPI_BUS 0x00
+#define OLED_SPI_PIN_RES            6
+#define OLED_SPI_PIN_DC             5
+// CS pin is controlled by linux spi driver
+#define OLED_SPI_PIN_CS             U8X8_PIN_NONE
+
+// Milliseconds per u8g2_SendBuffer() at the given clock
+static double probe_flush_ms(u8g2_t *u8g2, uint32_t speed, int frames) {
+    struct timespec t0, t1;
+
+    if (set_spi_hw_speed(u8g2, speed) < 0)
+        return -1.0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < frames; i++)
+        u8g2_SendBuffer(u8g2);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ((t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6) / frames;
+}
+
+int main(int argc, char **argv) {
+    uint32_t max_speed = argc > 1 ? (uint32_t)atoi(argv[1]) : 32000000;
+    int frames = argc > 2 ? atoi(argv[2]) : 50;
+    u8g2_t u8g2;
+    uint32_t rated, best;
+
+    if (frames <= 0)
+        frames = 50;
+
+    u8g2_Setup_st7567_jlx12864_f(&u8g2, U8G2_R0,
+        u8x8_byte_arm_linux_hw_spi, u8x8_arm_linux_gpio_and_delay);
+    init_spi_hw(&u8g2, GPIO_CHIP_NUM, SPI_BUS, OLED_SPI_PIN_DC,
+        OLED_SPI_PIN_RES, OLED_SPI_PIN_CS);
+    rated = u8g2_GetU8x8(&u8g2)->display_info->sck_clock_hz;
+
+    u8g2_InitDisplay(&u8g2);
+    u8g2_SetPowerSave(&u8g2, 0);
+
+    best = calibrate_spi_hw(&u8g2, max_speed);
+    if (best == 0)
+        printf("Calibration failed, is MOSI looped back to MISO?\n");
+
+    // Checkerboard, so every byte toggles
+    u8g2_ClearBuffer(&u8g2);
+    for (int y = 0; y < 64; y += 8)
+        for (int x = (y / 8) % 2 * 8; x < 128; x += 16)
+            u8g2_DrawBox(&u8g2, x, y, 8, 8);
+
+    printf("%10s %12s\n", "clock Hz", "ms/frame");
+    printf("%10u %12.2f\n", 500000u, probe_flush_ms(&u8g2, 500000, frames));
+    printf("%10u %12.2f\n", rated, probe_flush_ms(&u8g2, rated, frames));
+    if (best != 0)
+        printf("%10u %12.2f  (calibrated)\n", best, probe_flush_ms(&u8g2, best, frames));
+
+    u8g2_SetPowerSave(&u8g2, 1);
+    done_spi();
+    done_user_data(&u8g2);
+    return best != 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "u8g2port.h"
+
+// Draws a bouncing box on the ST7567 (hardware SPI), first with
+// u8g2_SendBuffer(), then with u8g2_SendBufferAsync() so that drawing and
+// the SPI transfer overlap. Prints frames per second for both and how many
+// frames the flush worker dropped because the bus was slower.
+// Usage: ./test_u8g2_async [frames] [spi_hz]
+
+// GPIO chip number for character device
+#define GPIO_CHIP_NUM 0
+// SPI bus uses upper 4 bits and lower 4 bits, so 0x10 will be /dev/spidev1.0
+#define SPI_BUS 0x00
+#define OLED_SPI_PIN_RES            6
+#define OLED_SPI_PIN_DC             5
+// CS pin is controlled by linux spi driver
+#define OLED_SPI_PIN_CS             U8X8_PIN_NONE
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void draw_frame(u8g2_t *u8g2, int i) {
+    int x = i % 224;
+    int y = i % 88;
+
+    // Triangle waves, box of 16x16 inside 128x64
+    if (x > 112)
+        x = 224 - x;
+    if (y > 44)
+        y = 88 - y;
+    u8g2_ClearBuffer(u8g2);
+    u8g2_DrawFrame(u8g2, 0, 0, 128, 64);
+    u8g2_DrawBox(u8g2, x, y + 2, 16, 16);
+}
+
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 200;
+    uint32_t speed = argc > 2 ? (uint32_t)atoi(argv[2]) : 500000;
+    u8g2_t u8g2;
+    uint32_t fence = 0;
+    double t0, t_sync, t_async;
+    int ret = 1;
+
+    if (frames <= 0)
+        frames = 200;
+
+    u8g2_Setup_st7567_jlx12864_f(&u8g2, U8G2_R0,
+        u8x8_byte_arm_linux_hw_spi, u8x8_arm_linux_gpio_and_delay);
+    init_spi_hw_advanced(&u8g2, GPIO_CHIP_NUM, SPI_BUS, OLED_SPI_PIN_DC,
+        OLED_SPI_PIN_RES, OLED_SPI_PIN_CS,
+        u8g2_GetU8x8(&u8g2)->display_info->spi_mode, speed);
+
+    u8g2_InitDisplay(&u8g2);
+    u8g2_SetPowerSave(&u8g2, 0);
+
+    t0 = now_s();
+    for (int i = 0; i < frames; i++) {
+        draw_frame(&u8g2, i);
+        u8g2_SendBuffer(&u8g2);
+    }
+    t_sync = now_s() - t0;
+
+    if (init_async_flush(&u8g2) < 0)
+        goto out;
+
+    t0 = now_s();
+    for (int i = 0; i < frames; i++) {
+        draw_frame(&u8g2, i);
+        fence = u8g2_SendBufferAsync(&u8g2);
+    }
+    // Last frame on the display
+    u8g2_WaitFlush(&u8g2, fence);
+    t_async = now_s() - t0;
+
+    printf("SPI %u Hz, %d frames\n", speed, frames);
+    printf("sync:  %7.1f frames/s\n", frames / t_sync);
+    printf("async: %7.1f frames/s drawn, %lu dropped\n", frames / t_async,
+           get_async_flush_dropped(&u8g2));
+    ret = 0;
+
+    done_async_flush(&u8g2);
+out:
+    u8g2_SetPowerSave(&u8g2, 1);
+    done_spi();
+    done_user_data(&u8g2);
+    return ret;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "u8g2port.h"
+
+// Two ST7567 panels, each drawn by its own thread with asynchronous flush.
+// With both panels on one SPI controller (spidev0.0 and spidev0.1) their
+// frames share one flush worker and the bus; on two controllers (spidev0.0
+// and spidev1.0) they are sent in parallel. Prints frames per second per
+// panel, compare both wirings.
+// Usage: ./test_u8g2_multi [frames] [bus2]   (bus2: 0x01 or 0x10, default 0x10)
+
+// GPIO chip number for character device
+#define GPIO_CHIP_NUM 0
+// SPI bus uses upper 4 bits and lower 4 bits, so 0x10 will be /dev/spidev1.0
+#define SPI_BUS_1 0x00
+#define OLED_1_PIN_RES              6
+#define OLED_1_PIN_DC               5
+#define OLED_2_PIN_RES              24
+#define OLED_2_PIN_DC               23
+// CS pins are controlled by linux spi driver
+#define OLED_SPI_PIN_CS             U8X8_PIN_NONE
+
+struct panel {
+    u8g2_t u8g2;
+    int frames;
+    double seconds;
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *draw_thread(void *arg) {
+    struct panel *p = arg;
+    uint32_t fence = 0;
+    double t0 = now_s();
+
+    for (int i = 0; i < p->frames; i++) {
+        u8g2_ClearBuffer(&p->u8g2);
+        u8g2_DrawFrame(&p->u8g2, 0, 0, 128, 64);
+        u8g2_DrawBox(&p->u8g2, i % 112, 24, 16, 16);
+        fence = u8g2_SendBufferAsync(&p->u8g2);
+    }
+    u8g2_WaitFlush(&p->u8g2, fence);
+    p->seconds = now_s() - t0;
+    return NULL;
+}
+
+static void init_panel(struct panel *p, uint8_t bus, uint8_t dc, uint8_t res,
+        int frames) {
+    u8g2_Setup_st7567_jlx12864_f(&p->u8g2, U8G2_R0,
+        u8x8_byte_arm_linux_hw_spi, u8x8_arm_linux_gpio_and_delay);
+    init_spi_hw(&p->u8g2, GPIO_CHIP_NUM, bus, dc, res, OLED_SPI_PIN_CS);
+    u8g2_InitDisplay(&p->u8g2);
+    u8g2_SetPowerSave(&p->u8g2, 0);
+    p->frames = frames;
+}
+
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 200;
+    uint8_t bus2 = argc > 2 ? (uint8_t)strtol(argv[2], NULL, 0) : 0x10;
+    struct panel panels[2];
+    pthread_t threads[2];
+    int ret = 1;
+
+    if (frames <= 0)
+        frames = 200;
+
+    init_panel(&panels[0], SPI_BUS_1, OLED_1_PIN_DC, OLED_1_PIN_RES, frames);
+    init_panel(&panels[1], bus2, OLED_2_PIN_DC, OLED_2_PIN_RES, frames);
+    if (init_async_flush(&panels[0].u8g2) < 0)
+        goto out;
+    if (init_async_flush(&panels[1].u8g2) < 0)
+        goto out;
+
+    for (int i = 0; i < 2; i++)
+        pthread_create(&threads[i], NULL, draw_thread, &panels[i]);
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+
+    printf("spidev%d.%d and spidev%d.%d, %d frames each\n", SPI_BUS_1 >> 4,
+           SPI_BUS_1 & 0x0f, bus2 >> 4, bus2 & 0x0f, frames);
+    for (int i = 0; i < 2; i++)
+        printf("panel %d: %7.1f frames/s, %lu dropped\n", i + 1,
+               frames / panels[i].seconds,
+               get_async_flush_dropped(&panels[i].u8g2));
+    ret = 0;
+
+out:
+    for (int i = 0; i < 2; i++) {
+        done_async_flush(&panels[i].u8g2);
+        u8g2_SetPowerSave(&panels[i].u8g2, 1);
+    }
+    done_spi();
+    for (int i = 0; i < 2; i++)
+        done_user_data(&panels[i].u8g2);
+    return ret;
+}
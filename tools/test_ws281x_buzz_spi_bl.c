@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <getopt.h>
+
+#include "ws2811.h"
+#include "u8g2port.h"
+#include "periph_arb.h"
+
+// test_cperiphery_buzz_spi_bl with the buzzer moved from sysfs PWM to the ws2811 DMA:
+// backlight LED on PWM0, buzzer on PWM1 and an ST7567 on SPI0, with no PWM clash.
+// Usage: sudo ./test_ws281x_buzz_spi_bl
+
+#define TARGET_FREQ             WS2811_TARGET_FREQ
+#define GPIO_PIN                18
+#define DMA                     10
+#define STRIP_TYPE            WS2811_STRIP_RGB
+
+#define LED_COUNT               3
+#define BL_LED_IDX              2
+
+// Buzzer on PWM1, played by the ws2811 DMA next to the LEDs on PWM0
+#define BUZZER_GPIO             13
+
+// GPIO chip number for character device
+#define GPIO_CHIP_NUM 0
+// SPI bus uses upper 4 bits and lower 4 bits, so 0x10 will be /dev/spidev1.0
+#define SPI_BUS 0x00
+#define OLED_SPI_PIN_RES            6
+#define OLED_SPI_PIN_DC             5
+
+// CS pin is controlled by linux spi driver, thus not defined here, but need to be wired
+#define OLED_SPI_PIN_CS             U8X8_PIN_NONE
+
+ws2811_t ledstring =
+{
+    .freq = TARGET_FREQ,
+    .dmanum = DMA,
+    .channel =
+    {
+        [0] =
+        {
+            .gpionum = GPIO_PIN,
+            .invert = 0,
+            .count = LED_COUNT,
+            .strip_type = STRIP_TYPE,
+            .brightness = 255,
+        },
+        [1] =
+        {
+            .gpionum = 0,
+            .invert = 0,
+            .count = 0,
+            .brightness = 0,
+        },
+    },
+};
+
+ws2811_led_t dotcolors[] =
+{
+    0x00202020,  // white
+    0x00200000,  // red
+    0x00201000,  // orange
+    0x00002020,  // lightblue
+    0x00202000,  // yellow
+    0x00000020,  // blue
+    0x00100010,  // purple
+    0x00002000,  // green
+    0x00200010,  // pink
+};
+
+int buzz_beep_freq[] = {
+    1047, 1175, 1319, 1397, 1568, 1760,
+};
+
+
+// Helper to play one tone for the given duration (ms)
+int play_tone_ms(ws2811_t *ws2811, int freq_hz, int duration_ms) {
+    ws2811_return_t ret;
+
+    if (freq_hz <= 0) return 0;
+    // Square wave at full volume, keeps playing while the LEDs are rendered
+    if ((ret = ws2811_buzzer_tone(ws2811, (uint32_t)freq_hz, 255)) != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_buzzer_tone for frequency %d failed: %s\n", freq_hz, ws2811_get_return_t_str(ret));
+        return -1;
+    }
+    usleep((useconds_t)duration_ms * 1000);
+    // Stop
+    if ((ret = ws2811_buzzer_stop(ws2811)) != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_buzzer_stop failed: %s\n", ws2811_get_return_t_str(ret));
+        return -1;
+    }
+
+    return 0;
+}
+
+// Claim what each backend is going to program, so a conflict is reported
+// up front instead of hanging on the first render. LEDs and buzzer share the
+// PWM block, its clock and the DMA channel through one ws2811 instance.
+static int claim_resources(periph_arb_t *leds, periph_arb_t *display) {
+    if (periph_arb_open(leds, "leds+buzzer") < 0 ||
+        periph_arb_claim(leds, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(leds, 3 * TARGET_FREQ) < 0 ||
+        periph_arb_claim_dma(leds, DMA, &ledstring.dmanum) < 0) {
+        fprintf(stderr, "LEDs: %s\n", periph_arb_errmsg(leds));
+        return -1;
+    }
+    if (periph_arb_open(display, "display") < 0 ||
+        periph_arb_claim(display, "spi0.0", NULL) < 0) {
+        fprintf(stderr, "Display: %s\n", periph_arb_errmsg(display));
+        return -1;
+    }
+    return 0;
+}
+
+// Release all claims, closing a handle that was never opened is fine
+static void release_resources(periph_arb_t *leds, periph_arb_t *display) {
+    periph_arb_close(leds);
+    periph_arb_close(display);
+    periph_arb_free(leds);
+    periph_arb_free(display);
+}
+
+int main(void) {
+    ws2811_return_t ret;
+    periph_arb_t *arb_leds = periph_arb_new();
+    periph_arb_t *arb_display = periph_arb_new();
+    if (!arb_leds || !arb_display) {
+        fprintf(stderr, "Failed to allocate arbiter handles\n");
+        periph_arb_free(arb_leds);
+        periph_arb_free(arb_display);
+        return 1;
+    }
+    if (claim_resources(arb_leds, arb_display) < 0) {
+        release_resources(arb_leds, arb_display);
+        return 1;
+    }
+
+    if ((ret = ws2811_init(&ledstring)) != WS2811_SUCCESS)
+    {
+        fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(ret));
+        release_resources(arb_leds, arb_display);
+        return ret;
+    }
+    if ((ret = ws2811_buzzer_init(&ledstring, BUZZER_GPIO)) != WS2811_SUCCESS)
+    {
+        fprintf(stderr, "ws2811_buzzer_init failed: %s\n", ws2811_get_return_t_str(ret));
+        ws2811_fini(&ledstring);
+        release_resources(arb_leds, arb_display);
+        return ret;
+    }
+    ledstring.channel[0].leds[BL_LED_IDX] = 0;
+    if ((ret = ws2811_render(&ledstring)) != WS2811_SUCCESS)
+    {
+        fprintf(stderr, "ws2811_render failed: %s\n", ws2811_get_return_t_str(ret));
+        ws2811_fini(&ledstring);
+        release_resources(arb_leds, arb_display);
+        return ret;
+    }
+
+    u8g2_t u8g2;
+
+    // Initialization
+    u8g2_Setup_st7567_jlx12864_f(&u8g2, U8G2_R0,
+        u8x8_byte_arm_linux_hw_spi, u8x8_arm_linux_gpio_and_delay);
+    
+    init_spi_hw(&u8g2, GPIO_CHIP_NUM, SPI_BUS, OLED_SPI_PIN_DC,
+        OLED_SPI_PIN_RES, OLED_SPI_PIN_CS);
+
+    u8g2_InitDisplay(&u8g2);
+    u8g2_ClearBuffer(&u8g2);
+    u8g2_SetPowerSave(&u8g2, 0);
+    u8g2_SetContrast(&u8g2, 180);
+
+    u8g2_SetFont(&u8g2, u8g2_font_ncenB08_tr);
+    u8g2_DrawStr(&u8g2, 20, 20, "U8g2 HW SPI");
+
+    u8g2_SetFont(&u8g2, u8g2_font_unifont_t_symbols);
+    u8g2_DrawGlyph(&u8g2, 112, 56, 0x2603);
+
+    u8g2_SendBuffer(&u8g2);
+
+    printf("Initialized\n");
+    for (int k=0; k<6; k++){
+        printf("Combination %d\n", k);
+        //Set backlight color
+        ledstring.channel[0].leds[BL_LED_IDX] = dotcolors[k];
+        if ((ret = ws2811_render(&ledstring)) != WS2811_SUCCESS)
+        {
+            fprintf(stderr, "ws2811_render failed: %s\n", ws2811_get_return_t_str(ret));
+            break;
+        }        
+        //Play buzzer
+        int rc = play_tone_ms(&ledstring, buzz_beep_freq[k], 1000);
+        if (rc){
+            fprintf(stderr, "Play sound failed: %d\n", rc);
+            break;
+        }
+        sleep_ms(3000);
+    }
+    u8g2_SetPowerSave(&u8g2, 1);
+    // Close and deallocate SPI resources
+    done_spi();
+    // Close and deallocate GPIO resources
+    done_user_data(&u8g2);
+    
+
+    (void)ws2811_buzzer_stop(&ledstring);
+    ledstring.channel[0].leds[BL_LED_IDX] = 0;
+    if ((ret = ws2811_render(&ledstring)) != WS2811_SUCCESS)
+    {
+        fprintf(stderr, "ws2811 cleanup failed: %s\n", ws2811_get_return_t_str(ret));
+        ws2811_fini(&ledstring);
+        release_resources(arb_leds, arb_display);
+        return ret;
+    }
+    ws2811_fini(&ledstring);
+
+    release_resources(arb_leds, arb_display);
+    printf("Done\n");
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "ws2811.h"
+#include "periph_arb.h"
+
+// Buzzer on PWM1 driven by the rpi_ws281x DMA channel, next to the LED strip on PWM0.
+// No sysfs PWM or pigpio involved, the tone keeps playing while LEDs are rendered.
+// Usage: sudo ./test_ws281x_buzzer [led_gpio] [buzzer_gpio] [led_count]
+
+#define DMA_CHANNEL     10
+
+static const uint32_t melody[] = {
+    1047, 1175, 1319, 1397, 1568, 1760
+};
+
+int main(int argc, char **argv) {
+    int led_gpio = argc > 1 ? atoi(argv[1]) : 18;
+    int buzzer_gpio = argc > 2 ? atoi(argv[2]) : 13;
+    int led_count = argc > 3 ? atoi(argv[3]) : 3;
+
+    ws2811_t leds;
+    memset(&leds, 0, sizeof(leds));
+    leds.freq = WS2811_TARGET_FREQ;
+    leds.dmanum = DMA_CHANNEL;
+    leds.channel[0].gpionum = led_gpio;
+    leds.channel[0].count = led_count;
+    leds.channel[0].strip_type = WS2811_STRIP_GRB;
+    leds.channel[0].brightness = 64;
+
+    // LEDs and buzzer share one PWM block, clock and DMA channel through ws2811
+    periph_arb_t *arb = periph_arb_new();
+    if (!arb) {
+        fprintf(stderr, "Failed to allocate arbiter handle\n");
+        return 1;
+    }
+    if (periph_arb_open(arb, "leds+buzzer") < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(arb, 3 * leds.freq) < 0 ||
+        periph_arb_claim_dma(arb, DMA_CHANNEL, &leds.dmanum) < 0) {
+        fprintf(stderr, "%s\n", periph_arb_errmsg(arb));
+        periph_arb_close(arb);
+        periph_arb_free(arb);
+        return 1;
+    }
+
+    ws2811_return_t ret = ws2811_init(&leds);
+    if (ret != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_init failed: %s\n", ws2811_get_return_t_str(ret));
+        periph_arb_close(arb);
+        periph_arb_free(arb);
+        return 1;
+    }
+
+    ret = ws2811_buzzer_init(&leds, buzzer_gpio);
+    if (ret != WS2811_SUCCESS) {
+        fprintf(stderr, "ws2811_buzzer_init failed: %s\n", ws2811_get_return_t_str(ret));
+        ws2811_fini(&leds);
+        periph_arb_close(arb);
+        periph_arb_free(arb);
+        return 1;
+    }
+
+    // Each note lasts 300 ms while a single lit LED walks along the strip
+    for (size_t n = 0; n < sizeof(melody) / sizeof(melody[0]); n++) {
+        ret = ws2811_buzzer_tone(&leds, melody[n], 255);
+        if (ret != WS2811_SUCCESS) {
+            fprintf(stderr, "ws2811_buzzer_tone %u Hz failed: %s\n", melody[n], ws2811_get_return_t_str(ret));
+            break;
+        }
+        for (int step = 0; step < 10; step++) {
+            for (int i = 0; i < led_count; i++) {
+                leds.channel[0].leds[i] = (i == step % led_count) ? 0x00200000 : 0;
+            }
+            ret = ws2811_render(&leds);
+            if (ret != WS2811_SUCCESS) {
+                fprintf(stderr, "ws2811_render failed: %s\n", ws2811_get_return_t_str(ret));
+                break;
+            }
+            usleep(30000);
+        }
+    }
+
+    (void)ws2811_buzzer_stop(&leds);
+    for (int i = 0; i < led_count; i++) {
+        leds.channel[0].leds[i] = 0;
+    }
+    (void)ws2811_render(&leds);
+    ws2811_fini(&leds);
+    periph_arb_close(arb);
+    periph_arb_free(arb);
+    return ret == WS2811_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "ws2811.h"
+#include "periph_arb.h"
+
+// Four strips refreshed as one frame: PWM0 + PWM1, PCM, SPI0 and SPI1 lanes.
+// The frame time printed should be close to the longest strip, not the sum.
+// SPI1 needs dtoverlay=spi1-1cs, PCM needs the audio overlay disabled.
+// Usage: sudo ./test_ws281x_lanes [leds_per_strip] [frames]
+
+#define LANE_COUNT      4
+
+static uint64_t now_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static void setup_lane(ws2811_t *lane, int dmanum, int gpio0, int gpio1, int count) {
+    memset(lane, 0, sizeof(*lane));
+    lane->freq = WS2811_TARGET_FREQ;
+    lane->dmanum = dmanum;
+    lane->channel[0].gpionum = gpio0;
+    lane->channel[0].count = count;
+    lane->channel[0].strip_type = WS2811_STRIP_GRB;
+    lane->channel[0].brightness = 64;
+    if (gpio1) {
+        lane->channel[1].gpionum = gpio1;
+        lane->channel[1].count = count;
+        lane->channel[1].strip_type = WS2811_STRIP_GRB;
+        lane->channel[1].brightness = 64;
+    }
+}
+
+int main(int argc, char **argv) {
+    int led_count = argc > 1 ? atoi(argv[1]) : 300;
+    int frames = argc > 2 ? atoi(argv[2]) : 300;
+
+    ws2811_t pwm_lane, pcm_lane, spi0_lane, spi1_lane;
+    ws2811_t *lanes[LANE_COUNT] = { &pwm_lane, &pcm_lane, &spi0_lane, &spi1_lane };
+    int initialized = 0;
+    int ret = 1;
+
+    setup_lane(&pwm_lane, 10, 18, 13, led_count);
+    setup_lane(&pcm_lane, 11, 21, 0, led_count);
+    setup_lane(&spi0_lane, 0, 10, 0, led_count);
+    setup_lane(&spi1_lane, 0, 20, 0, led_count);
+
+    periph_arb_t *arb = periph_arb_new();
+    if (!arb) {
+        fprintf(stderr, "Failed to allocate arbiter handle\n");
+        return 1;
+    }
+    if (periph_arb_open(arb, "ws281x lanes") < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_PWM, NULL) < 0 ||
+        periph_arb_claim_pwm_clock(arb, 3 * pwm_lane.freq) < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_PCM, NULL) < 0 ||
+        periph_arb_claim(arb, PERIPH_ARB_CM_PCM, NULL) < 0 ||
+        periph_arb_claim_dma(arb, 10, &pwm_lane.dmanum) < 0 ||
+        periph_arb_claim_dma(arb, 11, &pcm_lane.dmanum) < 0 ||
+        periph_arb_claim(arb, "spi0.0", NULL) < 0 ||
+        periph_arb_claim(arb, "spi1.0", NULL) < 0) {
+        fprintf(stderr, "%s\n", periph_arb_errmsg(arb));
+        goto out;
+    }
+
+    for (initialized = 0; initialized < LANE_COUNT; initialized++) {
+        ws2811_return_t err = ws2811_init(lanes[initialized]);
+        if (err != WS2811_SUCCESS) {
+            fprintf(stderr, "ws2811_init lane %d failed: %s\n", initialized, ws2811_get_return_t_str(err));
+            goto out;
+        }
+    }
+
+    // A dot chases along every strip, each strip with its own colour
+    static const ws2811_led_t colours[] = { 0x200000, 0x002000, 0x000020, 0x202000, 0x002020 };
+    uint64_t start = now_us();
+    for (int f = 0; f < frames; f++) {
+        int c = 0;
+        for (int l = 0; l < LANE_COUNT; l++) {
+            for (int ch = 0; ch < RPI_PWM_CHANNELS; ch++) {
+                ws2811_channel_t *channel = &lanes[l]->channel[ch];
+                for (int i = 0; i < channel->count; i++) {
+                    channel->leds[i] = (i == f % channel->count) ? colours[c] : 0;
+                }
+                if (channel->count) {
+                    c++;
+                }
+            }
+        }
+        ws2811_return_t err = ws2811_render_lanes(lanes, LANE_COUNT);
+        if (err != WS2811_SUCCESS) {
+            fprintf(stderr, "ws2811_render_lanes failed: %s\n", ws2811_get_return_t_str(err));
+            goto out;
+        }
+    }
+    (void)ws2811_wait_lanes(lanes, LANE_COUNT);
+    uint64_t elapsed = now_us() - start;
+    printf("%d frames of %d LEDs x 5 strips: %.1f fps, %.2f ms per frame\n", frames, led_count,
+           frames * 1e6 / elapsed, elapsed / 1000.0 / frames);
+    ret = 0;
+
+out:
+    for (int l = 0; l < initialized; l++) {
+        for (int ch = 0; ch < RPI_PWM_CHANNELS; ch++) {
+            ws2811_channel_t *channel = &lanes[l]->channel[ch];
+            for (int i = 0; i < channel->count; i++) {
+                channel->leds[i] = 0;
+            }
+        }
+    }
+    if (initialized == LANE_COUNT) {
+        (void)ws2811_render_lanes(lanes, LANE_COUNT);
+    }
+    for (int l = 0; l < initialized; l++) {
+        ws2811_fini(lanes[l]);
+    }
+    periph_arb_close(arb);
+    periph_arb_free(arb);
+    return ret;
+}